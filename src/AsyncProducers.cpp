@@ -0,0 +1,312 @@
+#include "AsyncProducers.h"
+#include "Debug.h"
+#include "FindCalls.h"
+#include "Function.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::string;
+
+namespace {
+
+// Does a statement contain the production of a given Func?
+class ContainsProducer : public IRVisitor {
+    const string &func;
+
+    using IRVisitor::visit;
+
+    void visit(const ProducerConsumer *op) {
+        if (op->is_producer && op->name == func) {
+            result = true;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    bool result = false;
+    ContainsProducer(const string &f) : func(f) {}
+};
+
+bool contains_producer(Stmt s, const string &func) {
+    ContainsProducer c(func);
+    s.accept(&c);
+    return c.result;
+}
+
+Expr semaphore_release(Expr sema) {
+    return Call::make(Int(32), "halide_semaphore_release", {sema, 1}, Call::Extern);
+}
+
+Stmt semaphore_acquire(Expr sema, Expr count) {
+    Expr user_context = Variable::make(type_of<void *>(), "__user_context");
+    Expr call = Call::make(Int(32), "halide_semaphore_acquire",
+                           {user_context, sema, count}, Call::Extern);
+    string result_name = unique_name("halide_semaphore_acquire_result");
+    Expr result_var = Variable::make(Int(32), result_name);
+    return LetStmt::make(result_name, call,
+                         AssertStmt::make(EQ::make(result_var, 0), result_var));
+}
+
+// If a statement acquires the semaphore that storage folding uses to
+// stop the producer of a Func from overwriting slots its consumer
+// still needs, return the call.
+const Call *folding_semaphore_acquire(const Evaluate *op, const string &func) {
+    const Call *call = op->value.as<Call>();
+    if (call && call->name == "halide_semaphore_acquire") {
+        const Variable *sema = call->args[1].as<Variable>();
+        if (sema && sema->name == func + ".folding_semaphore") {
+            return call;
+        }
+    }
+    return nullptr;
+}
+
+// Strip a loop nest down to the code that computes a Func, and
+// release a semaphore after each production of it. Productions of
+// other Funcs are kept only if the Func depends on them.
+class GenerateProducerBody : public IRMutator {
+    const string &func;
+    Expr sema;
+    const map<string, Function> &deps;
+
+    using IRMutator::visit;
+
+    void visit(const ProducerConsumer *op) {
+        if (op->name == func) {
+            if (op->is_producer) {
+                stmt = Block::make(op, Evaluate::make(semaphore_release(sema)));
+            } else {
+                stmt = Evaluate::make(0);
+            }
+        } else if (op->is_producer &&
+                   deps.count(op->name) &&
+                   !contains_producer(op, func)) {
+            stmt = op;
+        } else {
+            IRMutator::visit(op);
+            if (is_no_op(stmt.as<ProducerConsumer>()->body)) {
+                stmt = Evaluate::make(0);
+            }
+        }
+    }
+
+    void visit(const For *op) {
+        if (contains_producer(op, func)) {
+            // The semaphore counts productions, so the consumer must
+            // see them in the order they are made.
+            user_assert(!op->is_parallel())
+                << "Func " << func << " is scheduled async, but loop " << op->name
+                << " between the levels it is stored and computed at is not serial.\n";
+            user_assert(op->device_api == DeviceAPI::None ||
+                        op->device_api == DeviceAPI::Host)
+                << "Func " << func << " is scheduled async inside loop " << op->name
+                << ", which does not run on the host.\n";
+            IRMutator::visit(op);
+        } else {
+            stmt = Evaluate::make(0);
+        }
+    }
+
+    // Everything else outside of the kept productions belongs to the
+    // consumer.
+    void visit(const Provide *) {
+        stmt = Evaluate::make(0);
+    }
+
+    void visit(const Store *) {
+        stmt = Evaluate::make(0);
+    }
+
+    void visit(const Evaluate *op) {
+        // Except for waiting for the consumer to free up folded
+        // storage.
+        if (const Call *call = folding_semaphore_acquire(op, func)) {
+            stmt = semaphore_acquire(call->args[1], call->args[2]);
+        } else {
+            stmt = Evaluate::make(0);
+        }
+    }
+
+    void visit(const Realize *op) {
+        IRMutator::visit(op);
+        if (is_no_op(stmt.as<Realize>()->body)) {
+            stmt = Evaluate::make(0);
+        }
+    }
+
+public:
+    GenerateProducerBody(const string &f, Expr s, const map<string, Function> &d)
+        : func(f), sema(s), deps(d) {}
+};
+
+// Does a statement use a Func outside of its own productions?
+class UsesFunc : public IRVisitor {
+    const string &func;
+
+    using IRVisitor::visit;
+
+    void visit(const ProducerConsumer *op) {
+        if (!(op->is_producer && op->name == func)) {
+            IRVisitor::visit(op);
+        }
+    }
+
+    void visit(const Call *op) {
+        if (op->name == func) {
+            result = true;
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Variable *op) {
+        // Extern stages refer to their inputs by buffer.
+        if (op->name == func + ".buffer") {
+            result = true;
+        }
+    }
+
+public:
+    bool result = false;
+    UsesFunc(const string &f) : func(f) {}
+};
+
+bool uses_func(Stmt s, const string &func) {
+    UsesFunc u(func);
+    s.accept(&u);
+    return u.result;
+}
+
+// Remove the productions of a Func.
+class RemoveProducer : public IRMutator {
+    const string &func;
+
+    using IRMutator::visit;
+
+    void visit(const ProducerConsumer *op) {
+        if (op->is_producer && op->name == func) {
+            stmt = Evaluate::make(0);
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+public:
+    RemoveProducer(const string &f) : func(f) {}
+};
+
+// Replace each production of a Func with an acquire of the semaphore
+// the producer task releases. Only the producer waits for slots of
+// folded storage to be freed.
+class GenerateConsumerBody : public IRMutator {
+    const string &func;
+    Expr sema;
+
+    using IRMutator::visit;
+
+    void visit(const ProducerConsumer *op) {
+        if (op->name == func && op->is_producer) {
+            stmt = semaphore_acquire(sema, 1);
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+    void visit(const Evaluate *op) {
+        if (folding_semaphore_acquire(op, func)) {
+            stmt = Evaluate::make(0);
+        } else {
+            stmt = op;
+        }
+    }
+
+public:
+    GenerateConsumerBody(const string &f, Expr s) : func(f), sema(s) {}
+};
+
+// The consumer task must not compute the Funcs that only the producer
+// task uses, or they would be computed twice, and both tasks might
+// write to the same storage at once. Removing one such Func may leave
+// Funcs that only it used, so repeat until nothing changes.
+Stmt remove_producer_only_deps(Stmt s, const string &func, const map<string, Function> &deps) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto &d : deps) {
+            if (d.first != func &&
+                contains_producer(s, d.first) &&
+                !uses_func(s, d.first)) {
+                debug(3) << "Not computing " << d.first << " in the consumer of " << func << "\n";
+                s = RemoveProducer(d.first).mutate(s);
+                changed = true;
+            }
+        }
+    }
+    return s;
+}
+
+class ForkAsyncProducers : public IRMutator {
+    const map<string, Function> &env;
+
+    using IRMutator::visit;
+
+    void visit(const Realize *op) {
+        Stmt body = mutate(op->body);
+
+        auto it = env.find(op->name);
+        if (it == env.end() ||
+            !it->second.schedule().async() ||
+            !contains_producer(body, op->name)) {
+            if (body.same_as(op->body)) {
+                stmt = op;
+            } else {
+                stmt = Realize::make(op->name, op->types, op->bounds, op->condition, body);
+            }
+            return;
+        }
+
+        debug(3) << "Forking async producer " << op->name << "\n";
+
+        // Both tasks see the same storage for the Func, because it
+        // is allocated outside the fork. The semaphore is a
+        // halide_semaphore_t, allocated alongside it.
+        string sema_name = op->name + ".semaphore";
+        Expr sema = Variable::make(type_of<uint64_t *>(), sema_name);
+
+        map<string, Function> deps = find_transitive_calls(it->second);
+        Stmt producer = GenerateProducerBody(op->name, sema, deps).mutate(body);
+        Stmt consumer = GenerateConsumerBody(op->name, sema).mutate(body);
+        consumer = remove_producer_only_deps(consumer, op->name, deps);
+
+        // Fork the two tasks as the two iterations of a parallel
+        // loop. The producer is the first iteration, so it is
+        // claimed first; if the thread pool runs the tasks serially,
+        // it runs to completion before the consumer starts.
+        string fork_name = op->name + ".fork";
+        Expr task = Variable::make(Int(32), fork_name);
+        body = For::make(fork_name, 0, 2, ForType::Parallel, DeviceAPI::None,
+                         IfThenElse::make(task == 0, producer, consumer));
+
+        Expr init = Call::make(Int(32), "halide_semaphore_init", {sema, 0}, Call::Extern);
+        body = Block::make(Evaluate::make(init), body);
+        body = Allocate::make(sema_name, UInt(64), MemoryType::Auto, {2}, const_true(), body);
+
+        stmt = Realize::make(op->name, op->types, op->bounds, op->condition, body);
+    }
+
+public:
+    ForkAsyncProducers(const map<string, Function> &e) : env(e) {}
+};
+
+}  // namespace
+
+Stmt fork_async_producers(Stmt s, const map<string, Function> &env) {
+    return ForkAsyncProducers(env).mutate(s);
+}
+
+}
+}
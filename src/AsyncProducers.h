@@ -0,0 +1,32 @@
+#ifndef HALIDE_ASYNC_PRODUCERS_H
+#define HALIDE_ASYNC_PRODUCERS_H
+
+/** \file
+ * Defines the lowering pass that runs async Funcs concurrently with
+ * their consumers.
+ */
+
+#include <map>
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+class Function;
+
+/** Split the loop nest inside the realization of each Func scheduled
+ * async into a producer task and a consumer task that run
+ * concurrently. The producer task keeps only the code that computes
+ * the Func, and releases a counting semaphore after each region it
+ * produces. The consumer task replaces each production with an
+ * acquire of that semaphore. If storage folding made the producer
+ * wait for the consumer to free up slots, only the producer task
+ * keeps that wait. The two tasks are forked as the two iterations of
+ * a parallel loop. */
+Stmt fork_async_producers(Stmt s, const std::map<std::string, Function> &env);
+
+}
+}
+
+#endif
@@ -0,0 +1,803 @@
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "AutoSchedule.h"
+#include "Bounds.h"
+#include "FindCalls.h"
+#include "Func.h"
+#include "IRVisitor.h"
+#include "IROperator.h"
+#include "RealizationOrder.h"
+#include "Scope.h"
+#include "Simplify.h"
+#include "Util.h"
+
+namespace Halide {
+
+MachineParams MachineParams::generic() {
+    return MachineParams(16, 16 * 1024 * 1024, 40);
+}
+
+namespace Internal {
+
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+// A rough count of the arithmetic done by an expression, and of the
+// calls it makes to each Func and image.
+class CountOps : public IRVisitor {
+public:
+    double arith = 0;
+    map<string, double> calls;
+
+private:
+    using IRVisitor::visit;
+
+    void visit(const Cast *op) { arith++; IRVisitor::visit(op); }
+    void visit(const Add *op) { arith++; IRVisitor::visit(op); }
+    void visit(const Sub *op) { arith++; IRVisitor::visit(op); }
+    void visit(const Mul *op) { arith++; IRVisitor::visit(op); }
+    void visit(const Div *op) { arith += op->type.is_float() ? 4 : 8; IRVisitor::visit(op); }
+    void visit(const Mod *op) { arith += op->type.is_float() ? 4 : 8; IRVisitor::visit(op); }
+    void visit(const Min *op) { arith++; IRVisitor::visit(op); }
+    void visit(const Max *op) { arith++; IRVisitor::visit(op); }
+    void visit(const EQ *op) { arith++; IRVisitor::visit(op); }
+    void visit(const NE *op) { arith++; IRVisitor::visit(op); }
+    void visit(const LT *op) { arith++; IRVisitor::visit(op); }
+    void visit(const LE *op) { arith++; IRVisitor::visit(op); }
+    void visit(const GT *op) { arith++; IRVisitor::visit(op); }
+    void visit(const GE *op) { arith++; IRVisitor::visit(op); }
+    void visit(const And *op) { arith++; IRVisitor::visit(op); }
+    void visit(const Or *op) { arith++; IRVisitor::visit(op); }
+    void visit(const Not *op) { arith++; IRVisitor::visit(op); }
+    void visit(const Select *op) { arith++; IRVisitor::visit(op); }
+
+    void visit(const Call *op) {
+        if (op->call_type == Call::Halide || op->call_type == Call::Image) {
+            calls[op->name]++;
+        } else if (op->call_type == Call::Extern || op->call_type == Call::PureExtern) {
+            // Math library calls and the like.
+            arith += 10;
+        } else {
+            arith++;
+        }
+        IRVisitor::visit(op);
+    }
+};
+
+// What the cost model knows about one stage of a Func.
+struct StageInfo {
+    // Arithmetic per point computed.
+    double arith = 0;
+    // Calls made to each other Func per point computed.
+    map<string, double> calls;
+    // The number of points computed, or -1 if unknown.
+    double points = -1;
+};
+
+// What the cost model knows about a Func, and what was decided about it.
+struct FuncInfo {
+    Function func;
+    vector<StageInfo> stages;
+    // The region required to compute the outputs over their
+    // estimated extents, if known.
+    Box region;
+    // The number of points in the region, or -1 if unknown.
+    double points = -1;
+    double bytes_per_point = 0;
+    // Must this Func have storage of its own?
+    bool must_materialize = false;
+    bool inlined = false;
+    // The Func at whose tile loop this one is computed. A Func that
+    // is computed at root is its own group.
+    string group;
+    // For a group with members, the tile size of its innermost two
+    // dimensions.
+    vector<int> tile;
+    // For a group member, the region computed per tile.
+    Box tile_region;
+
+    double work() const {
+        double w = 0;
+        for (const StageInfo &s : stages) {
+            if (s.points < 0) {
+                return -1;
+            }
+            w += s.arith * s.points;
+        }
+        return w;
+    }
+};
+
+const Definition &get_stage_definition(const Function &f, int stage) {
+    return stage == 0 ? f.definition() : f.update(stage - 1);
+}
+
+int num_stages(const Function &f) {
+    return 1 + (int)f.updates().size();
+}
+
+bool get_extent(const Interval &i, int64_t &extent) {
+    const int64_t *min = as_const_int(i.min);
+    const int64_t *max = as_const_int(i.max);
+    if (!min || !max) {
+        return false;
+    }
+    extent = *max - *min + 1;
+    return true;
+}
+
+// The number of points in a box, or -1 if it isn't known.
+double box_points(const Box &b) {
+    double points = 1;
+    for (size_t i = 0; i < b.size(); i++) {
+        int64_t extent;
+        if (!get_extent(b[i], extent)) {
+            return -1;
+        }
+        points *= std::max(extent, (int64_t)0);
+    }
+    return points;
+}
+
+Box simplify_box(const Box &b) {
+    Box result(b.size());
+    for (size_t i = 0; i < b.size(); i++) {
+        result[i] = Interval(simplify(b[i].min), simplify(b[i].max));
+    }
+    return result;
+}
+
+// Starting from the regions already known, add the regions of the
+// producers required to compute them. Funcs are visited from
+// consumers to producers, so that each Func's region is complete
+// before it is used. Only Funcs for which 'expand' is true pass
+// requirements on to their producers.
+template<typename Pred>
+void propagate_regions(const vector<string> &order, const map<string, Function> &env,
+                       map<string, Box> &regions, Pred expand) {
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        auto r = regions.find(*it);
+        if (r == regions.end() || !expand(*it)) {
+            continue;
+        }
+        const Function &f = env.at(*it);
+        if (f.has_extern_definition()) {
+            // We can't see what an extern stage requires of its inputs.
+            continue;
+        }
+        const Box box = r->second;
+        internal_assert(box.size() == f.args().size());
+        for (int s = 0; s < num_stages(f); s++) {
+            const Definition &def = get_stage_definition(f, s);
+            Scope<Interval> scope;
+            for (size_t i = 0; i < f.args().size(); i++) {
+                scope.push(f.args()[i], box[i]);
+            }
+            for (const ReductionVariable &rv : def.schedule().rvars()) {
+                scope.push(rv.var, Interval(rv.min, simplify(rv.min + rv.extent - 1)));
+            }
+            vector<Expr> exprs = def.values();
+            exprs.insert(exprs.end(), def.args().begin(), def.args().end());
+            for (const Expr &e : exprs) {
+                for (const auto &req : boxes_required(e, scope)) {
+                    if (req.first == f.name() || !env.count(req.first)) {
+                        continue;
+                    }
+                    Box b = simplify_box(req.second);
+                    auto p = regions.find(req.first);
+                    if (p == regions.end()) {
+                        regions.emplace(req.first, b);
+                    } else {
+                        merge_boxes(p->second, b);
+                        p->second = simplify_box(p->second);
+                    }
+                }
+            }
+        }
+    }
+}
+
+string sanitize(const string &name) {
+    string result = name;
+    for (char &c : result) {
+        if (!isalnum(c)) {
+            c = '_';
+        }
+    }
+    return result;
+}
+
+class AutoScheduler {
+    const vector<Function> &outputs;
+    const Target &target;
+    const MachineParams &params;
+
+    map<string, Function> env;
+    vector<string> order;
+    map<string, FuncInfo> funcs;
+
+    // The Vars introduced by splits, and the scheduling source.
+    set<string> new_vars;
+    std::ostringstream source;
+
+    bool is_output(const string &name) const {
+        for (const Function &f : outputs) {
+            if (f.name() == name) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void validate() {
+        for (const auto &p : env) {
+            const Function &f = p.second;
+            user_assert(is_output(f.name()) || f.schedule().compute_level().is_inline())
+                << "Func " << f.name() << " is already scheduled. "
+                << "auto_schedule must be given Funcs without schedules.\n";
+            for (int s = 0; s < num_stages(f); s++) {
+                const Definition &def = get_stage_definition(f, s);
+                user_assert(def.schedule().splits().empty())
+                    << "Func " << f.name() << " is already scheduled. "
+                    << "auto_schedule must be given Funcs without schedules.\n";
+                user_assert(def.specializations().empty())
+                    << "auto_schedule does not support specializations, "
+                    << "which Func " << f.name() << " has.\n";
+            }
+        }
+    }
+
+    // Find the region of each Func required to compute the outputs
+    // over their estimated extents.
+    void compute_regions() {
+        map<string, Box> regions;
+        for (const Function &f : outputs) {
+            Box b;
+            for (const string &arg : f.args()) {
+                const Bound *estimate = nullptr;
+                for (const Bound &e : f.schedule().estimates()) {
+                    if (e.var == arg) {
+                        estimate = &e;
+                    }
+                }
+                user_assert(estimate)
+                    << "auto_schedule needs an estimate of the extent of dimension " << arg
+                    << " of output " << f.name() << ". Use Func::estimate to provide one.\n";
+                b.push_back(Interval(simplify(estimate->min),
+                                     simplify(estimate->min + estimate->extent - 1)));
+            }
+            regions[f.name()] = b;
+        }
+
+        propagate_regions(order, env, regions, [](const string &) { return true; });
+
+        for (auto &p : funcs) {
+            FuncInfo &info = p.second;
+            auto r = regions.find(p.first);
+            if (r != regions.end()) {
+                info.region = r->second;
+                info.points = box_points(info.region);
+            }
+            if (info.points < 0 && info.func.schedule().estimates().size() == info.func.args().size()) {
+                // Fall back to the estimates on an intermediate Func.
+                Box b(info.func.args().size());
+                for (const Bound &e : info.func.schedule().estimates()) {
+                    for (size_t i = 0; i < info.func.args().size(); i++) {
+                        if (info.func.args()[i] == e.var) {
+                            b[i] = Interval(simplify(e.min), simplify(e.min + e.extent - 1));
+                        }
+                    }
+                }
+                info.region = b;
+                info.points = box_points(b);
+            }
+        }
+    }
+
+    void analyze_stages() {
+        for (auto &p : funcs) {
+            FuncInfo &info = p.second;
+            const Function &f = info.func;
+            for (const Type &t : f.output_types()) {
+                info.bytes_per_point += t.bytes();
+            }
+            for (int s = 0; s < num_stages(f); s++) {
+                const Definition &def = get_stage_definition(f, s);
+                StageInfo stage;
+                CountOps counter;
+                for (const Expr &e : def.values()) {
+                    e.accept(&counter);
+                }
+                if (s > 0) {
+                    for (const Expr &e : def.args()) {
+                        e.accept(&counter);
+                    }
+                }
+                stage.arith = counter.arith;
+                stage.calls = counter.calls;
+                stage.calls.erase(f.name());
+
+                if (s == 0) {
+                    stage.points = info.points;
+                } else if (info.points >= 0) {
+                    // An update computes over the pure variables it
+                    // uses and its reduction domain.
+                    stage.points = 1;
+                    for (size_t i = 0; i < def.args().size() && i < f.args().size(); i++) {
+                        const Variable *v = def.args()[i].as<Variable>();
+                        int64_t extent;
+                        if (v && v->name == f.args()[i] && get_extent(info.region[i], extent)) {
+                            stage.points *= extent;
+                        }
+                    }
+                    for (const ReductionVariable &rv : def.schedule().rvars()) {
+                        const int64_t *extent = as_const_int(simplify(rv.extent));
+                        if (!extent) {
+                            stage.points = -1;
+                            break;
+                        }
+                        stage.points *= *extent;
+                    }
+                }
+                info.stages.push_back(stage);
+            }
+
+            info.must_materialize = (is_output(f.name()) ||
+                                     !f.can_be_inlined() ||
+                                     f.has_update_definition() ||
+                                     f.has_extern_definition());
+            if (f.has_extern_definition()) {
+                // Extern stages take their inputs as buffers.
+                for (const ExternFuncArgument &arg : f.extern_arguments()) {
+                    if (arg.is_func()) {
+                        string name = Function(arg.func).name();
+                        if (funcs.count(name)) {
+                            funcs[name].must_materialize = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // The number of loads of f by its consumers, if it's stored, or
+    // -1 if unknown. Also counts the call sites.
+    double loads_of(const string &f, double *call_sites = nullptr) {
+        double loads = 0, sites = 0;
+        for (auto &p : funcs) {
+            if (p.second.inlined) {
+                continue;
+            }
+            for (const StageInfo &s : p.second.stages) {
+                auto c = s.calls.find(f);
+                if (c == s.calls.end()) {
+                    continue;
+                }
+                sites += c->second;
+                if (loads >= 0 && s.points >= 0) {
+                    loads += c->second * s.points;
+                } else {
+                    loads = -1;
+                }
+            }
+        }
+        if (call_sites) {
+            *call_sites = sites;
+        }
+        return loads;
+    }
+
+    // Inline a Func wherever recomputing it costs less than storing
+    // and loading it. Producers are considered first, so the cost of
+    // a Func includes that of anything inlined into it.
+    void decide_inlining() {
+        for (const string &name : order) {
+            FuncInfo &info = funcs[name];
+            if (info.must_materialize) {
+                continue;
+            }
+            double call_sites = 0;
+            double loads = loads_of(name, &call_sites);
+            double arith = info.stages[0].arith;
+            bool inline_it;
+            if (loads >= 0 && info.points >= 0) {
+                double extra_arith = (loads - info.points) * arith;
+                inline_it = extra_arith <= loads + info.points;
+            } else {
+                inline_it = call_sites <= 1;
+            }
+            if (!inline_it) {
+                continue;
+            }
+
+            debug(2) << "auto_schedule: inlining " << name << "\n";
+            info.inlined = true;
+            for (auto &p : funcs) {
+                for (StageInfo &s : p.second.stages) {
+                    auto c = s.calls.find(name);
+                    if (c == s.calls.end()) {
+                        continue;
+                    }
+                    double k = c->second;
+                    s.calls.erase(c);
+                    s.arith += k * arith;
+                    for (const auto &producer : info.stages[0].calls) {
+                        s.calls[producer.first] += k * producer.second;
+                    }
+                }
+            }
+        }
+    }
+
+    bool can_be_group_root(const FuncInfo &info) {
+        return (info.points > 0 &&
+                !info.func.args().empty() &&
+                !info.func.has_update_definition() &&
+                !info.func.has_extern_definition());
+    }
+
+    // Tentatively put each Func whose consumers are all in one group
+    // into that group. Consumers are considered first.
+    void decide_groups() {
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            FuncInfo &info = funcs[*it];
+            if (info.inlined) {
+                continue;
+            }
+            info.group = *it;
+            if (info.must_materialize || info.points <= 0) {
+                continue;
+            }
+            set<string> consumer_groups;
+            for (auto &p : funcs) {
+                if (p.second.inlined) {
+                    continue;
+                }
+                for (const StageInfo &s : p.second.stages) {
+                    if (s.calls.count(*it)) {
+                        consumer_groups.insert(p.second.group);
+                    }
+                }
+            }
+            if (consumer_groups.size() == 1 &&
+                can_be_group_root(funcs[*consumer_groups.begin()])) {
+                info.group = *consumer_groups.begin();
+            }
+        }
+    }
+
+    vector<string> members_of(const string &root) {
+        vector<string> members;
+        for (const string &name : order) {
+            const FuncInfo &info = funcs[name];
+            if (!info.inlined && name != root && info.group == root) {
+                members.push_back(name);
+            }
+        }
+        return members;
+    }
+
+    // The estimated cost of computing a group with the given tile
+    // size, or -1 if it can't be estimated. Fills in the region of
+    // each member computed per tile.
+    double group_cost(const string &root, const vector<string> &members,
+                      const vector<int> &tile, map<string, Box> &tile_regions) {
+        const FuncInfo &r = funcs[root];
+        const vector<string> &args = r.func.args();
+
+        Box tile_box(args.size());
+        double tiles = 1, parallel_tiles = 1;
+        for (size_t i = 0; i < args.size(); i++) {
+            int64_t extent;
+            if (!get_extent(r.region[i], extent)) {
+                return -1;
+            }
+            if (i < tile.size()) {
+                tile_box[i] = Interval(r.region[i].min, simplify(r.region[i].min + tile[i] - 1));
+                tiles *= (extent + tile[i] - 1) / tile[i];
+                parallel_tiles = (extent + tile[i] - 1) / tile[i];
+            } else {
+                tile_box[i] = Interval(r.region[i].min, r.region[i].min);
+                tiles *= extent;
+                parallel_tiles = extent;
+            }
+        }
+
+        tile_regions.clear();
+        tile_regions[root] = tile_box;
+        set<string> expand(members.begin(), members.end());
+        expand.insert(root);
+        propagate_regions(order, env, tile_regions, [&](const string &name) {
+            return expand.count(name) || funcs[name].inlined;
+        });
+
+        double footprint = box_points(tile_box) * r.bytes_per_point;
+        double work = r.work(), redundant = 0, loads = 0;
+        for (const string &m : members) {
+            const FuncInfo &info = funcs[m];
+            double per_tile = box_points(tile_regions[m]);
+            double m_loads = loads_of(m);
+            if (per_tile < 0 || m_loads < 0 || info.work() < 0) {
+                return -1;
+            }
+            double arith = info.work() / info.points;
+            redundant += std::max(0.0, tiles * per_tile - info.points) * arith;
+            footprint += per_tile * info.bytes_per_point;
+            work += tiles * per_tile * arith;
+            loads += m_loads + info.points;
+        }
+
+        // Loads are cheap if each core's tile fits in its share of the cache.
+        double cache = (double)params.last_level_cache_size / params.parallelism;
+        double cost = redundant + loads * (footprint <= cache ? 1 : params.balance);
+        if (parallel_tiles < params.parallelism) {
+            // Cores left idle.
+            cost += work * (1 - parallel_tiles / params.parallelism);
+        }
+        // Per-tile overhead, which also breaks ties in favor of
+        // larger tiles.
+        cost += tiles * (members.size() + 1) * 10;
+        return cost;
+    }
+
+    // The estimated cost of computing the members of a group at
+    // root. Their loads are served by the last level cache at best.
+    double unfused_cost(const vector<string> &members) {
+        double cost = 0;
+        for (const string &m : members) {
+            const FuncInfo &info = funcs[m];
+            double loads = loads_of(m);
+            if (loads < 0) {
+                return -1;
+            }
+            bool fits = info.points * info.bytes_per_point <= params.last_level_cache_size;
+            cost += (loads + info.points) * params.balance * (fits ? 1 : 2);
+        }
+        return cost;
+    }
+
+    // Pick tile sizes for each group, and break up any group that is
+    // better off computed at root.
+    void decide_tiling() {
+        for (const string &root : order) {
+            FuncInfo &r = funcs[root];
+            if (r.inlined || r.group != root) {
+                continue;
+            }
+            vector<string> members = members_of(root);
+            if (members.empty()) {
+                continue;
+            }
+
+            const int sizes[] = {8, 16, 32, 64, 128, 256};
+            vector<vector<int>> candidates;
+            int64_t e0 = 1, e1 = 1;
+            get_extent(r.region[0], e0);
+            if (r.region.size() > 1) {
+                get_extent(r.region[1], e1);
+            }
+            vector<int> s0, s1;
+            for (int s : sizes) {
+                if (s < e0) s0.push_back(s);
+                if (s < e1) s1.push_back(s);
+            }
+            s0.push_back((int)e0);
+            s1.push_back((int)e1);
+            for (int t0 : s0) {
+                if (r.region.size() > 1) {
+                    for (int t1 : s1) {
+                        candidates.push_back({t0, t1});
+                    }
+                } else {
+                    candidates.push_back({t0});
+                }
+            }
+
+            double best_cost = -1;
+            vector<int> best_tile;
+            map<string, Box> best_regions, regions;
+            for (const vector<int> &tile : candidates) {
+                double cost = group_cost(root, members, tile, regions);
+                if (cost >= 0 && (best_cost < 0 || cost < best_cost)) {
+                    best_cost = cost;
+                    best_tile = tile;
+                    best_regions = regions;
+                }
+            }
+
+            double root_cost = unfused_cost(members);
+            debug(2) << "auto_schedule: group " << root << " costs " << best_cost
+                     << " fused and " << root_cost << " unfused\n";
+            if (best_cost < 0 || (root_cost >= 0 && root_cost <= best_cost)) {
+                for (const string &m : members) {
+                    funcs[m].group = m;
+                }
+                continue;
+            }
+            r.tile = best_tile;
+            for (const string &m : members) {
+                funcs[m].tile_region = best_regions[m];
+            }
+        }
+    }
+
+    int vector_size(const Function &f) {
+        return target.natural_vector_size(f.output_types()[0]);
+    }
+
+    string new_var(const string &name) {
+        string v = name + "_i";
+        new_vars.insert(v);
+        return v;
+    }
+
+    // Apply schedules to the pure vars of an update stage: vectorize
+    // the innermost and parallelize the outermost, if the stage
+    // iterates over them.
+    void schedule_update(const FuncInfo &info, int idx) {
+        const Function &f = info.func;
+        const Definition &def = f.update(idx);
+        auto is_pure = [&](size_t i) {
+            const Variable *v = def.args()[i].as<Variable>();
+            return v && v->name == f.args()[i];
+        };
+        Func fn(f);
+        std::ostringstream directives;
+        size_t dims = f.args().size();
+        int vec = vector_size(f);
+        int64_t extent;
+        if (dims > 0 && is_pure(0) && get_extent(info.region[0], extent) && extent >= vec) {
+            fn.update(idx).vectorize(Var(f.args()[0]), vec);
+            directives << "\n    .vectorize(" << sanitize(f.args()[0]) << ", " << vec << ")";
+        }
+        if (dims > 1 && is_pure(dims - 1)) {
+            fn.update(idx).parallel(Var(f.args()[dims - 1]));
+            directives << "\n    .parallel(" << sanitize(f.args()[dims - 1]) << ")";
+        }
+        if (!directives.str().empty()) {
+            source << sanitize(f.name()) << ".update(" << idx << ")" << directives.str() << ";\n";
+        }
+    }
+
+    void apply(const string &name) {
+        FuncInfo &info = funcs[name];
+        const Function &f = info.func;
+        const vector<string> &args = f.args();
+        Func fn(f);
+        std::ostringstream directives;
+        int vec = vector_size(f);
+
+        if (f.has_extern_definition() || args.empty()) {
+            if (!is_output(name)) {
+                fn.compute_root();
+                source << sanitize(name) << ".compute_root();\n";
+            }
+            return;
+        }
+
+        if (info.group != name) {
+            // A member of a group, computed per tile.
+            const FuncInfo &root = funcs[info.group];
+            fn.compute_at(Func(root.func), Var(root.func.args()[0]));
+            directives << "\n    .compute_at(" << sanitize(info.group) << ", "
+                       << sanitize(root.func.args()[0]) << ")";
+            int64_t extent;
+            if (get_extent(info.tile_region[0], extent) && extent >= vec) {
+                fn.vectorize(Var(args[0]), vec);
+                directives << "\n    .vectorize(" << sanitize(args[0]) << ", " << vec << ")";
+            }
+        } else {
+            if (!is_output(name)) {
+                fn.compute_root();
+                directives << "\n    .compute_root()";
+            }
+
+            string parallel_var = args.back();
+            int64_t inner_extent = 0;
+            if (!info.tile.empty()) {
+                // Tile the innermost dimensions, keeping the names of
+                // the original Vars for the tile loops.
+                string xi = new_var(args[0]);
+                if (info.tile.size() > 1) {
+                    string yi = new_var(args[1]);
+                    fn.tile(Var(args[0]), Var(args[1]), Var(args[0]), Var(args[1]),
+                            Var(xi), Var(yi), info.tile[0], info.tile[1]);
+                    directives << "\n    .tile(" << sanitize(args[0]) << ", " << sanitize(args[1]) << ", "
+                               << sanitize(args[0]) << ", " << sanitize(args[1]) << ", "
+                               << sanitize(xi) << ", " << sanitize(yi) << ", "
+                               << info.tile[0] << ", " << info.tile[1] << ")";
+                } else {
+                    fn.split(Var(args[0]), Var(args[0]), Var(xi), info.tile[0]);
+                    directives << "\n    .split(" << sanitize(args[0]) << ", " << sanitize(args[0]) << ", "
+                               << sanitize(xi) << ", " << info.tile[0] << ")";
+                }
+                inner_extent = info.tile[0];
+                if (inner_extent >= vec) {
+                    fn.vectorize(Var(xi), vec);
+                    directives << "\n    .vectorize(" << sanitize(xi) << ", " << vec << ")";
+                }
+            } else if (get_extent(info.region[0], inner_extent) && inner_extent >= vec) {
+                fn.vectorize(Var(args[0]), vec);
+                directives << "\n    .vectorize(" << sanitize(args[0]) << ", " << vec << ")";
+            }
+            if (args.size() > 1 || !info.tile.empty()) {
+                fn.parallel(Var(parallel_var));
+                directives << "\n    .parallel(" << sanitize(parallel_var) << ")";
+            }
+        }
+
+        if (!directives.str().empty()) {
+            source << sanitize(name) << directives.str() << ";\n";
+        }
+        if (info.group == name) {
+            for (int i = 0; i < (int)f.updates().size(); i++) {
+                schedule_update(info, i);
+            }
+        }
+    }
+
+public:
+    AutoScheduler(const vector<Function> &outputs, const Target &target, const MachineParams &params)
+        : outputs(outputs), target(target), params(params) {}
+
+    string run() {
+        for (const Function &f : outputs) {
+            map<string, Function> more_funcs = find_transitive_calls(f);
+            env.insert(more_funcs.begin(), more_funcs.end());
+        }
+        order = realization_order(outputs, env);
+        validate();
+
+        for (const auto &p : env) {
+            funcs[p.first].func = p.second;
+        }
+        compute_regions();
+        analyze_stages();
+        decide_inlining();
+        decide_groups();
+        decide_tiling();
+
+        for (const string &name : order) {
+            if (!funcs[name].inlined) {
+                apply(name);
+            }
+        }
+
+        std::ostringstream result;
+        result << "// Schedule generated by auto_schedule for " << target.to_string() << "\n"
+               << "// Funcs and Vars are referred to by their names.\n";
+        if (!new_vars.empty()) {
+            result << "Var ";
+            for (auto it = new_vars.begin(); it != new_vars.end(); ++it) {
+                if (it != new_vars.begin()) {
+                    result << ", ";
+                }
+                result << sanitize(*it) << "(\"" << *it << "\")";
+            }
+            result << ";\n";
+        }
+        result << source.str();
+        return result.str();
+    }
+};
+
+}  // namespace
+
+string generate_schedules(const vector<Function> &outputs,
+                          const Target &target,
+                          const MachineParams &arch_params) {
+    string schedule = AutoScheduler(outputs, target, arch_params).run();
+    debug(1) << "auto_schedule:\n" << schedule;
+    return schedule;
+}
+
+}
+}
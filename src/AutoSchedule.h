@@ -0,0 +1,50 @@
+#ifndef HALIDE_INTERNAL_AUTO_SCHEDULE_H
+#define HALIDE_INTERNAL_AUTO_SCHEDULE_H
+
+/** \file
+ *
+ * Defines the method that does automatic scheduling of Funcs within a pipeline.
+ */
+
+#include <string>
+#include <vector>
+
+#include "Function.h"
+#include "Target.h"
+
+namespace Halide {
+
+/** A struct representing the machine parameters to generate the auto-scheduled
+ * code for. */
+struct MachineParams {
+    /** Maximum level of parallelism avalaible. */
+    int parallelism;
+    /** Size of the last-level cache (in bytes). */
+    uint64_t last_level_cache_size;
+    /** Indicates how much more expensive is the cost of a load compared to
+     * the cost of an arithmetic operation at last level cache. */
+    float balance;
+
+    MachineParams(int parallelism, uint64_t llc, float balance)
+        : parallelism(parallelism), last_level_cache_size(llc), balance(balance) {}
+
+    /** Default machine parameters for generic CPU architecture. */
+    EXPORT static MachineParams generic();
+};
+
+namespace Internal {
+
+/** Generate schedules for Funcs within a pipeline. The Funcs should
+ * not already have schedules or specializations, as the
+ * auto-scheduler does not take them into account. Every dimension of
+ * each output must have an estimate (see \ref Func::estimate). This
+ * applies the schedules and returns the equivalent C++ scheduling
+ * source. */
+EXPORT std::string generate_schedules(const std::vector<Function> &outputs,
+                                      const Target &target,
+                                      const MachineParams &arch_params);
+
+}
+}
+
+#endif
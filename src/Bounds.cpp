@@ -1,4 +1,5 @@
 #include <iostream>
+#include <unordered_map>
 
 #include "Bounds.h"
 #include "IRVisitor.h"
@@ -55,6 +56,21 @@ Expr find_constant_bound(Expr e, Direction d, const Scope<Interval> &scope) {
 }
 
 
+/** The intervals found for subexpressions, keyed by their
+ * identity. An interval is only valid in the scope it was found in,
+ * so the owner of the cache must clear it whenever that scope
+ * changes. The Exprs are kept alive so that their addresses can't be
+ * reused. */
+struct BoundsCache {
+    // Indexed by whether the bounds were constant bounds.
+    std::unordered_map<const IRNode *, pair<Expr, Interval>> intervals[2];
+
+    void clear() {
+        intervals[0].clear();
+        intervals[1].clear();
+    }
+};
+
 class Bounds : public IRVisitor {
 public:
     Interval interval;
@@ -65,12 +81,41 @@ public:
     // unbounded.
     bool const_bound;
 
-    Bounds(const Scope<Interval> *s, const FuncValueBounds &fb, bool const_bound) :
-        func_bounds(fb), const_bound(const_bound) {
+    Bounds(const Scope<Interval> *s, const FuncValueBounds &fb, bool const_bound,
+           BoundsCache *c = nullptr) :
+        func_bounds(fb), const_bound(const_bound), cache(c ? c : &local_cache) {
         scope.set_containing_scope(s);
     }
 private:
 
+    BoundsCache local_cache;
+    BoundsCache *cache;
+
+    // Find the bounds of a subexpression. Inlining makes Exprs that
+    // share many subexpressions, so the bounds of each one are only
+    // found once.
+    void include(const Expr &e) {
+        switch (e.get()->node_type) {
+        case IRNodeType::IntImm:
+        case IRNodeType::UIntImm:
+        case IRNodeType::FloatImm:
+        case IRNodeType::Variable:
+            // Cheaper to visit than to look up.
+            e.accept(this);
+            return;
+        default:
+            break;
+        }
+        auto &intervals = cache->intervals[const_bound ? 1 : 0];
+        auto it = intervals.find(e.get());
+        if (it != intervals.end()) {
+            interval = it->second.second;
+            return;
+        }
+        e.accept(this);
+        intervals.emplace(e.get(), std::make_pair(e, interval));
+    }
+
     // Compute the intrinsic bounds of a function.
     void bounds_of_func(string name, int value_index, Type t) {
         // if we can't get a good bound from the function, fall back to the bounds of the type.
@@ -114,7 +159,7 @@ private:
     }
 
     void visit(const Cast *op) {
-        op->value.accept(this);
+        include(op->value);
         Interval a = interval;
 
         if (a.is_single_point(op->value)) {
@@ -227,9 +272,9 @@ private:
     }
 
     void visit(const Add *op) {
-        op->a.accept(this);
+        include(op->a);
         Interval a = interval;
-        op->b.accept(this);
+        include(op->b);
         Interval b = interval;
 
         if (a.is_single_point(op->a) && b.is_single_point(op->b)) {
@@ -266,9 +311,9 @@ private:
     }
 
     void visit(const Sub *op) {
-        op->a.accept(this);
+        include(op->a);
         Interval a = interval;
-        op->b.accept(this);
+        include(op->b);
         Interval b = interval;
 
         if (a.is_single_point(op->a) && b.is_single_point(op->b)) {
@@ -312,10 +357,10 @@ private:
     }
 
     void visit(const Mul *op) {
-        op->a.accept(this);
+        include(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        include(op->b);
         Interval b = interval;
 
         // Move constants to the right
@@ -377,10 +422,10 @@ private:
     }
 
     void visit(const Div *op) {
-        op->a.accept(this);
+        include(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        include(op->b);
         Interval b = interval;
 
         if (!b.is_bounded()) {
@@ -430,10 +475,10 @@ private:
     }
 
     void visit(const Mod *op) {
-        op->a.accept(this);
+        include(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        include(op->b);
         if (!interval.is_bounded()) {
             return;
         }
@@ -469,10 +514,10 @@ private:
     }
 
     void visit(const Min *op) {
-        op->a.accept(this);
+        include(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        include(op->b);
         Interval b = interval;
 
         if (a.is_single_point(op->a) && b.is_single_point(op->b)) {
@@ -485,10 +530,10 @@ private:
 
 
     void visit(const Max *op) {
-        op->a.accept(this);
+        include(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        include(op->b);
         Interval b = interval;
 
         if (a.is_single_point(op->a) && b.is_single_point(op->b)) {
@@ -561,19 +606,19 @@ private:
     }
 
     void visit(const Select *op) {
-        op->true_value.accept(this);
+        include(op->true_value);
         if (!interval.is_bounded()) {
             return;
         }
         Interval a = interval;
 
-        op->false_value.accept(this);
+        include(op->false_value);
         if (!interval.is_bounded()) {
             return;
         }
         Interval b = interval;
 
-        op->condition.accept(this);
+        include(op->condition);
         Interval cond = interval;
 
         if (cond.is_single_point()) {
@@ -608,7 +653,7 @@ private:
     }
 
     void visit(const Load *op) {
-        op->index.accept(this);
+        include(op->index);
         if (!const_bound && interval.is_single_point() && is_one(op->predicate)) {
             // If the index is const and it is not a predicated load,
             // we can return the load of that index
@@ -634,7 +679,7 @@ private:
     }
 
     void visit(const Broadcast *op) {
-        op->value.accept(this);
+        include(op->value);
     }
 
     void visit(const Call *op) {
@@ -646,7 +691,7 @@ private:
         std::vector<Expr> new_args(op->args.size());
         bool const_args = true;
         for (size_t i = 0; i < op->args.size() && const_args; i++) {
-            op->args[i].accept(this);
+            include(op->args[i]);
             if (interval.is_single_point()) {
                 new_args[i] = interval.min;
             } else {
@@ -687,10 +732,10 @@ private:
         } else if (op->is_intrinsic(Call::likely) ||
                    op->is_intrinsic(Call::likely_if_innermost)) {
             assert(op->args.size() == 1);
-            op->args[0].accept(this);
+            include(op->args[0]);
         } else if (op->is_intrinsic(Call::return_second)) {
             assert(op->args.size() == 2);
-            op->args[1].accept(this);
+            include(op->args[1]);
         } else if (op->is_intrinsic(Call::if_then_else)) {
             assert(op->args.size() == 3);
             // Probably more conservative than necessary
@@ -734,7 +779,7 @@ private:
                                 Call::make(Int(32), Call::buffer_get_max, op->args, Call::Extern));
         } else if (op->is_intrinsic(Call::memoize_expr)) {
             internal_assert(op->args.size() >= 1);
-            op->args[0].accept(this);
+            include(op->args[0]);
         } else if (op->call_type == Call::Halide) {
             bounds_of_func(op->name, op->value_index, op->type);
         } else {
@@ -744,7 +789,7 @@ private:
     }
 
     void visit(const Let *op) {
-        op->value.accept(this);
+        include(op->value);
         Interval val = interval;
 
         // We'll either substitute the values in directly, or pass
@@ -774,9 +819,15 @@ private:
             }
         }
 
+        // The body may refer to the new variable, so it gets a cache
+        // of its own.
+        BoundsCache *outer_cache = cache;
+        BoundsCache body_cache;
+        cache = &body_cache;
         scope.push(op->name, var);
         op->body.accept(this);
         scope.pop(op->name);
+        cache = outer_cache;
 
         if (interval.has_lower_bound()) {
             if (val.min.defined() && expr_uses_var(interval.min, min_name)) {
@@ -800,7 +851,7 @@ private:
     void visit(const Shuffle *op) {
         Interval result = Interval::nothing();
         for (Expr i : op->vectors) {
-            i.accept(this);
+            include(i);
             result.include(interval);
         }
         interval = result;
@@ -843,9 +894,12 @@ private:
     }
 };
 
-Interval bounds_of_expr_in_scope(Expr expr, const Scope<Interval> &scope, const FuncValueBounds &fb, bool const_bound) {
+namespace {
+
+Interval bounds_of_expr_in_scope(Expr expr, const Scope<Interval> &scope, const FuncValueBounds &fb,
+                                 bool const_bound, BoundsCache *cache) {
     //debug(3) << "computing bounds_of_expr_in_scope " << expr << "\n";
-    Bounds b(&scope, fb, const_bound);
+    Bounds b(&scope, fb, const_bound, cache);
     expr.accept(&b);
     //debug(3) << "bounds_of_expr_in_scope " << expr << " = " << simplify(b.interval.min) << ", " << simplify(b.interval.max) << "\n";
     if (b.interval.has_lower_bound()) {
@@ -861,6 +915,12 @@ Interval bounds_of_expr_in_scope(Expr expr, const Scope<Interval> &scope, const
     return b.interval;
 }
 
+} // namespace
+
+Interval bounds_of_expr_in_scope(Expr expr, const Scope<Interval> &scope, const FuncValueBounds &fb, bool const_bound) {
+    return bounds_of_expr_in_scope(expr, scope, fb, const_bound, nullptr);
+}
+
 Region region_union(const Region &a, const Region &b) {
     internal_assert(a.size() == b.size()) << "Mismatched dimensionality in region union\n";
     Region result;
@@ -1056,6 +1116,26 @@ private:
     Scope<Interval> scope;
     const FuncValueBounds &func_bounds;
 
+    // The intervals of the Exprs found so far in the current
+    // scope. The Exprs made by inlining share many subexpressions,
+    // and this saves finding the bounds of those again for every
+    // call.
+    BoundsCache bounds_cache;
+
+    Interval bounds_of(const Expr &e) {
+        return bounds_of_expr_in_scope(e, scope, func_bounds, false, &bounds_cache);
+    }
+
+    void push_scope(const string &name, const Interval &i) {
+        scope.push(name, i);
+        bounds_cache.clear();
+    }
+
+    void pop_scope(const string &name) {
+        scope.pop(name);
+        bounds_cache.clear();
+    }
+
     using IRGraphVisitor::visit;
 
     void visit(const Call *op) {
@@ -1083,7 +1163,7 @@ private:
                 Box b(op->args.size());
                 b.used = const_true();
                 for (size_t i = 0; i < op->args.size(); i++) {
-                    b[i] = bounds_of_expr_in_scope(op->args[i], scope, func_bounds);
+                    b[i] = bounds_of(op->args[i]);
                 }
                 merge_boxes(boxes[op->name], b);
             }
@@ -1117,7 +1197,7 @@ private:
         if (consider_calls) {
             op->value.accept(this);
         }
-        Interval value_bounds = bounds_of_expr_in_scope(op->value, scope, func_bounds);
+        Interval value_bounds = bounds_of(op->value);
 
         bool fixed = value_bounds.min.same_as(value_bounds.max);
         value_bounds.min = simplify(value_bounds.min);
@@ -1125,17 +1205,17 @@ private:
 
         if (is_small_enough_to_substitute(value_bounds.min) &&
             (fixed || is_small_enough_to_substitute(value_bounds.max))) {
-            scope.push(op->name, value_bounds);
+            push_scope(op->name, value_bounds);
             op->body.accept(this);
-            scope.pop(op->name);
+            pop_scope(op->name);
         } else {
             string max_name = unique_name('t');
             string min_name = unique_name('t');
 
-            scope.push(op->name, Interval(Variable::make(op->value.type(), min_name),
+            push_scope(op->name, Interval(Variable::make(op->value.type(), min_name),
                                           Variable::make(op->value.type(), max_name)));
             op->body.accept(this);
-            scope.pop(op->name);
+            pop_scope(op->name);
 
             for (pair<const string, Box> &i : boxes) {
                 Box &box = i.second;
@@ -1216,7 +1296,7 @@ private:
                             likely_i.max = likely_if_innermost(i.max);
                         }
 
-                        Interval bi = bounds_of_expr_in_scope(b, scope, func_bounds);
+                        Interval bi = bounds_of(b);
                         if (bi.has_upper_bound()) {
                             if (lt) {
                                 i.max = min(likely_i.max, bi.max - 1);
@@ -1233,7 +1313,7 @@ private:
                                 i.min = max(likely_i.min, bi.min);
                             }
                         }
-                        scope.push(var_a->name, i);
+                        push_scope(var_a->name, i);
                         var_to_pop = var_a->name;
                     } else if (var_b && scope.contains(var_b->name)) {
                         Interval i = scope.get(var_b->name);
@@ -1247,7 +1327,7 @@ private:
                             likely_i.max = likely_if_innermost(i.max);
                         }
 
-                        Interval ai = bounds_of_expr_in_scope(a, scope, func_bounds);
+                        Interval ai = bounds_of(a);
                         if (ai.has_upper_bound()) {
                             if (gt) {
                                 i.max = min(likely_i.max, ai.max - 1);
@@ -1264,13 +1344,13 @@ private:
                                 i.min = max(likely_i.min, ai.min);
                             }
                         }
-                        scope.push(var_b->name, i);
+                        push_scope(var_b->name, i);
                         var_to_pop = var_b->name;
                     }
                 }
                 op->then_case.accept(this);
                 if (!var_to_pop.empty()) {
-                    scope.pop(var_to_pop);
+                    pop_scope(var_to_pop);
                 }
             } else {
                 // Just take the union over the branches
@@ -1334,20 +1414,20 @@ private:
         if (scope.contains(op->name + ".loop_min")) {
             min_val = scope.get(op->name + ".loop_min").min;
         } else {
-            min_val = bounds_of_expr_in_scope(op->min, scope, func_bounds).min;
+            min_val = bounds_of(op->min).min;
         }
 
         if (scope.contains(op->name + ".loop_max")) {
             max_val = scope.get(op->name + ".loop_max").max;
         } else {
-            max_val = bounds_of_expr_in_scope(op->extent, scope, func_bounds).max;
-            max_val += bounds_of_expr_in_scope(op->min, scope, func_bounds).max;
+            max_val = bounds_of(op->extent).max;
+            max_val += bounds_of(op->min).max;
             max_val -= 1;
         }
 
-        scope.push(op->name, Interval(min_val, max_val));
+        push_scope(op->name, Interval(min_val, max_val));
         op->body.accept(this);
-        scope.pop(op->name);
+        pop_scope(op->name);
     }
 
     void visit(const Provide *op) {
@@ -1355,7 +1435,7 @@ private:
             if (op->name == func || func.empty()) {
                 Box b(op->args.size());
                 for (size_t i = 0; i < op->args.size(); i++) {
-                    b[i] = bounds_of_expr_in_scope(op->args[i], scope, func_bounds);
+                    b[i] = bounds_of(op->args[i]);
                 }
                 merge_boxes(boxes[op->name], b);
             }
@@ -1734,6 +1814,22 @@ void bounds_test() {
     internal_assert(equal(simplify(r2[0].min), 4));
     internal_assert(equal(simplify(r2[0].max), 19));
 
+    {
+        // Something that will hang if shared subexpressions are
+        // bounded once per use.
+        Expr e = y;
+        for (int i = 0; i < 100; i++) {
+            e = e + e;
+        }
+        Interval i = bounds_of_expr_in_scope(e, scope);
+        internal_assert(i.is_single_point(e));
+        e = x;
+        for (int i = 0; i < 10; i++) {
+            e = e + e;
+        }
+        check(scope, e, 0, 10240);
+    }
+
     std::cout << "Bounds test passed" << std::endl;
 }
 
@@ -979,9 +979,28 @@ public:
     }
 
     void visit(const ProducerConsumer *p) {
-        in_pipeline.insert(p->name);
+        // The production of a Func also produces the Funcs computed
+        // with it (see Func::compute_with), whose bounds are defined
+        // alongside its own.
+        vector<string> names;
+        if (!in_pipeline.count(p->name)) {
+            names.push_back(p->name);
+        }
+        if (p->is_producer) {
+            for (const Function &f : funcs) {
+                if (f.schedule().fuse_level().func == p->name &&
+                    !in_pipeline.count(f.name())) {
+                    names.push_back(f.name());
+                }
+            }
+        }
+        for (const string &n : names) {
+            in_pipeline.insert(n);
+        }
         IRMutator::visit(p);
-        in_pipeline.erase(p->name);
+        for (const string &n : names) {
+            in_pipeline.erase(n);
+        }
         inner_productions.insert(p->name);
     }
 
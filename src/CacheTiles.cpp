@@ -0,0 +1,182 @@
+#include "CacheTiles.h"
+#include "Bounds.h"
+#include "Debug.h"
+#include "IROperator.h"
+#include "IRVisitor.h"
+#include "Scope.h"
+#include "Simplify.h"
+#include "Substitute.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The size in bytes of one element of each Func or image called.
+class ElementSizes : public IRVisitor {
+    const map<string, Function> &env;
+
+    using IRVisitor::visit;
+
+    void visit(const Call *op) {
+        IRVisitor::visit(op);
+        if (op->call_type != Call::Halide && op->call_type != Call::Image) {
+            return;
+        }
+        int64_t bytes = op->type.bytes();
+        auto it = env.find(op->name);
+        if (op->call_type == Call::Halide && it != env.end()) {
+            // A tuple-valued Func stores all of its values.
+            bytes = 0;
+            for (Type t : it->second.output_types()) {
+                bytes += t.bytes();
+            }
+        }
+        sizes[op->name] = std::max(sizes[op->name], bytes);
+    }
+
+public:
+    map<string, int64_t> sizes;
+    ElementSizes(const map<string, Function> &e) : env(e) {}
+};
+
+// The number of elements in a box, counting the dimensions with
+// bounds that are not constant as one element wide.
+int64_t box_elements(const Box &b) {
+    int64_t elements = 1;
+    for (const Interval &i : b.bounds) {
+        if (!i.is_bounded()) {
+            continue;
+        }
+        const int64_t *extent = as_const_int(simplify(i.max - i.min + 1));
+        if (extent && *extent > 0) {
+            elements *= *extent;
+        }
+    }
+    return elements;
+}
+
+class CacheTileSizer {
+    const Function &func;
+    const Definition &def;
+    const map<string, Function> &env;
+    const CacheTile &tile;
+    map<string, int64_t> sizes;
+    int64_t output_bytes = 0;
+
+public:
+    CacheTileSizer(const Function &f, const Definition &d,
+                   const map<string, Function> &e, const CacheTile &t)
+        : func(f), def(d), env(e), tile(t) {
+        ElementSizes element_sizes(env);
+        for (Expr v : def.values()) {
+            v.accept(&element_sizes);
+        }
+        for (Expr a : def.args()) {
+            a.accept(&element_sizes);
+        }
+        sizes = element_sizes.sizes;
+        for (Type t : func.output_types()) {
+            output_bytes += t.bytes();
+        }
+    }
+
+    // The bytes one tile of the given size reads and writes.
+    int64_t footprint(int64_t tx, int64_t ty) {
+        Scope<Interval> scope;
+        scope.push(tile.x, Interval(0, make_const(Int(32), tx - 1)));
+        scope.push(tile.y, Interval(0, make_const(Int(32), ty - 1)));
+
+        map<string, Box> boxes;
+        vector<Expr> exprs = def.values();
+        exprs.insert(exprs.end(), def.args().begin(), def.args().end());
+        for (Expr e : exprs) {
+            for (const auto &b : boxes_required(e, scope)) {
+                auto it = boxes.find(b.first);
+                if (it == boxes.end()) {
+                    boxes.emplace(b.first, b.second);
+                } else {
+                    merge_boxes(it->second, b.second);
+                }
+            }
+        }
+
+        int64_t bytes = tx * ty * output_bytes;
+        for (const auto &b : boxes) {
+            if (b.first == func.name() || !sizes.count(b.first)) {
+                // Reads of the Func itself are counted in its output.
+                continue;
+            }
+            bytes += box_elements(b.second) * sizes[b.first];
+        }
+        return bytes;
+    }
+};
+
+void resolve_cache_tiles(const Function &func, Definition def, int stage,
+                         const map<string, Function> &env, const Target &t) {
+    for (const CacheTile &tile : def.schedule().cache_tiles()) {
+        int64_t budget = t.cache_size(tile.level) / 2;
+        if (tile.level == CacheLevel::LastLevel) {
+            budget /= t.num_cores();
+        }
+
+        // Grow the tile one dimension at a time, starting with x, for
+        // as long as it fits.
+        CacheTileSizer sizer(func, def, env, tile);
+        int64_t tx = 8, ty = 8;
+        const int64_t max_size = 4096;
+        while (true) {
+            int64_t nx = tx, ny = ty;
+            if (tx <= ty) {
+                nx *= 2;
+            } else {
+                ny *= 2;
+            }
+            if (nx > max_size || ny > max_size || sizer.footprint(nx, ny) > budget) {
+                break;
+            }
+            tx = nx;
+            ty = ny;
+        }
+        debug(2) << "Tiling " << tile.x << " and " << tile.y << " of "
+                 << func.name() << ".s" << stage << " by " << tx << "x" << ty
+                 << " to touch " << sizer.footprint(tx, ty) << " of "
+                 << budget << " bytes of the cache\n";
+
+        map<string, Expr> factors;
+        factors[tile.xfactor] = make_const(Int(32), tx);
+        factors[tile.yfactor] = make_const(Int(32), ty);
+        for (Split &s : def.schedule().splits()) {
+            if (s.factor.defined()) {
+                s.factor = substitute(factors, s.factor);
+            }
+        }
+    }
+
+    for (const Specialization &s : def.specializations()) {
+        resolve_cache_tiles(func, s.definition, stage, env, t);
+    }
+}
+
+}  // namespace
+
+void resolve_cache_tiles(const map<string, Function> &env, const Target &t) {
+    for (const auto &iter : env) {
+        Function func = iter.second;
+        if (func.has_extern_definition() || !func.has_pure_definition()) {
+            continue;
+        }
+        resolve_cache_tiles(func, func.definition(), 0, env, t);
+        for (size_t i = 0; i < func.updates().size(); i++) {
+            resolve_cache_tiles(func, func.update(i), (int)i + 1, env, t);
+        }
+    }
+}
+
+}
+}
@@ -0,0 +1,29 @@
+#ifndef HALIDE_CACHE_TILES_H
+#define HALIDE_CACHE_TILES_H
+
+/** \file
+ * Defines the lowering pass that chooses the sizes of tiles that
+ * should fit in a level of the cache.
+ */
+
+#include <map>
+
+#include "Function.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Choose the size of each tile made with Func::tile and a
+ * CacheLevel, and substitute it into the split factors of the
+ * schedule. The size is the largest power of two for which the
+ * regions of the inputs and the output one tile touches fit in half
+ * of the given cache level of the target, leaving the other half for
+ * everything else. The last level cache is divided between the
+ * cores. */
+void resolve_cache_tiles(const std::map<std::string, Function> &env, const Target &t);
+
+}
+}
+
+#endif
@@ -169,6 +169,15 @@ CodeGen_ARM::CodeGen_ARM(Target target) : CodeGen_Posix(target) {
     casts.push_back(Pattern("vqshiftnsu.v4i16", "sqshrun.v4i16", 4, u16_sat(wild_i32x_/wild_i32x_), Pattern::RightShift));
     casts.push_back(Pattern("vqshiftnsu.v2i32", "sqshrun.v2i32", 2, u32_sat(wild_i64x_/wild_i64x_), Pattern::RightShift));
 
+    // Rounding shift right and narrow. The narrowing keeps only the
+    // low half of the shifted value, so signedness doesn't matter.
+    casts.push_back(Pattern("vrshiftn.v8i8",  "rshrn.v8i8",  8,  i8((wild_i16x_ + wild_i16x_)/wild_i16x_), Pattern::RoundingRightShift));
+    casts.push_back(Pattern("vrshiftn.v4i16", "rshrn.v4i16", 4, i16((wild_i32x_ + wild_i32x_)/wild_i32x_), Pattern::RoundingRightShift));
+    casts.push_back(Pattern("vrshiftn.v2i32", "rshrn.v2i32", 2, i32((wild_i64x_ + wild_i64x_)/wild_i64x_), Pattern::RoundingRightShift));
+    casts.push_back(Pattern("vrshiftn.v8i8",  "rshrn.v8i8",  8,  u8((wild_u16x_ + wild_u16x_)/wild_u16x_), Pattern::RoundingRightShift));
+    casts.push_back(Pattern("vrshiftn.v4i16", "rshrn.v4i16", 4, u16((wild_u32x_ + wild_u32x_)/wild_u32x_), Pattern::RoundingRightShift));
+    casts.push_back(Pattern("vrshiftn.v2i32", "rshrn.v2i32", 2, u32((wild_u64x_ + wild_u64x_)/wild_u64x_), Pattern::RoundingRightShift));
+
     // Where a 64-bit and 128-bit version exist, we use the 64-bit
     // version only when the args are 64-bits wide.
     casts.push_back(Pattern("vqshifts.v8i8",  "sqshl.v8i8",  8, i8_sat(i16(wild_i8x8)*wild_i16x8), Pattern::LeftShift));
@@ -285,17 +294,30 @@ void CodeGen_ARM::visit(const Cast *op) {
                     return;
                 }
             } else { // must be a shift
+                bool right_shift = (pattern.type == Pattern::RightShift ||
+                                    pattern.type == Pattern::RoundingRightShift);
+                if (pattern.type == Pattern::RoundingRightShift) {
+                    // The rounding term must be half of the divisor,
+                    // and the shift can be at most the narrow width.
+                    int shift_amount;
+                    if (!is_const_power_of_two_integer(matches[2], &shift_amount) ||
+                        shift_amount == 0 || shift_amount > t.bits() ||
+                        !is_const(matches[1], int64_t(1) << (shift_amount - 1))) {
+                        continue;
+                    }
+                    matches = {matches[0], matches[2]};
+                }
                 Expr constant = matches[1];
                 int shift_amount;
                 bool power_of_two = is_const_power_of_two_integer(constant, &shift_amount);
                 if (power_of_two && shift_amount < matches[0].type().bits()) {
-                    if (target.bits == 32 && pattern.type == Pattern::RightShift) {
+                    if (target.bits == 32 && right_shift) {
                         // The arm32 llvm backend wants right shifts to come in as negative values.
                         shift_amount = -shift_amount;
                     }
                     Value *shift = nullptr;
                     // The arm64 llvm backend wants i32 constants for right shifts.
-                    if (target.bits == 64 && pattern.type == Pattern::RightShift) {
+                    if (target.bits == 64 && right_shift) {
                         shift = ConstantInt::get(i32_t, shift_amount);
                     } else {
                         shift = ConstantInt::get(llvm_type_of(matches[0].type()), shift_amount);
@@ -966,6 +988,41 @@ void CodeGen_ARM::visit(const Call *op) {
                 return;
             }
         }
+    } else if (op->is_intrinsic("dynamic_shuffle") && op->type.is_vector() &&
+               op->type.bits() == 8 && !target.has_feature(Target::NoNEON)) {
+        // A lookup in a small table (see OptimizeShuffles.h). tbl and
+        // vtbl take the table in one to four registers, of 16 bytes
+        // on arm64 and 8 bytes on arm32.
+        internal_assert(op->args.size() == 4);
+        const int64_t *max_index = as_const_int(op->args[3]);
+        internal_assert(max_index);
+        int entries = (int)*max_index + 1;
+        int intrin_lanes = target.bits == 64 ? 16 : 8;
+        int table_regs = (entries + intrin_lanes - 1) / intrin_lanes;
+        if (table_regs <= 4) {
+            string intrin;
+            if (target.bits == 64) {
+                intrin = "llvm.aarch64.neon.tbl" + std::to_string(table_regs) + ".v16i8";
+            } else {
+                intrin = "llvm.arm.neon.vtbl" + std::to_string(table_regs);
+            }
+
+            Value *lut = codegen(op->args[0]);
+            Value *idx = codegen(op->args[1]);
+            vector<Value *> tables;
+            for (int i = 0; i < table_regs; i++) {
+                tables.push_back(slice_vector(lut, i * intrin_lanes, intrin_lanes));
+            }
+
+            vector<Value *> results;
+            for (int i = 0; i < op->type.lanes(); i += intrin_lanes) {
+                vector<Value *> args = tables;
+                args.push_back(slice_vector(idx, i, intrin_lanes));
+                results.push_back(call_intrin(tables[0]->getType(), intrin_lanes, intrin, args));
+            }
+            value = slice_vector(concat_vectors(results), 0, op->type.lanes());
+            return;
+        }
     }
 
     CodeGen_Posix::visit(op);
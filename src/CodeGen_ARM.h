@@ -46,7 +46,8 @@ protected:
         enum PatternType {Simple = 0, ///< Just match the pattern
                           LeftShift,  ///< Match the pattern if the RHS is a const power of two
                           RightShift, ///< Match the pattern if the RHS is a const power of two
-                          NarrowArgs  ///< Match the pattern if the args can be losslessly narrowed
+                          NarrowArgs, ///< Match the pattern if the args can be losslessly narrowed
+                          RoundingRightShift ///< Match (x + r) / d, if d is a const power of two and r is half of d
         };
         PatternType type;
         Pattern() {}
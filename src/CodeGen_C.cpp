@@ -2447,11 +2447,20 @@ void CodeGen_C::visit(const Allocate *op) {
                            << op->name << " is constant but exceeds 2^31 - 1.\n";
             } else {
                 size_id = print_expr(Expr(static_cast<int32_t>(constant_size)));
-                if (can_allocation_fit_on_stack(stack_bytes)) {
+                if (op->memory_type == MemoryType::Stack ||
+                    op->memory_type == MemoryType::Register) {
+                    on_stack = true;
+                } else if (op->memory_type == MemoryType::Auto &&
+                           can_allocation_fit_on_stack(stack_bytes)) {
                     on_stack = true;
                 }
             }
         } else {
+            user_assert(op->memory_type != MemoryType::Stack &&
+                        op->memory_type != MemoryType::Register)
+                << "Allocation " << op->name << " is stored in " << op->memory_type
+                << " memory, but its size is not constant.\n";
+
             // Check that the allocation is not scalar (if it were scalar
             // it would have constant size).
             internal_assert(op->extents.size() > 0);
@@ -2506,11 +2515,13 @@ void CodeGen_C::visit(const Allocate *op) {
             stream << op_name
                    << "[" << size_id << "];\n";
         } else {
+            string malloc_function = (op->memory_type == MemoryType::LockedCache ?
+                                      "halide_locked_cache_malloc" : "halide_malloc");
             stream << "*"
                    << op_name
                    << " = ("
                    << op_type
-                   << " *)halide_malloc(_ucon, sizeof("
+                   << " *)" << malloc_function << "(_ucon, sizeof("
                    << op_type
                    << ")*" << size_id << ");\n";
             heap_allocations.push(op->name, 0);
@@ -2521,7 +2532,11 @@ void CodeGen_C::visit(const Allocate *op) {
         create_assertion(op_name, "halide_error_out_of_memory(_ucon)");
 
         do_indent();
-        string free_function = op->free_function.empty() ? "halide_free" : op->free_function;
+        string free_function = op->free_function;
+        if (free_function.empty()) {
+            free_function = (op->memory_type == MemoryType::LockedCache ?
+                             "halide_locked_cache_free" : "halide_free");
+        }
         stream << "HalideFreeHelper " << op_name << "_free(_ucon, "
                << op_name << ", " << free_function << ");\n";
     }
@@ -2623,9 +2638,9 @@ void CodeGen_C::test() {
     Stmt s = Store::make("buf", e, x, Parameter(), const_true());
     s = LetStmt::make("x", beta+1, s);
     s = Block::make(s, Free::make("tmp.stack"));
-    s = Allocate::make("tmp.stack", Int(32), {127}, const_true(), s);
+    s = Allocate::make("tmp.stack", Int(32), MemoryType::Auto, {127}, const_true(), s);
     s = Block::make(s, Free::make("tmp.heap"));
-    s = Allocate::make("tmp.heap", Int(32), {43, beta}, const_true(), s);
+    s = Allocate::make("tmp.heap", Int(32), MemoryType::Auto, {43, beta}, const_true(), s);
     Expr buf = Variable::make(Handle(), "buf.buffer");
     s = LetStmt::make("buf", Call::make(Handle(), Call::buffer_get_host, {buf}, Call::Extern), s);
 
@@ -155,6 +155,7 @@ bool function_takes_user_context(const std::string &name) {
         "halide_error",
         "halide_free",
         "halide_malloc",
+        "halide_loop_profile_pipeline_start",
         "halide_print",
         "halide_profiler_memory_allocate",
         "halide_profiler_memory_free",
@@ -6,6 +6,7 @@
 #include "IRPrinter.h"
 #include "CodeGen_LLVM.h"
 #include "CPlusPlusMangle.h"
+#include "CompilerProfiling.h"
 #include "IROperator.h"
 #include "Debug.h"
 #include "Deinterleave.h"
@@ -18,6 +19,7 @@
 #include "MatlabWrapper.h"
 #include "IntegerDivisionTable.h"
 #include "CSE.h"
+#include "LoopProfile.h"
 
 #include "CodeGen_X86.h"
 #include "CodeGen_GPU_Host.h"
@@ -488,11 +490,34 @@ MangledNames get_mangled_names(const LoweredFunc &f, const Target &target) {
     return get_mangled_names(f.name, f.linkage, f.name_mangling, f.args, target);
 }
 
+// Find the names shared by more than one loop. Loop partitioning
+// splits a loop into a prologue, steady state and epilogue with the
+// same name, and specializations copy loops, so the profiled trip
+// counts of a loop with one of these names don't describe any one of
+// the loops that carry it.
+class FindRepeatedLoopNames : public IRVisitor {
+    using IRVisitor::visit;
+
+    std::set<string> seen;
+
+    void visit(const For *op) {
+        if (!seen.insert(op->name).second) {
+            repeated.insert(op->name);
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    std::set<string> repeated;
+};
+
 }  // namespace
 
 std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
     input_module = &input;
 
+    CompilerProfiler profiler("codegen " + input.name());
+
     init_module();
 
     debug(1) << "Target triple of initial module: " << module->getTargetTriple() << "\n";
@@ -539,6 +564,11 @@ std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
     for (const auto &f : input.functions()) {
         const auto names = get_mangled_names(f, get_target());
 
+        // Loop profiles are keyed by the name of the pipeline.
+        current_pipeline_name = f.name;
+        FindRepeatedLoopNames repeated;
+        f.body.accept(&repeated);
+        repeated_loop_names.swap(repeated.repeated);
         compile_func(f, names.simple_name, names.extern_name);
 
         // If the Func is externally visible, also create the argv wrapper and metadata.
@@ -554,13 +584,16 @@ std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
     }
 
     debug(2) << module.get() << "\n";
+    profiler.lap("generating llvm bitcode");
 
     // Verify the module is ok
     verifyModule(*module);
     debug(2) << "Done generating llvm bitcode\n";
+    profiler.lap("verifying llvm bitcode");
 
     // Optimize
     CodeGen_LLVM::optimize_module();
+    profiler.lap("optimizing llvm bitcode");
 
     input_module = nullptr;
 
@@ -2247,6 +2280,19 @@ void CodeGen_LLVM::visit(const Call *op) {
         } else {
             internal_error << "mod_round_to_zero of non-integer type.\n";
         }
+    } else if (op->is_intrinsic("dynamic_shuffle")) {
+        // Backends with a table lookup instruction handle this
+        // themselves. Otherwise, extract each lane of the result from
+        // the table.
+        internal_assert(op->args.size() == 4);
+        Value *lut = codegen(op->args[0]);
+        Value *idx = codegen(op->args[1]);
+        value = UndefValue::get(llvm_type_of(op->type));
+        for (int i = 0; i < op->type.lanes(); i++) {
+            Value *lane = ConstantInt::get(i32_t, i);
+            Value *entry = builder->CreateZExt(builder->CreateExtractElement(idx, lane), i32_t);
+            value = builder->CreateInsertElement(value, builder->CreateExtractElement(lut, entry), lane);
+        }
     } else if (op->is_intrinsic(Call::lerp)) {
         internal_assert(op->args.size() == 3);
         value = codegen(lower_lerp(op->args[0], op->args[1], op->args[2]));
@@ -2981,9 +3027,27 @@ void CodeGen_LLVM::visit(const For *op) {
         // Add the back-edge to the phi node
         phi->addIncoming(next_var, builder->GetInsertBlock());
 
-        // Maybe exit the loop
+        // Maybe exit the loop. If a loop profile says how many
+        // iterations the loop usually runs, tell LLVM with the
+        // weights of the back edge, as profile-guided optimization
+        // would. Loops that share their name with another loop, such
+        // as the parts of a partitioned loop, get no weights.
         Value *end_condition = builder->CreateICmpNE(next_var, max);
-        builder->CreateCondBr(end_condition, loop_bb, after_bb);
+        LoopProfile profile;
+        if (!repeated_loop_names.count(op->name) &&
+            find_loop_profile(current_pipeline_name, op->name, &profile) &&
+            profile.entries > 0 && profile.iterations >= profile.entries) {
+            uint64_t back_edges = profile.iterations - profile.entries, exits = profile.entries;
+            while (back_edges > 0xffffffffULL || exits > 0xffffffffULL) {
+                back_edges >>= 1;
+                exits = (exits >> 1) | 1;
+            }
+            llvm::MDBuilder md_builder(*context);
+            builder->CreateCondBr(end_condition, loop_bb, after_bb,
+                                  md_builder.createBranchWeights((uint32_t)back_edges, (uint32_t)exits));
+        } else {
+            builder->CreateCondBr(end_condition, loop_bb, after_bb);
+        }
 
         builder->SetInsertPoint(after_bb);
 
@@ -140,6 +140,8 @@ protected:
     llvm::Value *value;
     llvm::MDNode *very_likely_branch;
     std::vector<LoweredArgument> current_function_args;
+    std::string current_pipeline_name;
+    std::set<std::string> repeated_loop_names;
     //@}
 
     /** The target we're generating code for */
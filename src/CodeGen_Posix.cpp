@@ -24,6 +24,49 @@ CodeGen_Posix::CodeGen_Posix(Target t) :
   CodeGen_LLVM(t) {
 }
 
+namespace {
+
+// Check that every access to an allocation is at a constant index,
+// so that llvm can promote it to registers.
+class CheckConstantAccess : public IRVisitor {
+    const string &name;
+
+    using IRVisitor::visit;
+
+    bool is_constant_index(Expr index) {
+        if (const Ramp *r = index.as<Ramp>()) {
+            return is_const(r->base) && is_const(r->stride);
+        }
+        return is_const(index);
+    }
+
+    void check(Expr index) {
+        user_assert(is_constant_index(index))
+            << "Allocation " << name << " is stored in registers, but is accessed at "
+            << "non-constant index " << index << ". Unroll the loops over its "
+            << "dimensions, or store it somewhere else.\n";
+    }
+
+    void visit(const Load *op) {
+        if (op->name == name) {
+            check(op->index);
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Store *op) {
+        if (op->name == name) {
+            check(op->index);
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    CheckConstantAccess(const string &n) : name(n) {}
+};
+
+}  // namespace
+
 Value *CodeGen_Posix::codegen_allocation_size(const std::string &name, Type type, const std::vector<Expr> &extents) {
     // Compute size from list of extents checking for overflow.
 
@@ -80,11 +123,14 @@ int CodeGen_Posix::allocation_padding(Type type) const {
 }
 
 CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &name, Type type,
+                                                           MemoryType memory_type,
                                                            const std::vector<Expr> &extents, Expr condition,
                                                            Expr new_expr, std::string free_function) {
     Value *llvm_size = nullptr;
     int64_t stack_bytes = 0;
     int32_t constant_bytes = Allocate::constant_allocation_size(extents, name);
+    bool on_heap = (memory_type == MemoryType::Heap ||
+                    memory_type == MemoryType::LockedCache);
     if (constant_bytes > 0) {
         constant_bytes *= type.bytes();
         stack_bytes = constant_bytes;
@@ -92,11 +138,16 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
         if (stack_bytes > target.maximum_buffer_size()) {
             const string str_max_size = target.has_feature(Target::LargeBuffers) ? "2^63 - 1" : "2^31 - 1";
             user_error << "Total size for allocation " << name << " is constant but exceeds " << str_max_size << ".";
-        } else if (!can_allocation_fit_on_stack(stack_bytes)) {
+        } else if (on_heap ||
+                   (memory_type == MemoryType::Auto && !can_allocation_fit_on_stack(stack_bytes))) {
             stack_bytes = 0;
             llvm_size = codegen(Expr(constant_bytes));
         }
     } else {
+        user_assert(memory_type != MemoryType::Stack &&
+                    memory_type != MemoryType::Register)
+            << "Allocation " << name << " is stored in " << memory_type
+            << " memory, but its size is not constant.\n";
         llvm_size = codegen_allocation_size(name, type, extents);
     }
 
@@ -124,7 +175,7 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
     allocation.destructor_function = nullptr;
     allocation.name = name;
 
-    if (!new_expr.defined() && extents.empty()) {
+    if (!new_expr.defined() && extents.empty() && !on_heap) {
         // If it's a scalar allocation, don't try anything clever. We
         // want llvm to be able to promote it to a register.
         allocation.ptr = create_alloca_at_entry(llvm_type_of(type), 1, false, name);
@@ -141,6 +192,7 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
             llvm::Function *current_func = builder->GetInsertBlock()->getParent();
 
             if (allocated_in == current_func &&
+                memory_type != MemoryType::Register &&
                 free->type == type &&
                 free->stack_bytes >= stack_bytes) {
                 break;
@@ -176,8 +228,10 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
             allocation.ptr = codegen(new_expr);
         } else {
             // call malloc
-            llvm::Function *malloc_fn = module->getFunction("halide_malloc");
-            internal_assert(malloc_fn) << "Could not find halide_malloc in module\n";
+            string malloc_function = (memory_type == MemoryType::LockedCache ?
+                                      "halide_locked_cache_malloc" : "halide_malloc");
+            llvm::Function *malloc_fn = module->getFunction(malloc_function);
+            internal_assert(malloc_fn) << "Could not find " << malloc_function << " in module\n";
             #if LLVM_VERSION < 50
             malloc_fn->setDoesNotAlias(0);
             #else
@@ -188,7 +242,7 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
             ++arg_iter;  // skip the user context *
             llvm_size = builder->CreateIntCast(llvm_size, arg_iter->getType(), false);
 
-            debug(4) << "Creating call to halide_malloc for allocation " << name
+            debug(4) << "Creating call to " << malloc_function << " for allocation " << name
                      << " of size " << type.bytes();
             for (Expr e : extents) {
                 debug(4) << " x " << e;
@@ -221,7 +275,8 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
 
         // Register a destructor for this allocation.
         if (free_function.empty()) {
-            free_function = "halide_free";
+            free_function = (memory_type == MemoryType::LockedCache ?
+                             "halide_locked_cache_free" : "halide_free");
         }
         llvm::Function *free_fn = module->getFunction(free_function);
         internal_assert(free_fn) << "Could not find " << free_function << " in module.\n";
@@ -268,7 +323,12 @@ void CodeGen_Posix::visit(const Allocate *alloc) {
                    << alloc->name << "\n";
     }
 
-    Allocation allocation = create_allocation(alloc->name, alloc->type,
+    if (alloc->memory_type == MemoryType::Register) {
+        CheckConstantAccess check(alloc->name);
+        alloc->body.accept(&check);
+    }
+
+    Allocation allocation = create_allocation(alloc->name, alloc->type, alloc->memory_type,
                                               alloc->extents, alloc->condition,
                                               alloc->new_expr, alloc->free_function);
     sym_push(alloc->name, allocation.ptr);
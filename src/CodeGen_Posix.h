@@ -24,7 +24,8 @@ protected:
 
     /** Posix implementation of Allocate. Small constant-sized allocations go
      * on the stack. The rest go on the heap by calling "halide_malloc"
-     * and "halide_free" in the standard library. */
+     * and "halide_free" in the standard library. An explicit memory
+     * type on the Allocate node overrides this choice. */
     // @{
     void visit(const Allocate *);
     void visit(const Free *);
@@ -100,7 +101,7 @@ private:
      *
      * When the allocation can be freed call 'free_allocation', and
      * when it goes out of scope call 'destroy_allocation'. */
-    Allocation create_allocation(const std::string &name, Type type,
+    Allocation create_allocation(const std::string &name, Type type, MemoryType memory_type,
                                  const std::vector<Expr> &extents,
                                  Expr condition, Expr new_expr, std::string free_function);
 
@@ -3,6 +3,7 @@
 #include "CodeGen_X86.h"
 #include "ConciseCasts.h"
 #include "JITModule.h"
+#include "IREquality.h"
 #include "IROperator.h"
 #include "IRMatch.h"
 #include "Debug.h"
@@ -60,6 +61,43 @@ bool should_use_pmaddwd(Expr a, Expr b, vector<Expr> &result) {
     return true;
 }
 
+// i16_sat(i32(u8_a)*i32(i8_b) + i32(u8_c)*i32(i8_d)) can be done by
+// interleaving a, c, and b, d, and then using pmaddubsw. Either
+// factor of each product may be the unsigned one.
+bool should_use_pmaddubsw(const Cast *op, vector<Expr> &result) {
+    Type t = op->type;
+    if (!(t.is_int() && t.bits() == 16 && t.lanes() >= 8)) {
+        return false;
+    }
+
+    Expr wild = Variable::make(Int(32, 0), "*");
+    Expr pattern = i16_sat(wild * wild + wild * wild);
+    vector<Expr> matches;
+    if (!expr_match(pattern, op, matches)) {
+        return false;
+    }
+
+    Type unsigned_narrow = UInt(8, t.lanes());
+    Type signed_narrow = Int(8, t.lanes());
+    vector<Expr> args;
+    for (int i = 0; i < 4; i += 2) {
+        Expr a = lossless_cast(unsigned_narrow, matches[i]);
+        Expr b = lossless_cast(signed_narrow, matches[i+1]);
+        if (!a.defined() || !b.defined()) {
+            a = lossless_cast(unsigned_narrow, matches[i+1]);
+            b = lossless_cast(signed_narrow, matches[i]);
+        }
+        if (!a.defined() || !b.defined()) {
+            return false;
+        }
+        args.push_back(a);
+        args.push_back(b);
+    }
+
+    result.swap(args);
+    return true;
+}
+
 }
 
 
@@ -199,6 +237,115 @@ void CodeGen_X86::visit(const Select *op) {
     }
 }
 
+namespace {
+bool has_avx512(const Target &target) {
+    return (target.has_feature(Target::AVX512) ||
+            target.has_feature(Target::AVX512_KNL) ||
+            target.has_feature(Target::AVX512_Skylake) ||
+            target.has_feature(Target::AVX512_Cannonlake));
+}
+}
+
+bool CodeGen_X86::use_gather(Type t) const {
+    // AVX2 and AVX-512 can gather 32- and 64-bit elements. There are
+    // no gathers of narrower elements, and a gather of fewer than
+    // four elements is no faster than loading them one at a time.
+    // Before LLVM 6, the AVX2 gather intrinsics can't be selected
+    // reliably without AVX-512.
+    constexpr bool have_avx2_gathers = LLVM_VERSION >= 60;
+    return (((have_avx2_gathers && target.has_feature(Target::AVX2)) || has_avx512(target)) &&
+            (t.bits() == 32 || t.bits() == 64) &&
+            t.lanes() >= 4);
+}
+
+bool CodeGen_X86::use_scatter(Type t) const {
+    // Only AVX-512 has scatters.
+    return (has_avx512(target) &&
+            (t.bits() == 32 || t.bits() == 64) &&
+            t.lanes() >= 4);
+}
+
+void CodeGen_X86::visit(const Load *op) {
+    const Ramp *ramp = op->index.as<Ramp>();
+    const IntImm *stride = ramp ? ramp->stride.as<IntImm>() : nullptr;
+    bool predicated = !is_one(op->predicate);
+    // Dense and reversed loads are handled with vector loads, and
+    // strided loads with a scalar stride are done one element at a
+    // time unless they are predicated, in which case the alternative
+    // is a branch per element.
+    bool dense = stride && (stride->value == 1 || stride->value == -1);
+    if (op->type.is_vector() && !op->type.is_handle() &&
+        !op->index.as<Let>() && !dense && (!ramp || predicated) &&
+        use_gather(op->type)) {
+        debug(4) << "Gather:\n\t" << Expr(op) << "\n";
+        Value *index = codegen(op->index);
+        Value *base = codegen_buffer_pointer(op->name, op->type.element_of(), ConstantInt::get(i32_t, 0));
+        Value *ptrs = builder->CreateInBoundsGEP(base, index);
+        Value *mask = predicated ? codegen(op->predicate) : nullptr;
+        Value *pass_thru = predicated ? Constant::getNullValue(llvm_type_of(op->type)) : nullptr;
+        Instruction *gather = builder->CreateMaskedGather(ptrs, op->type.bytes(), mask, pass_thru);
+        add_tbaa_metadata(gather, op->name, op->index);
+        value = gather;
+        return;
+    }
+    CodeGen_Posix::visit(op);
+}
+
+void CodeGen_X86::visit(const Store *op) {
+    // On AVX-512, a dense store of a select between a new value and
+    // the value already in memory is a masked store of the new value,
+    // which saves the load and the blend.
+    const Select *sel = op->value.as<Select>();
+    const Ramp *ramp = op->index.as<Ramp>();
+    int bits = op->value.type().bits();
+    bool masked_store = false;
+    if (target.has_feature(Target::AVX512_Skylake) ||
+        target.has_feature(Target::AVX512_Cannonlake)) {
+        masked_store = (bits == 8 || bits == 16 || bits == 32 || bits == 64);
+    } else if (target.has_feature(Target::AVX512) ||
+               target.has_feature(Target::AVX512_KNL)) {
+        masked_store = (bits == 32 || bits == 64);
+    }
+    if (masked_store && sel && sel->condition.type().is_vector() &&
+        ramp && is_one(ramp->stride) && is_one(op->predicate)) {
+        auto loads_stored_value = [&](const Expr &e) {
+            const Load *load = e.as<Load>();
+            return (load && load->name == op->name &&
+                    is_one(load->predicate) && equal(load->index, op->index));
+        };
+        Expr new_value, mask;
+        if (loads_stored_value(sel->false_value)) {
+            new_value = sel->true_value;
+            mask = sel->condition;
+        } else if (loads_stored_value(sel->true_value)) {
+            new_value = sel->false_value;
+            mask = !sel->condition;
+        }
+        if (new_value.defined()) {
+            debug(4) << "Masked store of select:\n\t" << Stmt(op) << "\n";
+            codegen(Store::make(op->name, new_value, op->index, op->param, mask));
+            return;
+        }
+    }
+
+    Type t = op->value.type();
+    if (t.is_vector() && !t.is_handle() && is_one(op->predicate) &&
+        !ramp && !op->index.as<Let>() && use_scatter(t)) {
+        debug(4) << "Scatter:\n\t" << Stmt(op) << "\n";
+        Value *val = codegen(op->value);
+        Value *index = codegen(op->index);
+        Value *base = codegen_buffer_pointer(op->name, t.element_of(), ConstantInt::get(i32_t, 0));
+        Value *ptrs = builder->CreateInBoundsGEP(base, index);
+        // Lanes that store to the same address are written in order,
+        // as they would be one element at a time.
+        Instruction *scatter = builder->CreateMaskedScatter(val, ptrs, t.bytes());
+        add_tbaa_metadata(scatter, op->name, op->index);
+        return;
+    }
+
+    CodeGen_Posix::visit(op);
+}
+
 void CodeGen_X86::visit(const Cast *op) {
 
     if (!op->type.is_vector()) {
@@ -209,6 +356,12 @@ void CodeGen_X86::visit(const Cast *op) {
 
     vector<Expr> matches;
 
+    if (target.has_feature(Target::SSE41) &&
+        should_use_pmaddubsw(op, matches)) {
+        codegen(Call::make(op->type, "pmaddubsw", matches, Call::Extern));
+        return;
+    }
+
     struct Pattern {
         Target::Feature feature;
         bool wide_op;
@@ -246,6 +399,14 @@ void CodeGen_X86::visit(const Cast *op) {
          i16((wild_i32x_ * wild_i32x_) / 65536)},
         {Target::FeatureEnd, true, UInt(16, 8), 0, "llvm.x86.sse2.pmulhu.w",
          u16((wild_u32x_ * wild_u32x_) / 65536)},
+
+        // Rounding multiply-high. pmulhrsw does not saturate, so
+        // only the wrapping cast matches.
+        {Target::AVX2, true, Int(16, 16), 9, "llvm.x86.avx2.pmul.hr.sw",
+         i16((wild_i32x_ * wild_i32x_ + 16384) / 32768)},
+        {Target::SSE41, true, Int(16, 8), 0, "llvm.x86.ssse3.pmul.hr.sw.128",
+         i16((wild_i32x_ * wild_i32x_ + 16384) / 32768)},
+
         {Target::FeatureEnd, true, UInt(8, 16), 0, "llvm.x86.sse2.pavg.b",
          u8(((wild_u16x_ + wild_u16x_) + 1) / 2)},
         {Target::FeatureEnd, true, UInt(16, 8), 0, "llvm.x86.sse2.pavg.w",
@@ -404,6 +565,67 @@ void CodeGen_X86::visit(const Call *op) {
                           cast(wider, op->args[0]) <<
                           cast(wider, op->args[1]));
         codegen(equiv);
+    } else if (op->is_intrinsic("dynamic_shuffle") && op->type.is_vector()) {
+        // A lookup in a small table (see OptimizeShuffles.h).
+        internal_assert(op->args.size() == 4);
+        const int64_t *max_index = as_const_int(op->args[3]);
+        internal_assert(max_index);
+        int entries = (int)*max_index + 1;
+        int bits = op->type.bits();
+
+        string intrin;
+        int intrin_lanes = 0;
+        if (bits == 8 && entries <= 64 && target.has_feature(Target::AVX512_Cannonlake)) {
+            #if LLVM_VERSION >= 60
+            intrin = "llvm.x86.avx512.permvar.qi.512";
+            #else
+            intrin = "llvm.x86.avx512.mask.permvar.qi.512";
+            #endif
+            intrin_lanes = 64;
+        } else if (bits == 8 && entries <= 16 && target.has_feature(Target::AVX2)) {
+            // vpshufb looks up each 128-bit half of the index in the
+            // corresponding half of the table, so we put a copy of
+            // the table in each half.
+            intrin = "llvm.x86.avx2.pshuf.b";
+            intrin_lanes = 32;
+        } else if (bits == 8 && entries <= 16 && target.has_feature(Target::SSE41)) {
+            intrin = "llvm.x86.ssse3.pshuf.b.128";
+            intrin_lanes = 16;
+        } else if (bits == 32 && entries <= 8 && target.has_feature(Target::AVX2)) {
+            intrin = op->type.is_float() ? "llvm.x86.avx2.permps" : "llvm.x86.avx2.permd";
+            intrin_lanes = 8;
+        }
+
+        if (intrin.empty()) {
+            CodeGen_Posix::visit(op);
+            return;
+        }
+
+        Value *lut = codegen(op->args[0]);
+        Value *idx = codegen(op->args[1]);
+        if (intrin_lanes == 32) {
+            lut = slice_vector(lut, 0, 16);
+            lut = concat_vectors({lut, lut});
+        } else {
+            lut = slice_vector(lut, 0, intrin_lanes);
+        }
+        if (bits == 32) {
+            // vpermd and vpermps take 32-bit indices.
+            idx = builder->CreateZExt(idx, VectorType::get(i32_t, op->type.lanes()));
+        }
+
+        vector<Value *> results;
+        for (int i = 0; i < op->type.lanes(); i += intrin_lanes) {
+            vector<Value *> args = {lut, slice_vector(idx, i, intrin_lanes)};
+            #if LLVM_VERSION < 60
+            if (intrin_lanes == 64) {
+                args.push_back(UndefValue::get(lut->getType()));
+                args.push_back(ConstantInt::get(i64_t, -1));
+            }
+            #endif
+            results.push_back(call_intrin(lut->getType(), intrin_lanes, intrin, args));
+        }
+        value = slice_vector(concat_vectors(results), 0, op->type.lanes());
     } else {
         CodeGen_Posix::visit(op);
     }
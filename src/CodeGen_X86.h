@@ -31,6 +31,14 @@ protected:
 
     Expr mulhi_shr(Expr a, Expr b, int shr);
 
+    /** Check if a vector load or store of the given type with
+     * arbitrary indices is better done with a hardware gather or
+     * scatter instruction than one element at a time. */
+    // @{
+    bool use_gather(Type t) const;
+    bool use_scatter(Type t) const;
+    // @}
+
     using CodeGen_Posix::visit;
 
     /** Nodes for which we want to emit specific sse/avx intrinsics */
@@ -48,6 +56,8 @@ protected:
     void visit(const EQ *);
     void visit(const NE *);
     void visit(const Select *);
+    void visit(const Load *);
+    void visit(const Store *);
     // @}
 };
 
@@ -0,0 +1,183 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "CompilerProfiling.h"
+#include "IRVisitor.h"
+#include "Util.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace Halide {
+namespace Internal {
+
+using std::string;
+
+namespace {
+
+double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The peak resident memory of the process so far, in bytes, or 0 if
+// it can't be found.
+int64_t peak_memory() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return (int64_t)counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (int64_t)usage.ru_maxrss;
+#else
+    // Linux reports kilobytes.
+    return (int64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+// Count the distinct nodes in a Stmt. Shared subexpressions are only
+// counted once.
+class CountNodes : public IRGraphVisitor {
+    using IRGraphVisitor::include;
+
+    void include(const Expr &e) {
+        if (e.defined() && !visited.count(e.get())) {
+            count++;
+        }
+        IRGraphVisitor::include(e);
+    }
+
+    void include(const Stmt &s) {
+        if (s.defined() && !visited.count(s.get())) {
+            count++;
+        }
+        IRGraphVisitor::include(s);
+    }
+
+public:
+    int64_t count = 0;
+
+    void count_stmt(const Stmt &s) {
+        include(s);
+    }
+};
+
+string json_escape(const string &str) {
+    string result;
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result;
+}
+
+}  // namespace
+
+int64_t count_nodes(const Stmt &s) {
+    CountNodes counter;
+    counter.count_stmt(s);
+    return counter.count;
+}
+
+CompilerProfiler::CompilerProfiler(const string &phase)
+    : phase(phase), active(enabled()), start_time(0), last_time(0), last_nodes(-1) {
+    if (active) {
+        start_time = last_time = now();
+    }
+}
+
+CompilerProfiler::~CompilerProfiler() {
+    if (active && !passes.empty()) {
+        report();
+    }
+}
+
+void CompilerProfiler::lap(const string &pass, const Stmt &s) {
+    if (!active) {
+        return;
+    }
+    double t = now();
+    int64_t nodes = s.defined() ? count_nodes(s) : -1;
+    passes.push_back({pass, t - last_time, last_nodes, nodes, peak_memory()});
+    last_nodes = nodes;
+    // Don't charge the counting of nodes to the next pass.
+    last_time = now();
+}
+
+bool CompilerProfiler::enabled() {
+    static bool result = [] {
+        string value = get_env_variable("HL_COMPILE_PROFILE");
+        return !value.empty() && value != "0";
+    }();
+    return result;
+}
+
+void CompilerProfiler::report() const {
+    double total = 0;
+    for (const Pass &p : passes) {
+        total += p.seconds;
+    }
+
+    // Print the whole report at once, so that reports from
+    // compilations on different threads don't interleave.
+    std::ostringstream out;
+    if (get_env_variable("HL_COMPILE_PROFILE") == "json") {
+        out << "{\"phase\": \"" << json_escape(phase) << "\", "
+            << "\"total_ms\": " << total * 1000 << ", "
+            << "\"passes\": [";
+        for (size_t i = 0; i < passes.size(); i++) {
+            const Pass &p = passes[i];
+            out << (i > 0 ? ", " : "")
+                << "{\"name\": \"" << json_escape(p.name) << "\", "
+                << "\"ms\": " << p.seconds * 1000 << ", "
+                << "\"nodes_before\": " << p.nodes_before << ", "
+                << "\"nodes_after\": " << p.nodes_after << ", "
+                << "\"peak_memory_bytes\": " << p.peak_memory << "}";
+        }
+        out << "]}\n";
+    } else {
+        out << "Compile profile of " << phase << ": "
+            << std::fixed << std::setprecision(3) << total * 1000 << " ms\n"
+            << std::left << std::setw(56) << "  pass"
+            << std::right << std::setw(12) << "ms"
+            << std::setw(8) << "%"
+            << std::setw(14) << "nodes before"
+            << std::setw(14) << "nodes after"
+            << std::setw(14) << "peak MB" << "\n";
+        for (const Pass &p : passes) {
+            out << std::left << std::setw(56) << ("  " + p.name)
+                << std::right << std::setw(12) << std::setprecision(3) << p.seconds * 1000
+                << std::setw(8) << std::setprecision(1) << (total > 0 ? 100 * p.seconds / total : 0.0);
+            if (p.nodes_before >= 0) {
+                out << std::setw(14) << p.nodes_before;
+            } else {
+                out << std::setw(14) << "-";
+            }
+            if (p.nodes_after >= 0) {
+                out << std::setw(14) << p.nodes_after;
+            } else {
+                out << std::setw(14) << "-";
+            }
+            out << std::setw(14) << std::setprecision(1) << p.peak_memory / (1024.0 * 1024.0) << "\n";
+        }
+    }
+    std::cerr << out.str();
+}
+
+}
+}
@@ -0,0 +1,61 @@
+#ifndef HALIDE_COMPILER_PROFILING_H
+#define HALIDE_COMPILER_PROFILING_H
+
+/** \file
+ * Defines a profiler for the passes of the compiler itself.
+ */
+
+#include <string>
+#include <vector>
+
+#include "Expr.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Records the wall time, the number of IR nodes, and the peak memory
+ * use of the process after each pass of one phase of compilation
+ * (lowering, LLVM code generation and optimization, or machine code
+ * generation), and prints them to stderr when it is destroyed. It
+ * does nothing unless the environment variable HL_COMPILE_PROFILE is
+ * set. If it is set to "json", each phase is printed as a JSON object
+ * on one line, otherwise as a table. */
+class CompilerProfiler {
+public:
+    EXPORT CompilerProfiler(const std::string &phase);
+    EXPORT ~CompilerProfiler();
+
+    /** Record the end of a pass, which started at the end of the
+     * previous one. If the pass produces a Stmt, the number of nodes
+     * in it is recorded too. */
+    EXPORT void lap(const std::string &pass, const Stmt &s = Stmt());
+
+    /** Whether HL_COMPILE_PROFILE is set. */
+    EXPORT static bool enabled();
+
+private:
+    struct Pass {
+        std::string name;
+        double seconds;
+        // -1 if unknown.
+        int64_t nodes_before, nodes_after;
+        int64_t peak_memory;
+    };
+
+    std::string phase;
+    bool active;
+    double start_time, last_time;
+    int64_t last_nodes;
+    std::vector<Pass> passes;
+
+    void report() const;
+};
+
+/** Count the distinct IR nodes in a Stmt. Shared subexpressions are
+ * only counted once. */
+EXPORT int64_t count_nodes(const Stmt &s);
+
+}
+}
+
+#endif
@@ -154,7 +154,7 @@ class InjectEarlyFrees : public IRMutator {
             IRMutator::visit(alloc);
             alloc = stmt.as<Allocate>();
             internal_assert(alloc);
-            stmt = Allocate::make(alloc->name, alloc->type, alloc->extents, alloc->condition,
+            stmt = Allocate::make(alloc->name, alloc->type, alloc->memory_type, alloc->extents, alloc->condition,
                                   Block::make(alloc->body, Free::make(alloc->name)), alloc->new_expr, alloc->free_function);
             return;
         }
@@ -172,7 +172,7 @@ class InjectEarlyFrees : public IRMutator {
             inject_marker.inject_device_free = last_use.found_device_malloc;
             stmt = inject_marker.mutate(stmt);
         } else {
-            stmt = Allocate::make(alloc->name, alloc->type, alloc->extents, alloc->condition,
+            stmt = Allocate::make(alloc->name, alloc->type, alloc->memory_type, alloc->extents, alloc->condition,
                                   Block::make(alloc->body, make_free(alloc->name, last_use.found_device_malloc)),
                                   alloc->new_expr);
         }
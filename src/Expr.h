@@ -324,6 +324,43 @@ enum class DeviceAPI {
     Hexagon
 };
 
+/** An enum describing where a Func's storage should be allocated.
+ * Used by schedules, and in the Allocate IR node. */
+enum class MemoryType {
+    /** Let the code generator decide, based on the size of the
+     * allocation. Small constant-sized allocations go on the stack,
+     * the rest on the heap. */
+    Auto,
+
+    /** Allocate on the heap, using halide_malloc and halide_free. */
+    Heap,
+
+    /** Allocate on the stack. The allocation must have a constant
+     * size. */
+    Stack,
+
+    /** Keep the allocation in registers. The allocation must have a
+     * constant size, and every access to it must be at a constant
+     * index once loops are unrolled. */
+    Register,
+
+    /** Allocate in fast scratch memory, such as a locked region of
+     * cache, or the local memory of an accelerator. Uses the
+     * halide_locked_cache_malloc and halide_locked_cache_free
+     * runtime functions, which fall back to the heap unless
+     * overridden. */
+    LockedCache,
+};
+
+/** A level of the cache hierarchy of a CPU. Used to ask for tiles
+ * that fit in a given level (see \ref Func::tile). The sizes of the
+ * levels come from the Target. */
+enum class CacheLevel {
+    L1,
+    L2,
+    LastLevel,
+};
+
 /** An array containing all the device apis. Useful for iterating
  * through them. */
 const DeviceAPI all_device_apis[] = {DeviceAPI::None,
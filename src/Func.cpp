@@ -1741,6 +1741,30 @@ Stage &Stage::tile(VarOrRVar x, VarOrRVar y,
     return *this;
 }
 
+Stage &Stage::tile(VarOrRVar x, VarOrRVar y,
+                   VarOrRVar xo, VarOrRVar yo,
+                   VarOrRVar xi, VarOrRVar yi,
+                   CacheLevel fit_in,
+                   TailStrategy tail) {
+    // The factors are placeholders until lowering resolves them (see
+    // CacheTiles.h).
+    CacheTile t = {x.name(), y.name(),
+                   unique_name(x.name() + "_tile_size"),
+                   unique_name(y.name() + "_tile_size"),
+                   fit_in};
+    tile(x, y, xo, yo, xi, yi,
+         Variable::make(Int(32), t.xfactor), Variable::make(Int(32), t.yfactor), tail);
+    definition.schedule().cache_tiles().push_back(t);
+    return *this;
+}
+
+Stage &Stage::tile(VarOrRVar x, VarOrRVar y,
+                   VarOrRVar xi, VarOrRVar yi,
+                   CacheLevel fit_in,
+                   TailStrategy tail) {
+    return tile(x, y, x, y, xi, yi, fit_in, tail);
+}
+
 namespace {
 // An helper function for reordering vars in a schedule.
 void reorder_vars(vector<Dim> &dims_old, const VarOrRVar *vars, size_t size, const Stage &stage) {
@@ -2163,6 +2187,12 @@ Func &Func::memoize() {
     return *this;
 }
 
+Func &Func::async() {
+    invalidate_cache();
+    func.schedule().async() = true;
+    return *this;
+}
+
 Stage Func::specialize(Expr c) {
     invalidate_cache();
     return Stage(func.definition(), name(), args(), func.schedule()).specialize(c);
@@ -2247,6 +2277,39 @@ Func &Func::bound_extent(Var var, Expr extent) {
     return bound(var, Expr(), extent);
 }
 
+Func &Func::estimate(Var var, Expr min, Expr extent) {
+    user_assert(min.defined() && extent.defined())
+        << "Estimates on Func " << name() << " must have a defined min and extent\n";
+    user_assert(Int(32).can_represent(min.type())) << "Can't represent min estimate in int32\n";
+    user_assert(Int(32).can_represent(extent.type())) << "Can't represent extent estimate in int32\n";
+
+    invalidate_cache();
+    bool found = false;
+    for (size_t i = 0; i < func.args().size(); i++) {
+        if (var.name() == func.args()[i]) {
+            found = true;
+        }
+    }
+    user_assert(found)
+        << "Can't provide an estimate on variable " << var.name()
+        << " of function " << name()
+        << " because " << var.name()
+        << " is not one of the pure variables of " << name() << ".\n";
+
+    // A later estimate on the same variable replaces an earlier one.
+    std::vector<Bound> &estimates = func.schedule().estimates();
+    for (Bound &b : estimates) {
+        if (b.var == var.name()) {
+            b.min = cast<int32_t>(min);
+            b.extent = cast<int32_t>(extent);
+            return *this;
+        }
+    }
+    Bound b = {var.name(), cast<int32_t>(min), cast<int32_t>(extent), Expr(), Expr()};
+    estimates.push_back(b);
+    return *this;
+}
+
 Func &Func::align_bounds(Var var, Expr modulus, Expr remainder) {
     user_assert(modulus.defined()) << "modulus is undefined\n";
     user_assert(remainder.defined()) << "remainder is undefined\n";
@@ -2297,6 +2360,25 @@ Func &Func::tile(VarOrRVar x, VarOrRVar y,
     return *this;
 }
 
+Func &Func::tile(VarOrRVar x, VarOrRVar y,
+                 VarOrRVar xo, VarOrRVar yo,
+                 VarOrRVar xi, VarOrRVar yi,
+                 CacheLevel fit_in,
+                 TailStrategy tail) {
+    invalidate_cache();
+    Stage(func.definition(), name(), args(), func.schedule()).tile(x, y, xo, yo, xi, yi, fit_in, tail);
+    return *this;
+}
+
+Func &Func::tile(VarOrRVar x, VarOrRVar y,
+                 VarOrRVar xi, VarOrRVar yi,
+                 CacheLevel fit_in,
+                 TailStrategy tail) {
+    invalidate_cache();
+    Stage(func.definition(), name(), args(), func.schedule()).tile(x, y, xi, yi, fit_in, tail);
+    return *this;
+}
+
 Func &Func::reorder(const std::vector<VarOrRVar> &vars) {
     invalidate_cache();
     Stage(func.definition(), name(), args(), func.schedule()).reorder(vars);
@@ -2600,6 +2682,17 @@ Func &Func::compute_root() {
     return compute_at(LoopLevel::root());
 }
 
+Func &Func::compute_with(Stage s, VarOrRVar var) {
+    invalidate_cache();
+    vector<string> tmp = split_string(s.name(), ".update(");
+    internal_assert(!tmp.empty() && !tmp[0].empty());
+    int stage = tmp.size() > 1 ? atoi(tmp[1].c_str()) + 1 : 0;
+    user_assert(tmp[0] != name())
+        << "Func " << name() << " cannot be computed with itself.\n";
+    func.schedule().fuse_level() = FuseLoopLevel(tmp[0], stage, var.name());
+    return *this;
+}
+
 Func &Func::store_at(LoopLevel loop_level) {
     invalidate_cache();
     func.schedule().store_level() = loop_level;
@@ -2618,6 +2711,12 @@ Func &Func::store_root() {
     return store_at(LoopLevel::root());
 }
 
+Func &Func::store_in(MemoryType memory_type) {
+    invalidate_cache();
+    func.schedule().memory_type() = memory_type;
+    return *this;
+}
+
 Func &Func::accelerate(vector<Func> inputs,
                        Var compute_var, Var store_var,
                        vector<Func> taps) {
@@ -3307,6 +3406,10 @@ void *Func::compile_jit(const Target &target) {
     return pipeline().compile_jit(target);
 }
 
+void Func::specialize_on_demand(int hot_threshold, int max_variants) {
+    pipeline().specialize_on_demand(hot_threshold, max_variants);
+}
+
 EXPORT Var _("_");
 EXPORT Var _0("_0"), _1("_1"), _2("_2"), _3("_3"), _4("_4"),
            _5("_5"), _6("_6"), _7("_7"), _8("_8"), _9("_9");
@@ -194,6 +194,15 @@ public:
                        VarOrRVar xi, VarOrRVar yi,
                        Expr xfactor, Expr yfactor,
                        TailStrategy tail = TailStrategy::Auto);
+    EXPORT Stage &tile(VarOrRVar x, VarOrRVar y,
+                       VarOrRVar xo, VarOrRVar yo,
+                       VarOrRVar xi, VarOrRVar yi,
+                       CacheLevel fit_in,
+                       TailStrategy tail = TailStrategy::Auto);
+    EXPORT Stage &tile(VarOrRVar x, VarOrRVar y,
+                       VarOrRVar xi, VarOrRVar yi,
+                       CacheLevel fit_in,
+                       TailStrategy tail = TailStrategy::Auto);
     EXPORT Stage &reorder(const std::vector<VarOrRVar> &vars);
 
     template <typename... Args>
@@ -747,6 +756,11 @@ public:
      */
     EXPORT void *compile_jit(const Target &target = get_jit_target_from_environment());
 
+    /** Compile specialized versions of this Func for the argument
+     * values it is realized with most often. See
+     * \ref Pipeline::specialize_on_demand */
+    EXPORT void specialize_on_demand(int hot_threshold = 4, int max_variants = 8);
+
     /** Set the error handler function that be called in the case of
      * runtime errors during halide pipelines. If you are compiling
      * statically, you can also just define your own function with
@@ -1208,6 +1222,14 @@ public:
      * runtime error will occur when you try to run your pipeline. */
     EXPORT Func &bound(Var var, Expr min, Expr extent);
 
+    /** Provide an estimate of the range over which a function will be
+     * evaluated, for use by the automatic scheduler (see
+     * \ref Pipeline::auto_schedule). Estimates are required on every
+     * dimension of a pipeline's outputs. Unlike \ref Func::bound,
+     * this does not constrain the code generated: the pipeline still
+     * works for any size. */
+    EXPORT Func &estimate(Var var, Expr min, Expr extent);
+
     /** Expand the region computed so that the min coordinates is
      * congruent to 'remainder' modulo 'modulus', and the extent is a
      * multiple of 'modulus'. For example, f.align_bounds(x, 2) forces
@@ -1242,6 +1264,35 @@ public:
                       Expr xfactor, Expr yfactor,
                       TailStrategy tail = TailStrategy::Auto);
 
+    /** Tile two dimensions as above, with a tile size chosen when the
+     * pipeline is lowered, so that the data one tile reads and writes
+     * fits in the given level of the cache of the target. The tile
+     * size is a power of two, and is computed from the regions of
+     * the inputs of this Func that one tile needs. It does not count
+     * the Funcs computed inside the tile. x and y should be
+     * dimensions of the definition, rather than the result of
+     * another split. E.g:
+     *
+     \code
+     f.tile(x, y, xo, yo, xi, yi, CacheLevel::L2).vectorize(xi, 8);
+     \endcode
+     *
+     * Lowering for a target that specifies the sizes of its caches
+     * (see \ref Target::l1_cache_size) uses those, and otherwise
+     * uses typical sizes. */
+    EXPORT Func &tile(VarOrRVar x, VarOrRVar y,
+                      VarOrRVar xo, VarOrRVar yo,
+                      VarOrRVar xi, VarOrRVar yi,
+                      CacheLevel fit_in,
+                      TailStrategy tail = TailStrategy::Auto);
+
+    /** A shorter form of the cache-sized tile, which reuses the old
+     * variable names as the new outer dimensions */
+    EXPORT Func &tile(VarOrRVar x, VarOrRVar y,
+                      VarOrRVar xi, VarOrRVar yi,
+                      CacheLevel fit_in,
+                      TailStrategy tail = TailStrategy::Auto);
+
     /** Reorder variables to have the given nesting order, from
      * innermost out */
     EXPORT Func &reorder(const std::vector<VarOrRVar> &vars);
@@ -1817,12 +1868,47 @@ public:
      */
     EXPORT Func &compute_root();
 
+    /** Compute the pure definition of this Func in the same loop nest
+     * as a stage of another, sibling Func, fusing the loops of the
+     * two from the outermost one down to and including the loop over
+     * var. The fused loops iterate over the union of the regions
+     * required of the two, and each side is guarded to only compute
+     * its own region. This means inputs shared by the two are read
+     * once while they are still in cache. This Func takes on the
+     * compute level of the other, and its store level if none has
+     * been set. Neither Func may depend on the other, and this Func
+     * must not have update definitions or specializations. For
+     * example, to compute g alongside f one scanline at a time:
+     \code
+     f(x, y) = in(x, y) + 1;
+     g(x, y) = in(x, y) * 2;
+     f.compute_root();
+     g.compute_with(f, y);
+     \endcode
+     */
+    EXPORT Func &compute_with(Stage s, VarOrRVar var);
+
     /** Use the halide_memoization_cache_... interface to store a
      *  computed version of this function across invocations of the
      *  Func.
      */
     EXPORT Func &memoize();
 
+    /** Produce this Func asynchronously in a separate task that runs
+     * concurrently with the loop nest that consumes it. The producer
+     * and consumer are forked at the level the Func is stored at
+     * (see \ref Func::store_at), and every loop between the store
+     * and compute levels is run twice: once producing the Func,
+     * releasing a counting semaphore after each computed region, and
+     * once consuming it, acquiring the semaphore before each region
+     * is used. The loops between the store level and the compute
+     * level must be serial. If the storage of the Func is folded
+     * (see \ref Func::fold_storage), the producer also waits for the
+     * consumer to be done with a slot before it overwrites it. This
+     * is useful for overlapping a serial or I/O-bound producer with
+     * the work of its consumer. The Func must not be inlined. */
+    EXPORT Func &async();
+
 
     /** Allocate storage for this function within f's loop over
      * var. Scheduling storage is optional, and can be used to
@@ -1933,6 +2019,19 @@ public:
      * outside the outermost loop. */
     EXPORT Func &store_root();
 
+    /** Set the type of memory this Func should be stored in. The
+     * default, MemoryType::Auto, puts small constant-sized
+     * allocations on the stack and the rest on the heap.
+     * MemoryType::Stack and MemoryType::Register require that the
+     * bounds of the Func's storage are constant; the latter also
+     * requires that every access to it is at a constant index once
+     * unrolled loops are unrolled, so that it can be kept in
+     * registers. MemoryType::LockedCache allocates using the
+     * halide_locked_cache_malloc and halide_locked_cache_free
+     * runtime functions, which can be overridden to allocate fast
+     * scratch memory on accelerators. */
+    EXPORT Func &store_in(MemoryType memory_type);
+
     /** Schedule a function onto the hardware accelerator.
      * Extract the pipeline from inputs to this function.
      * In addition, compute_var and store_var, specify
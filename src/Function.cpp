@@ -943,6 +943,38 @@ public:
     SubstituteScheduleParamExprs() = default;
 };
 
+class SubstituteConstants : public IRMutator {
+    const map<string, Expr> &constants;
+
+    using IRMutator::visit;
+
+    // Only references to a scalar parameter, or to a field of a
+    // buffer parameter, are replaced. A pure or reduction variable
+    // may share a parameter's name.
+    bool refers_to_param(const Variable *v) {
+        if (!v->param.defined()) {
+            return false;
+        }
+        if (v->param.is_buffer()) {
+            return starts_with(v->name, v->param.name() + ".");
+        } else {
+            return v->name == v->param.name();
+        }
+    }
+
+    void visit(const Variable *v) override {
+        auto it = constants.find(v->name);
+        if (it != constants.end() && refers_to_param(v)) {
+            expr = it->second;
+        } else {
+            expr = v;
+        }
+    }
+
+public:
+    SubstituteConstants(const map<string, Expr> &c) : constants(c) {}
+};
+
 
 } // anonymous namespace
 
@@ -969,5 +1001,18 @@ Function &Function::substitute_schedule_param_exprs() {
     return *this;
 }
 
+Function &Function::substitute_constants(const map<string, Expr> &constants) {
+    if (constants.empty()) {
+        return *this;
+    }
+    SubstituteConstants sub_constants(constants);
+    contents->mutate(&sub_constants);
+    return *this;
+}
+
+Stmt substitute_constants(const map<string, Expr> &constants, Stmt s) {
+    return SubstituteConstants(constants).mutate(s);
+}
+
 }
 }
@@ -285,8 +285,20 @@ public:
     /** Find all Vars that are placeholders for ScheduleParams and substitute in
      * the corresponding constant value. */
     EXPORT Function &substitute_schedule_param_exprs();
+
+    /** Replace all references to the scalar parameters and buffer
+     * parameter fields named by the keys of the map with the
+     * corresponding values, in the definitions and schedule of this
+     * function. */
+    EXPORT Function &substitute_constants(const std::map<std::string, Expr> &constants);
 };
 
+/** Replace all references to the scalar parameters and buffer
+ * parameter fields named by the keys of the map with the
+ * corresponding values in a statement, as
+ * Function::substitute_constants does for a Function. */
+EXPORT Stmt substitute_constants(const std::map<std::string, Expr> &constants, Stmt s);
+
 }}
 
 #endif
@@ -527,7 +527,7 @@ public:
             // Individual shared allocations.
             for (SharedAllocation alloc : allocations) {
                 s = Allocate::make(shared_mem_name + "_" + alloc.name,
-                                   alloc.type, {alloc.size}, const_true(), s);
+                                   alloc.type, MemoryType::Auto, {alloc.size}, const_true(), s);
             }
         } else {
             // One big combined shared allocation.
@@ -553,7 +553,7 @@ public:
 
             // Add a dummy allocation at the end to get the total size
             Expr total_size = Variable::make(Int(32), "group_" + std::to_string(mem_allocs.size()-1) + ".shared_offset");
-            s = Allocate::make(shared_mem_name, UInt(8), {total_size}, const_true(), s);
+            s = Allocate::make(shared_mem_name, UInt(8), MemoryType::Auto, {total_size}, const_true(), s);
 
             // Define an offset for each allocation. The offsets are in
             // elements, not bytes, so that the stores and loads can use
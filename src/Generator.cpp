@@ -3,6 +3,7 @@
 #include <set>
 
 #include "Generator.h"
+#include "LoopProfile.h"
 #include "Outputs.h"
 #include "Simplify.h"
 
@@ -781,12 +782,15 @@ const std::map<std::string, LoopLevel> &get_halide_looplevel_enum_map() {
 }
 
 int generate_filter_main(int argc, char **argv, std::ostream &cerr) {
-    const char kUsage[] = "gengen [-g GENERATOR_NAME] [-f FUNCTION_NAME] [-o OUTPUT_DIR] [-r RUNTIME_NAME] [-e EMIT_OPTIONS] [-x EXTENSION_OPTIONS] [-n FILE_BASE_NAME] "
+    const char kUsage[] = "gengen [-g GENERATOR_NAME] [-f FUNCTION_NAME] [-o OUTPUT_DIR] [-r RUNTIME_NAME] [-e EMIT_OPTIONS] [-x EXTENSION_OPTIONS] [-n FILE_BASE_NAME] [-p PROFILE_FILES] "
                           "target=target-string[,target-string...] [generator_arg=value [...]]\n\n"
                           "  -e  A comma separated list of files to emit. Accepted values are "
                           "[assembly, bitcode, cpp, h, html, o, static_library, stmt, cpp_stub]. If omitted, default value is [static_library, h].\n"
                           "  -x  A comma separated list of file extension pairs to substitute during file naming, "
-                          "in the form [.old=.new[,.old2=.new2]]\n";
+                          "in the form [.old=.new[,.old2=.new2]]\n"
+                          "  -p  A comma separated list of loop profiles to guide the compile. A loop profile is written "
+                          "when the generated code is built with the profile_loops target feature and run on "
+                          "representative inputs.\n";
 
     std::map<std::string, std::string> flags_info = { { "-f", "" },
                                                       { "-g", "" },
@@ -794,7 +798,8 @@ int generate_filter_main(int argc, char **argv, std::ostream &cerr) {
                                                       { "-e", "" },
                                                       { "-n", "" },
                                                       { "-x", "" },
-                                                      { "-r", "" }};
+                                                      { "-r", "" },
+                                                      { "-p", "" }};
     std::map<std::string, std::string> generator_args;
 
     for (int i = 1; i < argc; ++i) {
@@ -919,6 +924,16 @@ int generate_filter_main(int argc, char **argv, std::ostream &cerr) {
         emit_options.substitutions[subst_pair[0]] = subst_pair[1];
     }
 
+    for (const std::string &p : split_string(flags_info["-p"], ",")) {
+        if (p.empty()) {
+            continue;
+        }
+        if (!load_loop_profile(p)) {
+            cerr << "Could not read loop profile: " << p << "\n";
+            return 1;
+        }
+    }
+
     const auto target_string = generator_args["target"];
     auto target_strings = split_string(target_string, ",");
     std::vector<Target> targets;
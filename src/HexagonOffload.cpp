@@ -857,6 +857,11 @@ Stmt inject_hexagon_rpc(Stmt s, const Target &host_target,
             target = target.with_feature(i);
         }
     }
+    // There are no hardware counters or timeline on the DSP, but the
+    // host still expects the device to run the sampling profiler.
+    if (host_target.features_any_of({Target::ProfileHWCounters, Target::ProfileTimeline})) {
+        target = target.with_feature(Target::Profile);
+    }
 
     Module hexagon_module("hexagon_code", target);
     InjectHexagonRpc injector(hexagon_module);
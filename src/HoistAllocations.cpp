@@ -0,0 +1,197 @@
+#include "HoistAllocations.h"
+#include "CodeGen_Internal.h"
+#include "Debug.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Simplify.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// Does an expression call anything that may do work, such as an
+// extern stage or a copy to or from a device? The runtime functions
+// that only read or fill in a halide_buffer_t do no work.
+class CallsExtern : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Call *op) {
+        if ((op->call_type == Call::Extern || op->call_type == Call::ExternCPlusPlus) &&
+            !starts_with(op->name, "_halide_buffer_")) {
+            result = true;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    bool result = false;
+};
+
+bool calls_extern(Expr e) {
+    CallsExtern c;
+    e.accept(&c);
+    return c.result;
+}
+
+// Is this the result of calling an extern stage in bounds query mode?
+// Those calls only fill in buffer shapes on the stack, and the sizes
+// of the allocations depend on them, so they still run in query mode.
+bool is_bounds_query_result(const LetStmt *op) {
+    const AssertStmt *check = op->body.as<AssertStmt>();
+    const Call *error = check ? check->message.as<Call>() : nullptr;
+    return error && error->name == "halide_error_bounds_inference_call_failed";
+}
+
+// Walks the statements that run once per call to the pipeline,
+// giving the heap allocations among them a slot in the pipeline
+// instance. Everything that does work is guarded so that it does not
+// run in query mode.
+class HoistAllocations : public IRMutator {
+    Expr user_context, instance, is_query;
+
+    using IRMutator::visit;
+
+    // Only hoist the allocations that would otherwise call
+    // halide_malloc.
+    bool should_hoist(const Allocate *op) {
+        if (op->new_expr.defined() || !op->free_function.empty() || op->extents.empty()) {
+            return false;
+        }
+        if (op->memory_type == MemoryType::Heap) {
+            return true;
+        } else if (op->memory_type != MemoryType::Auto) {
+            return false;
+        }
+        int32_t elements = Allocate::constant_allocation_size(op->extents, op->name);
+        return (elements == 0 ||
+                !can_allocation_fit_on_stack((int64_t)elements * op->type.bytes()));
+    }
+
+    Stmt skip_in_query_mode(Stmt s) {
+        return IfThenElse::make(!is_query, s);
+    }
+
+    void visit(const Allocate *op) {
+        Stmt body = mutate(op->body);
+        if (!should_hoist(op)) {
+            stmt = Allocate::make(op->name, op->type, op->memory_type, op->extents, op->condition, body,
+                                  op->new_expr, op->free_function);
+            return;
+        }
+
+        // Compute the size in bytes, checking that it does not
+        // exceed the largest buffer size the target allows. The
+        // check against the quotient can't overflow.
+        Expr max_size = make_const(UInt(64), target.maximum_buffer_size());
+        Expr size = make_const(UInt(64), op->type.bytes());
+        Expr size_check = const_true();
+        for (Expr e : op->extents) {
+            Expr extent = cast(UInt(64), e);
+            size_check = size_check && (extent == 0 || size <= max_size / extent);
+            size = size * extent;
+        }
+        size_check = simplify(size_check);
+        size = simplify(size);
+
+        int slot = slots++;
+        debug(3) << "Giving allocation " << op->name << " slot " << slot << " in the pipeline instance\n";
+        Expr new_expr = Call::make(Handle(), "halide_pipeline_instance_malloc",
+                                   {user_context, instance, slot,
+                                    select(op->condition, size, make_zero(UInt(64)))},
+                                   Call::Extern);
+        stmt = Allocate::make(op->name, op->type, op->memory_type, op->extents, op->condition, body,
+                              new_expr, "halide_pipeline_instance_free");
+
+        if (!is_one(size_check)) {
+            Expr error = Call::make(Int(32), "halide_error_buffer_allocation_too_large",
+                                    {op->name, size, max_size}, Call::Extern);
+            stmt = Block::make(AssertStmt::make(size_check, error), stmt);
+        }
+    }
+
+    void visit(const For *op) {
+        stmt = skip_in_query_mode(op);
+    }
+
+    void visit(const Store *op) {
+        stmt = skip_in_query_mode(op);
+    }
+
+    void visit(const Evaluate *op) {
+        if (is_no_op(op)) {
+            stmt = op;
+        } else {
+            stmt = skip_in_query_mode(op);
+        }
+    }
+
+    void visit(const Prefetch *op) {
+        stmt = skip_in_query_mode(op);
+    }
+
+    // In query mode, the allocations all point at the instance
+    // itself, so nothing that could write to them may run. Extern
+    // stages and device copies are called in lets, with the result
+    // checked by an assert.
+    void visit(const LetStmt *op) {
+        Stmt body = mutate(op->body);
+        Expr value = op->value;
+        if (calls_extern(value) && !is_bounds_query_result(op)) {
+            value = Call::make(value.type(), Call::if_then_else,
+                               {is_query, make_zero(value.type()), value}, Call::Intrinsic);
+        }
+        if (value.same_as(op->value) && body.same_as(op->body)) {
+            stmt = op;
+        } else {
+            stmt = LetStmt::make(op->name, value, body);
+        }
+    }
+
+    void visit(const AssertStmt *op) {
+        if (calls_extern(op->condition)) {
+            stmt = skip_in_query_mode(op);
+        } else {
+            stmt = op;
+        }
+    }
+
+    void visit(const Free *op) {
+        stmt = op;
+    }
+
+public:
+    const Target &target;
+    int slots = 0;
+
+    HoistAllocations(const Target &t, const string &query_name) : target(t) {
+        user_context = Variable::make(type_of<void *>(), "__user_context");
+        instance = Variable::make(type_of<halide_pipeline_instance_t *>(), "__pipeline_instance");
+        is_query = Variable::make(Int(32), query_name) != 0;
+    }
+};
+
+}  // namespace
+
+Stmt hoist_allocations(Stmt s, const Target &t) {
+    string query_name = unique_name("pipeline_instance_query");
+    HoistAllocations hoister(t, query_name);
+    Stmt hoisted = hoister.mutate(s);
+    debug(3) << "Hoisted " << hoister.slots << " allocations into the pipeline instance\n";
+
+    // A negative result is an error code, and a positive one means
+    // the call is a query.
+    Expr user_context = Variable::make(type_of<void *>(), "__user_context");
+    Expr instance = Variable::make(type_of<halide_pipeline_instance_t *>(), "__pipeline_instance");
+    Expr query_var = Variable::make(Int(32), query_name);
+    Expr begin = Call::make(Int(32), "halide_pipeline_instance_begin",
+                            {user_context, instance}, Call::Extern);
+    hoisted = Block::make(AssertStmt::make(query_var >= 0, query_var), hoisted);
+    return LetStmt::make(query_name, begin, hoisted);
+}
+
+}
+}
@@ -0,0 +1,28 @@
+#ifndef HALIDE_HOIST_ALLOCATIONS_H
+#define HALIDE_HOIST_ALLOCATIONS_H
+
+/** \file
+ * Defines the lowering pass that keeps the intermediate buffers of a
+ * pipeline in a halide_pipeline_instance_t from one call to the next.
+ */
+
+#include "IR.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Allocate the heap buffers that live outside of any loop from the
+ * halide_pipeline_instance_t passed to the pipeline as
+ * __pipeline_instance, so that they are reused across calls instead
+ * of being allocated and freed by each one. Each such buffer gets its
+ * own slot in the instance. Also make the pipeline skip all of its
+ * work, including extern stages and device copies, when the instance
+ * is in query mode, after the sizes of the buffers have been
+ * reported. */
+Stmt hoist_allocations(Stmt s, const Target &t);
+
+}
+}
+
+#endif
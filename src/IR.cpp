@@ -375,7 +375,8 @@ Stmt Provide::make(const std::string &name, const std::vector<Expr> &values, con
     return node;
 }
 
-Stmt Allocate::make(const std::string &name, Type type, const std::vector<Expr> &extents,
+Stmt Allocate::make(const std::string &name, Type type, MemoryType memory_type,
+                    const std::vector<Expr> &extents,
                     Expr condition, Stmt body,
                     Expr new_expr, const std::string &free_function) {
     for (size_t i = 0; i < extents.size(); i++) {
@@ -389,6 +390,7 @@ Stmt Allocate::make(const std::string &name, Type type, const std::vector<Expr>
     Allocate *node = new Allocate;
     node->name = name;
     node->type = type;
+    node->memory_type = memory_type;
     node->extents = extents;
     node->new_expr = std::move(new_expr);
     node->free_function = free_function;
@@ -342,6 +342,7 @@ struct Provide : public StmtNode<Provide> {
 struct Allocate : public StmtNode<Allocate> {
     std::string name;
     Type type;
+    MemoryType memory_type;
     std::vector<Expr> extents;
     Expr condition;
 
@@ -356,7 +357,8 @@ struct Allocate : public StmtNode<Allocate> {
     std::string free_function;
     Stmt body;
 
-    EXPORT static Stmt make(const std::string &name, Type type, const std::vector<Expr> &extents,
+    EXPORT static Stmt make(const std::string &name, Type type, MemoryType memory_type,
+                            const std::vector<Expr> &extents,
                             Expr condition, Stmt body,
                             Expr new_expr = Expr(), const std::string &free_function = std::string());
 
@@ -1,4 +1,7 @@
+#include <string.h>
+
 #include "IREquality.h"
+#include "IRMutator.h"
 #include "IRVisitor.h"
 #include "IROperator.h"
 
@@ -389,6 +392,7 @@ void IRComparer::visit(const Allocate *op) {
     const Allocate *s = stmt.as<Allocate>();
 
     compare_names(s->name, op->name);
+    compare_scalar(s->memory_type, op->memory_type);
     compare_expr_vector(s->extents, op->extents);
     compare_stmt(s->body, op->body);
     compare_expr(s->condition, op->condition);
@@ -502,6 +506,209 @@ bool ExprWithCompareCache::operator<(const ExprWithCompareCache &other) const {
     return cmp.result == IRComparer::LessThan;
 }
 
+namespace {
+
+/** The fields of an Expr node other than its children, plus the
+ * identities of its children. Two nodes with equal signatures are
+ * equal if their children are canonical. */
+class ShallowSignature : public IRVisitor {
+    using IRVisitor::visit;
+
+    void add(const Expr &e) {
+        words.push_back((uint64_t)(uintptr_t)e.get());
+    }
+
+    void add(const void *p) {
+        words.push_back((uint64_t)(uintptr_t)p);
+    }
+
+    void add_image(const Buffer<> &image) {
+        add(image.defined() ? (const void *)image.get() : nullptr);
+    }
+
+    void visit(const IntImm *op) {words.push_back((uint64_t)op->value);}
+    void visit(const UIntImm *op) {words.push_back(op->value);}
+    void visit(const FloatImm *op) {
+        // Compare the bits, so that 0.0f and -0.0f stay distinct.
+        uint64_t bits;
+        memcpy(&bits, &op->value, sizeof(bits));
+        words.push_back(bits);
+    }
+    void visit(const StringImm *op) {names.push_back(op->value);}
+    void visit(const Cast *op) {add(op->value);}
+
+    void visit(const Variable *op) {
+        names.push_back(op->name);
+        params.push_back(op->param);
+        add_image(op->image);
+        domains.push_back(op->reduction_domain);
+    }
+
+    template<typename T>
+    void visit_binary_operator(const T *op) {
+        add(op->a);
+        add(op->b);
+    }
+
+    void visit(const Add *op) {visit_binary_operator(op);}
+    void visit(const Sub *op) {visit_binary_operator(op);}
+    void visit(const Mul *op) {visit_binary_operator(op);}
+    void visit(const Div *op) {visit_binary_operator(op);}
+    void visit(const Mod *op) {visit_binary_operator(op);}
+    void visit(const Min *op) {visit_binary_operator(op);}
+    void visit(const Max *op) {visit_binary_operator(op);}
+    void visit(const EQ *op) {visit_binary_operator(op);}
+    void visit(const NE *op) {visit_binary_operator(op);}
+    void visit(const LT *op) {visit_binary_operator(op);}
+    void visit(const LE *op) {visit_binary_operator(op);}
+    void visit(const GT *op) {visit_binary_operator(op);}
+    void visit(const GE *op) {visit_binary_operator(op);}
+    void visit(const And *op) {visit_binary_operator(op);}
+    void visit(const Or *op) {visit_binary_operator(op);}
+
+    void visit(const Not *op) {add(op->a);}
+
+    void visit(const Select *op) {
+        add(op->condition);
+        add(op->true_value);
+        add(op->false_value);
+    }
+
+    void visit(const Load *op) {
+        names.push_back(op->name);
+        add(op->predicate);
+        add(op->index);
+        add_image(op->image);
+        params.push_back(op->param);
+    }
+
+    void visit(const Ramp *op) {
+        add(op->base);
+        add(op->stride);
+        words.push_back(op->lanes);
+    }
+
+    void visit(const Broadcast *op) {
+        add(op->value);
+        words.push_back(op->lanes);
+    }
+
+    void visit(const Call *op) {
+        names.push_back(op->name);
+        for (const Expr &arg : op->args) {
+            add(arg);
+        }
+        words.push_back(op->call_type);
+        add(op->func.get());
+        words.push_back(op->value_index);
+        add_image(op->image);
+        params.push_back(op->param);
+    }
+
+    void visit(const Let *op) {
+        names.push_back(op->name);
+        add(op->value);
+        add(op->body);
+    }
+
+    void visit(const Shuffle *op) {
+        for (const Expr &v : op->vectors) {
+            add(v);
+        }
+        for (int i : op->indices) {
+            words.push_back((uint64_t)i);
+        }
+    }
+
+public:
+    std::vector<uint64_t> words;
+    std::vector<string> names;
+    std::vector<Parameter> params;
+    std::vector<ReductionDomain> domains;
+
+    ShallowSignature(const Expr &e) {
+        const Type &t = e.type();
+        words.push_back((uint64_t)e.get()->node_type);
+        words.push_back(((uint64_t)t.code() << 32) | ((uint64_t)t.bits() << 16) | (uint64_t)t.lanes());
+        add(t.handle_type);
+        e.accept(this);
+    }
+
+    uint64_t hash() const {
+        uint64_t h = 14695981039346656037ULL;
+        for (uint64_t w : words) {
+            h = (h ^ w) * 1099511628211ULL;
+        }
+        for (const string &n : names) {
+            h = (h ^ std::hash<string>()(n)) * 1099511628211ULL;
+        }
+        return h;
+    }
+
+    bool operator==(const ShallowSignature &other) const {
+        if (words != other.words ||
+            names != other.names ||
+            params.size() != other.params.size() ||
+            domains.size() != other.domains.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < params.size(); i++) {
+            if (!params[i].same_as(other.params[i])) {
+                return false;
+            }
+        }
+        for (size_t i = 0; i < domains.size(); i++) {
+            if (!domains[i].same_as(other.domains[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/** Rebuild a node with all of its children replaced by their
+ * canonical nodes. */
+class InternChildren : public IRMutator {
+    ExprInterner *interner;
+
+public:
+    using IRMutator::mutate;
+
+    Expr mutate(const Expr &e) {
+        return e.defined() ? interner->intern(e) : e;
+    }
+
+    /** Rebuild the top-level node only. */
+    Expr rebuild(const Expr &e) {
+        e.accept(this);
+        return expr;
+    }
+
+    InternChildren(ExprInterner *i) : interner(i) {}
+};
+
+} // namespace
+
+Expr ExprInterner::intern(const Expr &e) {
+    if (!e.defined() || is_interned(e)) {
+        return e;
+    }
+
+    Expr node = InternChildren(this).rebuild(e);
+
+    ShallowSignature sig(node);
+    uint64_t h = sig.hash();
+    auto range = table.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (ShallowSignature(it->second) == sig) {
+            return it->second;
+        }
+    }
+    table.emplace(h, node);
+    interned.insert(node.get());
+    return node;
+}
+
 // Testing code
 namespace {
 
@@ -560,6 +767,29 @@ void ir_equality_test() {
     e2 = e2*e2 + e2;
     check_not_equal(e1, e2);
 
+    {
+        // Interning equal Exprs built separately gives the same node,
+        // and so does interning the canonical node again.
+        ExprInterner interner;
+        Expr a = interner.intern(Ramp::make(x * 2 + 1, 4, 3));
+        Expr b = interner.intern(Ramp::make(x * 2 + 1, 4, 3));
+        internal_assert(a.same_as(b) && interner.is_interned(a));
+        internal_assert(interner.intern(a).same_as(a));
+        internal_assert(interner.intern(x * 2).same_as(a.as<Ramp>()->base.as<Add>()->a));
+
+        // Variables that refer to different Parameters are equal by
+        // value, but must not be merged.
+        Parameter p1(Int(32), false, 0, "p"), p2(Int(32), false, 0, "p");
+        Expr v1 = interner.intern(Variable::make(Int(32), "p", p1));
+        Expr v2 = interner.intern(Variable::make(Int(32), "p", p2));
+        internal_assert(!v1.same_as(v2));
+        internal_assert(interner.intern(Variable::make(Int(32), "p", p1)).same_as(v1));
+
+        // 0.0f and -0.0f are different constants.
+        internal_assert(!interner.intern(FloatImm::make(Float(32), 0.0)).same_as(
+                             interner.intern(FloatImm::make(Float(32), -0.0))));
+    }
+
     debug(0) << "ir_equality_test passed\n";
 }
 
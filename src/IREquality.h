@@ -5,6 +5,9 @@
  * Methods to test Exprs and Stmts for equality of value
  */
 
+#include <unordered_map>
+#include <unordered_set>
+
 #include "IR.h"
 
 namespace Halide {
@@ -112,7 +115,38 @@ EXPORT bool graph_equal(const Expr &a, const Expr &b);
 EXPORT bool graph_equal(const Stmt &a, const Stmt &b);
 // @}
 
+/** A table of hash-consed Exprs. Interning an Expr returns a
+ * canonical node that is structurally equal to it, such that any two
+ * Exprs that are equal (including the Parameters, Buffers and
+ * Functions they refer to) intern to the same node, and so can be
+ * compared with same_as. The canonical nodes are built bottom-up, so
+ * every subexpression of an interned Expr is also interned. The
+ * table holds a reference to everything in it until it is
+ * cleared. */
+class ExprInterner {
+    std::unordered_multimap<uint64_t, Expr> table;
+    std::unordered_set<const IRNode *> interned;
+
+public:
+    /** Get the canonical node for an Expr, adding it to the table
+     * (along with its subexpressions) if need be. */
+    EXPORT Expr intern(const Expr &e);
+
+    /** Check if an Expr is already a canonical node. */
+    bool is_interned(const Expr &e) const {
+        return interned.count(e.get()) > 0;
+    }
+
+    /** The number of canonical nodes in the table. */
+    size_t size() const {
+        return interned.size();
+    }
 
+    void clear() {
+        table.clear();
+        interned.clear();
+    }
+};
 
 EXPORT void ir_equality_test();
 
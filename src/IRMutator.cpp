@@ -279,7 +279,7 @@ void IRMutator::visit(const Allocate *op) {
         new_expr.same_as(op->new_expr)) {
         stmt = op;
     } else {
-        stmt = Allocate::make(op->name, op->type, new_extents, std::move(condition),
+        stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents, std::move(condition),
                               std::move(body), std::move(new_expr), op->free_function);
     }
 }
@@ -100,6 +100,27 @@ ostream &operator<<(ostream &out, const DeviceAPI &api) {
     return out;
 }
 
+ostream &operator<<(ostream &out, const MemoryType &t) {
+    switch (t) {
+    case MemoryType::Auto:
+        out << "Auto";
+        break;
+    case MemoryType::Heap:
+        out << "Heap";
+        break;
+    case MemoryType::Stack:
+        out << "Stack";
+        break;
+    case MemoryType::Register:
+        out << "Register";
+        break;
+    case MemoryType::LockedCache:
+        out << "LockedCache";
+        break;
+    }
+    return out;
+}
+
 ostream &operator<<(ostream &stream, const LoopLevel &loop_level) {
     return stream << "loop_level("
         << (loop_level.defined() ? loop_level.to_string() : "undefined") 
@@ -132,7 +153,7 @@ void IRPrinter::test() {
                                                          {string("y"), y, 3}, Call::Extern));
     Stmt block = Block::make(assertion, pipeline);
     Stmt let_stmt = LetStmt::make("y", 17, block);
-    Stmt allocate = Allocate::make("buf", f32, {1023}, const_true(), let_stmt);
+    Stmt allocate = Allocate::make("buf", f32, MemoryType::Auto, {1023}, const_true(), let_stmt);
 
     ostringstream source;
     source << allocate;
@@ -623,6 +644,9 @@ void IRPrinter::visit(const Allocate *op) {
         print(op->extents[i]);
     }
     stream << "]";
+    if (op->memory_type != MemoryType::Auto) {
+        stream << " in " << op->memory_type;
+    }
     if (!is_one(op->condition)) {
         stream << " if ";
         print(op->condition);
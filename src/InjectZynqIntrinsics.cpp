@@ -95,7 +95,7 @@ class InjectCmaIntrinsics : public IRMutator {
             // Create a new Allocation scope inside the buffer
             // creation, use the host pointer as the allocation and
             // set the destructor to a nop.
-            inner_body = Allocate::make(op->name, op->type, op->extents, op->condition, inner_body,
+            inner_body = Allocate::make(op->name, op->type, op->memory_type, op->extents, op->condition, inner_body,
                                         Call::make(Handle(), Call::buffer_get_host,
                                                    { Variable::make(type_of<struct halide_buffer_t *>(), op->name + ".buffer") },
                                                    Call::Extern),
@@ -1,3 +1,9 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
 #include <string>
 #include <stdint.h>
 #include <mutex>
@@ -14,6 +20,7 @@
 #include "Debug.h"
 #include "LLVM_Output.h"
 #include "CodeGen_LLVM.h"
+#include "CompilerProfiling.h"
 #include "Pipeline.h"
 
 
@@ -160,7 +167,8 @@ JITModule::Symbol compile_and_get_function(ExecutionEngine &ee, const string &na
         internal_error << "Compiling " << name << " returned nullptr\n";
     }
 
-    JITModule::Symbol symbol(f, fn->getFunctionType());
+    // Functions loaded from the JIT cache have no llvm::Function.
+    JITModule::Symbol symbol(f, fn ? fn->getFunctionType() : nullptr);
 
     debug(2) << "Function " << name << " is at " << f << "\n";
 
@@ -233,6 +241,185 @@ public:
     }
 };
 
+// Hands MCJIT previously compiled object code in place of compiling
+// a module, or captures the object code it produces.
+class JITObjectCache : public llvm::ObjectCache {
+public:
+    std::string object;
+
+    void notifyObjectCompiled(const llvm::Module *, llvm::MemoryBufferRef obj) override {
+        object.assign(obj.getBufferStart(), obj.getBufferSize());
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *) override {
+        if (object.empty()) {
+            return nullptr;
+        }
+        return llvm::MemoryBuffer::getMemBufferCopy(object);
+    }
+};
+
+// The on-disk JIT cache, enabled by setting HL_JIT_CACHE_DIR. Each
+// entry holds the object code for one lowered Module, along with
+// enough of the llvm::Module it came from to configure an execution
+// engine for it. Entries are keyed on the full text of the lowered
+// Module, so a hit skips codegen and LLVM entirely, but not lowering.
+const char *jit_cache_magic = "halide_jit_cache 1";
+
+struct JITCacheEntry {
+    std::string key, triple, data_layout, mcpu, mattrs, soft_float_abi, object;
+
+    std::vector<std::string *> fields() {
+        return {&key, &triple, &data_layout, &mcpu, &mattrs, &soft_float_abi, &object};
+    }
+};
+
+// The full text of a lowered Module.
+string jit_module_text(const Module &m) {
+    std::ostringstream key;
+    // Make sure distinct float constants print distinctly.
+    key << std::setprecision(std::numeric_limits<double>::max_digits10);
+    // The printed Module only names the arguments.
+    for (const auto &f : m.functions()) {
+        for (const auto &arg : f.args) {
+            key << f.name << " " << arg.name << " " << (int)arg.kind
+                << " " << (int)arg.dimensions << " " << arg.type << "\n";
+        }
+    }
+    key << m;
+    return key.str();
+}
+
+string jit_cache_key(const Module &m) {
+    std::ostringstream key;
+    // Object code from a different build of Halide or LLVM may call
+    // the runtime differently. The runtime is identified by a hash of
+    // its bitcode, so rebuilding Halide without changing the runtime
+    // keeps the cache.
+    key << jit_cache_magic << " llvm " << LLVM_VERSION
+        << " runtime " << std::hex << get_runtime_bitcode_hash() << std::dec << "\n";
+    key << jit_module_text(m);
+    return key.str();
+}
+
+string jit_cache_path(const string &dir, const string &key) {
+    // 64-bit FNV-1a. Collisions are caught by comparing the stored key.
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : key) {
+        hash = (hash ^ (uint8_t)c) * 1099511628211ULL;
+    }
+    std::ostringstream path;
+    path << dir << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".hjc";
+    return path.str();
+}
+
+bool read_jit_cache_entry(const string &path, JITCacheEntry &entry) {
+    std::ifstream in(path, std::ios::binary);
+    string magic;
+    if (!std::getline(in, magic) || magic != jit_cache_magic) {
+        return false;
+    }
+    for (string *field : entry.fields()) {
+        size_t size = 0;
+        if (!(in >> size) || in.get() != '\n') {
+            return false;
+        }
+        field->resize(size);
+        if (size > 0 && !in.read(&(*field)[0], size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void write_jit_cache_entry(const string &path, JITCacheEntry &entry) {
+    // Write to a temporary file and rename it into place, so that
+    // concurrent processes never see a partial entry.
+    string tmp = path + "." + std::to_string(std::chrono::high_resolution_clock::now().time_since_epoch().count()) + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        out << jit_cache_magic << "\n";
+        for (string *field : entry.fields()) {
+            out << field->size() << "\n";
+            out.write(field->data(), field->size());
+        }
+        if (!out) {
+            debug(1) << "Could not write JIT cache entry " << tmp << "\n";
+            out.close();
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+    }
+}
+
+// Make an empty module configured like the one a cache entry was
+// compiled from.
+std::unique_ptr<llvm::Module> make_module_for_cache_entry(const JITCacheEntry &entry, const string &name,
+                                                          llvm::LLVMContext &context) {
+    std::unique_ptr<llvm::Module> module(new llvm::Module(name, context));
+    module->setTargetTriple(entry.triple);
+    module->setDataLayout(entry.data_layout);
+    module->addModuleFlag(llvm::Module::Warning, "halide_use_soft_float_abi", entry.soft_float_abi == "1" ? 1 : 0);
+    module->addModuleFlag(llvm::Module::Warning, "halide_mcpu", llvm::MDString::get(context, entry.mcpu));
+    module->addModuleFlag(llvm::Module::Warning, "halide_mattrs", llvm::MDString::get(context, entry.mattrs));
+    return module;
+}
+
+// Find the $N suffix that unique_name adds to a part of a name, if
+// any. Other names, such as t123, may also have been made up by
+// unique_name, but they can't be told apart from names the user
+// chose, so they are left alone.
+size_t made_up_suffix(const string &name) {
+    size_t dollar = name.rfind('$');
+    if (dollar == string::npos || dollar + 1 == name.size()) {
+        return string::npos;
+    }
+    for (size_t i = dollar + 1; i < name.size(); i++) {
+        if (!isdigit(name[i])) {
+            return string::npos;
+        }
+    }
+    return dollar;
+}
+
+}
+
+string jit_variant_key(const Module &m) {
+    string key = jit_module_text(m);
+
+    // Renumber the $N suffixes of names in order of first
+    // appearance, so that lowering the same pipeline twice gives the
+    // same key even though unique_name never hands out a name twice.
+    std::map<string, int> renamed;
+    string result;
+    result.reserve(key.size());
+    auto is_name_char = [](char c) {
+        return isalnum(c) || c == '_' || c == '$';
+    };
+    size_t i = 0;
+    while (i < key.size()) {
+        if (!is_name_char(key[i])) {
+            result += key[i++];
+            continue;
+        }
+        size_t j = i;
+        while (j < key.size() && is_name_char(key[j])) {
+            j++;
+        }
+        string part = key.substr(i, j - i);
+        size_t dollar = made_up_suffix(part);
+        if (dollar != string::npos) {
+            auto it = renamed.emplace(part, (int)renamed.size()).first;
+            result += part.substr(0, dollar) + "$%" + std::to_string(it->second);
+        } else {
+            result += part;
+        }
+        i = j;
+    }
+    return result;
 }
 
 JITModule::JITModule() {
@@ -242,16 +429,62 @@ JITModule::JITModule() {
 JITModule::JITModule(const Module &m, const LoweredFunc &fn,
                      const std::vector<JITModule> &dependencies) {
     jit_module = new JITModuleContents();
-    std::unique_ptr<llvm::Module> llvm_module(compile_module_to_llvm_module(m, jit_module->context));
+
+    // Modules that embed buffers or external code aren't cached,
+    // because the key doesn't capture their contents.
+    string cache_dir = get_env_variable("HL_JIT_CACHE_DIR");
+    bool use_cache = (!cache_dir.empty() &&
+                      m.buffers().empty() &&
+                      m.submodules().empty() &&
+                      m.external_code().empty());
+    JITObjectCache object_cache;
+    JITCacheEntry entry;
+    string cache_path;
+    bool cache_hit = false;
+
+    std::unique_ptr<llvm::Module> llvm_module;
+    if (use_cache) {
+        string key = jit_cache_key(m);
+        cache_path = jit_cache_path(cache_dir, key);
+        if (read_jit_cache_entry(cache_path, entry) && entry.key == key) {
+            debug(1) << "Loading " << fn.name << " from JIT cache entry " << cache_path << "\n";
+            llvm_module = make_module_for_cache_entry(entry, fn.name, jit_module->context);
+            object_cache.object = std::move(entry.object);
+            cache_hit = true;
+        } else {
+            entry = JITCacheEntry();
+            entry.key = key;
+        }
+    }
+
+    if (!cache_hit) {
+        llvm_module = compile_module_to_llvm_module(m, jit_module->context);
+        if (use_cache) {
+            llvm::TargetOptions options;
+            get_target_options(*llvm_module, options, entry.mcpu, entry.mattrs);
+            entry.soft_float_abi = options.FloatABIType == llvm::FloatABI::Soft ? "1" : "0";
+            entry.triple = llvm_module->getTargetTriple();
+            entry.data_layout = llvm_module->getDataLayout().getStringRepresentation();
+        }
+    }
+
     std::vector<JITModule> deps_with_runtime = dependencies;
     std::vector<JITModule> shared_runtime = JITSharedRuntime::get(llvm_module.get(), m.target());
     deps_with_runtime.insert(deps_with_runtime.end(), shared_runtime.begin(), shared_runtime.end());
-    compile_module(std::move(llvm_module), fn.name, m.target(), deps_with_runtime);
+    compile_module(std::move(llvm_module), fn.name, m.target(), deps_with_runtime,
+                   std::vector<std::string>(), use_cache ? &object_cache : nullptr);
+
+    if (use_cache && !cache_hit && !object_cache.object.empty()) {
+        debug(1) << "Saving " << fn.name << " to JIT cache entry " << cache_path << "\n";
+        entry.object = std::move(object_cache.object);
+        write_jit_cache_entry(cache_path, entry);
+    }
 }
 
 void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &function_name, const Target &target,
                                const std::vector<JITModule> &dependencies,
-                               const std::vector<std::string> &requested_exports) {
+                               const std::vector<std::string> &requested_exports,
+                               llvm::ObjectCache *object_cache) {
 
     // Ensure that LLVM is initialized
     CodeGen_LLVM::initialize_llvm();
@@ -269,6 +502,8 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     DataLayout initial_module_data_layout = m->getDataLayout();
     string module_name = m->getModuleIdentifier();
 
+    CompilerProfiler profiler("jit " + module_name);
+
     llvm::EngineBuilder engine_builder((std::move(m)));
     engine_builder.setTargetOptions(options);
     engine_builder.setErrorStr(&error_string);
@@ -300,6 +535,7 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
 
     if (!ee) std::cerr << error_string << "\n";
     internal_assert(ee) << "Couldn't create execution engine\n";
+    profiler.lap("creating execution engine");
 
     // Do any target-specific initialization
     std::vector<llvm::JITEventListener *> listeners;
@@ -314,6 +550,14 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
         ee->RegisterJITEventListener(listeners[i]);
     }
 
+    if (object_cache) {
+        ee->setObjectCache(object_cache);
+        // Produce the object code up front. Object code supplied by
+        // the cache has no llvm::Functions for MCJIT to compile on
+        // demand when looking up symbols below.
+        ee->finalizeObject();
+    }
+
     // Retrieve function pointers from the compiled module (which also
     // triggers compilation)
     debug(1) << "JIT compiling " << module_name << "\n";
@@ -336,6 +580,7 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     debug(2) << "Finalizing object\n";
     ee->finalizeObject();
     memory_manager->work_around_llvm_bugs();
+    profiler.lap("jit compiling");
 
     // Do any target-specific post-compilation module meddling
     for (size_t i = 0; i < listeners.size(); i++) {
@@ -15,6 +15,7 @@
 
 namespace llvm {
 class Module;
+class ObjectCache;
 class Type;
 }
 
@@ -107,11 +108,14 @@ struct JITModule {
     EXPORT Symbol find_symbol_by_name(const std::string &) const;
 
     /** Take an llvm module and compile it. The requested exports will
-        be available via the exports method. */
+        be available via the exports method. If an object cache is
+        given, it is offered the object code produced, and may supply
+        previously compiled object code in place of compiling mod. */
     EXPORT void compile_module(std::unique_ptr<llvm::Module> mod,
                                const std::string &function_name, const Target &target,
                                const std::vector<JITModule> &dependencies = std::vector<JITModule>(),
-                               const std::vector<std::string> &requested_exports = std::vector<std::string>());
+                               const std::vector<std::string> &requested_exports = std::vector<std::string>(),
+                               llvm::ObjectCache *object_cache = nullptr);
 
     /** Encapsulate device (GPU) and buffer interactions. */
     EXPORT void memoization_cache_set_size(int64_t size) const;
@@ -120,6 +124,13 @@ struct JITModule {
     EXPORT bool compiled() const;
 };
 
+/** A key for the code a Module compiles to when jitted. It is the
+ * text of the Module with the $N suffixes that unique_name adds to
+ * names renumbered, so that two Modules lowered from the same Funcs
+ * with the same schedules usually get the same key. Names without
+ * such a suffix are kept as they are. */
+EXPORT std::string jit_variant_key(const Module &m);
+
 typedef int (*halide_task)(void *user_context, int, uint8_t *);
 
 struct JITHandlers {
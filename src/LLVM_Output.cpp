@@ -4,6 +4,7 @@
 #include "CodeGen_LLVM.h"
 #include "CodeGen_C.h"
 #include "CodeGen_Internal.h"
+#include "CompilerProfiling.h"
 
 #include <iostream>
 #include <fstream>
@@ -25,6 +26,8 @@ void emit_file(llvm::Module &module, Internal::LLVMOStream& out, llvm::TargetMac
     Internal::debug(1) << "emit_file.Compiling to native code...\n";
     Internal::debug(2) << "Target triple: " << module.getTargetTriple() << "\n";
 
+    Internal::CompilerProfiler profiler("native codegen " + module.getModuleIdentifier());
+
     // Get the target specific parser.
     auto target_machine = Internal::make_target_machine(module);
     internal_assert(target_machine.get()) << "Could not allocate target machine!\n";
@@ -65,6 +68,7 @@ void emit_file(llvm::Module &module, Internal::LLVMOStream& out, llvm::TargetMac
     target_machine->addPassesToEmitFile(pass_manager, out, file_type);
 
     pass_manager.run(module);
+    profiler.lap("emitting native code");
 }
 
 std::unique_ptr<llvm::Module> compile_module_to_llvm_module(const Module &module, llvm::LLVMContext &context) {
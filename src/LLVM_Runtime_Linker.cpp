@@ -29,11 +29,33 @@ std::unique_ptr<llvm::Module> parse_bitcode_file(llvm::StringRef buf, llvm::LLVM
     return result;
 }
 
+// The runtime bitcode built into libHalide, gathered so that it can
+// be hashed.
+struct Initmod {
+    const unsigned char *data;
+    const int *length;
+};
+
+vector<Initmod> &all_initmods() {
+    static vector<Initmod> initmods;
+    return initmods;
+}
+
+struct RegisterInitmod {
+    RegisterInitmod(const unsigned char *data, const int *length) {
+        all_initmods().push_back({data, length});
+    }
+};
+
 }  // namespace
 
 #define DECLARE_INITMOD(mod)                                                              \
     extern "C" unsigned char halide_internal_initmod_##mod[];                             \
     extern "C" int halide_internal_initmod_##mod##_length;                                \
+    namespace {                                                                           \
+    RegisterInitmod register_initmod_##mod(halide_internal_initmod_##mod,                 \
+                                           &halide_internal_initmod_##mod##_length);      \
+    }                                                                                     \
     std::unique_ptr<llvm::Module> get_initmod_##mod(llvm::LLVMContext *context) {         \
         llvm::StringRef sb = llvm::StringRef((const char *)halide_internal_initmod_##mod, \
                                              halide_internal_initmod_##mod##_length);     \
@@ -81,6 +103,7 @@ DECLARE_CPP_INITMOD(cuda)
 DECLARE_CPP_INITMOD(destructors)
 DECLARE_CPP_INITMOD(device_interface)
 DECLARE_CPP_INITMOD(errors)
+DECLARE_CPP_INITMOD(fake_perf_counters)
 DECLARE_CPP_INITMOD(fake_thread_pool)
 DECLARE_CPP_INITMOD(float16_t)
 DECLARE_CPP_INITMOD(gcd_thread_pool)
@@ -90,6 +113,9 @@ DECLARE_CPP_INITMOD(ios_io)
 DECLARE_CPP_INITMOD(linux_clock)
 DECLARE_CPP_INITMOD(linux_host_cpu_count)
 DECLARE_CPP_INITMOD(linux_opengl_context)
+DECLARE_CPP_INITMOD(linux_perf_counters)
+DECLARE_CPP_INITMOD(locked_cache_allocator)
+DECLARE_CPP_INITMOD(loop_profile)
 DECLARE_CPP_INITMOD(matlab)
 DECLARE_CPP_INITMOD(metadata)
 DECLARE_CPP_INITMOD(mingw_math)
@@ -106,6 +132,7 @@ DECLARE_CPP_INITMOD(osx_clock)
 DECLARE_CPP_INITMOD(osx_get_symbol)
 DECLARE_CPP_INITMOD(osx_host_cpu_count)
 DECLARE_CPP_INITMOD(osx_opengl_context)
+DECLARE_CPP_INITMOD(pipeline_instance)
 DECLARE_CPP_INITMOD(posix_allocator)
 DECLARE_CPP_INITMOD(posix_clock)
 DECLARE_CPP_INITMOD(posix_error_handler)
@@ -161,6 +188,7 @@ DECLARE_NO_INITMOD(metal_objc_x86)
 #ifdef WITH_ARM
 DECLARE_LL_INITMOD(arm)
 DECLARE_LL_INITMOD(arm_no_neon)
+DECLARE_CPP_INITMOD(arena_allocator)
 DECLARE_CPP_INITMOD(arm_cpu_features)
 #else
 DECLARE_NO_INITMOD(arm)
@@ -722,6 +750,9 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
             modules.push_back(get_initmod_tracing(c, bits_64, debug));
             modules.push_back(get_initmod_write_debug_image(c, bits_64, debug));
             modules.push_back(get_initmod_cache(c, bits_64, debug));
+            modules.push_back(get_initmod_locked_cache_allocator(c, bits_64, debug));
+            modules.push_back(get_initmod_arena_allocator(c, bits_64, debug));
+            modules.push_back(get_initmod_pipeline_instance(c, bits_64, debug));
             modules.push_back(get_initmod_to_string(c, bits_64, debug));
 
             modules.push_back(get_initmod_device_interface(c, bits_64, debug));
@@ -731,8 +762,14 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
             modules.push_back(get_initmod_errors(c, bits_64, debug));
 
             if (t.arch != Target::MIPS && t.os != Target::NoOS) {
-                // MIPS doesn't support the atomics the profiler requires.
+                // MIPS doesn't support the atomics the profilers require.
                 modules.push_back(get_initmod_profiler(c, bits_64, debug));
+                modules.push_back(get_initmod_loop_profile(c, bits_64, debug));
+                if (t.os == Target::Linux && t.arch == Target::X86) {
+                    modules.push_back(get_initmod_linux_perf_counters(c, bits_64, debug));
+                } else {
+                    modules.push_back(get_initmod_fake_perf_counters(c, bits_64, debug));
+                }
             }
 
             if (t.has_feature(Target::MSAN)) {
@@ -780,7 +817,7 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
             if (t.has_feature(Target::AVX)) {
                 modules.push_back(get_initmod_x86_avx_ll(c));
             }
-            if (t.has_feature(Target::Profile)) {
+            if (t.features_any_of({Target::Profile, Target::ProfileHWCounters, Target::ProfileTimeline})) {
                 modules.push_back(get_initmod_profiler_inlined(c, bits_64, debug));
             }
         }
@@ -974,6 +1011,20 @@ void add_bitcode_to_module(llvm::LLVMContext *context, llvm::Module &module,
         internal_error << "Failure linking in additional module: " << name << "\n";
     }
 }
+
+uint64_t get_runtime_bitcode_hash() {
+    // 64-bit FNV-1a, computed the first time it is needed.
+    static uint64_t hash = []() {
+        uint64_t h = 14695981039346656037ULL;
+        for (const Initmod &m : all_initmods()) {
+            for (int i = 0; i < *m.length; i++) {
+                h = (h ^ m.data[i]) * 1099511628211ULL;
+            }
+        }
+        return h;
+    }();
+    return hash;
+}
   
 }  // namespace Internal
 
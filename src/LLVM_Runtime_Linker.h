@@ -26,6 +26,10 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target, llvm::LLVMCo
 /** Create an llvm module containing the support code for ptx device. */
 std::unique_ptr<llvm::Module> get_initial_module_for_ptx_device(Target, llvm::LLVMContext *c);
 
+/** A hash of all of the runtime bitcode built into this copy of
+ * Halide. It changes whenever the runtime does. */
+uint64_t get_runtime_bitcode_hash();
+
 /** Link a block of llvm bitcode into an llvm module. */
 void add_bitcode_to_module(llvm::LLVMContext *context, llvm::Module &module,
                            const std::vector<uint8_t> &bitcode, const std::string &name);
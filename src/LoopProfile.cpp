@@ -0,0 +1,203 @@
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#include "LoopProfile.h"
+#include "Debug.h"
+#include "Error.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Util.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::pair;
+using std::string;
+
+namespace {
+
+const char *const marker_name = "halide_loop_profile_marker";
+
+struct LoadedLoopProfiles {
+    std::mutex mutex;
+    // Maps from (pipeline name, loop name) -> counts.
+    map<pair<string, string>, LoopProfile> counts;
+    bool loaded_environment = false;
+};
+
+LoadedLoopProfiles &loaded_loop_profiles() {
+    static LoadedLoopProfiles profiles;
+    return profiles;
+}
+
+bool load_loop_profile_locked(LoadedLoopProfiles &profiles, const string &filename) {
+    std::ifstream in(filename);
+    if (!in) {
+        return false;
+    }
+    string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        string pipeline_name, name;
+        LoopProfile p;
+        if (!(fields >> pipeline_name >> name >> p.entries >> p.iterations)) {
+            debug(1) << "Ignoring malformed line in loop profile " << filename << ": " << line << "\n";
+            continue;
+        }
+        LoopProfile &counts = profiles.counts[{pipeline_name, name}];
+        counts.entries += p.entries;
+        counts.iterations += p.iterations;
+    }
+    debug(1) << "Loaded loop profile " << filename << "\n";
+    return true;
+}
+
+// The loop profiles named by HL_USE_LOOP_PROFILE are loaded the first
+// time any profile is looked up.
+void load_environment_locked(LoadedLoopProfiles &profiles) {
+    if (profiles.loaded_environment) {
+        return;
+    }
+    profiles.loaded_environment = true;
+    for (const string &filename : split_string(get_env_variable("HL_USE_LOOP_PROFILE"), ",")) {
+        if (!filename.empty()) {
+            user_assert(load_loop_profile_locked(profiles, filename))
+                << "Could not read the loop profile " << filename
+                << " named by HL_USE_LOOP_PROFILE\n";
+        }
+    }
+}
+
+class InjectLoopProfiling : public IRMutator {
+    using IRMutator::visit;
+
+    Expr counters = Variable::make(Handle(), "loop_profile_counters");
+
+    bool in_device_code = false;
+
+    Stmt record(const string &name, Expr iterations) {
+        int idx;
+        auto it = indices.find(name);
+        if (it == indices.end()) {
+            idx = (int)indices.size();
+            indices[name] = idx;
+        } else {
+            idx = it->second;
+        }
+        return Evaluate::make(Call::make(Int(32), "halide_loop_profile_record",
+                                         {counters, idx, iterations}, Call::Extern));
+    }
+
+    void visit(const For *op) {
+        if (in_device_code ||
+            (op->device_api != DeviceAPI::None &&
+             op->device_api != DeviceAPI::Host)) {
+            // Nothing is counted in code for other devices, but the
+            // markers inside it still need removing.
+            bool old_in_device_code = in_device_code;
+            in_device_code = true;
+            IRMutator::visit(op);
+            in_device_code = old_in_device_code;
+            return;
+        }
+        IRMutator::visit(op);
+        stmt = Block::make(record(op->name, max(op->extent, 0)), stmt);
+    }
+
+    void visit(const Evaluate *op) {
+        const Call *call = op->value.as<Call>();
+        if (call && call->name == marker_name) {
+            const StringImm *name = call->args[0].as<StringImm>();
+            internal_assert(name);
+            if (in_device_code) {
+                stmt = Evaluate::make(0);
+            } else {
+                stmt = record(name->value, 1);
+            }
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+public:
+    map<string, int> indices;  // maps from loop name -> index in the counters.
+};
+
+}  // namespace
+
+bool load_loop_profile(const string &filename) {
+    LoadedLoopProfiles &profiles = loaded_loop_profiles();
+    std::lock_guard<std::mutex> lock(profiles.mutex);
+    return load_loop_profile_locked(profiles, filename);
+}
+
+void clear_loop_profiles() {
+    LoadedLoopProfiles &profiles = loaded_loop_profiles();
+    std::lock_guard<std::mutex> lock(profiles.mutex);
+    profiles.counts.clear();
+}
+
+bool find_loop_profile(const string &pipeline_name, const string &name, LoopProfile *result) {
+    LoadedLoopProfiles &profiles = loaded_loop_profiles();
+    std::lock_guard<std::mutex> lock(profiles.mutex);
+    load_environment_locked(profiles);
+
+    if (!pipeline_name.empty()) {
+        auto it = profiles.counts.find({pipeline_name, name});
+        if (it == profiles.counts.end()) {
+            return false;
+        }
+        *result = it->second;
+        return true;
+    }
+
+    bool found = false;
+    *result = LoopProfile();
+    for (const auto &p : profiles.counts) {
+        if (p.first.second == name) {
+            result->entries += p.second.entries;
+            result->iterations += p.second.iterations;
+            found = true;
+        }
+    }
+    return found;
+}
+
+Stmt loop_profile_marker(const string &name) {
+    return Evaluate::make(Call::make(Int(32), marker_name, {name}, Call::Extern));
+}
+
+Stmt inject_loop_profiling(Stmt s, const string &pipeline_name) {
+    InjectLoopProfiling profiling;
+    s = profiling.mutate(s);
+
+    int num_counters = (int)profiling.indices.size();
+    if (num_counters == 0) {
+        return s;
+    }
+
+    Expr names_buf = Variable::make(Handle(), "loop_profile_names");
+    // If the counters can't be allocated, this reports an error and
+    // returns null, and the pipeline runs without counting anything.
+    Expr start = Call::make(Handle(), "halide_loop_profile_pipeline_start",
+                            {pipeline_name, num_counters, names_buf}, Call::Extern);
+    s = LetStmt::make("loop_profile_counters", start, s);
+
+    for (const pair<string, int> &p : profiling.indices) {
+        s = Block::make(Store::make("loop_profile_names", p.first, p.second, Parameter(), const_true()), s);
+    }
+    s = Block::make(s, Free::make("loop_profile_names"));
+    s = Allocate::make("loop_profile_names", Handle(), MemoryType::Auto, {num_counters}, const_true(), s);
+
+    return s;
+}
+
+}
+}
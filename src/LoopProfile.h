@@ -0,0 +1,67 @@
+#ifndef HALIDE_LOOP_PROFILE_H
+#define HALIDE_LOOP_PROFILE_H
+
+/** \file
+ * Defines the lowering pass that counts loop trip counts when the
+ * target has the profile_loops feature, and the loop profiles that
+ * guide later compiles.
+ *
+ * A pipeline compiled with 'host-profile_loops' counts, for each loop
+ * and each specialization of each Func, how many times it was entered
+ * and how many iterations it ran in total. The counts are written to
+ * the file named by HL_LOOP_PROFILE_FILE (default
+ * halide_loop_profile.txt) at process exit, or after each realization
+ * when jitting, in this format:
+ *
+ * \<pipeline_name\> \<loop or specialization name\> \<entries\> \<iterations\>
+ *
+ * Loops are named as in the lowered code (e.g. f.s0.y). A
+ * specialization is named after the stage it specializes and its
+ * index in the list of specializations (e.g. f.s0.specialization.1).
+ *
+ * Giving the profile to a later compile, with the -p flag of a
+ * Generator or the HL_USE_LOOP_PROFILE environment variable (a comma
+ * separated list of files), puts the most frequently taken
+ * specialization of each stage first, doesn't partition loops that
+ * usually run too few iterations for a steady state to pay off, and
+ * tells LLVM how many iterations each loop usually runs.
+ */
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** The counts recorded for a loop or specialization. */
+struct LoopProfile {
+    uint64_t entries = 0, iterations = 0;
+};
+
+/** Add the counts in a loop profile file to those already
+ * loaded. Returns false if the file can't be read. */
+EXPORT bool load_loop_profile(const std::string &filename);
+
+/** Forget all loaded loop profiles. */
+EXPORT void clear_loop_profiles();
+
+/** Look up the counts for a loop or specialization of the named
+ * pipeline in the loaded loop profiles. An empty pipeline name sums
+ * the counts for that name from all pipelines. Returns false if there
+ * are none. */
+EXPORT bool find_loop_profile(const std::string &pipeline_name, const std::string &name,
+                              LoopProfile *result);
+
+/** A statement that marks where a specialization starts running, for
+ * inject_loop_profiling to count. */
+Stmt loop_profile_marker(const std::string &name);
+
+/** Count the entries and iterations of every loop that runs on the
+ * host, and the specializations marked with loop_profile_marker. Done
+ * before loop partitioning, so that the counts of a loop cover its
+ * prologue, steady state and epilogue. */
+Stmt inject_loop_profiling(Stmt s, const std::string &pipeline_name);
+
+}
+}
+
+#endif
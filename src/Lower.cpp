@@ -8,10 +8,13 @@
 #include "AddImageChecks.h"
 #include "AddParameterChecks.h"
 #include "AllocationBoundsInference.h"
+#include "AsyncProducers.h"
 #include "Bounds.h"
 #include "BoundsInference.h"
 #include "CSE.h"
+#include "CacheTiles.h"
 #include "CanonicalizeGPUVars.h"
+#include "CompilerProfiling.h"
 #include "Debug.h"
 #include "DebugArguments.h"
 #include "DebugToFile.h"
@@ -25,6 +28,7 @@
 #include "FuseGPUThreadLoops.h"
 #include "FuzzFloatStores.h"
 #include "HexagonOffload.h"
+#include "HoistAllocations.h"
 #include "InferArguments.h"
 #include "InjectHostDevBufferCopies.h"
 #include "InjectImageIntrinsics.h"
@@ -35,9 +39,12 @@
 #include "IROperator.h"
 #include "IRPrinter.h"
 #include "LoopCarry.h"
+#include "LoopProfile.h"
 #include "Memoization.h"
+#include "OptimizeShuffles.h"
 #include "PartitionLoops.h"
 #include "PerfectNestedLoops.h"
+#include "PoolAllocations.h"
 #include "Prefetch.h"
 #include "Profiling.h"
 #include "Qualify.h"
@@ -78,12 +85,15 @@ using std::map;
 
 Module lower(const vector<Function> &output_funcs, const string &pipeline_name, const Target &t,
              const vector<Argument> &args, const Internal::LoweredFunc::LinkageType linkage_type,
-             const vector<IRMutator *> &custom_passes) {
+             const vector<IRMutator *> &custom_passes,
+             const map<string, Expr> &constants) {
     std::vector<std::string> namespaces;
     std::string simple_pipeline_name = extract_namespaces(pipeline_name, namespaces);
 
     Module result_module(simple_pipeline_name, t);
 
+    CompilerProfiler profiler("lowering " + pipeline_name);
+
     // Compute an environment
     map<string, Function> env;
     for (Function f : output_funcs) {
@@ -105,30 +115,42 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
         f.second.substitute_schedule_param_exprs();
     }
 
+    // Substitute in the values of any arguments we're specializing on.
+    for (auto &f : env) {
+        f.second.substitute_constants(constants);
+    }
+
     // Substitute in wrapper Funcs
     env = wrap_func_calls(env);
 
+    // Choose the sizes of the tiles that should fit in the cache
+    resolve_cache_tiles(env, t);
+
     // Compute a realization order
     vector<string> order = realization_order(outputs, env);
 
     // Try to simplify the RHS/LHS of a function definition by propagating its
     // specializations' conditions
     simplify_specializations(env);
+    profiler.lap("preparing the functions");
 
     bool any_memoized = false;
 
     debug(1) << "Creating initial loop nests...\n";
-    Stmt s = schedule_functions(outputs, order, env, t, any_memoized);
+    Stmt s = schedule_functions(outputs, order, env, pipeline_name, t, any_memoized);
     debug(2) << "Lowering after creating initial loop nests:\n" << s << '\n';
+    profiler.lap("creating initial loop nests", s);
 
     debug(1) << "Canonicalizing GPU var names...\n";
     s = canonicalize_gpu_vars(s);
     debug(2) << "Lowering after canonicalizing GPU var names:\n" << s << '\n';
+    profiler.lap("canonicalizing GPU var names", s);
 
     if (any_memoized) {
         debug(1) << "Injecting memoization...\n";
         s = inject_memoization(s, env, pipeline_name, outputs);
         debug(2) << "Lowering after injecting memoization:\n" << s << '\n';
+        profiler.lap("injecting memoization", s);
     } else {
         debug(1) << "Skipping injecting memoization...\n";
     }
@@ -136,21 +158,25 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     debug(1) << "Injecting tracing...\n";
     s = inject_tracing(s, pipeline_name, env, outputs, t);
     debug(2) << "Lowering after injecting tracing:\n" << s << '\n';
+    profiler.lap("injecting tracing", s);
 
     debug(1) << "Adding checks for parameters\n";
     s = add_parameter_checks(s, t);
     debug(2) << "Lowering after injecting parameter checks:\n" << s << '\n';
+    profiler.lap("injecting parameter checks", s);
 
     // Compute the maximum and minimum possible value of each
     // function. Used in later bounds inference passes.
     debug(1) << "Computing bounds of each function's value\n";
     FuncValueBounds func_bounds = compute_function_value_bounds(order, env);
+    profiler.lap("computing bounds of each function's value", s);
 
     // The checks will be in terms of the symbols defined by bounds
     // inference.
     debug(1) << "Adding checks for images\n";
     s = add_image_checks(s, outputs, t, order, env, func_bounds);
     debug(2) << "Lowering after injecting image checks:\n" << s << '\n';
+    profiler.lap("injecting image checks", s);
 
     // This pass injects nested definitions of variable names, so we
     // can't simplify statements from here until we fix them up. (We
@@ -159,18 +185,31 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     debug(1) << "Performing computation bounds inference...\n";
     s = bounds_inference(s, outputs, order, env, func_bounds, inlined_stages, t);
     debug(2) << "Lowering after computation bounds inference:\n" << s << '\n';
+    profiler.lap("computation bounds inference", s);
+
+    if (!constants.empty()) {
+        // The bounds of the outputs, and the checks on the buffer
+        // arguments, now refer to the fields of the buffers.
+        debug(1) << "Substituting constant arguments...\n";
+        s = substitute_constants(constants, s);
+        debug(2) << "Lowering after substituting constant arguments:\n" << s << '\n';
+        profiler.lap("substituting constant arguments", s);
+    }
 
     debug(1) << "Performing sliding window optimization...\n";
     s = sliding_window(s, env);
     debug(2) << "Lowering after sliding window:\n" << s << '\n';
+    profiler.lap("sliding window", s);
 
     debug(1) << "Performing allocation bounds inference...\n";
     s = allocation_bounds_inference(s, env, func_bounds);
     debug(2) << "Lowering after allocation bounds inference:\n" << s << '\n';
+    profiler.lap("allocation bounds inference", s);
 
     debug(1) << "Removing code that depends on undef values...\n";
     s = remove_undef(s);
     debug(2) << "Lowering after removing code that depends on undef values:\n" << s << "\n\n";
+    profiler.lap("removing code that depends on undef values", s);
 
     // This uniquifies the variable names, so we're good to simplify
     // after this point. This lets later passes assume syntactic
@@ -178,6 +217,7 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     debug(1) << "Uniquifying variable names...\n";
     s = uniquify_variable_names(s);
     debug(2) << "Lowering after uniquifying variable names:\n" << s << "\n\n";
+    profiler.lap("uniquifying variable names", s);
 
     {
         // passes specific to HLS backend
@@ -191,36 +231,49 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
         }
 
         debug(2) << "Lowering after HLS optimization:\n" << s << '\n';
+        profiler.lap("HLS optimization", s);
     }
 
     debug(1) << "Performing storage folding optimization...\n";
     s = storage_folding(s, env);
     debug(2) << "Lowering after storage folding:\n" << s << '\n';
+    profiler.lap("storage folding", s);
+
+    debug(1) << "Forking asynchronous producers...\n";
+    s = fork_async_producers(s, env);
+    debug(2) << "Lowering after forking asynchronous producers:\n" << s << '\n';
+    profiler.lap("forking asynchronous producers", s);
 
     debug(1) << "Injecting debug_to_file calls...\n";
     s = debug_to_file(s, outputs, env);
     debug(2) << "Lowering after injecting debug_to_file calls:\n" << s << '\n';
+    profiler.lap("injecting debug_to_file calls", s);
 
     debug(1) << "Simplifying...\n"; // without removing dead lets, because storage flattening needs the strides
     s = simplify(s, false);
     debug(2) << "Lowering after first simplification:\n" << s << "\n\n";
+    profiler.lap("first simplification", s);
 
     debug(1) << "Injecting prefetches...\n";
     s = inject_prefetch(s, env);
     debug(2) << "Lowering after injecting prefetches:\n" << s << "\n\n";
+    profiler.lap("injecting prefetches", s);
 
     debug(1) << "Dynamically skipping stages...\n";
     s = skip_stages(s, order);
     debug(2) << "Lowering after dynamically skipping stages:\n" << s << "\n\n";
+    profiler.lap("dynamically skipping stages", s);
 
     debug(1) << "Destructuring tuple-valued realizations...\n";
     s = split_tuples(s, env);
     debug(2) << "Lowering after destructuring tuple-valued realizations:\n" << s << "\n\n";
+    profiler.lap("destructuring tuple-valued realizations", s);
 
     if (t.has_feature(Target::OpenGL)) {
         debug(1) << "Injecting image intrinsics...\n";
         s = inject_image_intrinsics(s, env);
         debug(2) << "Lowering after image intrinsics:\n" << s << "\n\n";
+        profiler.lap("image intrinsics", s);
     }
 
     debug(1) << "Performing storage flattening...\n";
@@ -229,15 +282,18 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
         s = inject_zynq_intrinsics(s, env);
     }
     debug(2) << "Lowering after storage flattening:\n" << s << "\n\n";
+    profiler.lap("storage flattening", s);
 
     debug(1) << "Unpacking buffer arguments...\n";
     s = unpack_buffers(s);
     debug(2) << "Lowering after unpacking buffer arguments...\n";
+    profiler.lap("unpacking buffer arguments", s);
 
     if (any_memoized) {
         debug(1) << "Rewriting memoized allocations...\n";
         s = rewrite_memoized_allocations(s, env);
         debug(2) << "Lowering after rewriting memoized allocations:\n" << s << "\n\n";
+        profiler.lap("rewriting memoized allocations", s);
     } else {
         debug(1) << "Skipping rewriting memoized allocations...\n";
     }
@@ -249,16 +305,19 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
         debug(1) << "Selecting a GPU API for GPU loops...\n";
         s = select_gpu_api(s, t);
         debug(2) << "Lowering after selecting a GPU API:\n" << s << "\n\n";
+        profiler.lap("selecting a GPU API", s);
 
         debug(1) << "Injecting host <-> dev buffer copies...\n";
         s = inject_host_dev_buffer_copies(s, t);
         debug(2) << "Lowering after injecting host <-> dev buffer copies:\n" << s << "\n\n";
+        profiler.lap("injecting host <-> dev buffer copies", s);
     }
 
     if (t.has_feature(Target::OpenGL)) {
         debug(1) << "Injecting OpenGL texture intrinsics...\n";
         s = inject_opengl_intrinsics(s);
         debug(2) << "Lowering after OpenGL intrinsics:\n" << s << "\n\n";
+        profiler.lap("OpenGL intrinsics", s);
     }
 
     if (t.has_gpu_feature() ||
@@ -266,6 +325,7 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
         debug(1) << "Injecting per-block gpu synchronization...\n";
         s = fuse_gpu_thread_loops(s);
         debug(2) << "Lowering after injecting per-block gpu synchronization:\n" << s << "\n\n";
+        profiler.lap("injecting per-block gpu synchronization", s);
     }
 
     debug(1) << "Simplifying...\n";
@@ -273,63 +333,102 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
     s = unify_duplicate_lets(s);
     s = remove_trivial_for_loops(s);
     debug(2) << "Lowering after second simplifcation:\n" << s << "\n\n";
+    profiler.lap("second simplification", s);
+
+    if (t.has_feature(Target::AutoPrefetch)) {
+        debug(1) << "Injecting automatic prefetches...\n";
+        s = inject_auto_prefetches(s, t);
+        debug(2) << "Lowering after injecting automatic prefetches:\n" << s << "\n\n";
+        profiler.lap("injecting automatic prefetches", s);
+    }
 
     debug(1) << "Reduce prefetch dimension...\n";
     s = reduce_prefetch_dimension(s, t);
     debug(2) << "Lowering after reduce prefetch dimension:\n" << s << "\n";
+    profiler.lap("reduce prefetch dimension", s);
 
     debug(1) << "Unrolling...\n";
     s = unroll_loops(s);
     s = simplify(s);
     debug(2) << "Lowering after unrolling:\n" << s << "\n\n";
+    profiler.lap("unrolling", s);
 
     debug(1) << "Vectorizing...\n";
     s = vectorize_loops(s, t);
     s = simplify(s);
     debug(2) << "Lowering after vectorizing:\n" << s << "\n\n";
+    profiler.lap("vectorizing", s);
 
     debug(1) << "Detecting vector interleavings...\n";
     s = rewrite_interleavings(s);
     s = simplify(s);
     debug(2) << "Lowering after rewriting vector interleavings:\n" << s << "\n\n";
+    profiler.lap("rewriting vector interleavings", s);
+
+    if (t.has_feature(Target::ProfileLoops)) {
+        debug(1) << "Injecting loop profiling...\n";
+        s = inject_loop_profiling(s, pipeline_name);
+        debug(2) << "Lowering after injecting loop profiling:\n" << s << "\n\n";
+        profiler.lap("injecting loop profiling", s);
+    }
 
     debug(1) << "Partitioning loops to simplify boundary conditions...\n";
-    s = partition_loops(s);
+    s = partition_loops(s, pipeline_name, t);
     s = unify_duplicate_lets(s);  // try this again as all likely() calls are removed
     s = simplify(s);
     debug(2) << "Lowering after partitioning loops:\n" << s << "\n\n";
+    profiler.lap("partitioning loops", s);
 
     debug(1) << "Trimming loops to the region over which they do something...\n";
     s = trim_no_ops(s);
     debug(2) << "Lowering after loop trimming:\n" << s << "\n\n";
+    profiler.lap("loop trimming", s);
 
     debug(1) << "Injecting early frees...\n";
     s = inject_early_frees(s);
     debug(2) << "Lowering after injecting early frees:\n" << s << "\n\n";
+    profiler.lap("injecting early frees", s);
 
-    if (t.has_feature(Target::Profile)) {
+    if (t.features_any_of({Target::Profile, Target::ProfileHWCounters, Target::ProfileTimeline})) {
         debug(1) << "Injecting profiling...\n";
-        s = inject_profiling(s, pipeline_name);
+        s = inject_profiling(s, pipeline_name, outputs, t);
         debug(2) << "Lowering after injecting profiling:\n" << s << "\n\n";
+        profiler.lap("injecting profiling", s);
+    }
+
+    debug(1) << "Pooling allocations inside parallel tasks...\n";
+    s = pool_allocations(s, t);
+    debug(2) << "Lowering after pooling allocations:\n" << s << "\n\n";
+    profiler.lap("pooling allocations", s);
+
+    if (t.has_feature(Target::PipelineInstance)) {
+        debug(1) << "Hoisting allocations into the pipeline instance...\n";
+        s = hoist_allocations(s, t);
+        debug(2) << "Lowering after hoisting allocations:\n" << s << "\n\n";
+        profiler.lap("hoisting allocations", s);
     }
 
     if (t.has_feature(Target::FuzzFloatStores)) {
         debug(1) << "Fuzzing floating point stores...\n";
         s = fuzz_float_stores(s);
         debug(2) << "Lowering after fuzzing floating point stores:\n" << s << "\n\n";
+        profiler.lap("fuzzing floating point stores", s);
     }
 
     debug(1) << "Simplifying...\n";
     s = common_subexpression_elimination(s);
+    profiler.lap("common subexpression elimination", s);
 
     if (t.has_feature(Target::OpenGL)) {
         debug(1) << "Detecting varying attributes...\n";
         s = find_linear_expressions(s);
         debug(2) << "Lowering after detecting varying attributes:\n" << s << "\n\n";
+        profiler.lap("detecting varying attributes", s);
 
         debug(1) << "Moving varying attribute expressions out of the shader...\n";
         s = setup_gpu_vertex_buffer(s);
         debug(2) << "Lowering after removing varying attributes:\n" << s << "\n\n";
+        profiler.lap("removing varying attributes", s);
     }
 
     {
@@ -337,22 +436,31 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
         debug(1) << "Perfecting nested loops for better inner loop pipelining...\n";
         s = perfect_nested_loops(s);
         debug(2) << "Lowering after perfecting nested loops:\n" << s << "\n\n";
+        profiler.lap("perfecting nested loops", s);
     }
 
     s = remove_dead_allocations(s);
     s = remove_trivial_for_loops(s);
     s = simplify(s);
     debug(1) << "Lowering after final simplification:\n" << s << "\n\n";
+    profiler.lap("final simplification", s);
 
     debug(1) << "Splitting off Hexagon offload...\n";
     s = inject_hexagon_rpc(s, t, result_module);
     debug(2) << "Lowering after splitting off Hexagon offload:\n" << s << '\n';
+    profiler.lap("splitting off Hexagon offload", s);
+
+    debug(1) << "Turning lookups in small tables into shuffles...\n";
+    s = optimize_shuffles(s, t);
+    debug(2) << "Lowering after turning lookups in small tables into shuffles:\n" << s << "\n\n";
+    profiler.lap("turning lookups in small tables into shuffles", s);
 
     if (!custom_passes.empty()) {
         for (size_t i = 0; i < custom_passes.size(); i++) {
             debug(1) << "Running custom lowering pass " << i << "...\n";
             s = custom_passes[i]->mutate(s);
             debug(1) << "Lowering after custom pass " << i << ":\n" << s << "\n\n";
+            profiler.lap("custom pass " + std::to_string(i), s);
         }
     }
 
@@ -427,6 +535,7 @@ Module lower(const vector<Function> &output_funcs, const string &pipeline_name,
 
     // Also append any wrappers for extern stages that expect the old buffer_t
     wrap_legacy_extern_stages(result_module);
+    profiler.lap("building the module");
 
     return result_module;
 }
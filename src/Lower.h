@@ -8,6 +8,7 @@
  */
 
 #include <iterator>
+#include <map>
 
 #include "Argument.h"
 #include "IR.h"
@@ -25,10 +26,14 @@ class IRMutator;
  * contain submodules for computation offloaded to another execution
  * engine or API as well as buffers that are used in the passed in
  * Stmt. Multiple LoweredFuncs are added to support legacy buffer_t
- * calling convention. */
+ * calling convention. The scalar parameters and the fields of the
+ * buffer arguments (e.g. "input.extent.0") named in constants are
+ * assumed to have the given values, which the caller must
+ * guarantee. */
 EXPORT Module lower(const std::vector<Function> &output_funcs, const std::string &pipeline_name, const Target &t,
                     const std::vector<Argument> &args, const Internal::LoweredFunc::LinkageType linkage_type,
-                    const std::vector<IRMutator *> &custom_passes = std::vector<IRMutator *>());
+                    const std::vector<IRMutator *> &custom_passes = std::vector<IRMutator *>(),
+                    const std::map<std::string, Expr> &constants = std::map<std::string, Expr>());
 
 /** Given a halide function with a schedule, create a statement that
  * evaluates it. Automatically pulls in all the functions f depends
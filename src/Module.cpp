@@ -106,6 +106,70 @@ uint64_t target_feature_mask(const Target &target) {
     return feature_mask;
 }
 
+// Compile sequentially when debugging, so that the debug output isn't
+// utterly incomprehensible.
+size_t num_compile_threads() {
+    return (debug::debug_level() > 0) ? 1 : ThreadPool<void>::num_processors_online();
+}
+
+// Can each function in a module be compiled to an object of its own?
+// Internal functions and embedded buffers or code may be referenced
+// from any of the functions, so they would have to be duplicated.
+bool can_compile_functions_separately(const Module &m) {
+    if (m.functions().size() < 2 ||
+        !m.buffers().empty() ||
+        !m.external_code().empty()) {
+        return false;
+    }
+    for (const auto &f : m.functions()) {
+        if (f.linkage == LoweredFunc::Internal) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Optimize and generate code for each function of a module, and for
+// the runtime, in parallel, then archive the objects. The archive
+// lists the objects in the order of the module's functions, so the
+// output doesn't depend on scheduling.
+void compile_functions_to_static_library(const Module &m, const std::string &static_library_name) {
+    TemporaryObjectFileDir temp_dir;
+    std::vector<std::future<void>> futures;
+    ThreadPool<void> pool(num_compile_threads());
+
+    // As in compile_multitarget, the runtime is compiled separately.
+    Target fn_target = m.target().with_feature(Target::NoRuntime);
+    for (size_t i = 0; i < m.functions().size(); i++) {
+        const LoweredFunc &f = m.functions()[i];
+        Module fn_module(f.name, fn_target);
+        fn_module.append(f);
+        Outputs fn_out = Outputs().object(
+            temp_dir.add_temp_object_file(static_library_name, "_" + std::to_string(i), m.target()));
+        futures.emplace_back(pool.async([](Module m, Outputs o) {
+            debug(1) << "Module.compile(): function object " << o.object_name << "\n";
+            m.compile(o);
+        }, std::move(fn_module), std::move(fn_out)));
+    }
+
+    if (!m.target().has_feature(Target::NoRuntime)) {
+        Outputs runtime_out = Outputs().object(
+            temp_dir.add_temp_object_file(static_library_name, "_runtime", m.target()));
+        futures.emplace_back(pool.async([](Target t, Outputs o) {
+            debug(1) << "Module.compile(): runtime object " << o.object_name << "\n";
+            compile_standalone_runtime(o, t);
+        }, m.target(), std::move(runtime_out)));
+    }
+
+    // Use get() rather than wait() so that errors propagate.
+    for (auto &f : futures) {
+        f.get();
+    }
+
+    Target base_target(m.target().os, m.target().arch, m.target().bits);
+    create_static_library(temp_dir.files(), base_target, static_library_name);
+}
+
 }  // namespace
 
 struct ModuleContents {
@@ -280,6 +344,10 @@ Module Module::resolve_submodules() const {
     for (const auto &ec : external_code()) {
         lowered_module.append(ec);
     }
+    // The submodules are independent, so compile them in parallel,
+    // appending the results in order.
+    std::vector<std::future<Buffer<uint8_t>>> futures;
+    ThreadPool<Buffer<uint8_t>> pool(std::min(num_compile_threads(), submodules().size()));
     for (const auto &m : submodules()) {
         Module copy(m.resolve_submodules());
 
@@ -298,8 +366,12 @@ Module Module::resolve_submodules() const {
             }
         }
 
-        auto buf = copy.compile_to_buffer();
-        lowered_module.append(buf);
+        futures.emplace_back(pool.async([](Module m) {
+            return m.compile_to_buffer();
+        }, std::move(copy)));
+    }
+    for (auto &f : futures) {
+        lowered_module.append(f.get());
     }
 
     return lowered_module;
@@ -314,9 +386,19 @@ void Module::compile(const Outputs &output_files) const {
         return;
     }
 
+    // Static libraries may be made of several objects, so each
+    // function can be compiled separately and in parallel.
+    const bool split_static_library = (!output_files.static_library_name.empty() &&
+                                       can_compile_functions_separately(*this));
+    if (split_static_library) {
+        debug(1) << "Module.compile(): static_library_name " << output_files.static_library_name
+                 << " (one object per function)\n";
+        compile_functions_to_static_library(*this, output_files.static_library_name);
+    }
+
     if (!output_files.object_name.empty() || !output_files.assembly_name.empty() ||
         !output_files.bitcode_name.empty() || !output_files.llvm_assembly_name.empty() ||
-        !output_files.static_library_name.empty()) {
+        (!output_files.static_library_name.empty() && !split_static_library)) {
         llvm::LLVMContext context;
         std::unique_ptr<llvm::Module> llvm_module(compile_module_to_llvm_module(*this, context));
 
@@ -325,7 +407,7 @@ void Module::compile(const Outputs &output_files) const {
             auto out = make_raw_fd_ostream(output_files.object_name);
             compile_llvm_module_to_object(*llvm_module, *out);
         }
-        if (!output_files.static_library_name.empty()) {
+        if (!output_files.static_library_name.empty() && !split_static_library) {
             // To simplify the code, we always create a temporary object output
             // here, even if output_files.object_name was also set: in practice,
             // no real-world code ever sets both object_name and static_library_name
@@ -444,10 +526,7 @@ void compile_multitarget(const std::string &fn_name,
     }
 
     std::vector<std::future<void>> futures;
-    // If we are running with HL_DEBUG_CODEGEN=1, use threads=1 to enforce
-    // sequential execution, so that debug output won't be utterly incomprehensible
-    const size_t num_threads = (debug::debug_level() > 0) ? 1 : Internal::ThreadPool<void>::num_processors_online();
-    Internal::ThreadPool<void> pool(num_threads);
+    Internal::ThreadPool<void> pool(num_compile_threads());
 
     // For safety, the runtime must be built only with features common to all
     // of the targets; given an unusual ordering like
@@ -471,12 +550,13 @@ void compile_multitarget(const std::string &fn_name,
             user_error << "All Targets must have matching arch-bits-os for compile_multitarget.\n";
         }
         // Some features must match across all targets.
-        static const std::array<Target::Feature, 6> must_match_features = {{
+        static const std::array<Target::Feature, 7> must_match_features = {{
             Target::CPlusPlusMangling,
             Target::JIT,
             Target::Matlab,
             Target::MSAN,
             Target::NoRuntime,
+            Target::PipelineInstance,
             Target::UserContext,
         }};
         for (auto f : must_match_features) {
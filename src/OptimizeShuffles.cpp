@@ -0,0 +1,151 @@
+#include "OptimizeShuffles.h"
+#include "Bounds.h"
+#include "CSE.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Scope.h"
+#include "Simplify.h"
+
+namespace Halide {
+namespace Internal {
+
+namespace {
+
+// The number of entries of the largest table of elements of type t
+// the target can look up in registers, or zero if it can't.
+int max_lut_entries(const Target &target, Type t) {
+    if (target.arch == Target::X86) {
+        if (t.bits() == 8) {
+            if (target.has_feature(Target::AVX512_Cannonlake)) {
+                // vpermb
+                return 64;
+            } else if (target.has_feature(Target::SSE41)) {
+                // pshufb
+                return 16;
+            }
+        } else if (t.bits() == 32 && target.has_feature(Target::AVX2)) {
+            // vpermd and vpermps
+            return 8;
+        }
+    } else if (target.arch == Target::ARM) {
+        if (t.bits() == 8 && !target.has_feature(Target::NoNEON)) {
+            // tbl and vtbl look up in up to four registers.
+            return target.bits == 64 ? 64 : 32;
+        }
+    }
+    return 0;
+}
+
+class OptimizeShuffles : public IRMutator {
+    const Target &target;
+    Scope<Interval> bounds;
+    Scope<int> allocation_size;
+
+    using IRMutator::visit;
+
+    template <typename T>
+    void visit_let(const T *op) {
+        // We only care about vector lets.
+        if (op->value.type().is_vector()) {
+            bounds.push(op->name, bounds_of_expr_in_scope(op->value, bounds));
+        }
+        IRMutator::visit(op);
+        if (op->value.type().is_vector()) {
+            bounds.pop(op->name);
+        }
+    }
+
+    void visit(const Let *op) { visit_let(op); }
+    void visit(const LetStmt *op) { visit_let(op); }
+
+    void visit(const Allocate *op) {
+        // Zero for allocations that aren't of constant size.
+        int size = op->new_expr.defined() ? 0 : op->constant_allocation_size();
+        allocation_size.push(op->name, size);
+        IRMutator::visit(op);
+        allocation_size.pop(op->name);
+    }
+
+    void visit(const For *op) {
+        if (op->device_api != DeviceAPI::None &&
+            op->device_api != DeviceAPI::Host) {
+            // Leave code for other devices alone.
+            stmt = op;
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+    // The number of elements in the buffer loaded from, or zero if
+    // it isn't known.
+    int buffer_size(const Load *op) {
+        if (allocation_size.contains(op->name)) {
+            return allocation_size.get(op->name);
+        } else if (op->image.defined() &&
+                   op->image.dimensions() == 1 &&
+                   op->image.dim(0).stride() == 1) {
+            return op->image.dim(0).extent();
+        }
+        return 0;
+    }
+
+    void visit(const Load *op) {
+        if (!op->type.is_vector() || op->index.as<Ramp>() || !is_one(op->predicate)) {
+            // Don't handle scalar, dense, or predicated loads.
+            IRMutator::visit(op);
+            return;
+        }
+
+        Expr index = mutate(op->index);
+
+        int max_entries = max_lut_entries(target, op->type);
+        int size = buffer_size(op);
+        if (max_entries > 0 && size > 0) {
+            Interval index_bounds = bounds_of_expr_in_scope(index, bounds);
+            if (index_bounds.is_bounded()) {
+                Expr base = simplify(index_bounds.min);
+                Expr span = simplify(common_subexpression_elimination(index_bounds.max - index_bounds.min));
+                const int64_t *max_index = as_const_int(span);
+                if (max_index && *max_index > 0 && *max_index < max_entries &&
+                    can_prove(base >= 0 && base + (int)*max_index < size)) {
+                    int entries = (int)*max_index + 1;
+
+                    // Load all of the table the index can reach. The
+                    // check above makes sure this doesn't read past
+                    // the end of the buffer.
+                    Expr lut = Load::make(op->type.with_lanes(entries), op->name,
+                                          Ramp::make(base, 1, entries),
+                                          op->image, op->param, const_true(entries));
+
+                    // The table has at most 64 entries, so the index
+                    // fits in 8 bits.
+                    index = simplify(cast(UInt(8).with_lanes(op->type.lanes()), index - base));
+
+                    expr = Call::make(op->type, "dynamic_shuffle", {lut, index, 0, entries - 1}, Call::PureIntrinsic);
+                    return;
+                }
+            }
+        }
+
+        if (!index.same_as(op->index)) {
+            expr = Load::make(op->type, op->name, index, op->image, op->param, op->predicate);
+        } else {
+            expr = op;
+        }
+    }
+
+public:
+    OptimizeShuffles(const Target &t) : target(t) {}
+};
+
+}  // namespace
+
+Stmt optimize_shuffles(Stmt s, const Target &t) {
+    if (t.arch != Target::X86 && t.arch != Target::ARM) {
+        return s;
+    }
+    return OptimizeShuffles(t).mutate(s);
+}
+
+}
+}
@@ -0,0 +1,28 @@
+#ifndef HALIDE_OPTIMIZE_SHUFFLES_H
+#define HALIDE_OPTIMIZE_SHUFFLES_H
+
+/** \file
+ * Defines the lowering pass that turns vector loads from small lookup
+ * tables into in-register table lookups.
+ */
+
+#include "IR.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Replace vector loads with a non-linear index from a small buffer
+ * of constant size with a dense load of the part of the table the
+ * index can reach, and a dynamic_shuffle intrinsic that looks the
+ * values up in that vector. This is only done where the bounds of the
+ * index prove that every lane stays inside the buffer, and where the
+ * table is small enough for the target to look up with a single
+ * shuffle instruction (pshufb, vpermb, vpermd, or tbl/vtbl on
+ * ARM). Does nothing for other targets. */
+Stmt optimize_shuffles(Stmt s, const Target &t);
+
+}
+}
+
+#endif
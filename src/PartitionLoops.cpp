@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <numeric>
 
 #include "PartitionLoops.h"
@@ -12,6 +14,9 @@
 #include "CodeGen_GPU_Dev.h"
 #include "Var.h"
 #include "CSE.h"
+#include "CompilerProfiling.h"
+#include "LoopProfile.h"
+#include "Util.h"
 
 namespace Halide {
 namespace Internal {
@@ -454,11 +459,69 @@ bool contains_thread_barrier(Stmt s) {
     return c.result;
 }
 
+// The name of the Func a loop belongs to. Loop names start with the
+// Func name and the stage (e.g. f.s0.x.x_o).
+string func_name_of_loop(const string &loop_name) {
+    size_t pos = 0;
+    while ((pos = loop_name.find(".s", pos)) != string::npos) {
+        size_t end = pos + 2;
+        while (end < loop_name.size() && isdigit(loop_name[end])) {
+            end++;
+        }
+        if (end > pos + 2 && (end == loop_name.size() || loop_name[end] == '.')) {
+            return loop_name.substr(0, pos);
+        }
+        pos++;
+    }
+    return loop_name;
+}
+
+// The code a Func's partitioned loops add, measured in IR nodes: the
+// copies of each loop body for its prologue and epilogue.
+struct PartitionCost {
+    int64_t nodes = 0;
+    int loops = 0;
+    // The loops left alone because partitioning them would have gone
+    // over the budget.
+    int over_budget = 0;
+};
+
 class PartitionLoops : public IRMutator {
     using IRMutator::visit;
 
     bool in_gpu_loop = false;
 
+    const string &pipeline_name;
+
+    // Whether to share one generic boundary body between the
+    // prologue and epilogue of a loop.
+    bool share_boundaries;
+
+    // The most IR nodes partitioning may add to the loops of each
+    // Func, or -1 for no limit.
+    int64_t budget;
+
+    bool over_budget(const string &func, int64_t added) {
+        if (budget < 0) {
+            return false;
+        }
+        auto it = costs.find(func);
+        int64_t used = (it == costs.end()) ? 0 : it->second.nodes;
+        return used + added > budget;
+    }
+
+    // A loop that runs fewer iterations than this on average isn't
+    // worth splitting into three: the prologue and epilogue take
+    // most of its iterations, and the steady state only adds code.
+    static const int min_profiled_trip_count = 4;
+
+    bool profiled_as_short(const For *op) {
+        LoopProfile profile;
+        return (find_loop_profile(pipeline_name, op->name, &profile) &&
+                profile.entries > 0 &&
+                profile.iterations < profile.entries * min_profiled_trip_count);
+    }
+
     void visit(const For *op) {
         // We dont partition loops that contain accelerated functions
         if (contains_hw_functions(op)) {
@@ -492,6 +555,15 @@ class PartitionLoops : public IRMutator {
             return;
         }
 
+        if (profiled_as_short(op)) {
+            debug(3) << "Not partitioning loop over " << op->name
+                     << " because it usually runs fewer than "
+                     << min_profiled_trip_count << " iterations\n";
+            IRMutator::visit(op);
+            in_gpu_loop = old_in_gpu_loop;
+            return;
+        }
+
         // Find simplifications in this loop body
         FindSimplifications finder(op->name);
         body.accept(&finder);
@@ -625,6 +697,43 @@ class PartitionLoops : public IRMutator {
         bool make_prologue = !equal(prologue, simpler_body);
         bool make_epilogue = !equal(epilogue, simpler_body);
 
+        // When partitioning for size, a loop with both a prologue and
+        // an epilogue gets a single copy of the body that is valid
+        // anywhere, and branches to it from one loop over the whole
+        // range. This costs a well-predicted branch per iteration.
+        bool share_boundary = share_boundaries && make_prologue && make_epilogue;
+        if (share_boundary && !equal(prologue, epilogue)) {
+            prologue = epilogue = body;
+        }
+
+        // Count the code this adds, and check it against the budget
+        // of the Func.
+        bool one_boundary_body = (make_prologue && make_epilogue && equal(prologue, epilogue) &&
+                                  (op->for_type != ForType::Serial || share_boundary));
+        int64_t added = 0;
+        if (make_prologue) {
+            added += count_nodes(prologue);
+        }
+        if (make_epilogue && !one_boundary_body) {
+            added += count_nodes(epilogue);
+        }
+        string func = func_name_of_loop(op->name);
+        if (over_budget(func, added)) {
+            debug(3) << "Not partitioning loop over " << op->name
+                     << " because it would take " << func << " over its code size budget\n";
+            costs[func].over_budget++;
+            IRMutator::visit(op);
+            in_gpu_loop = old_in_gpu_loop;
+            return;
+        }
+        map<string, PartitionCost> old_costs = costs;
+
+        // Charge this loop to the budget before recursing, so the
+        // loops partitioned inside its steady state can only use what
+        // is left, and it never has to be undone for their sake.
+        costs[func].nodes += added;
+        costs[func].loops++;
+
         // Recurse on the middle section.
         simpler_body = mutate(simpler_body);
 
@@ -666,7 +775,7 @@ class PartitionLoops : public IRMutator {
         }
 
         // Bust serial for loops up into three.
-        if (op->for_type == ForType::Serial) {
+        if (op->for_type == ForType::Serial && !share_boundary) {
             stmt = For::make(op->name, min_steady, max_steady - min_steady,
                              op->for_type, op->device_api, simpler_body);
 
@@ -682,8 +791,9 @@ class PartitionLoops : public IRMutator {
             }
         } else {
             // We don't have task parallelism. So for parallel for
-            // loops just put an if-then-else in the loop body. It
-            // should branch-predict to the steady state pretty well.
+            // loops (or to share the boundary body) just put an
+            // if-then-else in the loop body. It should branch-predict
+            // to the steady state pretty well.
             Expr loop_var = Variable::make(Int(32), op->name);
             stmt = simpler_body;
             if (make_epilogue && make_prologue && equal(prologue, epilogue)) {
@@ -717,6 +827,7 @@ class PartitionLoops : public IRMutator {
         if (can_prove(epilogue_val <= prologue_val)) {
             // The steady state is empty. I've made a huge
             // mistake. Try to partition a loop further in.
+            costs = old_costs;
             IRMutator::visit(op);
             return;
         }
@@ -727,6 +838,12 @@ class PartitionLoops : public IRMutator {
                  << "Old: " << Stmt(op) << "\n"
                  << "New: " << stmt << "\n";
     }
+
+public:
+    map<string, PartitionCost> costs;
+
+    PartitionLoops(const string &pipeline_name, bool share_boundaries, int64_t budget)
+        : pipeline_name(pipeline_name), share_boundaries(share_boundaries), budget(budget) {}
 };
 
 class ExprContainsLoad : public IRVisitor {
@@ -840,7 +957,7 @@ class RenormalizeGPULoops : public IRMutator {
                 IRMutator::visit(op);
             } else {
                 Stmt inner = LetStmt::make(op->name, op->value, a->body);
-                inner = Allocate::make(a->name, a->type, a->extents, a->condition, inner);
+                inner = Allocate::make(a->name, a->type, a->memory_type, a->extents, a->condition, inner);
                 stmt = mutate(inner);
             }
         } else {
@@ -877,7 +994,7 @@ class RenormalizeGPULoops : public IRMutator {
             allocate_a->name == "__shared" &&
             allocate_b->name == "__shared") {
             Stmt inner = IfThenElse::make(op->condition, allocate_a->body, allocate_b->body);
-            inner = Allocate::make(allocate_a->name, allocate_a->type, allocate_a->extents, allocate_a->condition, inner);
+            inner = Allocate::make(allocate_a->name, allocate_a->type, allocate_a->memory_type, allocate_a->extents, allocate_a->condition, inner);
             stmt = mutate(inner);
         } else if (let_a && let_b && let_a->name == let_b->name) {
             string condition_name = unique_name('t');
@@ -1017,11 +1134,43 @@ class LowerLikelyIfInnermost : public IRMutator {
 
 }
 
-Stmt partition_loops(Stmt s) {
+Stmt partition_loops(Stmt s, const string &pipeline_name, const Target &t) {
+    bool for_size = t.has_feature(Target::PartitionForSize);
+    int64_t budget = -1;
+    if (for_size) {
+        budget = 4096;
+        string budget_str = get_env_variable("HL_PARTITION_BUDGET");
+        if (!budget_str.empty()) {
+            char *end = nullptr;
+            budget = std::strtoll(budget_str.c_str(), &end, 10);
+            user_assert(*end == '\0' && budget >= 0)
+                << "HL_PARTITION_BUDGET must be a non-negative number of IR nodes, not \""
+                << budget_str << "\"\n";
+        }
+    }
+
     s = LowerLikelyIfInnermost().mutate(s);
     s = MarkClampedRampsAsLikely().mutate(s);
     s = ExpandSelects().mutate(s);
-    s = PartitionLoops().mutate(s);
+    PartitionLoops partitioner(pipeline_name, for_size, budget);
+    s = partitioner.mutate(s);
+
+    if (!partitioner.costs.empty()) {
+        debug(1) << "IR nodes added by loop partitioning";
+        if (budget >= 0) {
+            debug(1) << " (budget " << budget << " per Func)";
+        }
+        debug(1) << ":\n";
+        for (const auto &p : partitioner.costs) {
+            debug(1) << "  " << p.first << ": " << p.second.nodes
+                     << " in " << p.second.loops << " loop(s)";
+            if (p.second.over_budget) {
+                debug(1) << ", " << p.second.over_budget << " loop(s) left alone by the budget";
+            }
+            debug(1) << "\n";
+        }
+    }
+
     s = RenormalizeGPULoops().mutate(s);
     s = RemoveLikelyTags().mutate(s);
     s = CollapseSelects().mutate(s);
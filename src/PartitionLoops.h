@@ -8,14 +8,26 @@
  */
 
 #include "IR.h"
+#include "Target.h"
 
 namespace Halide {
 namespace Internal {
 
 /** Partitions loop bodies into a prologue, a steady state, and an
  * epilogue. Finds the steady state by hunting for use of clamped
- * ramps, or the 'likely' intrinsic. */
-EXPORT Stmt partition_loops(Stmt s);
+ * ramps, or the 'likely' intrinsic. Loops that the loaded loop
+ * profiles of the named pipeline say usually run only a few
+ * iterations are not partitioned.
+ *
+ * If the target has the PartitionForSize feature, a loop that needs
+ * both a prologue and an epilogue runs one generic copy of the body
+ * for both, from an if statement in a single loop, and once the
+ * partitioned loops of a Func have added HL_PARTITION_BUDGET IR nodes
+ * (default 4096), its other loops are left alone. Outer loops are
+ * charged to the budget before the loops inside them. The number of IR
+ * nodes partitioning adds to each Func is reported at debug level
+ * 1. */
+EXPORT Stmt partition_loops(Stmt s, const std::string &pipeline_name, const Target &t);
 
 }
 }
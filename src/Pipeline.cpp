@@ -1,9 +1,12 @@
 #include <algorithm>
+#include <list>
+#include <unordered_map>
 
 #include "Pipeline.h"
 #include "Argument.h"
 #include "Func.h"
 #include "InferArguments.h"
+#include "IROperator.h"
 #include "IRVisitor.h"
 #include "LLVM_Headers.h"
 #include "LLVM_Output.h"
@@ -39,6 +42,22 @@ Outputs static_library_outputs(const string &filename_prefix, const Target &targ
     return outputs;
 }
 
+// Hashes the argument values a specialization was compiled for.
+struct SpecializationKeyHash {
+    size_t operator()(const vector<int64_t> &key) const {
+        size_t h = key.size();
+        for (int64_t v : key) {
+            h = h * 31 + std::hash<int64_t>()(v);
+        }
+        return h;
+    }
+};
+
+// The maximum number of distinct argument values to count before
+// forgetting the ones seen so far. Stops pipelines called with
+// values that rarely recur from using an unbounded amount of memory.
+const size_t max_specialization_candidates = 1024;
+
 }  // namespace
 
 struct PipelineContents {
@@ -54,12 +73,34 @@ struct PipelineContents {
     JITModule jit_module;
     Target jit_target;
 
+    /** Versions of the jit-compiled code specialized on the values
+     * of their arguments, and the number of times each set of
+     * argument values has been seen by realize. See
+     * Pipeline::specialize_on_demand. */
+    // @{
+    int specialize_threshold = 0;
+    int max_specializations = 0;
+    std::unordered_map<vector<int64_t>, JITModule, SpecializationKeyHash> specializations;
+    std::unordered_map<vector<int64_t>, int, SpecializationKeyHash> specialization_counts;
+    // @}
+
+    /** The jit-compiled code for the last few lowered Modules, most
+     * recently used first, keyed by jit_variant_key. These survive
+     * invalidate_cache, so that going back to a schedule tried
+     * before, as a tuning loop does, skips code generation. */
+    // @{
+    static const size_t max_jit_variants = 8;
+    std::list<std::pair<string, JITModule>> jit_variants;
+    // @}
+
     /** Clear all cached state */
     void invalidate_cache() {
         module = Module("", Target());
         jit_module = JITModule();
         jit_target = Target();
         inferred_args.clear();
+        specializations.clear();
+        specialization_counts.clear();
     }
 
     // The outputs
@@ -148,6 +189,18 @@ vector<Func> Pipeline::outputs() const {
     return funcs;
 }
 
+std::string Pipeline::auto_schedule(const Target &target, const MachineParams &arch_params) {
+    user_assert(defined()) << "Pipeline is undefined\n";
+    user_assert(target.arch == Target::X86 ||
+                target.arch == Target::ARM ||
+                target.arch == Target::POWERPC ||
+                target.arch == Target::MIPS)
+        << "auto_schedule currently only supports CPU targets\n";
+    std::string schedule = generate_schedules(contents->outputs, target, arch_params);
+    contents->invalidate_cache();
+    return schedule;
+}
+
 void Pipeline::compile_to(const Outputs &output_files,
                           const vector<Argument> &args,
                           const string &fn_name,
@@ -348,6 +401,20 @@ Module Pipeline::compile_to_module(const vector<Argument> &args,
         lowering_args.insert(lowering_args.begin(), contents->user_context_arg.arg);
     }
 
+    // Pipelines that keep their intermediate buffers in a pipeline
+    // instance take it as the argument after the user context.
+    if (target.has_feature(Target::PipelineInstance)) {
+        auto it = lowering_args.begin();
+        if (requires_user_context || has_user_context) {
+            while (it->name != contents->user_context_arg.arg.name) {
+                it++;
+            }
+            it++;
+        }
+        lowering_args.insert(it, Argument("__pipeline_instance", Argument::InputScalar,
+                                          type_of<halide_pipeline_instance_t *>(), 0));
+    }
+
     const Module &old_module = contents->module;
 
     bool same_compile = !old_module.functions().empty() && old_module.target() == target;
@@ -402,6 +469,8 @@ void *Pipeline::compile_jit(const Target &target_arg) {
     Target target(target_arg);
     target.set_feature(Target::JIT);
     target.set_feature(Target::UserContext);
+    // The JIT has no way to pass a pipeline instance.
+    target = target.without_feature(Target::PipelineInstance);
 
     debug(2) << "jit-compiling for: " << target_arg.to_string() << "\n";
 
@@ -414,6 +483,8 @@ void *Pipeline::compile_jit(const Target &target_arg) {
     }
 
     contents->jit_target = target;
+    contents->specializations.clear();
+    contents->specialization_counts.clear();
 
     // Infer an arguments vector
     infer_arguments();
@@ -434,6 +505,24 @@ void *Pipeline::compile_jit(const Target &target_arg) {
     Module module = compile_to_module(args, name, target).resolve_submodules();
     auto f = module.get_function_by_name(name);
 
+    // Only look up Modules that the key fully describes. Extern
+    // stages may be redefined without changing it.
+    string variant_key;
+    if (contents->jit_externs.empty() &&
+        module.buffers().empty() &&
+        module.external_code().empty()) {
+        variant_key = target.to_string() + "\n" + jit_variant_key(module);
+        auto &variants = contents->jit_variants;
+        for (auto it = variants.begin(); it != variants.end(); it++) {
+            if (it->first == variant_key) {
+                debug(2) << "Reusing jit module compiled for an earlier schedule\n";
+                variants.splice(variants.begin(), variants, it);
+                contents->jit_module = it->second;
+                return contents->jit_module.main_function();
+            }
+        }
+    }
+
     std::map<std::string, JITExtern> lowered_externs = contents->jit_externs;
 
     // Compile to jit module
@@ -453,10 +542,152 @@ void *Pipeline::compile_jit(const Target &target_arg) {
 
     contents->jit_module = jit_module;
 
+    if (!variant_key.empty()) {
+        contents->jit_variants.emplace_front(variant_key, jit_module);
+        if (contents->jit_variants.size() > PipelineContents::max_jit_variants) {
+            contents->jit_variants.pop_back();
+        }
+    }
+
     return jit_module.main_function();
 }
 
 
+void Pipeline::specialize_on_demand(int hot_threshold, int max_variants) {
+    user_assert(defined()) << "Pipeline is undefined\n";
+    user_assert(hot_threshold >= 0 && max_variants >= 0)
+        << "specialize_on_demand requires a non-negative threshold and number of variants\n";
+    contents->specialize_threshold = hot_threshold;
+    contents->max_specializations = max_variants;
+    contents->specializations.clear();
+    contents->specialization_counts.clear();
+}
+
+JITModule Pipeline::compile_jit_specialization(const std::map<std::string, Expr> &constants) {
+    const Target &target = contents->jit_target;
+
+    vector<Argument> args;
+    for (const InferredArgument &arg : contents->inferred_args) {
+        args.push_back(arg.arg);
+    }
+    string name = generate_function_name();
+
+    vector<IRMutator *> custom_passes;
+    for (CustomLoweringPass p : contents->custom_lowering_passes) {
+        custom_passes.push_back(p.pass);
+    }
+
+    Module module = lower(contents->outputs, name, target, args, LoweredFunc::External,
+                          custom_passes, constants).resolve_submodules();
+    auto f = module.get_function_by_name(name);
+
+    std::map<std::string, JITExtern> lowered_externs = contents->jit_externs;
+    return JITModule(module, f, make_externs_jit_module(target, lowered_externs));
+}
+
+namespace {
+
+// Add the mins and extents of a buffer to the key of a
+// specialization, and to the constants it is compiled with.
+void add_buffer_fields(const string &name, const halide_buffer_t *buf,
+                       vector<int64_t> &key, std::map<string, Expr> &constants) {
+    for (int d = 0; d < buf->dimensions; d++) {
+        key.push_back(buf->dim[d].min);
+        key.push_back(buf->dim[d].extent);
+        constants[name + ".min." + std::to_string(d)] = buf->dim[d].min;
+        constants[name + ".extent." + std::to_string(d)] = buf->dim[d].extent;
+    }
+}
+
+// Add the value of a scalar argument to the key of a specialization,
+// and to the constants it is compiled with.
+void add_scalar(const string &name, Type t, const void *value,
+                vector<int64_t> &key, std::map<string, Expr> &constants) {
+    Expr e;
+    if (t.is_float() && t.bits() == 32) {
+        e = make_const(t, *(const float *)value);
+    } else if (t.is_float()) {
+        e = make_const(t, *(const double *)value);
+    } else if (t.is_int()) {
+        switch (t.bits()) {
+        case 8: e = make_const(t, *(const int8_t *)value); break;
+        case 16: e = make_const(t, *(const int16_t *)value); break;
+        case 32: e = make_const(t, *(const int32_t *)value); break;
+        default: e = make_const(t, *(const int64_t *)value); break;
+        }
+    } else {
+        switch (t.bits()) {
+        case 1: e = make_const(t, *(const bool *)value); break;
+        case 8: e = make_const(t, *(const uint8_t *)value); break;
+        case 16: e = make_const(t, *(const uint16_t *)value); break;
+        case 32: e = make_const(t, *(const uint32_t *)value); break;
+        default: e = make_const(t, *(const uint64_t *)value); break;
+        }
+    }
+    int64_t bits = 0;
+    memcpy(&bits, value, t.bytes());
+    key.push_back(bits);
+    constants[name] = e;
+}
+
+}  // namespace
+
+// Find the specialization for the argument values in args, compiling
+// it if they have become hot. Returns null if the generic code should
+// be used.
+JITModule *Pipeline::find_specialization(const vector<const void *> &args) {
+    if (contents->specialize_threshold == 0) {
+        return nullptr;
+    }
+
+    vector<int64_t> key;
+    std::map<string, Expr> constants;
+    size_t i = 0;
+    for (; i < contents->inferred_args.size(); i++) {
+        const InferredArgument &arg = contents->inferred_args[i];
+        if (arg.buffer.defined()) {
+            // Embedded images are already known at compile time.
+            continue;
+        } else if (arg.param.defined() && arg.param.is_buffer()) {
+            if (args[i] == nullptr) {
+                return nullptr;
+            }
+            add_buffer_fields(arg.arg.name, (const halide_buffer_t *)args[i], key, constants);
+        } else if (!arg.arg.type.is_handle()) {
+            add_scalar(arg.arg.name, arg.arg.type, args[i], key, constants);
+        }
+    }
+    for (Function f : contents->outputs) {
+        for (Parameter buf : f.output_buffers()) {
+            add_buffer_fields(buf.name(), (const halide_buffer_t *)args[i++], key, constants);
+        }
+    }
+
+    auto it = contents->specializations.find(key);
+    if (it != contents->specializations.end()) {
+        return &it->second;
+    }
+
+    if ((int)contents->specializations.size() >= contents->max_specializations) {
+        return nullptr;
+    }
+    if (contents->specialization_counts.size() >= max_specialization_candidates) {
+        contents->specialization_counts.clear();
+    }
+    int &count = contents->specialization_counts[key];
+    if (++count < contents->specialize_threshold) {
+        return nullptr;
+    }
+
+    debug(1) << "Compiling a specialization of " << generate_function_name() << " for:\n";
+    for (const auto &c : constants) {
+        debug(1) << "  " << c.first << " = " << c.second << "\n";
+    }
+    JITModule specialization = compile_jit_specialization(constants);
+    contents->specialization_counts.erase(key);
+    return &contents->specializations.emplace(key, specialization).first->second;
+}
+
 void Pipeline::set_error_handler(void (*handler)(void *, const char *)) {
     user_assert(defined()) << "Pipeline is undefined\n";
     contents->jit_handlers.custom_error = handler;
@@ -830,6 +1061,11 @@ void Pipeline::realize(Realization dst, const Target &t) {
 
     vector<const void *> args = prepare_jit_call_arguments(dst, target);
 
+    // Use a version of the code specialized on the values of the
+    // arguments, if there is one.
+    JITModule *specialization = find_specialization(args);
+    JITModule &jit_module = specialization ? *specialization : contents->jit_module;
+
     // We need to make a context for calling the jitted function to
     // carry the the set of custom handlers. Here's how handlers get
     // called when running jitted code:
@@ -892,11 +1128,11 @@ void Pipeline::realize(Realization dst, const Target &t) {
     // exception.
 
     debug(2) << "Calling jitted function\n";
-    int exit_status = contents->jit_module.argv_function()(&(args[0]));
+    int exit_status = jit_module.argv_function()(&(args[0]));
     debug(2) << "Back from jitted function. Exit status was " << exit_status << "\n";
 
     // If we're profiling, report runtimes and reset profiler stats.
-    if (target.has_feature(Target::Profile)) {
+    if (target.features_any_of({Target::Profile, Target::ProfileHWCounters, Target::ProfileTimeline})) {
         JITModule::Symbol report_sym =
             contents->jit_module.find_symbol_by_name("halide_profiler_report");
         JITModule::Symbol reset_sym =
@@ -911,6 +1147,17 @@ void Pipeline::realize(Realization dst, const Target &t) {
         }
     }
 
+    // If we're counting loop trip counts, write out the counts so far.
+    if (target.has_feature(Target::ProfileLoops)) {
+        JITModule::Symbol dump_sym =
+            contents->jit_module.find_symbol_by_name("halide_loop_profile_dump");
+        if (dump_sym.address) {
+            void *uc = jit_context.user_context_param.get_scalar<void *>();
+            int (*dump_fn_ptr)(void *, const char *) = (int (*)(void *, const char *))(dump_sym.address);
+            dump_fn_ptr(uc, nullptr);
+        }
+    }
+
     jit_context.finalize(exit_status);
 }
 
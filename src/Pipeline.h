@@ -9,6 +9,7 @@
 
 #include <vector>
 
+#include "AutoSchedule.h"
 #include "ExternalCode.h"
 #include "IntrusivePtr.h"
 #include "JITModule.h"
@@ -59,6 +60,8 @@ class Pipeline {
 
     std::vector<Argument> infer_arguments(Internal::Stmt body);
     std::vector<const void *> prepare_jit_call_arguments(Realization dst, const Target &target);
+    Internal::JITModule compile_jit_specialization(const std::map<std::string, Expr> &constants);
+    Internal::JITModule *find_specialization(const std::vector<const void *> &args);
 
     static std::vector<Internal::JITModule> make_externs_jit_module(const Target &target,
                                                                     std::map<std::string, JITExtern> &externs_in_out);
@@ -78,6 +81,17 @@ public:
     /** Get the Funcs this pipeline outputs. */
     EXPORT std::vector<Func> outputs() const;
 
+    /** Generate a schedule for the pipeline with the automatic
+     * scheduler, apply it to the Funcs, and return the equivalent C++
+     * scheduling source. The scheduler decides which Funcs to inline,
+     * which to compute per tile of their consumers, the tile sizes,
+     * and what to vectorize and parallelize, using a cost model of
+     * arithmetic, memory footprint and parallelism. Every dimension
+     * of every output must have an estimate (see \ref Func::estimate),
+     * and the Funcs must not already be scheduled. */
+    EXPORT std::string auto_schedule(const Target &target,
+                                     const MachineParams &arch_params = MachineParams::generic());
+
     /** Compile and generate multiple target files with single call.
      * Deduces target files based on filenames specified in
      * output_files struct.
@@ -217,6 +231,17 @@ public:
      */
      EXPORT void *compile_jit(const Target &target = get_jit_target_from_environment());
 
+    /** Compile specialized versions of the pipeline on demand, for
+     * the argument values it is called with most often. Each call to
+     * realize records the values of the scalar parameters, and the
+     * mins and extents of the buffers, passed to the pipeline. Once
+     * the same values have been seen hot_threshold times, a version
+     * of the pipeline with those values substituted in as constants
+     * is jit-compiled, and later calls with the same values run it
+     * instead. At most max_variants such versions are kept. A
+     * hot_threshold of zero turns this off, which is the default. */
+    EXPORT void specialize_on_demand(int hot_threshold = 4, int max_variants = 8);
+
     /** Set the error handler function that be called in the case of
      * runtime errors during halide pipelines. If you are compiling
      * statically, you can also just define your own function with
@@ -407,7 +432,9 @@ public:
     EXPORT bool defined() const;
 
     /** Invalidate any internal cached state, e.g. because Funcs have
-     * been rescheduled. */
+     * been rescheduled. The code jit-compiled for the last few
+     * schedules is kept, and reused if lowering the pipeline again
+     * gives the same code. */
     EXPORT void invalidate_cache();
 
 private:
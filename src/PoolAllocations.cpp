@@ -0,0 +1,220 @@
+#include <set>
+
+#include "PoolAllocations.h"
+#include "CodeGen_Internal.h"
+#include "Debug.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Simplify.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The alignment of blocks in an arena, and the size of the header in
+// front of each. Must match the runtime (see arena_allocator.cpp).
+const int64_t arena_alignment = 128;
+
+int64_t arena_block_size(int64_t bytes) {
+    return arena_alignment + ((bytes + arena_alignment - 1) / arena_alignment) * arena_alignment;
+}
+
+// Compute the peak number of bytes the pooled allocations of a task
+// have live at once. The allocations freed early (see EarlyFree.h)
+// stop counting at their Free node. Nested parallel loops are tasks
+// of their own.
+class PeakLiveBytes : public IRVisitor {
+    const set<string> &pooled;
+    map<string, int64_t> live;
+    int64_t current = 0;
+
+    using IRVisitor::visit;
+
+    void visit(const Allocate *op) {
+        if (!pooled.count(op->name)) {
+            IRVisitor::visit(op);
+            return;
+        }
+        int32_t elements = Allocate::constant_allocation_size(op->extents, op->name);
+        if (elements == 0) {
+            constant = false;
+            return;
+        }
+        int64_t bytes = arena_block_size((int64_t)elements * op->type.bytes());
+        live[op->name] = bytes;
+        current += bytes;
+        peak = std::max(peak, current);
+        op->body.accept(this);
+        if (live.count(op->name)) {
+            current -= bytes;
+            live.erase(op->name);
+        }
+    }
+
+    void visit(const Free *op) {
+        auto it = live.find(op->name);
+        if (it != live.end()) {
+            current -= it->second;
+            live.erase(it);
+        }
+    }
+
+    void visit(const For *op) {
+        if (op->for_type != ForType::Parallel) {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    int64_t peak = 0;
+    bool constant = true;
+    PeakLiveBytes(const set<string> &p) : pooled(p) {}
+};
+
+class PoolAllocations : public IRMutator {
+    const Target &target;
+    Expr user_context;
+
+    // The pool of arenas, and the arena of the innermost enclosing
+    // parallel task, if any.
+    Expr pool;
+    string arena;
+    set<string> pooled;
+    bool used_pool = false;
+
+    using IRMutator::visit;
+
+    // Only pool the allocations that would otherwise call
+    // halide_malloc.
+    bool should_pool(const Allocate *op) {
+        if (op->new_expr.defined() || !op->free_function.empty() || op->extents.empty()) {
+            return false;
+        }
+        if (op->memory_type == MemoryType::Heap) {
+            return true;
+        } else if (op->memory_type != MemoryType::Auto) {
+            return false;
+        }
+        int32_t elements = Allocate::constant_allocation_size(op->extents, op->name);
+        return (elements == 0 ||
+                !can_allocation_fit_on_stack((int64_t)elements * op->type.bytes()));
+    }
+
+    void visit(const For *op) {
+        if (op->device_api != DeviceAPI::None &&
+            op->device_api != DeviceAPI::Host) {
+            // Device code allocates its own memory.
+            stmt = op;
+            return;
+        }
+        if (op->for_type != ForType::Parallel) {
+            IRMutator::visit(op);
+            return;
+        }
+
+        string old_arena = arena;
+        set<string> old_pooled;
+        old_pooled.swap(pooled);
+        arena = unique_name("task_arena");
+
+        Stmt body = mutate(op->body);
+        if (!pooled.empty()) {
+            PeakLiveBytes peak(pooled);
+            body.accept(&peak);
+            Expr size_hint = make_const(UInt(64), peak.constant ? peak.peak : 0);
+            debug(3) << "Pooling " << pooled.size() << " allocations inside parallel loop "
+                     << op->name << " in an arena of at least " << size_hint << " bytes\n";
+            Expr new_expr = Call::make(Handle(), "halide_arena_acquire",
+                                       {user_context, pool, size_hint}, Call::Extern);
+            body = Allocate::make(arena, UInt(8), MemoryType::Auto, {}, const_true(), body,
+                                  new_expr, "halide_arena_release");
+            used_pool = true;
+        }
+
+        arena = old_arena;
+        pooled.swap(old_pooled);
+        stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+    }
+
+    void visit(const Allocate *op) {
+        if (arena.empty() || !should_pool(op)) {
+            IRMutator::visit(op);
+            return;
+        }
+
+        pooled.insert(op->name);
+        vector<Expr> extents;
+        for (Expr e : op->extents) {
+            extents.push_back(mutate(e));
+        }
+        Expr condition = mutate(op->condition);
+        Stmt body = mutate(op->body);
+
+        // Compute the size in bytes, checking that it does not
+        // exceed the largest buffer size the target allows. The
+        // check against the quotient can't overflow.
+        Expr max_size = make_const(UInt(64), target.maximum_buffer_size());
+        Expr size = make_const(UInt(64), op->type.bytes());
+        Expr size_check = const_true();
+        for (Expr e : extents) {
+            Expr extent = cast(UInt(64), e);
+            size_check = size_check && (extent == 0 || size <= max_size / extent);
+            size = size * extent;
+        }
+        size_check = simplify(size_check);
+        size = simplify(size);
+
+        Expr arena_var = Variable::make(Handle(), arena);
+        Expr new_expr = Call::make(Handle(), "halide_arena_malloc",
+                                   {user_context, arena_var, select(condition, size, make_zero(UInt(64)))},
+                                   Call::Extern);
+        stmt = Allocate::make(op->name, op->type, op->memory_type, extents, condition, body,
+                              new_expr, "halide_arena_free");
+
+        if (!is_one(size_check)) {
+            Expr error = Call::make(Int(32), "halide_error_buffer_allocation_too_large",
+                                    {op->name, size, max_size}, Call::Extern);
+            stmt = Block::make(AssertStmt::make(size_check, error), stmt);
+        }
+    }
+
+public:
+    PoolAllocations(const Target &t) : target(t) {
+        user_context = Variable::make(type_of<void *>(), "__user_context");
+    }
+
+    Stmt run(Stmt s) {
+        string pool_name = unique_name("arena_pool");
+        pool = Variable::make(Handle(), pool_name);
+        s = mutate(s);
+        if (used_pool) {
+            // The pool lives as long as the pipeline invocation, so
+            // the arenas are freed with the allocator that made them.
+            Expr new_expr = Call::make(Handle(), "halide_arena_pool_create",
+                                       {user_context}, Call::Extern);
+            s = Allocate::make(pool_name, UInt(8), MemoryType::Auto, {}, const_true(), s,
+                               new_expr, "halide_arena_pool_destroy");
+        }
+        return s;
+    }
+};
+
+}  // namespace
+
+Stmt pool_allocations(Stmt s, const Target &t) {
+    if (t.arch == Target::Hexagon) {
+        // Hexagon code uses its own allocators.
+        return s;
+    }
+    PoolAllocations pooler(t);
+    return pooler.run(s);
+}
+
+}
+}
@@ -0,0 +1,28 @@
+#ifndef HALIDE_POOL_ALLOCATIONS_H
+#define HALIDE_POOL_ALLOCATIONS_H
+
+/** \file
+ * Defines the lowering pass that carves the heap allocations inside
+ * parallel tasks out of per-task arenas.
+ */
+
+#include "IR.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Make each parallel task allocate the heap memory it needs from an
+ * arena, instead of calling halide_malloc and halide_free for every
+ * allocation. The arena is sized by the peak memory the task's
+ * allocations have live at once, where that is a constant, and is
+ * taken from a pool of arenas owned by the pipeline invocation, so
+ * that tasks run one after another on the same thread reuse the same
+ * memory. Allocations that would go on the stack, or that already
+ * have a custom allocator, are left alone. */
+Stmt pool_allocations(Stmt s, const Target &t);
+
+}
+}
+
+#endif
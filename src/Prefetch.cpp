@@ -6,8 +6,11 @@
 #include "Bounds.h"
 #include "ExprUsesVar.h"
 #include "IRMutator.h"
+#include "IROperator.h"
+#include "ModulusRemainder.h"
 #include "Scope.h"
 #include "Simplify.h"
+#include "Substitute.h"
 #include "Util.h"
 
 namespace Halide {
@@ -381,6 +384,277 @@ public:
     SplitPrefetch(Expr bytes) : max_byte_size(bytes) {}
 };
 
+// Collect the names of the buffers that are already prefetched
+// explicitly, so that automatic prefetches do not duplicate them.
+class FindPrefetchedBuffers : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Call *op) {
+        IRVisitor::visit(op);
+        if (op->is_intrinsic(Call::prefetch)) {
+            const Variable *base = op->args[0].as<Variable>();
+            internal_assert(base);
+            buffers.insert(base->name);
+        }
+    }
+
+public:
+    set<string> buffers;
+};
+
+// Check whether a statement contains a serial or parallel loop.
+class ContainsSerialLoop : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const For *op) {
+        if (op->for_type == ForType::Serial || op->for_type == ForType::Parallel) {
+            result = true;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    bool result = false;
+};
+
+// A rough estimate of the number of cycles an iteration of a loop
+// body takes, used to convert the latency of a load from memory into
+// a number of iterations. Loops inside the body are vectorized or
+// unrolled; the work of an unrolled loop is multiplied by its extent.
+class EstimateCost : public IRVisitor {
+    using IRVisitor::visit;
+
+    int factor = 1;
+
+    void visit(const Load *op) {
+        IRVisitor::visit(op);
+        cost += 4 * factor;
+    }
+
+    void visit(const Store *op) {
+        IRVisitor::visit(op);
+        cost += 4 * factor;
+    }
+
+    void visit(const Div *op) {
+        IRVisitor::visit(op);
+        cost += 10 * factor;
+    }
+
+    void visit(const Mod *op) {
+        IRVisitor::visit(op);
+        cost += 10 * factor;
+    }
+
+    void visit(const Call *op) {
+        IRVisitor::visit(op);
+        cost += (op->is_pure() ? 1 : 10) * factor;
+    }
+
+    void visit(const Add *op) {
+        IRVisitor::visit(op);
+        cost += factor;
+    }
+
+    void visit(const Sub *op) {
+        IRVisitor::visit(op);
+        cost += factor;
+    }
+
+    void visit(const Mul *op) {
+        IRVisitor::visit(op);
+        cost += factor;
+    }
+
+    void visit(const Select *op) {
+        IRVisitor::visit(op);
+        cost += factor;
+    }
+
+    void visit(const For *op) {
+        const int64_t *extent = as_const_int(op->extent);
+        int old_factor = factor;
+        if (op->for_type == ForType::Unrolled && extent) {
+            factor *= (int)std::min(*extent, (int64_t)64);
+        }
+        IRVisitor::visit(op);
+        factor = old_factor;
+    }
+
+public:
+    int cost = 0;
+};
+
+// Collect the loads in the body of an innermost serial loop whose
+// index can be evaluated at the top of the body, i.e. that only
+// depends on names defined outside of it. The variables of inner
+// vectorized and unrolled loops are replaced with their mins.
+class CollectLoads : public IRVisitor {
+    using IRVisitor::visit;
+
+    Scope<int> inner;
+    map<string, Expr> inner_loop_mins;
+
+    void visit(const Load *op) {
+        IRVisitor::visit(op);
+        if (!op->type.is_scalar() || op->type.is_handle() || inner.contains(op->name)) {
+            return;
+        }
+        Expr index = substitute(inner_loop_mins, op->index);
+        if (expr_uses_vars(index, inner)) {
+            return;
+        }
+        loads.push_back({op, index});
+    }
+
+    void visit(const LetStmt *op) {
+        op->value.accept(this);
+        inner.push(op->name, 0);
+        op->body.accept(this);
+        inner.pop(op->name);
+    }
+
+    void visit(const Let *op) {
+        op->value.accept(this);
+        inner.push(op->name, 0);
+        op->body.accept(this);
+        inner.pop(op->name);
+    }
+
+    void visit(const Allocate *op) {
+        inner.push(op->name, 0);
+        IRVisitor::visit(op);
+        inner.pop(op->name);
+    }
+
+    void visit(const For *op) {
+        op->min.accept(this);
+        op->extent.accept(this);
+        if (!expr_uses_vars(op->min, inner)) {
+            inner_loop_mins[op->name] = substitute(inner_loop_mins, op->min);
+        } else {
+            inner.push(op->name, 0);
+        }
+        op->body.accept(this);
+        if (inner.contains(op->name)) {
+            inner.pop(op->name);
+        }
+        inner_loop_mins.erase(op->name);
+    }
+
+public:
+    vector<std::pair<const Load *, Expr>> loads;
+};
+
+class InjectAutoPrefetch : public IRMutator {
+    using IRMutator::visit;
+
+    const set<string> &prefetched;
+    int cache_line_bytes;
+
+    // The number of cycles to hide with a prefetch, roughly the
+    // latency of a load that misses all levels of cache.
+    const int memory_latency = 200;
+    const int max_prefetch_distance = 64;
+
+    void visit(const For *op) {
+        if (op->device_api != DeviceAPI::None && op->device_api != DeviceAPI::Host) {
+            // Leave device loops alone.
+            stmt = op;
+            return;
+        }
+
+        IRMutator::visit(op);
+        if (op->for_type != ForType::Serial) {
+            return;
+        }
+        op = stmt.as<For>();
+        internal_assert(op);
+
+        ContainsSerialLoop inner_loops;
+        op->body.accept(&inner_loops);
+        if (inner_loops.result) {
+            return;
+        }
+
+        EstimateCost cost;
+        op->body.accept(&cost);
+        int distance = (memory_latency + std::max(cost.cost, 1) - 1) / std::max(cost.cost, 1);
+        distance = std::max(1, std::min(distance, max_prefetch_distance));
+
+        const int64_t *extent = as_const_int(op->extent);
+        if (extent && *extent <= distance) {
+            // The prefetches would all land past the end of the loop.
+            return;
+        }
+
+        CollectLoads collect;
+        op->body.accept(&collect);
+
+        Expr var = Variable::make(Int(32), op->name);
+        map<string, vector<Expr>> chosen;
+        vector<Stmt> prefetches;
+        for (const auto &l : collect.loads) {
+            const Load *load = l.first;
+            const Expr &index = l.second;
+            if (prefetched.count(load->name)) {
+                continue;
+            }
+
+            Expr stride = simplify(substitute(op->name, var + 1, index) - index);
+            if (expr_uses_var(stride, op->name)) {
+                continue;
+            }
+            int bytes = load->type.bytes();
+            ModulusRemainder mod_rem = modulus_remainder(stride);
+            if (mod_rem.modulus == 0 &&
+                std::abs((int64_t)mod_rem.remainder) * bytes < cache_line_bytes) {
+                // Consecutive iterations touch the same cache line
+                // most of the time, which the hardware prefetcher
+                // already handles. A stride that is not a constant
+                // is usually the stride of a row of some buffer,
+                // which is assumed to cross lines.
+                continue;
+            }
+
+            // Skip loads that touch the same line as a load that is
+            // already prefetched.
+            bool same_line = false;
+            for (const Expr &other : chosen[load->name]) {
+                const int64_t *diff = as_const_int(simplify(index - other));
+                if (diff && std::abs(*diff) * bytes < cache_line_bytes) {
+                    same_line = true;
+                    break;
+                }
+            }
+            if (same_line) {
+                continue;
+            }
+            chosen[load->name].push_back(index);
+
+            Expr ahead = simplify(substitute(op->name, var + distance, index));
+            Expr base = Variable::make(Handle(), load->name);
+            Expr call = Call::make(load->type, Call::prefetch, {base, ahead, 1, 1}, Call::Intrinsic);
+            prefetches.push_back(Evaluate::make(call));
+            debug(1) << "Prefetching " << load->name << "[" << index << "] "
+                     << distance << " iterations ahead in loop " << op->name
+                     << " (stride " << stride << ")\n";
+        }
+
+        if (prefetches.empty()) {
+            return;
+        }
+        prefetches.push_back(op->body);
+        Stmt body = Block::make(prefetches);
+        stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+    }
+
+public:
+    InjectAutoPrefetch(const set<string> &p, int line)
+        : prefetched(p), cache_line_bytes(line) {}
+};
+
 } // anonymous namespace
 
 Stmt inject_prefetch(Stmt s, const map<string, Function> &env) {
@@ -415,5 +689,17 @@ Stmt reduce_prefetch_dimension(Stmt stmt, const Target &t) {
     return stmt;
 }
 
+Stmt inject_auto_prefetches(Stmt stmt, const Target &t) {
+    if (t.features_any_of({Target::HVX_64, Target::HVX_128})) {
+        return stmt;
+    }
+    // See reduce_prefetch_dimension for the choice of line size.
+    int cache_line_bytes = (t.arch == Target::ARM) ? 32 : 64;
+
+    FindPrefetchedBuffers prefetched;
+    stmt.accept(&prefetched);
+    return InjectAutoPrefetch(prefetched.buffers, cache_line_bytes).mutate(stmt);
+}
+
 }
 }
@@ -23,6 +23,16 @@ Stmt inject_prefetch(Stmt s, const std::map<std::string, Function> &env);
  * on the architecture), this also adds an outer loops that tile the prefetches. */
 Stmt reduce_prefetch_dimension(Stmt stmt, const Target &t);
 
+/** Prefetch the loads in innermost serial loops that touch a new cache
+ * line on every iteration, i.e. those with a constant stride across
+ * the loop of at least one cache line, or a stride that is not a
+ * constant (typically the stride of a row of a buffer). The prefetch
+ * distance is the number of iterations estimated to cover the
+ * latency of a load from memory. Loops that already contain a
+ * prefetch of a buffer are left alone for that buffer. Must run
+ * after storage flattening, and before reduce_prefetch_dimension. */
+Stmt inject_auto_prefetches(Stmt stmt, const Target &t);
+
 }
 }
 
@@ -27,7 +27,8 @@ public:
 
     string pipeline_name;
 
-    InjectProfiling(const string &pipeline_name) : pipeline_name(pipeline_name) {
+    InjectProfiling(const string &pipeline_name, bool hw_counters, bool timeline) :
+        pipeline_name(pipeline_name), profiling_hw_counters(hw_counters), profiling_timeline(timeline) {
         indices["overhead"] = 0;
         stack.push_back(0);
     }
@@ -35,6 +36,21 @@ public:
     map<int, uint64_t> func_stack_current; // map from func id -> current stack allocation
     map<int, uint64_t> func_stack_peak; // map from func id -> peak stack allocation
 
+    // Bill this thread's hardware counters to the given func id from
+    // here on.
+    Stmt switch_hw_counters(int idx) {
+        Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+        return Evaluate::make(Call::make(Int(32), "halide_profiler_hw_counters_switch",
+                                         {profiler_pipeline_state, idx}, Call::Extern));
+    }
+
+    // Record a timeline event on the calling thread.
+    Stmt timeline_event(int idx, halide_profiler_timeline_event_code_t code, Expr arg = 0) {
+        Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+        return Evaluate::make(Call::make(Int(32), "halide_profiler_timeline_event",
+                                         {profiler_pipeline_state, idx, (int)code, arg}, Call::Extern));
+    }
+
 private:
     using IRMutator::visit;
 
@@ -47,6 +63,14 @@ private:
 
     bool profiling_memory = true;
 
+    // Whether to attribute per-thread hardware performance counters
+    // to the Func each thread is working on.
+    bool profiling_hw_counters;
+
+    // Whether to record when each producer, parallel task and device
+    // launch begins and ends.
+    bool profiling_timeline;
+
     // Strip down the tuple name, e.g. f.0 into f
     string normalize_name(const string &name) {
         vector<string> v = split_string(name, ".");
@@ -139,7 +163,7 @@ private:
             new_expr.same_as(op->new_expr)) {
             stmt = op;
         } else {
-            stmt = Allocate::make(op->name, op->type, new_extents, condition, body, new_expr, op->free_function);
+            stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents, condition, body, new_expr, op->free_function);
         }
 
         if (!is_zero(size) && !on_stack && profiling_memory) {
@@ -205,6 +229,16 @@ private:
 
         body = Block::make(Evaluate::make(set_task), body);
 
+        if (profiling_hw_counters) {
+            body = Block::make(switch_hw_counters(idx), body);
+        }
+
+        if (profiling_timeline && op->is_producer) {
+            body = Block::make({timeline_event(idx, halide_profiler_timeline_begin_produce),
+                                body,
+                                timeline_event(idx, halide_profiler_timeline_end_produce)});
+        }
+
         stmt = ProducerConsumer::make(op->name, op->is_producer, body);
     }
 
@@ -230,6 +264,28 @@ private:
             body = Block::make({incr_active_threads, body, decr_active_threads});
         }
 
+        // Parallel tasks may run on any thread, so each one starts
+        // billing counters to the enclosing Func and stops when it's
+        // done. The calling thread resumes billing after the loop.
+        bool update_hw_counters = profiling_hw_counters && op->is_parallel();
+        if (update_hw_counters) {
+            body = Block::make({switch_hw_counters(stack.back()), body,
+                                switch_hw_counters(halide_profiler_outside_of_halide)});
+        }
+
+        if (profiling_timeline && op->is_parallel()) {
+            Expr task = Variable::make(Int(32), op->name);
+            body = Block::make({timeline_event(stack.back(), halide_profiler_timeline_begin_task, task),
+                                body,
+                                timeline_event(stack.back(), halide_profiler_timeline_end_task, task)});
+        }
+
+        // Device loops are launches onto an accelerator, which show
+        // up on the timeline of the thread that waits for them.
+        bool device_launch = (profiling_timeline &&
+                              op->device_api != DeviceAPI::None &&
+                              op->device_api != DeviceAPI::Host);
+
         // We profile by storing a token to global memory, so don't enter GPU loops
         if (op->device_api == DeviceAPI::Hexagon) {
             // TODO: This is for all offload targets that support
@@ -237,9 +293,15 @@ private:
             // hexagon. We don't support per-func stats remotely,
             // which means we can't do memory accounting.
             bool old_profiling_memory = profiling_memory;
+            bool old_profiling_hw_counters = profiling_hw_counters;
+            bool old_profiling_timeline = profiling_timeline;
             profiling_memory = false;
+            profiling_hw_counters = false;
+            profiling_timeline = false;
             body = mutate(body);
             profiling_memory = old_profiling_memory;
+            profiling_hw_counters = old_profiling_hw_counters;
+            profiling_timeline = old_profiling_timeline;
 
             // Get the profiler state pointer from scratch inside the
             // kernel. There will be a separate copy of the state on
@@ -259,11 +321,24 @@ private:
         if (update_active_threads) {
             stmt = Block::make({decr_active_threads, stmt, incr_active_threads});
         }
+
+        if (update_hw_counters) {
+            stmt = Block::make(stmt, switch_hw_counters(stack.back()));
+        }
+
+        if (device_launch) {
+            int api = (int)op->device_api;
+            stmt = Block::make({timeline_event(stack.back(), halide_profiler_timeline_begin_device, api),
+                                stmt,
+                                timeline_event(stack.back(), halide_profiler_timeline_end_device, api)});
+        }
     }
 };
 
-Stmt inject_profiling(Stmt s, string pipeline_name) {
-    InjectProfiling profiling(pipeline_name);
+Stmt inject_profiling(Stmt s, string pipeline_name, const vector<Function> &outputs, const Target &t) {
+    bool hw_counters = t.has_feature(Target::ProfileHWCounters);
+    bool timeline = t.has_feature(Target::ProfileTimeline);
+    InjectProfiling profiling(pipeline_name, hw_counters, timeline);
     s = profiling.mutate(s);
 
     int num_funcs = (int)(profiling.indices.size());
@@ -301,6 +376,31 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
                                   {profiler_state}, Call::Extern));
     s = Block::make({incr_active_threads, s, decr_active_threads});
 
+    if (hw_counters) {
+        // Count the output pixels of the first output, so that
+        // counters can be reported per pixel produced.
+        Parameter output_buffer = outputs[0].output_buffers()[0];
+        Expr pixels = make_one(UInt(64));
+        for (int i = 0; i < output_buffer.dimensions(); i++) {
+            string extent_name = output_buffer.name() + ".extent." + std::to_string(i);
+            pixels *= cast<uint64_t>(Variable::make(Int(32), extent_name));
+        }
+        Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+        Stmt start_hw_counters =
+            Evaluate::make(Call::make(Int(32), "halide_profiler_hw_counters_pipeline_start",
+                                      {profiler_pipeline_state, simplify(pixels)}, Call::Extern));
+        s = Block::make({start_hw_counters, s,
+                         profiling.switch_hw_counters(halide_profiler_outside_of_halide)});
+    }
+
+    if (timeline) {
+        s = Block::make({profiling.timeline_event(halide_profiler_outside_of_halide,
+                                                  halide_profiler_timeline_begin_pipeline),
+                         s,
+                         profiling.timeline_event(halide_profiler_outside_of_halide,
+                                                  halide_profiler_timeline_end_pipeline)});
+    }
+
     s = LetStmt::make("profiler_pipeline_state", get_pipeline_state, s);
     s = LetStmt::make("profiler_state", get_state, s);
     // If there was a problem starting the profiler, it will call an
@@ -316,7 +416,7 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
                                         i, Parameter(), const_true()), s);
         }
         s = Block::make(s, Free::make("profiling_func_stack_peak_buf"));
-        s = Allocate::make("profiling_func_stack_peak_buf", UInt(64), {num_funcs}, const_true(), s);
+        s = Allocate::make("profiling_func_stack_peak_buf", UInt(64), MemoryType::Auto, {num_funcs}, const_true(), s);
     }
 
     for (std::pair<string, int> p : profiling.indices) {
@@ -324,7 +424,7 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
     }
 
     s = Block::make(s, Free::make("profiling_func_names"));
-    s = Allocate::make("profiling_func_names", Handle(), {num_funcs}, const_true(), s);
+    s = Allocate::make("profiling_func_names", Handle(), MemoryType::Auto, {num_funcs}, const_true(), s);
     s = Block::make(Evaluate::make(stop_profiler), s);
 
     return s;
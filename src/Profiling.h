@@ -15,6 +15,16 @@
  *     (\<peak heap alloc by this func\> \<num of allocs\> \<average alloc size\> |
  *      \<worst-case peak stack alloc by this func\>)?
  *
+ * When compiled with 'host-profile_hw_counters', each Func's line also
+ * reports instructions per cycle, last-level cache misses per output
+ * pixel, DRAM traffic in bytes/cycle (one cache line per miss) and
+ * branch misses, read from per-thread hardware performance counters.
+ *
+ * When compiled with 'host-profile_timeline', the pipeline also
+ * records when each Func, parallel task and device launch ran on
+ * which thread. Set HL_TIMELINE_FILE to write this as a Chrome trace
+ * alongside the report.
+ *
  * Sample output:
  * memory_profiler_mandelbrot
  *  total time: 59.832336 ms   samples: 43   runs: 1000   time/run: 0.059832 ms
@@ -25,6 +35,8 @@
  */
 
 #include "IR.h"
+#include "Function.h"
+#include "Target.h"
 
 namespace Halide {
 namespace Internal {
@@ -33,10 +45,14 @@ namespace Internal {
  * high-resolution timing into the generated code (via spawning a
  * thread that acts as a sampling profiler); summaries of execution
  * times and counts will be logged at the end. Should be done before
- * storage flattening, but after all bounds inference.
- *
+ * storage flattening, but after all bounds inference. If the target
+ * has the ProfileHWCounters feature, also attribute hardware
+ * performance counter deltas to each Func, normalized by the pixel
+ * count of the first of the outputs. If it has the ProfileTimeline
+ * feature, also record begin and end events for each producer,
+ * parallel task and device launch.
  */
-Stmt inject_profiling(Stmt, std::string);
+Stmt inject_profiling(Stmt, std::string, const std::vector<Function> &outputs, const Target &t);
 
 }
 }
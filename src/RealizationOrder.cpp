@@ -3,6 +3,7 @@
 
 #include "RealizationOrder.h"
 #include "FindCalls.h"
+#include "Function.h"
 
 namespace Halide {
 namespace Internal {
@@ -15,6 +16,7 @@ using std::pair;
 
 void realization_order_dfs(string current,
                            const vector<pair<string, vector<string>>> &graph,
+                           const map<string, vector<string>> &fused_children,
                            set<string> &visited,
                            set<string> &result_set,
                            vector<string> &order) {
@@ -26,7 +28,7 @@ void realization_order_dfs(string current,
 
     for (const string &fn : iter->second) {
         if (visited.find(fn) == visited.end()) {
-            realization_order_dfs(fn, graph, visited, result_set, order);
+            realization_order_dfs(fn, graph, fused_children, visited, result_set, order);
         } else if (fn != current) { // Self-loops are allowed in update stages
             internal_assert(result_set.find(fn) != result_set.end())
                 << "Stuck in a loop computing a realization order. "
@@ -34,6 +36,16 @@ void realization_order_dfs(string current,
         }
     }
 
+    // Funcs computed with this one are realized immediately before
+    // it, so that their realizations enclose its production.
+    auto children = fused_children.find(current);
+    if (children != fused_children.end()) {
+        for (const string &c : children->second) {
+            result_set.insert(c);
+            order.push_back(c);
+        }
+    }
+
     result_set.insert(current);
     order.push_back(current);
 }
@@ -41,15 +53,54 @@ void realization_order_dfs(string current,
 vector<string> realization_order(const vector<Function> &outputs,
                                  const map<string, Function> &env) {
 
+    // A Func computed with another (see Func::compute_with) is
+    // treated as part of that Func in the graph: its inputs become
+    // the other's inputs, and calls to it are calls to the other.
+    map<string, string> fused_parent;
+    map<string, vector<string>> fused_children;
+    for (const pair<string, Function> &p : env) {
+        const FuseLoopLevel &fuse = p.second.schedule().fuse_level();
+        if (fuse.defined()) {
+            user_assert(env.count(fuse.func))
+                << "Func " << p.first << " is computed with " << fuse.func
+                << ", which is not used in this pipeline.\n";
+            user_assert(!env.find(fuse.func)->second.schedule().fuse_level().defined())
+                << "Func " << p.first << " is computed with " << fuse.func
+                << ", which is itself computed with another Func.\n";
+            fused_parent[p.first] = fuse.func;
+            fused_children[fuse.func].push_back(p.first);
+        }
+    }
+    auto group_of = [&](const string &f) {
+        auto it = fused_parent.find(f);
+        return it == fused_parent.end() ? f : it->second;
+    };
+
     // Make a DAG representing the pipeline. Each function maps to the
     // set describing its inputs.
     vector<pair<string, vector<string>>> graph;
 
     for (const pair<string, Function> &caller : env) {
+        if (fused_parent.count(caller.first)) {
+            continue;
+        }
+        vector<string> members = {caller.first};
+        auto children = fused_children.find(caller.first);
+        if (children != fused_children.end()) {
+            members.insert(members.end(), children->second.begin(), children->second.end());
+        }
         vector<string> s;
-        for (const pair<string, Function> &callee : find_direct_calls(caller.second)) {
-            if (std::find(s.begin(), s.end(), callee.first) == s.end()) {
-                s.push_back(callee.first);
+        for (const string &member : members) {
+            for (const pair<string, Function> &callee : find_direct_calls(env.find(member)->second)) {
+                string input = group_of(callee.first);
+                if (input == caller.first && callee.first != member) {
+                    user_error << "Funcs " << member << " and " << callee.first
+                               << " cannot be computed with each other, because "
+                               << member << " calls " << callee.first << ".\n";
+                }
+                if (std::find(s.begin(), s.end(), input) == s.end()) {
+                    s.push_back(input);
+                }
             }
         }
         graph.push_back({caller.first, s});
@@ -60,8 +111,9 @@ vector<string> realization_order(const vector<Function> &outputs,
     set<string> visited;
 
     for (Function f : outputs) {
-        if (visited.find(f.name()) == visited.end()) {
-            realization_order_dfs(f.name(), graph, visited, result_set, order);
+        string group = group_of(f.name());
+        if (visited.find(group) == visited.end()) {
+            realization_order_dfs(group, graph, fused_children, visited, result_set, order);
         }
     }
 
@@ -20,7 +20,8 @@ class Function;
  * order in which to do the scheduling. This in turn influences the
  * order in which stages are computed when there's no strict
  * dependency between them. Currently just some arbitrary depth-first
- * traversal of the call graph. */
+ * traversal of the call graph. Funcs computed with another Func (see
+ * Func::compute_with) come immediately before it. */
 std::vector<std::string> realization_order(const std::vector<Function> &output,
                                            const std::map<std::string, Function> &env);
 
@@ -44,6 +44,15 @@ class RemoveDeadAllocations : public IRMutator {
         IRMutator::visit(op);
     }
 
+    void visit(const Variable *op) {
+        // A reference to the allocation by name takes its address.
+        if (allocs.contains(op->name)) {
+            allocs.pop(op->name);
+        }
+
+        expr = op;
+    }
+
     void visit(const Allocate *op) {
         allocs.push(op->name, 1);
         Stmt body = mutate(op->body);
@@ -54,7 +63,7 @@ class RemoveDeadAllocations : public IRMutator {
         } else if (body.same_as(op->body)) {
             stmt = op;
         } else {
-            stmt = Allocate::make(op->name, op->type, op->extents, op->condition, body, op->new_expr, op->free_function);
+            stmt = Allocate::make(op->name, op->type, op->memory_type, op->extents, op->condition, body, op->new_expr, op->free_function);
         }
     }
 
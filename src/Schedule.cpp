@@ -127,8 +127,12 @@ struct FuncScheduleContents {
     LoopLevel store_level, compute_level;
     std::vector<StorageDim> storage_dims;
     std::vector<Bound> bounds;
+    std::vector<Bound> estimates;
     std::map<std::string, IntrusivePtr<Internal::FunctionContents>> wrappers;
     bool memoized;
+    bool async;
+    MemoryType memory_type;
+    FuseLoopLevel fuse_level;
 
     //----- HLS Modification Begins -----//
     // TODO(jingpu) move it to StageSchedule
@@ -147,7 +151,8 @@ struct FuncScheduleContents {
 
     FuncScheduleContents()
         : store_level(LoopLevel::inlined()),
-          compute_level(LoopLevel::inlined()), memoized(false),
+          compute_level(LoopLevel::inlined()), memoized(false), async(false),
+          memory_type(MemoryType::Auto),
           //----- HLS Modification Begins -----//
           is_hw_kernel(false), is_accelerated(false), is_linebuffered(false),
           is_kernel_buffer(false), is_kernel_buffer_slice(false){};
@@ -169,6 +174,14 @@ struct FuncScheduleContents {
                 b.remainder = mutator->mutate(b.remainder);
             }
         }
+        for (Bound &b : estimates) {
+            if (b.min.defined()) {
+                b.min = mutator->mutate(b.min);
+            }
+            if (b.extent.defined()) {
+                b.extent = mutator->mutate(b.extent);
+            }
+        }
     }
 };
 
@@ -192,6 +205,7 @@ struct StageScheduleContents {
     std::vector<Split> splits;
     std::vector<Dim> dims;
     std::vector<PrefetchDirective> prefetches;
+    std::vector<CacheTile> cache_tiles;
     bool touched;
     bool allow_race_conditions;
 
@@ -242,7 +256,11 @@ FuncSchedule FuncSchedule::deep_copy(
     copy.contents->compute_level = contents->compute_level;
     copy.contents->storage_dims = contents->storage_dims;
     copy.contents->bounds = contents->bounds;
+    copy.contents->estimates = contents->estimates;
     copy.contents->memoized = contents->memoized;
+    copy.contents->async = contents->async;
+    copy.contents->memory_type = contents->memory_type;
+    copy.contents->fuse_level = contents->fuse_level;
 
     //----- HLS Modification Begins -----//
     // HLS related fields
@@ -284,6 +302,30 @@ bool FuncSchedule::memoized() const {
     return contents->memoized;
 }
 
+bool &FuncSchedule::async() {
+    return contents->async;
+}
+
+bool FuncSchedule::async() const {
+    return contents->async;
+}
+
+MemoryType &FuncSchedule::memory_type() {
+    return contents->memory_type;
+}
+
+MemoryType FuncSchedule::memory_type() const {
+    return contents->memory_type;
+}
+
+FuseLoopLevel &FuncSchedule::fuse_level() {
+    return contents->fuse_level;
+}
+
+const FuseLoopLevel &FuncSchedule::fuse_level() const {
+    return contents->fuse_level;
+}
+
 std::vector<StorageDim> &FuncSchedule::storage_dims() {
     return contents->storage_dims;
 }
@@ -300,6 +342,14 @@ const std::vector<Bound> &FuncSchedule::bounds() const {
     return contents->bounds;
 }
 
+std::vector<Bound> &FuncSchedule::estimates() {
+    return contents->estimates;
+}
+
+const std::vector<Bound> &FuncSchedule::estimates() const {
+    return contents->estimates;
+}
+
 std::map<std::string, IntrusivePtr<Internal::FunctionContents>> &FuncSchedule::wrappers() {
     return contents->wrappers;
 }
@@ -352,6 +402,14 @@ void FuncSchedule::accept(IRVisitor *visitor) const {
             b.remainder.accept(visitor);
         }
     }
+    for (const Bound &b : estimates()) {
+        if (b.min.defined()) {
+            b.min.accept(visitor);
+        }
+        if (b.extent.defined()) {
+            b.extent.accept(visitor);
+        }
+    }
 }
 
 void FuncSchedule::mutate(IRMutator *mutator) {
@@ -370,6 +428,7 @@ StageSchedule StageSchedule::get_copy() const {
     copy.contents->splits = contents->splits;
     copy.contents->dims = contents->dims;
     copy.contents->prefetches = contents->prefetches;
+    copy.contents->cache_tiles = contents->cache_tiles;
     copy.contents->touched = contents->touched;
     copy.contents->allow_race_conditions = contents->allow_race_conditions;
     return copy;
@@ -415,6 +474,14 @@ const std::vector<PrefetchDirective> &StageSchedule::prefetches() const {
     return contents->prefetches;
 }
 
+std::vector<CacheTile> &StageSchedule::cache_tiles() {
+    return contents->cache_tiles;
+}
+
+const std::vector<CacheTile> &StageSchedule::cache_tiles() const {
+    return contents->cache_tiles;
+}
+
 //----- HLS Modification Begins -----//
 bool &FuncSchedule::is_hw_kernel() {
     return contents->is_hw_kernel;
@@ -235,6 +235,31 @@ struct PrefetchDirective {
     Parameter param;
 };
 
+/** A tile of a stage whose size is chosen during lowering, so that
+ * the data one tile touches fits in a level of the cache of the
+ * target (see Func::tile). Until then, the factors of the splits of
+ * x and y are the variables named xfactor and yfactor. */
+struct CacheTile {
+    std::string x, y;
+    std::string xfactor, yfactor;
+    CacheLevel level;
+};
+
+/** The loop of one stage of a Func that the loops of another Func
+ * are fused into (see Func::compute_with). The loops from the
+ * outermost one down to and including var are shared. */
+struct FuseLoopLevel {
+    std::string func;
+    int stage;
+    std::string var;
+
+    FuseLoopLevel() : stage(0) {}
+    FuseLoopLevel(const std::string &f, int s, const std::string &v)
+        : func(f), stage(s), var(v) {}
+
+    bool defined() const { return !func.empty(); }
+};
+
 struct FuncScheduleContents;
 struct StageScheduleContents;
 struct FunctionContents;
@@ -268,6 +293,28 @@ public:
     bool memoized() const;
     // @}
 
+    /** The loop of another Func's stage that this Func's pure
+     * definition is fused into, if any. */
+    // @{
+    FuseLoopLevel &fuse_level();
+    const FuseLoopLevel &fuse_level() const;
+    // @}
+
+    /** This flag is set to true if the function is computed
+     * asynchronously, in a task that runs concurrently with its
+     * consumers. */
+    // @{
+    bool &async();
+    bool async() const;
+    // @}
+
+    /** The kind of memory the storage of this function is allocated
+     * in. See \ref Func::store_in */
+    // @{
+    MemoryType &memory_type();
+    MemoryType memory_type() const;
+    // @}
+
     /** The list and order of dimensions used to store this
      * function. The first dimension in the vector corresponds to the
      * innermost dimension for storage (i.e. which dimension is
@@ -285,6 +332,14 @@ public:
     std::vector<Bound> &bounds();
     // @}
 
+    /** You may provide hints for the size of some dimensions of a
+     * function for the automatic scheduler. They have no effect on
+     * the code generated. See \ref Func::estimate */
+    // @{
+    const std::vector<Bound> &estimates() const;
+    std::vector<Bound> &estimates();
+    // @}
+
     /** Mark calls of a function by 'f' to be replaced with its wrapper
      * during the lowering stage. If the string 'f' is empty, it means replace
      * all calls to the function by all other functions (excluding itself) in
@@ -436,6 +491,13 @@ public:
     std::vector<PrefetchDirective> &prefetches();
     // @}
 
+    /** The tiles of this stage that are sized to fit in the
+     * cache. See \ref Func::tile */
+    // @{
+    const std::vector<CacheTile> &cache_tiles() const;
+    std::vector<CacheTile> &cache_tiles();
+    // @}
+
     /** Are race conditions permitted? */
     // @{
     bool allow_race_conditions() const;
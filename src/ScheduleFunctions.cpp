@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "ScheduleFunctions.h"
 #include "IROperator.h"
 #include "Simplify.h"
@@ -13,6 +15,7 @@
 #include "Func.h"
 #include "ApplySplit.h"
 #include "IREquality.h"
+#include "LoopProfile.h"
 
 namespace Halide {
 namespace Internal {
@@ -261,13 +264,64 @@ Stmt build_provide_loop_nest_helper(string func_name,
     return stmt;
 }
 
-// Build a loop nest about a provide node using a schedule
+// The order in which to try the specializations of a
+// definition. They are tried in the order they were declared, unless
+// the loop profiles say which are taken most often, and their
+// conditions are mutually exclusive, in which case the most frequently
+// taken go first. (Without mutually exclusive conditions, the later
+// specializations have been simplified assuming the earlier ones are
+// false.) specialize_fail() always stays last.
+vector<size_t> specialization_order(const vector<Specialization> &specializations,
+                                    const string &pipeline_name,
+                                    const string &specialization_prefix) {
+    vector<size_t> order(specializations.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+
+    size_t num_movable = specializations.size();
+    if (num_movable > 0 && !specializations.back().failure_message.empty()) {
+        num_movable--;
+    }
+
+    vector<uint64_t> taken(num_movable, 0);
+    bool any_profiled = false;
+    for (size_t i = 0; i < num_movable; i++) {
+        LoopProfile profile;
+        if (find_loop_profile(pipeline_name, specialization_prefix + std::to_string(i), &profile)) {
+            taken[i] = profile.entries;
+            any_profiled = true;
+        }
+    }
+    if (!any_profiled) {
+        return order;
+    }
+
+    for (size_t i = 0; i < num_movable; i++) {
+        for (size_t j = i + 1; j < num_movable; j++) {
+            if (!can_prove(!(specializations[i].condition && specializations[j].condition))) {
+                return order;
+            }
+        }
+    }
+
+    std::stable_sort(order.begin(), order.begin() + num_movable,
+                     [&](size_t a, size_t b) { return taken[a] > taken[b]; });
+    return order;
+}
+
+// Build a loop nest about a provide node using a schedule. The
+// specializations are named after specialization_prefix in the loop
+// profiles of the pipeline.
 Stmt build_provide_loop_nest(string func_name,
                              string prefix,
                              const vector<string> &dims,
                              const FuncSchedule &f_sched,
                              const Definition &def,
-                             bool is_update) {
+                             bool is_update,
+                             const string &pipeline_name,
+                             const Target &target,
+                             const string &specialization_prefix) {
 
     internal_assert(!is_update == def.is_init());
 
@@ -295,17 +349,23 @@ Stmt build_provide_loop_nest(string func_name,
 
     // Make any specialized copies
     const vector<Specialization> &specializations = def.specializations();
-    for (size_t i = specializations.size(); i > 0; i--) {
-        const Specialization &s = specializations[i-1];
+    vector<size_t> order = specialization_order(specializations, pipeline_name, specialization_prefix);
+    for (size_t i = order.size(); i > 0; i--) {
+        const Specialization &s = specializations[order[i-1]];
         Expr c = s.condition;
         const Definition &s_def = s.definition;
         Stmt then_case;
         if (s.failure_message.empty()) {
-            then_case = build_provide_loop_nest(func_name, prefix, dims, f_sched, s_def, is_update);
+            string name = specialization_prefix + std::to_string(order[i-1]);
+            then_case = build_provide_loop_nest(func_name, prefix, dims, f_sched, s_def, is_update,
+                                                pipeline_name, target, name + ".");
+            if (target.has_feature(Target::ProfileLoops)) {
+                then_case = Block::make(loop_profile_marker(name), then_case);
+            }
         } else {
             internal_assert(equal(c, const_true()));
             // specialize_fail() should only be possible on the final specialization
-            internal_assert(i == specializations.size());
+            internal_assert(order[i-1] == specializations.size() - 1);
             Expr specialize_fail_error =
                 Internal::Call::make(Int(32),
                                      "halide_error_specialize_fail",
@@ -325,7 +385,7 @@ Stmt build_provide_loop_nest(string func_name,
 // which it should be realized. It will compute at least those
 // bounds (depending on splits, it may compute more). This loop
 // won't do any allocation.
-Stmt build_produce(Function f, const Target &target) {
+Stmt build_produce(Function f, const string &pipeline_name, const Target &target) {
 
     if (f.has_extern_definition()) {
         // Call the external function
@@ -508,12 +568,13 @@ Stmt build_produce(Function f, const Target &target) {
 
         string prefix = f.name() + ".s0.";
         vector<string> dims = f.args();
-        return build_provide_loop_nest(f.name(), prefix, dims, f.schedule(), f.definition(), false);
+        return build_provide_loop_nest(f.name(), prefix, dims, f.schedule(), f.definition(), false,
+                                       pipeline_name, target, prefix + "specialization.");
     }
 }
 
 // Build the loop nests that update a function (assuming it's a reduction).
-vector<Stmt> build_update(Function f) {
+vector<Stmt> build_update(Function f, const string &pipeline_name, const Target &target) {
 
     vector<Stmt> updates;
 
@@ -523,16 +584,17 @@ vector<Stmt> build_update(Function f) {
         string prefix = f.name() + ".s" + std::to_string(i+1) + ".";
 
         vector<string> dims = f.args();
-        Stmt loop = build_provide_loop_nest(f.name(), prefix, dims, f.schedule(), def, true);
+        Stmt loop = build_provide_loop_nest(f.name(), prefix, dims, f.schedule(), def, true,
+                                            pipeline_name, target, prefix + "specialization.");
         updates.push_back(loop);
     }
 
     return updates;
 }
 
-pair<Stmt, Stmt> build_production(Function func, const Target &target) {
-    Stmt produce = build_produce(func, target);
-    vector<Stmt> updates = build_update(func);
+pair<Stmt, Stmt> build_production(Function func, const string &pipeline_name, const Target &target) {
+    Stmt produce = build_produce(func, pipeline_name, target);
+    vector<Stmt> updates = build_update(func, pipeline_name, target);
 
     // Combine the update steps
     Stmt merged_updates = Block::make(updates);
@@ -606,25 +668,146 @@ bool function_is_used_in_stmt(Function f, Stmt s) {
     return is_called.result;
 }
 
+// Fuse the outermost loops of the loop nest of a Func computed with
+// another (see Func::compute_with) into the loop nest of the other
+// Func's stage. Each fused loop iterates over the union of the two
+// loops' ranges, and the remaining body of each nest is guarded so
+// that it only runs over its own range.
+Stmt fuse_loop_nests(Stmt parent, Stmt child, int num_fused, const string &child_name,
+                     Expr parent_guard, Expr child_guard) {
+    vector<pair<string, Expr>> parent_lets, child_lets;
+    while (const LetStmt *l = parent.as<LetStmt>()) {
+        parent_lets.push_back({ l->name, l->value });
+        parent = l->body;
+    }
+    while (const LetStmt *l = child.as<LetStmt>()) {
+        child_lets.push_back({ l->name, l->value });
+        child = l->body;
+    }
+
+    const For *p = parent.as<For>();
+    const For *c = child.as<For>();
+    user_assert(p && c)
+        << "Func " << child_name << " cannot be computed with another Func, "
+        << "because one of their loop nests is specialized or guarded by a "
+        << "condition above the level they are fused at.\n";
+
+    Expr var = Variable::make(Int(32), p->name);
+    Expr p_max = p->min + p->extent - 1;
+    Expr c_max = c->min + c->extent - 1;
+    parent_guard = parent_guard && var >= p->min && var <= p_max;
+    child_guard = child_guard && var >= c->min && var <= c_max;
+
+    // The child's loop variable is the parent's.
+    Stmt child_body = LetStmt::make(c->name, var, c->body);
+
+    Stmt body;
+    if (num_fused == 1) {
+        child_body = ProducerConsumer::make_produce(child_name, child_body);
+        body = Block::make(IfThenElse::make(likely(parent_guard), p->body),
+                           IfThenElse::make(likely(child_guard), child_body));
+    } else {
+        body = fuse_loop_nests(p->body, child_body, num_fused - 1, child_name,
+                               parent_guard, child_guard);
+    }
+
+    Expr min = Min::make(p->min, c->min);
+    Expr extent = Max::make(p_max, c_max) + 1 - min;
+    Stmt stmt = For::make(p->name, min, extent, p->for_type, p->device_api, body);
+
+    for (size_t i = child_lets.size(); i > 0; i--) {
+        stmt = LetStmt::make(child_lets[i - 1].first, child_lets[i - 1].second, stmt);
+    }
+    for (size_t i = parent_lets.size(); i > 0; i--) {
+        stmt = LetStmt::make(parent_lets[i - 1].first, parent_lets[i - 1].second, stmt);
+    }
+    return stmt;
+}
+
+// Find the production of the Func that another Func is computed with
+// at this loop level, and fuse the other Func's loop nest into it.
+class FuseIntoProduction : public IRMutator {
+    const Function &func;
+    const Function &parent;
+    Stmt nest;
+
+    using IRMutator::visit;
+
+    void visit(const For *op) {
+        // Productions in inner loops are at a different loop level.
+        stmt = op;
+    }
+
+    void visit(const ProducerConsumer *op) {
+        if (!op->is_producer || op->name != parent.name()) {
+            IRMutator::visit(op);
+            return;
+        }
+
+        const FuseLoopLevel &fuse = func.schedule().fuse_level();
+        const Definition &def = fuse.stage == 0 ? parent.definition() : parent.update(fuse.stage - 1);
+        const vector<Dim> &dims = def.schedule().dims();
+        int num_fused = 0;
+        for (size_t i = 0; i < dims.size(); i++) {
+            if (dims[i].var == fuse.var) {
+                num_fused = (int)(dims.size() - i);
+            }
+        }
+        user_assert(num_fused > 0)
+            << "Func " << func.name() << " cannot be computed with " << parent.name()
+            << " at " << fuse.var << ", because stage " << fuse.stage << " of "
+            << parent.name() << " has no loop over " << fuse.var << ".\n";
+        user_assert((int)func.definition().schedule().dims().size() >= num_fused)
+            << "Func " << func.name() << " cannot be computed with " << parent.name()
+            << " at " << fuse.var << ", because it has fewer loops than "
+            << parent.name() << " has outside of " << fuse.var << ".\n";
+
+        // The stages of a production are a sequence of loop nests,
+        // one per stage.
+        vector<Stmt> stages;
+        Stmt rest = op->body;
+        while (const Block *b = rest.as<Block>()) {
+            stages.push_back(b->first);
+            rest = b->rest;
+        }
+        stages.push_back(rest);
+        internal_assert(fuse.stage < (int)stages.size());
+
+        stages[fuse.stage] = fuse_loop_nests(stages[fuse.stage], nest, num_fused, func.name(),
+                                             const_true(), const_true());
+        stmt = ProducerConsumer::make_produce(op->name, Block::make(stages));
+        found = true;
+    }
+
+public:
+    bool found = false;
+    FuseIntoProduction(const Function &f, const Function &p,
+                       const string &pipeline_name, const Target &target)
+        : func(f), parent(p), nest(build_produce(f, pipeline_name, target)) {}
+};
+
 // Inject the allocation and realization of a function into an
 // existing loop nest using its schedule
 class InjectRealization : public IRMutator {
 public:
     const Function &func;
     bool is_output, found_store_level, found_compute_level;
+    const string &pipeline_name;
     const Target &target;
+    // The Func this one is computed with, if any.
+    Function fuse_parent;
 
-    InjectRealization(const Function &f, bool o, const Target &t) :
+    InjectRealization(const Function &f, bool o, const string &p, const Target &t) :
         func(f), is_output(o),
         found_store_level(false), found_compute_level(false),
-        target(t) {}
+        pipeline_name(p), target(t) {}
 
 private:
 
     string producing;
 
     Stmt build_pipeline(Stmt consumer) {
-        pair<Stmt, Stmt> realization = build_production(func, target);
+        pair<Stmt, Stmt> realization = build_production(func, pipeline_name, target);
 
         Stmt producer;
         if (realization.first.defined() && realization.second.defined()) {
@@ -725,7 +908,14 @@ private:
 
         if (compute_level.match(for_loop->name)) {
             debug(3) << "Found compute level\n";
-            if (function_is_used_in_stmt(func, body) || is_output) {
+            if (func.schedule().fuse_level().defined()) {
+                FuseIntoProduction fuser(func, fuse_parent, pipeline_name, target);
+                body = fuser.mutate(body);
+                user_assert(fuser.found)
+                    << "Func " << func.name() << " is computed with " << fuse_parent.name()
+                    << ", but " << fuse_parent.name() << " is not computed at "
+                    << compute_level.to_string() << ".\n";
+            } else if (function_is_used_in_stmt(func, body) || is_output) {
                 body = build_pipeline(body);
             }
             found_compute_level = true;
@@ -1147,6 +1337,7 @@ class RemoveLoopsOverOutermost : public IRMutator {
 Stmt schedule_functions(const vector<Function> &outputs,
                         const vector<string> &order,
                         const map<string, Function> &env,
+                        const string &pipeline_name,
                         const Target &target,
                         bool &any_memoized) {
 
@@ -1172,6 +1363,29 @@ Stmt schedule_functions(const vector<Function> &outputs,
             f.schedule().compute_level() = func_exit.schedule().accelerate_compute_level();
             f.schedule().store_level() = func_exit.schedule().accelerate_store_level();
         }
+        // A Func computed with another is computed at the same loop
+        // level, and by default stored there too.
+        Function fuse_parent;
+        if (f.schedule().fuse_level().defined()) {
+            fuse_parent = env.find(f.schedule().fuse_level().func)->second;
+            user_assert(!f.has_extern_definition() && f.updates().empty() &&
+                        f.definition().specializations().empty())
+                << "Func " << f.name() << " cannot be computed with " << fuse_parent.name()
+                << ", because only Funcs with a single, unspecialized, pure definition "
+                << "can be computed with another Func.\n";
+            user_assert(!fuse_parent.has_extern_definition() &&
+                        f.schedule().fuse_level().stage <= (int)fuse_parent.updates().size())
+                << "Func " << f.name() << " cannot be computed with a stage of "
+                << fuse_parent.name() << " that does not exist.\n";
+            user_assert(!fuse_parent.schedule().compute_level().is_inline())
+                << "Func " << f.name() << " cannot be computed with " << fuse_parent.name()
+                << ", because " << fuse_parent.name() << " is inlined.\n";
+            if (f.schedule().store_level().is_inline()) {
+                f.schedule().store_level() = fuse_parent.schedule().compute_level();
+            }
+            f.schedule().compute_level() = fuse_parent.schedule().compute_level();
+        }
+
         bool necessary = validate_schedule(f, s, target, is_output, env);
 
         if (!necessary) {
@@ -1190,7 +1404,8 @@ Stmt schedule_functions(const vector<Function> &outputs,
             s = inline_function(s, f);
         } else {
             debug(1) << "Injecting realization of " << order[i-1] << '\n';
-            InjectRealization injector(f, is_output, target);
+            InjectRealization injector(f, is_output, pipeline_name, target);
+            injector.fuse_parent = fuse_parent;
             s = injector.mutate(s);
             internal_assert(injector.found_store_level && injector.found_compute_level);
         }
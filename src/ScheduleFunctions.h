@@ -20,11 +20,14 @@ namespace Internal {
 class Function;
 
 /** Build loop nests and inject Function realizations at the
- * appropriate places using the schedule. Returns a flag indicating
- * whether memoization passes need to be run. */
+ * appropriate places using the schedule. Specializations are ordered
+ * using the loop profiles of the named pipeline, or of all pipelines
+ * if the name is empty. Returns a flag indicating whether memoization
+ * passes need to be run. */
 Stmt schedule_functions(const std::vector<Function> &outputs,
                         const std::vector<std::string> &order,
                         const std::map<std::string, Function> &env,
+                        const std::string &pipeline_name,
                         const Target &target,
                         bool &any_memoized);
 
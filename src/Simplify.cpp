@@ -2,7 +2,10 @@
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <stdio.h>
+#include <unordered_map>
 
 #include "Simplify.h"
 #include "IROperator.h"
@@ -167,6 +170,216 @@ bool expr_is_pure(const Expr &e) {
     return pure.result;
 }
 
+/** Test if an expression contains a poison value made by
+ * signed_integer_overflow_error or
+ * indeterminate_expression_error. Each of those is unique, so they
+ * can't be reused from a cache. */
+class ContainsPoison : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    void visit(const Call *op) {
+        if (op->is_intrinsic(Call::signed_integer_overflow) ||
+            op->is_intrinsic(Call::indeterminate_expression)) {
+            result = true;
+        } else if (!result) {
+            IRGraphVisitor::visit(op);
+        }
+    }
+public:
+    bool result = false;
+};
+
+/** Collect the immediate children of an Expr. */
+class ExprChildren : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+public:
+    vector<Expr> children;
+    void include(const Expr &e) {
+        children.push_back(e);
+    }
+    void include(const Stmt &s) {}
+};
+
+/** A bounded cache of the results of simplifying interned
+ * Exprs. Simplifying an Expr depends on more than the Expr itself:
+ * it also depends on the constant bounds and alignment known for its
+ * free variables, so those facts are part of the key. Subexpressions
+ * that refer to variables bound by an enclosing Let are never cached,
+ * because simplifying them updates the use counts of the Let. The
+ * cache is shared between calls to simplify, so that the identical
+ * subexpressions that bounds inference and loop partitioning query
+ * again and again are only simplified once. Set HL_SIMPLIFY_MEMO=1
+ * to turn it on. */
+class SimplifyMemo {
+public:
+    /** What the simplification of an interned Expr depends on,
+     * computed once per node. */
+    struct Info {
+        // The number of nodes in the tree, stopping at max_size.
+        int size;
+        // Lets rename and count the uses of their variables, so
+        // trees containing them are never cached.
+        bool memoizable;
+        // The names the simplifier looks up in its scopes when
+        // simplifying this Expr, sorted.
+        vector<string> names;
+        vector<Expr> children;
+    };
+
+    /** What the simplifier knows about one of the names of an Expr. */
+    struct Fact {
+        bool bounded = false, aligned = false;
+        int64_t min = 0, max = 0;
+        int modulus = 0, remainder = 0;
+
+        bool operator==(const Fact &other) const {
+            return (bounded == other.bounded && min == other.min && max == other.max &&
+                    aligned == other.aligned && modulus == other.modulus &&
+                    remainder == other.remainder);
+        }
+    };
+
+    struct Key {
+        Expr expr;
+        bool simplify_lets;
+        vector<Fact> facts;
+
+        uint64_t hash() const {
+            uint64_t h = (uint64_t)(uintptr_t)expr.get() * 2 + simplify_lets;
+            for (const Fact &f : facts) {
+                uint64_t w = ((uint64_t)f.min * 31 + (uint64_t)f.max) * 31 + f.modulus;
+                w = (w * 31 + f.remainder) * 4 + f.bounded * 2 + f.aligned;
+                h = (h ^ w) * 1099511628211ULL;
+            }
+            return h ^ (h >> 29);
+        }
+
+        bool operator==(const Key &other) const {
+            return (expr.same_as(other.expr) &&
+                    simplify_lets == other.simplify_lets &&
+                    facts == other.facts);
+        }
+    };
+
+    // Expressions smaller than this are cheaper to simplify than to
+    // look up.
+    static const int min_size = 8;
+    static const int max_size = 1 << 16;
+
+    bool enabled;
+
+    static SimplifyMemo &get() {
+        static SimplifyMemo memo;
+        return memo;
+    }
+
+    /** Intern an Expr and find its subexpressions worth caching. */
+    Expr prepare(const Expr &e, std::unordered_map<const IRNode *, std::shared_ptr<const Info>> *candidates) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (interner.size() > max_interned) {
+            interner.clear();
+            infos.clear();
+            for (Entry &entry : entries) {
+                entry = Entry();
+            }
+        }
+        Expr canonical = interner.intern(e);
+        find_candidates(canonical, candidates);
+        return canonical;
+    }
+
+    bool lookup(const Key &key, Expr *result) {
+        std::lock_guard<std::mutex> lock(mutex);
+        const Entry &entry = entries[key.hash() & (entries.size() - 1)];
+        if (entry.result.defined() && entry.key == key) {
+            *result = entry.result;
+            return true;
+        }
+        return false;
+    }
+
+    void insert(Key &&key, const Expr &result) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry &entry = entries[key.hash() & (entries.size() - 1)];
+        entry.key = std::move(key);
+        entry.result = result;
+    }
+
+private:
+    struct Entry {
+        Key key;
+        Expr result;
+    };
+
+    static const size_t max_interned = 1 << 17;
+
+    std::mutex mutex;
+    ExprInterner interner;
+    std::unordered_map<const IRNode *, std::shared_ptr<const Info>> infos;
+    vector<Entry> entries;
+
+    SimplifyMemo() : entries(1 << 12) {
+        enabled = get_env_variable("HL_SIMPLIFY_MEMO") == "1";
+    }
+
+    std::shared_ptr<const Info> get_info(const Expr &e) {
+        auto it = infos.find(e.get());
+        if (it != infos.end()) {
+            return it->second;
+        }
+
+        std::shared_ptr<Info> info = std::make_shared<Info>();
+        ExprChildren children;
+        e.accept(&children);
+        info->children = std::move(children.children);
+        info->size = 1;
+        info->memoizable = (e.as<Let>() == nullptr);
+        vector<string> names;
+        for (const Expr &c : info->children) {
+            std::shared_ptr<const Info> child = get_info(c);
+            info->size = std::min(max_size, info->size + child->size);
+            info->memoizable = info->memoizable && child->memoizable;
+            names.insert(names.end(), child->names.begin(), child->names.end());
+        }
+
+        if (const Variable *var = e.as<Variable>()) {
+            names.push_back(var->name);
+        } else if (const Load *load = e.as<Load>()) {
+            names.push_back(load->name);
+        } else if (const Call *call = e.as<Call>()) {
+            if (call->call_type == Call::Image || call->call_type == Call::Halide) {
+                names.push_back(call->name);
+                for (size_t i = 0; i < call->args.size(); i++) {
+                    names.push_back(call->name + ".stride." + std::to_string(i));
+                    names.push_back(call->name + ".min." + std::to_string(i));
+                }
+            }
+        }
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+        info->names = std::move(names);
+
+        infos.emplace(e.get(), info);
+        return info;
+    }
+
+    void find_candidates(const Expr &e, std::unordered_map<const IRNode *, std::shared_ptr<const Info>> *candidates) {
+        if (candidates->count(e.get())) {
+            return;
+        }
+        std::shared_ptr<const Info> info = get_info(e);
+        if (info->size < min_size) {
+            return;
+        }
+        if (info->memoizable) {
+            (*candidates)[e.get()] = info;
+        }
+        for (const Expr &c : info->children) {
+            find_candidates(c, candidates);
+        }
+    }
+};
+
 #if LOG_EXPR_MUTATIONS || LOG_STMT_MUTATIONS
 static int debug_indent = 0;
 #endif
@@ -220,13 +433,68 @@ public:
         }
         return new_s;
     }
+#else
+    Expr mutate(const Expr &e) {
+        if (memo_candidates.empty()) {
+            return IRMutator::mutate(e);
+        }
+        auto it = memo_candidates.find(e.get());
+        if (it == memo_candidates.end()) {
+            return IRMutator::mutate(e);
+        }
+
+        SimplifyMemo::Key key;
+        key.expr = e;
+        key.simplify_lets = simplify_lets;
+        for (const string &name : it->second->names) {
+            if (var_info.contains(name)) {
+                return IRMutator::mutate(e);
+            }
+            SimplifyMemo::Fact fact;
+            if (bounds_info.contains(name)) {
+                pair<int64_t, int64_t> b = bounds_info.get(name);
+                fact.bounded = true;
+                fact.min = b.first;
+                fact.max = b.second;
+            }
+            if (alignment_info.contains(name)) {
+                ModulusRemainder mod_rem = alignment_info.get(name);
+                fact.aligned = true;
+                fact.modulus = mod_rem.modulus;
+                fact.remainder = mod_rem.remainder;
+            }
+            key.facts.push_back(fact);
+        }
+
+        SimplifyMemo &memo = SimplifyMemo::get();
+        Expr result;
+        if (!memo.lookup(key, &result)) {
+            result = IRMutator::mutate(e);
+            ContainsPoison poison;
+            result.accept(&poison);
+            if (!poison.result) {
+                memo.insert(std::move(key), result);
+            }
+        }
+        return result;
+    }
 #endif
     using IRMutator::mutate;
 
+    /** Intern an Expr and find the subexpressions of it that are
+     * worth looking up in the memo. Returns the canonical node to
+     * simplify instead of e. */
+    Expr prepare_memo(const Expr &e) {
+        return SimplifyMemo::get().prepare(e, &memo_candidates);
+    }
 
 private:
     bool simplify_lets;
 
+    // The interned subexpressions of the Expr being simplified that
+    // are looked up in the memo.
+    std::unordered_map<const IRNode *, std::shared_ptr<const SimplifyMemo::Info>> memo_candidates;
+
     struct VarInfo {
         Expr replacement;
         int old_uses, new_uses;
@@ -4950,7 +5218,7 @@ private:
             equal(op->condition, body_if->condition)) {
             // We can move the allocation into the if body case. The
             // else case must not use it.
-            stmt = Allocate::make(op->name, op->type, new_extents,
+            stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents,
                                   condition, body_if->then_case,
                                   new_expr, op->free_function);
             stmt = IfThenElse::make(body_if->condition, stmt, body_if->else_case);
@@ -4960,7 +5228,7 @@ private:
                    new_expr.same_as(op->new_expr)) {
             stmt = op;
         } else {
-            stmt = Allocate::make(op->name, op->type, new_extents,
+            stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents,
                                   condition, body,
                                   new_expr, op->free_function);
         }
@@ -5074,7 +5342,14 @@ private:
 Expr simplify(Expr e, bool simplify_lets,
               const Scope<Interval> &bounds,
               const Scope<ModulusRemainder> &alignment) {
-    return Simplify(simplify_lets, &bounds, &alignment).mutate(e);
+    Simplify simplifier(simplify_lets, &bounds, &alignment);
+    if (!e.defined() || !SimplifyMemo::get().enabled) {
+        return simplifier.mutate(e);
+    }
+    Expr canonical = simplifier.prepare_memo(e);
+    Expr result = simplifier.mutate(canonical);
+    // Callers check whether simplification did anything with same_as.
+    return result.same_as(canonical) ? e : result;
 }
 
 Stmt simplify(Stmt s, bool simplify_lets,
@@ -6429,6 +6704,25 @@ void simplify_test() {
     check_in_bounds(max(ramp(x, -1, 4), broadcast(-4, 4)), ramp(x, -1, 4),   bounds_info);
     check_in_bounds(max(ramp(x, -1, 4), broadcast( 5, 4)), broadcast(5, 4),  bounds_info);
 
+    {
+        // The memo has to key the simplified Expr on the bounds of
+        // its free variables, not just on the Expr.
+        SimplifyMemo &memo = SimplifyMemo::get();
+        bool was_enabled = memo.enabled;
+        memo.enabled = true;
+        Scope<Interval> small;
+        small.push("x", Interval(0, 4));
+        small.push("y", Interval(0, 1));
+        Expr e = min(x + y*2 + 3, 10) + z*w;
+        Expr with_bounds = simplify(e, true, small);
+        Expr without_bounds = simplify(e);
+        internal_assert(!equal(with_bounds, without_bounds))
+            << with_bounds << " and " << without_bounds << " should differ\n";
+        internal_assert(equal(simplify(e, true, small), with_bounds));
+        internal_assert(equal(simplify(e), without_bounds));
+        memo.enabled = was_enabled;
+    }
+
     // Collapse some vector interleaves
     check(interleave_vectors({ramp(x, 2, 4), ramp(x+1, 2, 4)}), ramp(x, 1, 8));
     check(interleave_vectors({ramp(x, 4, 4), ramp(x+2, 4, 4)}), ramp(x, 2, 8));
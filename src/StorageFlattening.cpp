@@ -126,10 +126,12 @@ private:
         realizations.pop(op->name);
 
         vector<int> storage_permutation;
+        MemoryType memory_type;
         {
             auto iter = env.find(op->name);
             internal_assert(iter != env.end()) << "Realize node refers to function not in environment.\n";
             Function f = iter->second.first;
+            memory_type = f.schedule().memory_type();
             const vector<StorageDim> &storage_dims = f.schedule().storage_dims();
             const vector<string> &args = f.args();
             for (size_t i = 0; i < storage_dims.size(); i++) {
@@ -180,7 +182,7 @@ private:
         stmt = LetStmt::make(op->name + ".buffer", builder.build(), stmt);
 
         // Make the allocation node
-        stmt = Allocate::make(op->name, op->types[0], extents, condition, stmt);
+        stmt = Allocate::make(op->name, op->types[0], memory_type, extents, condition, stmt);
 
         // Compute the strides
         for (int i = (int)op->bounds.size()-1; i > 0; i--) {
@@ -355,7 +357,7 @@ class PromoteToMemoryType : public IRMutator {
             for (Expr e : op->extents) {
                 extents.push_back(mutate(e));
             }
-            stmt = Allocate::make(op->name, t, extents,
+            stmt = Allocate::make(op->name, t, op->memory_type, extents,
                                   mutate(op->condition), mutate(op->body),
                                   mutate(op->new_expr), op->free_function);
         } else {
@@ -91,6 +91,7 @@ public:
 class AttemptStorageFoldingOfFunction : public IRMutator {
     Function func;
     bool explicit_only;
+    bool async;
 
     using IRMutator::visit;
 
@@ -119,8 +120,25 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
         Box required = box_required(body, func.name());
         Box box = box_union(provided, required);
 
+        // If there's no communication of values from one loop
+        // iteration to the next (which may happen due to sliding),
+        // then each iteration only needs storage for its own
+        // footprint, wherever that lies.
+        bool independent = box_contains(provided, required);
+
+        // Whether values computed by one iteration are used by the
+        // next in a dimension we folded. If so, we can keep folding
+        // other dimensions over this loop, but not over inner loops.
+        bool carried = false;
+
         // Try each dimension in turn from outermost in
         for (size_t i = box.size(); i > 0; i--) {
+            if (async && !dims_folded.empty()) {
+                // The back-pressure on the producer of an async Func
+                // only counts the slots of one folded dimension.
+                break;
+            }
+
             Expr min = simplify(box[i-1].min);
             Expr max = simplify(box[i-1].max);
 
@@ -174,6 +192,30 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
                 body = Block::make(AssertStmt::make(condition, error), body);
             }
 
+            if (async && (min_monotonic_increasing || max_monotonic_decreasing)) {
+                // The producer of an async Func claims slots as the
+                // footprint grows into them, so the other end of the
+                // footprint must move in the same direction.
+                bool forward = min_monotonic_increasing;
+                Expr other = forward ? max : min;
+                Monotonic m = is_monotonic(other, op->name);
+                if (m != Monotonic::Constant &&
+                    m != (forward ? Monotonic::Increasing : Monotonic::Decreasing)) {
+                    if (explicit_factor.defined()) {
+                        Expr loop_var = Variable::make(Int(32), op->name);
+                        Expr other_next = substitute(op->name, loop_var + 1, other);
+                        Expr condition = forward ? other_next >= other : other_next <= other;
+                        Expr error = Call::make(Int(32), "halide_error_bad_fold",
+                                                {func.name(), storage_dim.var, op->name},
+                                                Call::Extern);
+                        body = Block::make(AssertStmt::make(condition, error), body);
+                    } else {
+                        debug(3) << "Not folding async Func because the footprint doesn't move monotonically\n";
+                        min_monotonic_increasing = max_monotonic_decreasing = false;
+                    }
+                }
+            }
+
             // The min or max has to be monotonic with the loop
             // variable, and should depend on the loop variable.
             if (min_monotonic_increasing || max_monotonic_decreasing) {
@@ -187,46 +229,47 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
 
                     factor = explicit_factor;
                 } else {
-                    // The max of the extent over all values of the loop variable must be a constant
-                    Scope<Interval> scope;
-                    scope.push(op->name, Interval(Variable::make(Int(32), op->name + ".loop_min"),
-                                                  Variable::make(Int(32), op->name + ".loop_max")));
-                    Expr max_extent = find_constant_bound(extent, Direction::Upper, scope);
-                    scope.pop(op->name);
-
-                    const int max_fold = 1024;
-                    const int64_t *const_max_extent = as_const_int(max_extent);
-                    if (const_max_extent && *const_max_extent <= max_fold) {
-                        factor = static_cast<int>(next_power_of_two(*const_max_extent));
-                    } else {
-                        debug(3) << "Not folding because extent not bounded by a constant not greater than " << max_fold << "\n"
-                                 << "extent = " << extent << "\n"
-                                 << "max extent = " << max_extent << "\n";
-                    }
+                    factor = automatic_fold_factor(extent, op->name);
                 }
 
                 if (factor.defined()) {
                     debug(3) << "Proceeding with factor " << factor << "\n";
 
-                    Fold fold = {(int)i - 1, factor};
-                    dims_folded.push_back(fold);
+                    Fold fold = {(int)i - 1, factor, ""};
                     body = FoldStorageOfFunction(func.name(), (int)i - 1, factor).mutate(body);
+                    if (async) {
+                        fold.semaphore = func.name() + ".folding_semaphore";
+                        body = add_back_pressure(body, op, min, max, factor, min_monotonic_increasing,
+                                                 Variable::make(type_of<uint64_t *>(), fold.semaphore));
+                    }
+                    dims_folded.push_back(fold);
 
                     Expr next_var = Variable::make(Int(32), op->name) + 1;
                     Expr next_min = substitute(op->name, next_var, min);
-                    if (can_prove(max < next_min)) {
-                        // There's no overlapping usage between loop
-                        // iterations, so we can continue to search
-                        // for further folding opportinities
-                        // recursively.
-                    } else if (!body.same_as(op->body)) {
-                        stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
-                        return;
-                    } else {
-                        stmt = op;
-                        return;
+                    if (!can_prove(max < next_min)) {
+                        // There's overlapping usage between loop
+                        // iterations. Each folded dimension keeps its
+                        // own window of values live, so we can still
+                        // fold the remaining dimensions over this
+                        // loop, but not over any inner loop.
+                        carried = true;
                     }
                 }
+            } else if (!explicit_only && !async && independent && !is_folded((int)i - 1) &&
+                       (expr_uses_var(min, op->name) || expr_uses_var(max, op->name))) {
+                // The footprint moves with the loop variable, but not
+                // monotonically. As no values outlive an iteration,
+                // any modulus at least as large as the footprint of
+                // one iteration is safe.
+                Expr extent = simplify(max - min + 1);
+                Expr factor = automatic_fold_factor(extent, op->name);
+                if (factor.defined()) {
+                    debug(3) << "Proceeding with factor " << factor << " for non-monotonic footprint\n";
+
+                    Fold fold = {(int)i - 1, factor, ""};
+                    dims_folded.push_back(fold);
+                    body = FoldStorageOfFunction(func.name(), (int)i - 1, factor).mutate(body);
+                }
             } else {
                 debug(3) << "Not folding because loop min or max not monotonic in the loop variable\n"
                          << "min = " << min << "\n"
@@ -234,10 +277,9 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
             }
         }
 
-        // If there's no communication of values from one loop
-        // iteration to the next (which may happen due to sliding),
-        // then we're safe to fold an inner loop.
-        if (box_contains(provided, required)) {
+        // We're safe to fold an inner loop if no values are carried
+        // from one iteration of this one to the next.
+        if (independent && !carried) {
             body = mutate(body);
         }
 
@@ -248,15 +290,90 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
         }
     }
 
+    // The producer of an async Func runs ahead of its consumer, so it
+    // must not overwrite a slot of the folded storage before the
+    // consumer is done with it. The free slots are counted by a
+    // semaphore that starts at the fold factor. Each iteration of the
+    // loop, the producer acquires the slots the footprint grows into,
+    // and the consumer releases the slots it leaves behind, or all of
+    // them on the last iteration, as the loop may run again. Only the
+    // producer task keeps the acquire (see fork_async_producers),
+    // and only the consumer task keeps the release.
+    Stmt add_back_pressure(Stmt body, const For *op, Expr min, Expr max, Expr factor,
+                           bool forward, Expr sema) {
+        Expr loop_var = Variable::make(Int(32), op->name);
+        Expr extent = max - min + 1;
+        Expr acquired, released;
+        if (forward) {
+            Expr prev_max = substitute(op->name, loop_var - 1, max);
+            Expr next_min = substitute(op->name, loop_var + 1, min);
+            acquired = max - Max::make(prev_max, min - 1);
+            released = Min::make(next_min, max + 1) - min;
+        } else {
+            Expr prev_min = substitute(op->name, loop_var - 1, min);
+            Expr next_max = substitute(op->name, loop_var + 1, max);
+            acquired = Min::make(prev_min, max + 1) - min;
+            released = max - Max::make(next_max, min - 1);
+        }
+        acquired = select(loop_var == op->min, extent, acquired);
+        // If an explicit fold factor is too small, never wait for more
+        // slots than there are, so that the assertion after the
+        // acquire can fail instead.
+        acquired = simplify(Min::make(acquired, factor));
+        released = simplify(select(loop_var == op->min + op->extent - 1, extent, released));
+
+        Expr user_context = Variable::make(type_of<void *>(), "__user_context");
+        Stmt acquire = Evaluate::make(Call::make(Int(32), "halide_semaphore_acquire",
+                                                 {user_context, sema, acquired}, Call::Extern));
+        Stmt release = Evaluate::make(Call::make(Int(32), "halide_semaphore_release",
+                                                 {sema, released}, Call::Extern));
+        return Block::make({acquire, body, release});
+    }
+
+    // Find the fold factor for a dimension with the given extent
+    // over the loop, which is the smallest power of two at least as
+    // large as a constant upper bound of the extent.
+    Expr automatic_fold_factor(Expr extent, const string &loop_var) {
+        // The max of the extent over all values of the loop variable must be a constant
+        Scope<Interval> scope;
+        scope.push(loop_var, Interval(Variable::make(Int(32), loop_var + ".loop_min"),
+                                      Variable::make(Int(32), loop_var + ".loop_max")));
+        Expr max_extent = find_constant_bound(extent, Direction::Upper, scope);
+        scope.pop(loop_var);
+
+        const int max_fold = 1024;
+        const int64_t *const_max_extent = as_const_int(max_extent);
+        if (const_max_extent && *const_max_extent <= max_fold) {
+            return static_cast<int>(next_power_of_two(*const_max_extent));
+        } else {
+            debug(3) << "Not folding because extent not bounded by a constant not greater than " << max_fold << "\n"
+                     << "extent = " << extent << "\n"
+                     << "max extent = " << max_extent << "\n";
+            return Expr();
+        }
+    }
+
+    bool is_folded(int dim) const {
+        for (const Fold &f : dims_folded) {
+            if (f.dim == dim) {
+                return true;
+            }
+        }
+        return false;
+    }
+
 public:
     struct Fold {
         int dim;
         Expr factor;
+        // The semaphore that holds back the producer of an async
+        // Func, if any.
+        string semaphore;
     };
     vector<Fold> dims_folded;
 
     AttemptStorageFoldingOfFunction(Function f, bool explicit_only)
-        : func(f), explicit_only(explicit_only) {}
+        : func(f), explicit_only(explicit_only), async(f.schedule().async()) {}
 };
 
 /** Check if a buffer's allocated is referred to directly via an
@@ -347,7 +464,36 @@ class StorageFolding : public IRMutator {
                     bounds[d] = Range(0, f);
                 }
 
+                Expr unfolded_size = 1, folded_size = 1;
+                for (size_t i = 0; i < bounds.size(); i++) {
+                    unfolded_size *= op->bounds[i].extent;
+                    folded_size *= bounds[i].extent;
+                }
+                debug(1) << "Folded storage of " << op->name << " from "
+                         << simplify(unfolded_size) << " to " << simplify(folded_size)
+                         << " elements\n";
+                for (size_t i = 0; i < bounds.size(); i++) {
+                    if (!bounds[i].extent.same_as(op->bounds[i].extent)) {
+                        debug(1) << "  dimension " << i << ": "
+                                 << simplify(op->bounds[i].extent) << " -> " << bounds[i].extent << "\n";
+                    }
+                }
+
                 stmt = Realize::make(op->name, op->types, bounds, op->condition, body);
+
+                // The semaphores that hold back an async producer
+                // live outside the realization, so that the producer
+                // and consumer tasks forked inside it share them.
+                for (const auto &fold : folder.dims_folded) {
+                    if (!fold.semaphore.empty()) {
+                        Expr sema = Variable::make(type_of<uint64_t *>(), fold.semaphore);
+                        Expr init = Call::make(Int(32), "halide_semaphore_init",
+                                               {sema, fold.factor}, Call::Extern);
+                        stmt = Block::make(Evaluate::make(init), stmt);
+                        stmt = Allocate::make(fold.semaphore, UInt(64), MemoryType::Auto,
+                                              {2}, const_true(), stmt);
+                    }
+                }
             }
         }
     }
@@ -23,6 +23,16 @@ namespace Internal {
  *
  * We can store f as a circular buffer of size two, instead of
  * allocating space for all of it.
+ *
+ * Several dimensions may be folded over the same loop, and a
+ * dimension whose footprint moves with a loop without moving
+ * monotonically is folded too, as long as no values are carried from
+ * one iteration of the loop to the next. The size of each folded
+ * allocation is reported at debug level 1.
+ *
+ * A Func scheduled async is folded in at most one dimension, and
+ * only monotonically. A semaphore that counts the free slots makes
+ * its producer wait for the consumer before reusing one.
  */
 Stmt storage_folding(Stmt s, const std::map<std::string, Function> &env);
 
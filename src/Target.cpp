@@ -1,5 +1,6 @@
 #include <iostream>
 #include <string>
+#include <thread>
 
 #include "Target.h"
 #include "Debug.h"
@@ -164,6 +165,69 @@ Target calculate_host_target() {
 #endif
 }
 
+// Return a Target with only the cache sizes and the number of cores
+// of the host set.
+Target calculate_host_caches() {
+    Target t;
+#if defined(__x86_64__) || defined(__i386__) || defined(_MSC_VER)
+    // Walk the deterministic cache parameters. Intel reports them in
+    // leaf 4, and AMD in leaf 0x8000001D, with the same layout.
+    int info[4];
+    cpuid(info, 0, 0);
+    unsigned leaf = 4;
+    if ((unsigned)info[0] < 4) {
+        leaf = 0;
+    }
+    cpuid(info, 0x80000000, 0);
+    bool has_amd_leaf = (unsigned)info[0] >= 0x8000001D;
+
+    int64_t sizes[4] = {0, 0, 0, 0};
+    int last_level = 0;
+    for (int attempt = 0; attempt < 2 && last_level == 0; attempt++) {
+        if (attempt == 1) {
+            if (!has_amd_leaf) break;
+            leaf = 0x8000001D;
+        }
+        if (leaf == 0) continue;
+        for (int i = 0; i < 16; i++) {
+            cpuid(info, leaf, i);
+            int type = info[0] & 0x1f;
+            if (type == 0) {
+                break;
+            }
+            // Skip instruction caches.
+            if (type == 2) {
+                continue;
+            }
+            int level = (info[0] >> 5) & 0x7;
+            int64_t ways = ((info[1] >> 22) & 0x3ff) + 1;
+            int64_t partitions = ((info[1] >> 12) & 0x3ff) + 1;
+            int64_t line_size = (info[1] & 0xfff) + 1;
+            int64_t sets = (int64_t)(unsigned)info[2] + 1;
+            if (level >= 1 && level <= 3) {
+                sizes[level] = ways * partitions * line_size * sets;
+                last_level = std::max(last_level, level);
+            }
+        }
+    }
+    t.l1_cache_size = sizes[1];
+    t.l2_cache_size = sizes[2];
+    t.last_level_cache_size = sizes[last_level];
+#endif
+    t.cores = (int)std::thread::hardware_concurrency();
+    return t;
+}
+
+// Fill in the cache sizes and the number of cores of the host, where
+// the Target does not already specify them.
+void add_host_caches(Target &t) {
+    static Target host = calculate_host_caches();
+    if (t.l1_cache_size == 0) t.l1_cache_size = host.l1_cache_size;
+    if (t.l2_cache_size == 0) t.l2_cache_size = host.l2_cache_size;
+    if (t.last_level_cache_size == 0) t.last_level_cache_size = host.last_level_cache_size;
+    if (t.cores == 0) t.cores = host.cores;
+}
+
 }  // namespace
 
 Target get_host_target() {
@@ -268,6 +332,12 @@ const std::map<std::string, Target::Feature> feature_name_map = {
     {"trace_loads", Target::TraceLoads},
     {"trace_stores", Target::TraceStores},
     {"trace_realizations", Target::TraceRealizations},
+    {"profile_hw_counters", Target::ProfileHWCounters},
+    {"profile_timeline", Target::ProfileTimeline},
+    {"pipeline_instance", Target::PipelineInstance},
+    {"auto_prefetch", Target::AutoPrefetch},
+    {"profile_loops", Target::ProfileLoops},
+    {"partition_for_size", Target::PartitionForSize},
 };
 
 bool lookup_feature(const std::string &tok, Target::Feature &result) {
@@ -295,6 +365,7 @@ Target get_jit_target_from_environment() {
     host.set_feature(Target::JIT);
     string target = Internal::get_env_variable("HL_JIT_TARGET");
     if (target.empty()) {
+        add_host_caches(host);
         return host;
     } else {
         Target t(target);
@@ -303,11 +374,26 @@ Target get_jit_target_from_environment() {
             << "HL_JIT_TARGET must match the host OS, architecture, and bit width.\n"
             << "HL_JIT_TARGET was " << target << ". "
             << "Host is " << host.to_string() << ".\n";
+        add_host_caches(t);
         return t;
     }
 }
 
 namespace {
+// Parse a token of the form prefixN, where N is a positive integer.
+bool parse_size(const std::string &tok, const std::string &prefix, int64_t &result) {
+    if (!Internal::starts_with(tok, prefix)) {
+        return false;
+    }
+    string digits = tok.substr(prefix.size());
+    if (digits.empty() || digits.size() > 15 ||
+        digits.find_first_not_of("0123456789") != string::npos) {
+        return false;
+    }
+    result = std::stoll(digits);
+    return result > 0;
+}
+
 bool merge_string(Target &t, const std::string &target) {
     string rest = target;
     vector<string> tokens;
@@ -320,6 +406,7 @@ bool merge_string(Target &t, const std::string &target) {
     tokens.push_back(rest);
 
     bool os_specified = false, arch_specified = false, bits_specified = false, features_specified = false;
+    int64_t cores = 0;
 
     for (size_t i = 0; i < tokens.size(); i++) {
         const string &tok = tokens[i];
@@ -350,6 +437,13 @@ bool merge_string(Target &t, const std::string &target) {
         } else if (lookup_feature(tok, feature)) {
             t.set_feature(feature);
             features_specified = true;
+        } else if (parse_size(tok, "l1_cache_", t.l1_cache_size) ||
+                   parse_size(tok, "l2_cache_", t.l2_cache_size) ||
+                   parse_size(tok, "llc_", t.last_level_cache_size)) {
+            features_specified = true;
+        } else if (parse_size(tok, "cores_", cores)) {
+            t.cores = (int)cores;
+            features_specified = true;
         } else {
             return false;
         }
@@ -409,6 +503,9 @@ void bad_target_string(const std::string &target) {
                << "\n"
                << "Features are: " << features << ".\n"
                << "\n"
+               << "The cache sizes and the number of cores can be given as "
+               << "l1_cache_N, l2_cache_N, llc_N and cores_N.\n"
+               << "\n"
                << "The target can also begin with \"host\", which sets the "
                << "host's architecture, os, and feature set, with the "
                << "exception of the GPU runtimes, which default to off.\n"
@@ -468,6 +565,18 @@ std::string Target::to_string() const {
             result += "-" + feature_entry.first;
         }
     }
+    if (l1_cache_size) {
+        result += "-l1_cache_" + std::to_string(l1_cache_size);
+    }
+    if (l2_cache_size) {
+        result += "-l2_cache_" + std::to_string(l2_cache_size);
+    }
+    if (last_level_cache_size) {
+        result += "-llc_" + std::to_string(last_level_cache_size);
+    }
+    if (cores) {
+        result += "-cores_" + std::to_string(cores);
+    }
     return result;
 }
 
@@ -32,6 +32,17 @@ struct Target {
     /** The bit-width of the target machine. Must be 0 for unknown, or 32 or 64. */
     int bits;
 
+    /** The sizes in bytes of the L1 data cache and the L2 cache of one
+     * core and of the last level cache, and the number of cores. Zero
+     * for unknown, in which case \ref cache_size and \ref num_cores
+     * return typical values. Specified in target strings as
+     * l1_cache_N, l2_cache_N, llc_N and cores_N, and detected for
+     * the host when jit-compiling. */
+    // @{
+    int64_t l1_cache_size, l2_cache_size, last_level_cache_size;
+    int cores;
+    // @}
+
     /** Optional features a target can have.
      * Corresponds to feature_name_map in Target.cpp.
      * See definitions in HalideRuntime.h for full information.
@@ -89,11 +100,19 @@ struct Target {
         TraceLoads = halide_target_feature_trace_loads,
         TraceStores = halide_target_feature_trace_stores,
         TraceRealizations = halide_target_feature_trace_realizations,
+        ProfileHWCounters = halide_target_feature_profile_hw_counters,
+        ProfileTimeline = halide_target_feature_profile_timeline,
+        PipelineInstance = halide_target_feature_pipeline_instance,
+        AutoPrefetch = halide_target_feature_auto_prefetch,
+        ProfileLoops = halide_target_feature_profile_loops,
+        PartitionForSize = halide_target_feature_partition_for_size,
         FeatureEnd = halide_target_feature_end
     };
-    Target() : os(OSUnknown), arch(ArchUnknown), bits(0) {}
+    Target() : os(OSUnknown), arch(ArchUnknown), bits(0),
+               l1_cache_size(0), l2_cache_size(0), last_level_cache_size(0), cores(0) {}
     Target(OS o, Arch a, int b, std::vector<Feature> initial_features = std::vector<Feature>())
-        : os(o), arch(a), bits(b) {
+        : os(o), arch(a), bits(b),
+          l1_cache_size(0), l2_cache_size(0), last_level_cache_size(0), cores(0) {
         for (size_t i = 0; i < initial_features.size(); i++) {
             set_feature(initial_features[i]);
         }
@@ -207,6 +226,10 @@ struct Target {
       return os == other.os &&
           arch == other.arch &&
           bits == other.bits &&
+          l1_cache_size == other.l1_cache_size &&
+          l2_cache_size == other.l2_cache_size &&
+          last_level_cache_size == other.last_level_cache_size &&
+          cores == other.cores &&
           features == other.features;
     }
 
@@ -286,6 +309,25 @@ struct Target {
         return natural_vector_size(type_of<data_t>());
     }
 
+    /** Return the size in bytes of a level of the cache, or a typical
+     * size for that level if the Target does not specify it. */
+    int64_t cache_size(CacheLevel level) const {
+        switch (level) {
+        case CacheLevel::L1:
+            return l1_cache_size ? l1_cache_size : 32 * 1024;
+        case CacheLevel::L2:
+            return l2_cache_size ? l2_cache_size : 256 * 1024;
+        default:
+            return last_level_cache_size ? last_level_cache_size : 8 * 1024 * 1024;
+        }
+    }
+
+    /** Return the number of cores, or a typical number if the Target
+     * does not specify it. */
+    int num_cores() const {
+        return cores ? cores : 8;
+    }
+
     /** Return the maximum buffer size in bytes supported on this
      * Target. This is 2^31 - 1 except when the LargeBuffers feature
      * is enabled, which expands the maximum to 2^63 - 1. */
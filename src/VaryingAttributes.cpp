@@ -1241,7 +1241,7 @@ public:
             stmt = LetStmt::make("glsl.num_coords_dim0", dont_simplify((int)(coords[0].size())),
                    LetStmt::make("glsl.num_coords_dim1", dont_simplify((int)(coords[1].size())),
                    LetStmt::make("glsl.num_padded_attributes", dont_simplify(num_padded_attributes),
-                   Allocate::make(vs.vertex_buffer_name, Float(32), {vertex_buffer_size}, const_true(),
+                   Allocate::make(vs.vertex_buffer_name, Float(32), MemoryType::Auto, {vertex_buffer_size}, const_true(),
                    Block::make(vertex_setup,
                    Block::make(loop_stmt,
                    Block::make(used_in_codegen(Int(32), "glsl.num_coords_dim0"),
@@ -249,6 +249,18 @@ class PredicateLoadStore : public IRMutator {
                 << "We are inside a hexagon loop, but the target doesn't have hexagon's features\n";
             return true;
         } else if (target.arch == Target::X86) {
+            // AVX-512 has masked loads and stores of 32- and 64-bit
+            // elements, and AVX512BW (Skylake and later) adds 8- and
+            // 16-bit elements. The mask lives in a k-register, so
+            // these are as cheap as unmasked ones.
+            if (target.has_feature(Target::AVX512_Skylake) ||
+                target.has_feature(Target::AVX512_Cannonlake)) {
+                return (bit_size == 8 || bit_size == 16 ||
+                        bit_size == 32 || bit_size == 64) && (lanes >= 4);
+            } else if (target.has_feature(Target::AVX512) ||
+                       target.has_feature(Target::AVX512_KNL)) {
+                return (bit_size == 32 || bit_size == 64) && (lanes >= 4);
+            }
             // Should only attempt to predicate store/load if the lane size is
             // no less than 4
             return (bit_size == 32) && (lanes >= 4);
@@ -853,7 +865,7 @@ class VectorSubs : public IRMutator {
         // The variable itself could still exist inside an inner scalarized block.
         body = substitute(v, Variable::make(Int(32), var), body);
 
-        stmt = Allocate::make(op->name, op->type, new_extents, op->condition, body, new_expr, op->free_function);
+        stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents, op->condition, body, new_expr, op->free_function);
     }
 
     Stmt scalarize(Stmt s) {
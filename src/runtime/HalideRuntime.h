@@ -180,6 +180,35 @@ extern void halide_join_thread(struct halide_thread *);
  */
 extern int halide_set_num_threads(int n);
 
+/** A counting semaphore, used to synchronize the producer and
+ * consumer tasks of an asynchronous Func (see Func::async). The
+ * contents are private to the runtime. Semaphores must be initialized
+ * with halide_semaphore_init before use, and need no destruction.
+ */
+struct halide_semaphore_t {
+    uint64_t _private[2];
+};
+
+/** Functions on semaphores. halide_semaphore_init sets the count to
+ * n. halide_semaphore_release adds n to the count, waking up any
+ * threads blocked acquiring it, and returns the new
+ * count. halide_semaphore_try_acquire subtracts n from the count if
+ * that would not make it negative, and returns whether it did so
+ * without ever blocking. halide_semaphore_acquire blocks until the
+ * count is at least n and then subtracts n from it. It does not run
+ * other tasks while it is blocked, because the producer and consumer
+ * of a Func with folded storage wait on each other; instead the
+ * thread pool makes sure there is a thread that isn't blocked to run
+ * pending tasks. It returns zero on success, or an error code if
+ * the semaphore can never be acquired (e.g. on a thread pool that
+ * runs every task serially). */
+//@{
+extern int halide_semaphore_init(struct halide_semaphore_t *, int n);
+extern int halide_semaphore_release(struct halide_semaphore_t *, int n);
+extern bool halide_semaphore_try_acquire(struct halide_semaphore_t *, int n);
+extern int halide_semaphore_acquire(void *user_context, struct halide_semaphore_t *, int n);
+//@}
+
 /** Halide calls these functions to allocate and free memory. To
  * replace in AOT code, use the halide_set_custom_malloc and
  * halide_set_custom_free, or (on platforms that support weak
@@ -208,6 +237,86 @@ extern halide_malloc_t halide_set_custom_malloc(halide_malloc_t user_malloc);
 extern halide_free_t halide_set_custom_free(halide_free_t user_free);
 //@}
 
+/** Halide calls these functions to allocate and free the storage of
+ * Funcs scheduled with store_in(MemoryType::LockedCache). They are
+ * intended for fast scratch memory, such as a locked region of cache
+ * or the local memory of an accelerator. By default they call
+ * halide_malloc and halide_free. Install replacements with the
+ * set_custom functions, which return the previously installed
+ * functions. Memory returned must satisfy the same alignment and
+ * padding requirements as halide_malloc. The free function must
+ * accept pointers returned by the malloc function installed at the
+ * time of the allocation, so install both together, before running
+ * any pipeline. */
+//@{
+extern void *halide_locked_cache_malloc(void *user_context, size_t x);
+extern void halide_locked_cache_free(void *user_context, void *ptr);
+extern halide_malloc_t halide_set_custom_locked_cache_malloc(halide_malloc_t user_malloc);
+extern halide_free_t halide_set_custom_locked_cache_free(halide_free_t user_free);
+//@}
+
+/** Functions that manage the arenas the heap allocations inside
+ * parallel tasks are carved out of. Generated code creates one pool
+ * of arenas per pipeline invocation. Each task acquires an arena
+ * from the pool, with room for at least size_hint bytes, and
+ * releases it back when done. The memory for the pool and its
+ * arenas comes from halide_malloc. Not intended to be called
+ * directly. */
+//@{
+extern void *halide_arena_pool_create(void *user_context);
+extern void halide_arena_pool_destroy(void *user_context, void *pool);
+extern void *halide_arena_acquire(void *user_context, void *pool, uint64_t size_hint);
+extern void halide_arena_release(void *user_context, void *arena);
+extern void *halide_arena_malloc(void *user_context, void *arena, uint64_t size);
+extern void halide_arena_free(void *user_context, void *ptr);
+//@}
+
+/** The state a pipeline compiled with the pipeline_instance target
+ * feature keeps from one call to the next. Such a pipeline takes a
+ * pointer to one of these as an extra argument, after the user
+ * context if there is one. The intermediate buffers the pipeline
+ * computes outside of any loop are allocated in the instance on the
+ * first call, and reused by later calls, which reallocate them only
+ * if they need to grow. Zero-initialize an instance before its first
+ * use, and free the memory it holds with
+ * halide_pipeline_instance_release. An instance may only be used by
+ * one call at a time. */
+struct halide_pipeline_instance_t {
+    /** If nonzero, calls to the pipeline compute
+     * required_scratch_size for the given arguments, and do no other
+     * work. */
+    int query;
+
+    /** The number of bytes of scratch memory the intermediate
+     * buffers need. Set by query calls. */
+    uint64_t required_scratch_size;
+
+    /** Optional memory owned by the caller, that the intermediate
+     * buffers are placed in before falling back to halide_malloc.
+     * Must be aligned as halide_malloc aligns its allocations, and
+     * remain valid until the instance is released. */
+    void *scratch;
+    uint64_t scratch_size;
+
+    /** Private to the runtime. */
+    void *_private;
+};
+
+/** Free the memory held by a halide_pipeline_instance_t, other than
+ * its scratch memory. The instance may be used again afterwards. */
+extern void halide_pipeline_instance_release(void *user_context, struct halide_pipeline_instance_t *instance);
+
+/** Functions called by pipelines compiled with the pipeline_instance
+ * target feature to start a call, and to get the memory for the
+ * intermediate buffer with the given index. Not intended to be
+ * called directly. */
+//@{
+extern int halide_pipeline_instance_begin(void *user_context, struct halide_pipeline_instance_t *instance);
+extern void *halide_pipeline_instance_malloc(void *user_context, struct halide_pipeline_instance_t *instance,
+                                             int index, uint64_t size);
+extern void halide_pipeline_instance_free(void *user_context, void *ptr);
+//@}
+
 /** Halide calls these functions to interact with the underlying
  * system runtime functions. To replace in AOT code on platforms that
  * support weak linking, define these functions yourself, or use
@@ -382,6 +491,14 @@ struct halide_trace_event_t {
  * below. If the trace is going to be large, you may want to make the
  * file a named pipe, and then read from that pipe into gzip.
  *
+ * Packets are collected in a 1MB buffer and written out when it
+ * fills, when a pipeline ends, and in halide_shutdown_trace. The
+ * default implementation also drops events according to the
+ * environment variables HL_TRACE_EVENTS (a comma-separated list of
+ * load, store, realization, produce, consume and pipeline),
+ * HL_TRACE_FUNCS (a comma-separated list of Func names) and
+ * HL_TRACE_SAMPLE (keep only one in every N loads and stores).
+ *
  * halide_trace returns a unique ID which will be passed to future
  * events that "belong" to the earlier event as the parent id. The
  * ownership hierarchy looks like:
@@ -946,8 +1063,14 @@ typedef enum halide_target_feature_t {
     //----- HLS Modification Begins -----//
     halide_target_feature_vivado_hls = 49,  ///< Enable Vivado HLS code generation.
     halide_target_feature_zynq = 50, ///< Enable Xilinx Zynq runtime.
-    halide_target_feature_end = 51 ///< A sentinel. Every target is considered to have this feature, and setting this feature does nothing.
     //----- HLS Modification Ends -------//
+    halide_target_feature_profile_hw_counters = 51, ///< In addition to the sampling profiler, read per-thread hardware performance counters (cycles, instructions, cache and branch misses) and attribute them to each Func. Implies profile. Currently only supported on x86 Linux.
+    halide_target_feature_profile_timeline = 52, ///< In addition to the sampling profiler, record when each Func, parallel task and device launch ran on which thread, and write the result as a Chrome trace (see halide_profiler_timeline_dump). Implies profile.
+    halide_target_feature_pipeline_instance = 53, ///< Generate pipelines that take a halide_pipeline_instance_t argument, which keeps the intermediate buffers computed outside of any loop from one call to the next.
+    halide_target_feature_auto_prefetch = 54, ///< Prefetch the loads in innermost loops that touch a new cache line on every iteration.
+    halide_target_feature_profile_loops = 55, ///< Count how many times each loop and each specialization of each Func runs, and how many iterations the loops take, and write the counts to a loop profile (see halide_loop_profile_dump) that can guide a later compile.
+    halide_target_feature_partition_for_size = 56, ///< Partition loops for small code: share one boundary body between the prologue and epilogue of each partitioned loop, and stop partitioning the loops of a Func once they have added HL_PARTITION_BUDGET IR nodes (default 4096).
+    halide_target_feature_end = 57 ///< A sentinel. Every target is considered to have this feature, and setting this feature does nothing.
 } halide_target_feature_t;
 
 /** This function is called internally by Halide in some situations to determine
@@ -1270,6 +1393,21 @@ struct halide_filter_metadata_t {
  * the -profile target flag, which runs a sampling profiler thread
  * alongside the pipeline. */
 
+/** Hardware performance counters tracked by the profiler for
+ * pipelines compiled with the -profile_hw_counters target flag. */
+enum {
+    /// CPU cycles
+    halide_profiler_hw_cycles = 0,
+    /// Retired instructions
+    halide_profiler_hw_instructions = 1,
+    /// Last-level cache misses
+    halide_profiler_hw_cache_misses = 2,
+    /// Mispredicted branches
+    halide_profiler_hw_branch_misses = 3,
+    /// The number of counters above
+    halide_profiler_hw_num_counters = 4
+};
+
 /** Per-Func state tracked by the sampling profiler. */
 struct halide_profiler_func_stats {
     /** Total time taken evaluating this Func (in nanoseconds). */
@@ -1290,6 +1428,12 @@ struct halide_profiler_func_stats {
     /** The average number of thread pool worker threads active while computing this Func. */
     uint64_t active_threads_numerator, active_threads_denominator;
 
+    /** Hardware performance counter totals accumulated by all
+     * threads while computing this Func, indexed by the
+     * halide_profiler_hw_* enum. Zero unless the pipeline was
+     * compiled with -profile_hw_counters. */
+    uint64_t hw_counters[halide_profiler_hw_num_counters];
+
     /** The name of this Func. A global constant string. */
     const char *name;
 
@@ -1316,6 +1460,14 @@ struct halide_profiler_pipeline_stats {
      * work while computing this pipeline. */
     uint64_t active_threads_numerator, active_threads_denominator;
 
+    /** Hardware performance counter totals for all Funcs in this
+     * pipeline, indexed by the halide_profiler_hw_* enum. */
+    uint64_t hw_counters[halide_profiler_hw_num_counters];
+
+    /** The total number of output pixels produced over all runs of
+     * this pipeline. Only tracked with -profile_hw_counters. */
+    uint64_t pixels;
+
     /** The name of this pipeline. A global constant string. */
     const char *name;
 
@@ -1385,6 +1537,20 @@ enum {
     halide_profiler_please_stop = -2
 };
 
+/** The kinds of events recorded for pipelines compiled with the
+ * -profile_timeline target flag. Each begin event is matched by the
+ * corresponding end event on the same thread. */
+enum halide_profiler_timeline_event_code_t {
+    halide_profiler_timeline_begin_pipeline = 0,
+    halide_profiler_timeline_end_pipeline = 1,
+    halide_profiler_timeline_begin_produce = 2,
+    halide_profiler_timeline_end_produce = 3,
+    halide_profiler_timeline_begin_task = 4,
+    halide_profiler_timeline_end_task = 5,
+    halide_profiler_timeline_begin_device = 6,
+    halide_profiler_timeline_end_device = 7
+};
+
 /** Get a pointer to the global profiler state for programmatic
  * inspection. Lock it before using to pause the profiler. */
 extern struct halide_profiler_state *halide_profiler_get_state();
@@ -1401,9 +1567,34 @@ extern struct halide_profiler_pipeline_stats *halide_profiler_get_pipeline_state
 extern void halide_profiler_reset();
 
 /** Print out timing statistics for everything run since the last
- * reset. Also happens at process exit. */
+ * reset. Also happens at process exit. If the environment variable
+ * HL_TIMELINE_FILE is set, also writes the timeline recorded by
+ * pipelines compiled with -profile_timeline to that file. */
 extern void halide_profiler_report(void *user_context);
 
+/** Write the events recorded by pipelines compiled with
+ * -profile_timeline to the named file in the Chrome Trace Event JSON
+ * format, which can be opened with chrome://tracing or the Perfetto
+ * UI. Each thread keeps the most recent HL_TIMELINE_EVENTS events
+ * (default 65536) in a ring buffer. Returns zero on success. */
+extern int halide_profiler_timeline_dump(void *user_context, const char *filename);
+
+/** Write the counts recorded by pipelines compiled with the
+ * -profile_loops target flag since the last reset to the named file,
+ * one "pipeline name entries iterations" line for each loop and each
+ * specialization. If filename is NULL, uses the file named by the
+ * environment variable HL_LOOP_PROFILE_FILE, or
+ * halide_loop_profile.txt. Also happens at process exit. Give the file
+ * to a later compile of the same pipelines (the -p flag of a
+ * Generator, or the environment variable HL_USE_LOOP_PROFILE) to guide
+ * it. Returns zero on success. */
+extern int halide_loop_profile_dump(void *user_context, const char *filename);
+
+/** Forget the counts recorded by pipelines compiled with
+ * -profile_loops. Do NOT call this while any such pipeline is
+ * running. */
+extern void halide_loop_profile_reset();
+
 /// \name "Float16" functions
 /// These functions operate of bits (``uint16_t``) representing a half
 /// precision floating point number (IEEE-754 2008 binary16).
@@ -0,0 +1,194 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+#include "scoped_mutex_lock.h"
+
+// Arenas for the heap allocations made inside parallel tasks. Each
+// pipeline invocation owns a pool of arenas. A task takes an arena
+// from the pool when it starts, carves its allocations out of it with
+// a bump pointer, and returns it to the pool when it finishes, so
+// that only the first few tasks of an invocation ever call
+// halide_malloc. The pool is freed at the end of the invocation,
+// which keeps every block of memory tied to the allocator that was
+// installed when it was made.
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// Blocks in an arena are aligned as strictly as halide_malloc
+// aligns its allocations. Each block is preceded by a header of
+// this size. Lowering assumes this layout when it computes the size
+// hint for an arena, so the two must change together.
+const uint64_t arena_alignment = 128;
+
+struct arena_pool;
+
+struct arena {
+    arena_pool *pool;
+    arena *next;
+    char *base;
+    uint64_t capacity;
+    // The offset of the first free byte.
+    uint64_t top;
+    // The number of live blocks in the arena.
+    int live;
+    // The bytes requested by the live blocks, including the ones
+    // that did not fit, and the peak of that over the task. A
+    // returned arena is grown to the peak so that the next task does
+    // not overflow it.
+    uint64_t used;
+    uint64_t demand;
+};
+
+struct arena_pool {
+    halide_mutex mutex;
+    arena *free_arenas;
+};
+
+struct arena_block_header {
+    arena *owner;
+    uint64_t start;
+    uint64_t size;
+    // True if the block did not fit in its arena, and was allocated
+    // with halide_malloc instead.
+    bool direct;
+};
+
+WEAK uint64_t arena_round_up(uint64_t x) {
+    return (x + arena_alignment - 1) & ~(arena_alignment - 1);
+}
+
+WEAK arena *arena_create(void *user_context, arena_pool *pool, uint64_t capacity) {
+    capacity = arena_round_up(capacity);
+    // The extra block at the end lets vector code read past the end
+    // of the last allocation.
+    uint64_t header = arena_round_up(sizeof(arena));
+    arena *a = (arena *)halide_malloc(user_context, header + capacity + arena_alignment);
+    if (a == NULL) {
+        return NULL;
+    }
+    a->pool = pool;
+    a->next = NULL;
+    a->base = (char *)a + header;
+    a->capacity = capacity;
+    a->top = 0;
+    a->live = 0;
+    a->used = 0;
+    a->demand = 0;
+    return a;
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK void *halide_arena_pool_create(void *user_context) {
+    arena_pool *pool = (arena_pool *)halide_malloc(user_context, sizeof(arena_pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    memset(&pool->mutex, 0, sizeof(halide_mutex));
+    pool->free_arenas = NULL;
+    return pool;
+}
+
+WEAK void halide_arena_pool_destroy(void *user_context, void *p) {
+    arena_pool *pool = (arena_pool *)p;
+    arena *a = pool->free_arenas;
+    while (a) {
+        arena *next = a->next;
+        halide_free(user_context, a);
+        a = next;
+    }
+    halide_mutex_destroy(&pool->mutex);
+    halide_free(user_context, pool);
+}
+
+WEAK void *halide_arena_acquire(void *user_context, void *p, uint64_t size_hint) {
+    arena_pool *pool = (arena_pool *)p;
+    arena *a = NULL;
+    {
+        ScopedMutexLock lock(&pool->mutex);
+        a = pool->free_arenas;
+        if (a) {
+            pool->free_arenas = a->next;
+        }
+    }
+    if (a && a->capacity < size_hint) {
+        halide_free(user_context, a);
+        a = NULL;
+    }
+    if (a == NULL) {
+        a = arena_create(user_context, pool, size_hint);
+    }
+    return a;
+}
+
+WEAK void halide_arena_release(void *user_context, void *p) {
+    arena *a = (arena *)p;
+    arena_pool *pool = a->pool;
+    if (a->demand > a->capacity) {
+        uint64_t demand = a->demand;
+        halide_free(user_context, a);
+        a = arena_create(user_context, pool, demand);
+        if (a == NULL) {
+            return;
+        }
+    }
+    a->top = 0;
+    a->live = 0;
+    a->used = 0;
+    a->demand = 0;
+    ScopedMutexLock lock(&pool->mutex);
+    a->next = pool->free_arenas;
+    pool->free_arenas = a;
+}
+
+WEAK void *halide_arena_malloc(void *user_context, void *p, uint64_t size) {
+    arena *a = (arena *)p;
+    uint64_t bytes = arena_alignment + arena_round_up(size);
+    a->used += bytes;
+    if (a->used > a->demand) {
+        a->demand = a->used;
+    }
+
+    arena_block_header *header;
+    if (a->top + bytes <= a->capacity) {
+        header = (arena_block_header *)(a->base + a->top);
+        header->start = a->top;
+        header->direct = false;
+        a->top += bytes;
+        a->live++;
+    } else {
+        header = (arena_block_header *)halide_malloc(user_context, bytes + arena_alignment);
+        if (header == NULL) {
+            a->used -= bytes;
+            return NULL;
+        }
+        header->start = 0;
+        header->direct = true;
+    }
+    header->owner = a;
+    header->size = bytes;
+    return (char *)header + arena_alignment;
+}
+
+WEAK void halide_arena_free(void *user_context, void *ptr) {
+    arena_block_header *header = (arena_block_header *)((char *)ptr - arena_alignment);
+    arena *a = header->owner;
+    a->used -= header->size;
+    if (header->direct) {
+        halide_free(user_context, header);
+        return;
+    }
+    // Blocks are usually freed in the reverse order they were
+    // allocated, so popping the top block is enough to reuse the
+    // memory of each loop iteration. Out of order frees are
+    // reclaimed once the arena is empty.
+    a->live--;
+    if (a->live == 0) {
+        a->top = 0;
+    } else if (header->start + header->size == a->top) {
+        a->top = header->start;
+    }
+}
+
+}
@@ -0,0 +1,16 @@
+#include "HalideRuntime.h"
+
+// Hardware performance counters are not available on this
+// platform. The profiler reports time and memory only.
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+WEAK int halide_perf_counters_thread_slot(void *user_context) {
+    return -1;
+}
+
+WEAK int halide_perf_counters_read(int slot, uint64_t *values) {
+    return -1;
+}
+
+}}} // namespace Halide::Runtime::Internal
@@ -1,4 +1,5 @@
 #include "HalideRuntime.h"
+#include "semaphore_common.h"
 
 extern "C" {
 
@@ -24,6 +25,9 @@ extern long dispatch_semaphore_wait(dispatch_semaphore_t dsema, dispatch_time_t
 extern long dispatch_semaphore_signal(dispatch_semaphore_t dsema);
 extern void dispatch_release(void *object);
 
+// GCD worker threads are still pthreads.
+extern void *pthread_self();
+
 }
 
 namespace Halide { namespace Runtime { namespace Internal {
@@ -37,6 +41,10 @@ WEAK void spawn_thread_helper(void *arg) {
     t->f(t->closure);
     dispatch_semaphore_signal(t->join_semaphore);
 }
+
+WEAK uint64_t halide_current_thread_id() {
+    return (uint64_t)pthread_self();
+}
 }}} // namespace Halide::Runtime::Internal
 
 
@@ -156,6 +164,27 @@ WEAK void halide_mutex_unlock(halide_mutex *mutex_arg) {
 WEAK void halide_shutdown_thread_pool() {
 }
 
+WEAK int halide_semaphore_init(halide_semaphore_t *s, int n) {
+    semaphore_init(s, n);
+    return n;
+}
+
+WEAK int halide_semaphore_release(halide_semaphore_t *s, int n) {
+    return semaphore_release(s, n);
+}
+
+WEAK bool halide_semaphore_try_acquire(halide_semaphore_t *s, int n) {
+    return semaphore_try_acquire(s, n);
+}
+
+WEAK int halide_semaphore_acquire(void *user_context, halide_semaphore_t *s, int n) {
+    // GCD owns the threads, so we can't hand this one other tasks to
+    // do while it waits. Spin until the other task catches up.
+    while (!semaphore_try_acquire(s, n)) {
+    }
+    return 0;
+}
+
 WEAK int halide_set_num_threads(int n) {
     if (n < 0) {
         halide_error(NULL, "halide_set_num_threads: must be >= 0.");
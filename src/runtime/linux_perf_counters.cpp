@@ -0,0 +1,145 @@
+#include "HalideRuntime.h"
+
+// Per-thread hardware performance counters for the profiler, read
+// via the Linux perf_event interface. Each thread that asks for a
+// slot opens one counter group (cycles, instructions, cache misses,
+// branch misses) that counts only that thread, so a single read()
+// returns all four values.
+
+// The syscall numbers vary across platforms. As in linux_clock.cpp,
+// we only know about x86 here.
+#ifndef SYS_PERF_EVENT_OPEN
+
+#ifdef BITS_64
+#define SYS_PERF_EVENT_OPEN 298
+#define SYS_GETTID 186
+#endif
+
+#ifdef BITS_32
+#define SYS_PERF_EVENT_OPEN 336
+#define SYS_GETTID 224
+#endif
+
+#endif
+
+extern "C" {
+
+extern int syscall(int num, ...);
+extern ssize_t read(int fd, void *buf, size_t bytes);
+
+}
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// The first version of struct perf_event_attr from
+// linux/perf_event.h. The kernel accepts any older version of the
+// struct as long as the size field says which one it is.
+struct perf_event_attr {
+    uint32_t type;
+    uint32_t size;
+    uint64_t config;
+    uint64_t sample_period;
+    uint64_t sample_type;
+    uint64_t read_format;
+    uint64_t flags;
+    uint32_t wakeup_events;
+    uint32_t bp_type;
+    uint64_t config1;
+};
+
+#define PERF_TYPE_HARDWARE 0
+#define PERF_COUNT_HW_CPU_CYCLES 0
+#define PERF_COUNT_HW_INSTRUCTIONS 1
+#define PERF_COUNT_HW_CACHE_MISSES 3
+#define PERF_COUNT_HW_BRANCH_MISSES 5
+#define PERF_FORMAT_GROUP 8
+// Bits in perf_event_attr::flags
+#define PERF_ATTR_FLAG_EXCLUDE_KERNEL (1 << 5)
+#define PERF_ATTR_FLAG_EXCLUDE_HV (1 << 6)
+
+// In the order of the halide_profiler_hw_* enum.
+WEAK uint64_t perf_counter_configs[halide_profiler_hw_num_counters] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+struct perf_counters_thread {
+    // Zero if the slot is free.
+    int tid;
+    // The group leader's file descriptor, or -1 if opening the
+    // counters failed.
+    int fd;
+};
+
+WEAK perf_counters_thread perf_counters_threads[HALIDE_PERF_COUNTERS_MAX_THREADS];
+WEAK bool perf_counters_warned = false;
+
+WEAK int open_perf_counter_group(void *user_context) {
+    int leader = -1;
+    for (int i = 0; i < halide_profiler_hw_num_counters; i++) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = perf_counter_configs[i];
+        attr.read_format = PERF_FORMAT_GROUP;
+        // Don't require a permissive perf_event_paranoid setting.
+        attr.flags = PERF_ATTR_FLAG_EXCLUDE_KERNEL | PERF_ATTR_FLAG_EXCLUDE_HV;
+        // pid = 0, cpu = -1 counts the calling thread on any cpu.
+        int fd = syscall(SYS_PERF_EVENT_OPEN, &attr, 0, -1, leader, 0);
+        if (fd < 0) {
+            if (!perf_counters_warned) {
+                perf_counters_warned = true;
+                halide_print(user_context, "Warning: Could not open hardware performance counters. "
+                             "Check /proc/sys/kernel/perf_event_paranoid. "
+                             "Profiling will continue without them.\n");
+            }
+            if (leader >= 0) {
+                // Closing the leader also tears down the group's
+                // members in the kernel.
+                close(leader);
+            }
+            return -1;
+        }
+        if (leader < 0) {
+            leader = fd;
+        }
+    }
+    return leader;
+}
+
+WEAK int halide_perf_counters_thread_slot(void *user_context) {
+    int tid = syscall(SYS_GETTID);
+    for (int i = 0; i < HALIDE_PERF_COUNTERS_MAX_THREADS; i++) {
+        perf_counters_thread *t = perf_counters_threads + i;
+        if (t->tid == tid) {
+            return t->fd < 0 ? -1 : i;
+        }
+        if (t->tid == 0 && __sync_bool_compare_and_swap(&t->tid, 0, tid)) {
+            // This slot is now ours. Only this thread will ever read
+            // its fd, so it's safe to fill it in without a lock.
+            t->fd = open_perf_counter_group(user_context);
+            return t->fd < 0 ? -1 : i;
+        }
+    }
+    // More threads than slots. Don't count this one.
+    return -1;
+}
+
+WEAK int halide_perf_counters_read(int slot, uint64_t *values) {
+    // With PERF_FORMAT_GROUP the leader returns the number of
+    // counters followed by each counter's value.
+    uint64_t buf[halide_profiler_hw_num_counters + 1];
+    ssize_t bytes = read(perf_counters_threads[slot].fd, buf, sizeof(buf));
+    if (bytes != (ssize_t)sizeof(buf) || buf[0] != halide_profiler_hw_num_counters) {
+        return -1;
+    }
+    for (int i = 0; i < halide_profiler_hw_num_counters; i++) {
+        values[i] = buf[i + 1];
+    }
+    return 0;
+}
+
+}}} // namespace Halide::Runtime::Internal
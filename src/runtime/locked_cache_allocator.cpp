@@ -0,0 +1,41 @@
+#include "HalideRuntime.h"
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// Null until an allocator for fast scratch memory is installed, in
+// which case allocations fall back to halide_malloc and halide_free.
+WEAK halide_malloc_t custom_locked_cache_malloc = NULL;
+WEAK halide_free_t custom_locked_cache_free = NULL;
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK halide_malloc_t halide_set_custom_locked_cache_malloc(halide_malloc_t user_malloc) {
+    halide_malloc_t result = custom_locked_cache_malloc;
+    custom_locked_cache_malloc = user_malloc;
+    return result;
+}
+
+WEAK halide_free_t halide_set_custom_locked_cache_free(halide_free_t user_free) {
+    halide_free_t result = custom_locked_cache_free;
+    custom_locked_cache_free = user_free;
+    return result;
+}
+
+WEAK void *halide_locked_cache_malloc(void *user_context, size_t x) {
+    if (custom_locked_cache_malloc) {
+        return custom_locked_cache_malloc(user_context, x);
+    }
+    return halide_malloc(user_context, x);
+}
+
+WEAK void halide_locked_cache_free(void *user_context, void *ptr) {
+    if (custom_locked_cache_free) {
+        custom_locked_cache_free(user_context, ptr);
+    } else {
+        halide_free(user_context, ptr);
+    }
+}
+
+}
@@ -0,0 +1,177 @@
+#include "HalideRuntime.h"
+#include "printer.h"
+#include "scoped_mutex_lock.h"
+
+// The counts recorded by pipelines compiled with -profile_loops. Each
+// pipeline gets an array of (entries, iterations) pairs, one for each
+// loop and specialization it counts, which generated code updates
+// with atomic adds.
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+struct loop_profile_pipeline {
+    const char *name;
+    int num_counters;
+    // Copies of the names, so that the counts can still be written
+    // after a jitted pipeline has been freed.
+    char **counter_names;
+    uint64_t *counts;
+    loop_profile_pipeline *next;
+};
+
+WEAK loop_profile_pipeline *loop_profile_pipelines = NULL;
+WEAK halide_mutex loop_profile_lock = {{0}};
+
+WEAK char *copy_string(const char *s) {
+    size_t len = strlen(s) + 1;
+    char *result = (char *)malloc(len);
+    if (result) {
+        memcpy(result, s, len);
+    }
+    return result;
+}
+
+WEAK void free_loop_profile_pipeline(loop_profile_pipeline *p) {
+    if (p->counter_names) {
+        for (int i = 0; i < p->num_counters; i++) {
+            free(p->counter_names[i]);
+        }
+    }
+    free(p->counter_names);
+    free(p->counts);
+    free((void *)p->name);
+    free(p);
+}
+
+// Does a pipeline's profile have the given counters? A pipeline may
+// be compiled again with a different schedule under the same name,
+// and then the counter ids mean different loops.
+WEAK bool same_counters(const loop_profile_pipeline *p, int num_counters,
+                        const uint64_t *counter_names) {
+    if (p->num_counters != num_counters) {
+        return false;
+    }
+    for (int i = 0; i < num_counters; i++) {
+        if (strcmp(p->counter_names[i], (const char *)(counter_names[i])) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}}}  // namespace Halide::Runtime::Internal
+
+using namespace Halide::Runtime::Internal;
+
+extern "C" {
+
+WEAK void *halide_loop_profile_pipeline_start(void *user_context,
+                                              const char *pipeline_name,
+                                              int num_counters,
+                                              const uint64_t *counter_names) {
+    ScopedMutexLock lock(&loop_profile_lock);
+
+    for (loop_profile_pipeline *p = loop_profile_pipelines; p; p = p->next) {
+        if (strcmp(p->name, pipeline_name) == 0 &&
+            same_counters(p, num_counters, counter_names)) {
+            return p->counts;
+        }
+    }
+
+    loop_profile_pipeline *p = (loop_profile_pipeline *)malloc(sizeof(loop_profile_pipeline));
+    if (!p) {
+        error(user_context) << "Out of memory allocating the loop profile of " << pipeline_name << "\n";
+        return NULL;
+    }
+    p->num_counters = num_counters;
+    p->name = copy_string(pipeline_name);
+    p->counter_names = (char **)malloc(num_counters * sizeof(char *));
+    p->counts = (uint64_t *)malloc(2 * num_counters * sizeof(uint64_t));
+    p->next = NULL;
+    if (p->counter_names) {
+        memset(p->counter_names, 0, num_counters * sizeof(char *));
+    }
+    bool ok = p->name && p->counter_names && p->counts;
+    for (int i = 0; ok && i < num_counters; i++) {
+        p->counter_names[i] = copy_string((const char *)(counter_names[i]));
+        ok = p->counter_names[i] != NULL;
+    }
+    if (!ok) {
+        error(user_context) << "Out of memory allocating the loop profile of " << pipeline_name << "\n";
+        free_loop_profile_pipeline(p);
+        return NULL;
+    }
+    memset(p->counts, 0, 2 * num_counters * sizeof(uint64_t));
+
+    p->next = loop_profile_pipelines;
+    loop_profile_pipelines = p;
+    return p->counts;
+}
+
+WEAK int halide_loop_profile_record(void *counters, int id, int iterations) {
+    // If the pipeline couldn't allocate its counters, it still runs,
+    // but nothing is recorded.
+    if (counters) {
+        uint64_t *c = (uint64_t *)counters + 2 * id;
+        __sync_fetch_and_add(c, (uint64_t)1);
+        if (iterations > 0) {
+            __sync_fetch_and_add(c + 1, (uint64_t)iterations);
+        }
+    }
+    return 0;
+}
+
+WEAK int halide_loop_profile_dump(void *user_context, const char *filename) {
+    if (!filename) {
+        filename = getenv("HL_LOOP_PROFILE_FILE");
+    }
+    if (!filename) {
+        filename = "halide_loop_profile.txt";
+    }
+
+    ScopedMutexLock lock(&loop_profile_lock);
+
+    void *f = fopen(filename, "w");
+    if (!f) {
+        error(user_context) << "Could not open loop profile file " << filename << "\n";
+        return -1;
+    }
+
+    char line_buf[1024];
+    Printer<StringStreamPrinter, sizeof(line_buf)> sstr(user_context, line_buf);
+
+    const char *header = "# pipeline name entries iterations\n";
+    fwrite(header, 1, strlen(header), f);
+    for (loop_profile_pipeline *p = loop_profile_pipelines; p; p = p->next) {
+        for (int i = 0; i < p->num_counters; i++) {
+            sstr.clear();
+            sstr << p->name << " " << p->counter_names[i] << " "
+                 << p->counts[2 * i] << " " << p->counts[2 * i + 1] << "\n";
+            fwrite(sstr.str(), 1, sstr.size(), f);
+        }
+    }
+    return fclose(f);
+}
+
+WEAK void halide_loop_profile_reset() {
+    // WARNING: Do not call this method while any pipeline compiled
+    // with -profile_loops is running. The counters it is updating are
+    // freed.
+    ScopedMutexLock lock(&loop_profile_lock);
+    while (loop_profile_pipelines) {
+        loop_profile_pipeline *p = loop_profile_pipelines;
+        loop_profile_pipelines = p->next;
+        free_loop_profile_pipeline(p);
+    }
+}
+
+namespace {
+__attribute__((destructor))
+WEAK void halide_loop_profile_shutdown() {
+    if (loop_profile_pipelines) {
+        halide_loop_profile_dump(NULL, NULL);
+    }
+}
+}
+
+}  // extern "C"
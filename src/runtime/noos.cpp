@@ -1,6 +1,7 @@
 #include "runtime_internal.h"
 
 #include "HalideRuntime.h"
+#include "semaphore_common.h"
 
 namespace Halide { namespace Runtime { namespace Internal {
 
@@ -84,6 +85,30 @@ WEAK halide_get_library_symbol_t halide_set_custom_get_library_symbol(halide_get
     return result;
 }
 
+WEAK int halide_semaphore_init(halide_semaphore_t *s, int n) {
+    semaphore_init(s, n);
+    return n;
+}
+
+WEAK int halide_semaphore_release(halide_semaphore_t *s, int n) {
+    return semaphore_release(s, n);
+}
+
+WEAK bool halide_semaphore_try_acquire(halide_semaphore_t *s, int n) {
+    return semaphore_try_acquire(s, n);
+}
+
+WEAK int halide_semaphore_acquire(void *user_context, halide_semaphore_t *s, int n) {
+    // Every task runs to completion on the calling thread, so if the
+    // count is too low now, nothing will ever raise it.
+    if (!semaphore_try_acquire(s, n)) {
+        halide_error(user_context, "halide_semaphore_acquire would block forever, "
+                     "as this thread pool runs tasks serially.\n");
+        return halide_error_code_generic_error;
+    }
+    return 0;
+}
+
 WEAK int halide_do_task(void *user_context, halide_task_t f, int idx,
                         uint8_t *closure) {
     return (*custom_do_task)(user_context, f, idx, closure);
@@ -0,0 +1,148 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+// Storage for the intermediate buffers of a pipeline compiled with the
+// pipeline_instance target feature. Each intermediate buffer that is
+// allocated outside of any loop is given an index at compile time,
+// and keeps the block of memory at that index in the instance from
+// one call to the next. A block is only reallocated when a call needs
+// more memory than it holds.
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// Blocks are aligned as strictly as halide_malloc aligns its
+// allocations, and padded by one more block so that vector code may
+// read past the end of them. Query calls report sizes that include
+// this padding.
+const uint64_t pipeline_instance_alignment = 128;
+
+struct pipeline_instance_block {
+    void *ptr;
+    uint64_t size;
+    // True if the block was allocated with halide_malloc, rather than
+    // carved out of the scratch memory of the caller.
+    bool owned;
+};
+
+struct pipeline_instance_state {
+    pipeline_instance_block *blocks;
+    int num_blocks;
+    // The number of bytes of scratch memory used so far. Blocks carved
+    // out of scratch memory are never returned to it.
+    uint64_t scratch_used;
+};
+
+WEAK uint64_t pipeline_instance_block_size(uint64_t size) {
+    return ((size + pipeline_instance_alignment - 1) & ~(pipeline_instance_alignment - 1)) +
+        pipeline_instance_alignment;
+}
+
+WEAK pipeline_instance_state *pipeline_instance_get_state(void *user_context,
+                                                          halide_pipeline_instance_t *instance,
+                                                          int index) {
+    pipeline_instance_state *state = (pipeline_instance_state *)instance->_private;
+    if (state == NULL) {
+        state = (pipeline_instance_state *)halide_malloc(user_context, sizeof(pipeline_instance_state));
+        if (state == NULL) {
+            return NULL;
+        }
+        state->blocks = NULL;
+        state->num_blocks = 0;
+        state->scratch_used = 0;
+        instance->_private = state;
+    }
+    if (index >= state->num_blocks) {
+        int num_blocks = index + 1;
+        size_t bytes = num_blocks * sizeof(pipeline_instance_block);
+        pipeline_instance_block *blocks = (pipeline_instance_block *)halide_malloc(user_context, bytes);
+        if (blocks == NULL) {
+            return NULL;
+        }
+        memset(blocks, 0, bytes);
+        if (state->blocks) {
+            memcpy(blocks, state->blocks, state->num_blocks * sizeof(pipeline_instance_block));
+            halide_free(user_context, state->blocks);
+        }
+        state->blocks = blocks;
+        state->num_blocks = num_blocks;
+    }
+    return state;
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK int halide_pipeline_instance_begin(void *user_context, halide_pipeline_instance_t *instance) {
+    if (instance == NULL) {
+        halide_error(user_context, "NULL halide_pipeline_instance_t passed to a pipeline compiled with pipeline_instance\n");
+        return halide_error_code_generic_error;
+    }
+    if (instance->query) {
+        instance->required_scratch_size = 0;
+        return 1;
+    }
+    return 0;
+}
+
+WEAK void *halide_pipeline_instance_malloc(void *user_context, halide_pipeline_instance_t *instance,
+                                           int index, uint64_t size) {
+    uint64_t bytes = pipeline_instance_block_size(size);
+    if (instance->query) {
+        instance->required_scratch_size += bytes;
+        // Query calls do no work, so any non-NULL pointer will do.
+        return instance;
+    }
+
+    pipeline_instance_state *state = pipeline_instance_get_state(user_context, instance, index);
+    if (state == NULL) {
+        return NULL;
+    }
+    pipeline_instance_block *block = state->blocks + index;
+    if (block->ptr && block->size >= bytes) {
+        return block->ptr;
+    }
+
+    if (block->owned) {
+        halide_free(user_context, block->ptr);
+    }
+    block->ptr = NULL;
+    block->size = 0;
+    block->owned = false;
+
+    if (instance->scratch && state->scratch_used + bytes <= instance->scratch_size) {
+        block->ptr = (char *)instance->scratch + state->scratch_used;
+        state->scratch_used += bytes;
+    } else {
+        block->ptr = halide_malloc(user_context, bytes);
+        if (block->ptr == NULL) {
+            return NULL;
+        }
+        block->owned = true;
+    }
+    block->size = bytes;
+    return block->ptr;
+}
+
+WEAK void halide_pipeline_instance_free(void *user_context, void *ptr) {
+    // The memory belongs to the instance until it is released.
+}
+
+WEAK void halide_pipeline_instance_release(void *user_context, halide_pipeline_instance_t *instance) {
+    pipeline_instance_state *state = (pipeline_instance_state *)instance->_private;
+    if (state == NULL) {
+        return;
+    }
+    for (int i = 0; i < state->num_blocks; i++) {
+        if (state->blocks[i].owned) {
+            halide_free(user_context, state->blocks[i].ptr);
+        }
+    }
+    if (state->blocks) {
+        halide_free(user_context, state->blocks);
+    }
+    halide_free(user_context, state);
+    instance->_private = NULL;
+}
+
+}
@@ -19,6 +19,7 @@ extern "C" {
 typedef long pthread_t;
 extern int pthread_create(pthread_t *, const void * attr,
                           void *(*start_routine)(void *), void * arg);
+extern pthread_t pthread_self();
 extern int pthread_join(pthread_t thread, void **retval);
 extern int pthread_cond_init(halide_cond *cond, const void *attr);
 extern int pthread_cond_wait(halide_cond *cond, halide_mutex *mutex);
@@ -42,6 +43,10 @@ WEAK void *spawn_thread_helper(void *arg) {
     t->f(t->closure);
     return NULL;
 }
+
+WEAK uint64_t halide_current_thread_id() {
+    return (uint64_t)pthread_self();
+}
 }}} // namespace Halide::Runtime::Internal
 
 extern "C" {
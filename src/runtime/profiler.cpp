@@ -1,6 +1,7 @@
 #include "HalideRuntime.h"
 #include "printer.h"
 #include "scoped_mutex_lock.h"
+#include "scoped_spin_lock.h"
 
 // Note: The profiler thread may out-live any valid user_context, or
 // be used across many different user_contexts, so nothing it calls
@@ -45,6 +46,10 @@ WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipelin
     p->num_allocs = 0;
     p->active_threads_numerator = 0;
     p->active_threads_denominator = 0;
+    for (int j = 0; j < halide_profiler_hw_num_counters; j++) {
+        p->hw_counters[j] = 0;
+    }
+    p->pixels = 0;
     p->funcs = (halide_profiler_func_stats *)malloc(num_funcs * sizeof(halide_profiler_func_stats));
     if (!p->funcs) {
         free(p);
@@ -60,6 +65,9 @@ WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipelin
         p->funcs[i].stack_peak = 0;
         p->funcs[i].active_threads_numerator = 0;
         p->funcs[i].active_threads_denominator = 0;
+        for (int j = 0; j < halide_profiler_hw_num_counters; j++) {
+            p->funcs[i].hw_counters[j] = 0;
+        }
     }
     s->first_free_id += num_funcs;
     s->pipelines = p;
@@ -92,6 +100,88 @@ WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int ac
     // Someone must have called reset_state while a kernel was running. Do nothing.
 }
 
+// The Func each thread is currently billing hardware counters to,
+// and the counter values when it started doing so. Indexed by the
+// slot returned by halide_perf_counters_thread_slot. Each slot is
+// only ever touched by the thread that owns it.
+struct hw_thread_state {
+    halide_profiler_pipeline_stats *pipeline;
+    int func_id;
+    uint64_t start[halide_profiler_hw_num_counters];
+};
+
+WEAK hw_thread_state hw_threads[HALIDE_PERF_COUNTERS_MAX_THREADS];
+
+WEAK void bill_hw_counters(hw_thread_state *t, const uint64_t *now) {
+    halide_profiler_pipeline_stats *p = t->pipeline;
+    if (!p || t->func_id < 0 || t->func_id >= p->num_funcs) return;
+    halide_profiler_func_stats *f = p->funcs + t->func_id;
+    for (int i = 0; i < halide_profiler_hw_num_counters; i++) {
+        uint64_t delta = now[i] - t->start[i];
+        __sync_add_and_fetch(&f->hw_counters[i], delta);
+        __sync_add_and_fetch(&p->hw_counters[i], delta);
+    }
+}
+
+// A begin or end event recorded by a pipeline compiled with
+// -profile_timeline.
+struct timeline_event {
+    int64_t time;
+    halide_profiler_pipeline_stats *pipeline;
+    int func_id;
+    int code;
+    int arg;
+};
+
+// Each thread records events into its own ring buffer, so recording
+// needs no locks. Threads are numbered in the order they first
+// recorded an event.
+struct timeline_thread {
+    uint64_t thread_id;
+    timeline_event *events;
+    // The total number of events recorded by this thread. The most
+    // recent min(count, timeline_capacity) are in the buffer.
+    uint64_t count;
+};
+
+#define TIMELINE_MAX_THREADS 256
+WEAK timeline_thread timeline_threads[TIMELINE_MAX_THREADS];
+WEAK int timeline_num_threads = 0;
+WEAK int timeline_capacity = 0;
+WEAK int timeline_lock = 0;
+
+WEAK timeline_thread *timeline_thread_for_current(void *user_context) {
+    uint64_t id = halide_current_thread_id();
+    for (int i = 0; i < timeline_num_threads; i++) {
+        if (timeline_threads[i].thread_id == id) {
+            return timeline_threads + i;
+        }
+    }
+
+    ScopedSpinLock lock(&timeline_lock);
+    if (timeline_capacity == 0) {
+        const char *capacity_str = getenv("HL_TIMELINE_EVENTS");
+        timeline_capacity = capacity_str ? atoi(capacity_str) : 0;
+        if (timeline_capacity <= 0) {
+            timeline_capacity = 65536;
+        }
+    }
+    if (timeline_num_threads == TIMELINE_MAX_THREADS) {
+        return NULL;
+    }
+    timeline_thread *t = timeline_threads + timeline_num_threads;
+    t->events = (timeline_event *)malloc(timeline_capacity * sizeof(timeline_event));
+    if (!t->events) {
+        return NULL;
+    }
+    t->thread_id = id;
+    t->count = 0;
+    // Make sure the slot is filled in before other threads can see it.
+    __sync_synchronize();
+    timeline_num_threads++;
+    return t;
+}
+
 WEAK void sampling_profiler_thread(void *) {
     halide_profiler_state *s = halide_profiler_get_state();
 
@@ -283,6 +373,156 @@ WEAK void halide_profiler_memory_free(void *user_context,
     __sync_sub_and_fetch(&f_stats->memory_current, decr);
 }
 
+WEAK int halide_profiler_hw_counters_pipeline_start(void *user_context,
+                                                    void *pipeline_state,
+                                                    uint64_t pixels) {
+    halide_profiler_pipeline_stats *p_stats = (halide_profiler_pipeline_stats *) pipeline_state;
+    halide_assert(user_context, p_stats != NULL);
+
+    __sync_add_and_fetch(&p_stats->pixels, pixels);
+
+    int slot = halide_perf_counters_thread_slot(user_context);
+    if (slot < 0) {
+        // Counters are unavailable on this platform or for this
+        // thread. Profile everything else as usual.
+        return 0;
+    }
+
+    // Start billing the overhead slot. Anything this thread did
+    // before entering the pipeline is discarded.
+    hw_thread_state *t = hw_threads + slot;
+    halide_perf_counters_read(slot, t->start);
+    t->pipeline = p_stats;
+    t->func_id = 0;
+    return 0;
+}
+
+WEAK int halide_profiler_hw_counters_switch(void *user_context,
+                                            void *pipeline_state,
+                                            int func_id) {
+    int slot = halide_perf_counters_thread_slot(user_context);
+    if (slot < 0) {
+        return 0;
+    }
+
+    uint64_t now[halide_profiler_hw_num_counters];
+    if (halide_perf_counters_read(slot, now) != 0) {
+        return 0;
+    }
+
+    // Bill everything since the last switch on this thread to the
+    // Func it was working on, then start billing the new one. A
+    // func_id of halide_profiler_outside_of_halide stops billing
+    // until the next switch (e.g. at the end of a parallel task).
+    hw_thread_state *t = hw_threads + slot;
+    bill_hw_counters(t, now);
+    for (int i = 0; i < halide_profiler_hw_num_counters; i++) {
+        t->start[i] = now[i];
+    }
+    t->pipeline = (halide_profiler_pipeline_stats *) pipeline_state;
+    t->func_id = func_id;
+    return 0;
+}
+
+WEAK int halide_profiler_timeline_event(void *user_context,
+                                        void *pipeline_state,
+                                        int func_id,
+                                        int code,
+                                        int arg) {
+    timeline_thread *t = timeline_thread_for_current(user_context);
+    if (!t) {
+        // Out of threads or memory. Drop the event.
+        return 0;
+    }
+    timeline_event *e = t->events + (t->count % timeline_capacity);
+    e->time = halide_current_time_ns(user_context);
+    e->pipeline = (halide_profiler_pipeline_stats *) pipeline_state;
+    e->func_id = func_id;
+    e->code = code;
+    e->arg = arg;
+    t->count++;
+    return 0;
+}
+
+WEAK int halide_profiler_timeline_dump(void *user_context, const char *filename) {
+    void *f = fopen(filename, "w");
+    if (!f) {
+        error(user_context) << "Could not open timeline file " << filename << "\n";
+        return -1;
+    }
+
+    char line_buf[1024];
+    Printer<StringStreamPrinter, sizeof(line_buf)> sstr(user_context, line_buf);
+
+    const char *prefix = "{\"traceEvents\":[\n";
+    fwrite(prefix, 1, strlen(prefix), f);
+    const char *separator = "";
+    for (int i = 0; i < timeline_num_threads; i++) {
+        timeline_thread *t = timeline_threads + i;
+
+        sstr.clear();
+        sstr << separator
+             << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i
+             << ",\"args\":{\"name\":\"" << (i == 0 ? "halide thread " : "halide worker ") << i
+             << " (" << t->thread_id << ")\"}}";
+        fwrite(sstr.str(), 1, sstr.size(), f);
+        separator = ",\n";
+
+        uint64_t first = 0;
+        if (t->count > (uint64_t)timeline_capacity) {
+            // The ring buffer wrapped. Only the most recent events remain.
+            first = t->count - timeline_capacity;
+        }
+        for (uint64_t j = first; j < t->count; j++) {
+            timeline_event *e = t->events + (j % timeline_capacity);
+            halide_profiler_pipeline_stats *p = e->pipeline;
+            const char *name = p->name;
+            if (e->func_id >= 0 && e->func_id < p->num_funcs) {
+                name = p->funcs[e->func_id].name;
+            }
+            const char *category = "pipeline";
+            switch (e->code) {
+            case halide_profiler_timeline_begin_produce:
+            case halide_profiler_timeline_end_produce:
+                category = "produce";
+                break;
+            case halide_profiler_timeline_begin_task:
+            case halide_profiler_timeline_end_task:
+                category = "task";
+                break;
+            case halide_profiler_timeline_begin_device:
+            case halide_profiler_timeline_end_device:
+                category = "device";
+                break;
+            }
+            bool begin = (e->code % 2) == 0;
+            // Chrome traces are in microseconds.
+            uint64_t us = e->time / 1000, ns = e->time % 1000;
+
+            sstr.clear();
+            sstr << ",\n{\"name\":\"" << name
+                 << "\",\"cat\":\"" << category
+                 << "\",\"ph\":\"" << (begin ? "B" : "E")
+                 << "\",\"ts\":" << us << "." << (ns < 100 ? "0" : "") << (ns < 10 ? "0" : "") << ns
+                 << ",\"pid\":0,\"tid\":" << i;
+            if (begin) {
+                sstr << ",\"args\":{\"pipeline\":\"" << p->name << "\"";
+                if (e->code == halide_profiler_timeline_begin_task) {
+                    sstr << ",\"task\":" << e->arg;
+                } else if (e->code == halide_profiler_timeline_begin_device) {
+                    sstr << ",\"device_api\":" << e->arg;
+                }
+                sstr << "}";
+            }
+            sstr << "}";
+            fwrite(sstr.str(), 1, sstr.size(), f);
+        }
+    }
+    const char *suffix = "\n]}\n";
+    fwrite(suffix, 1, strlen(suffix), f);
+    return fclose(f);
+}
+
 WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_state *s) {
 
     char line_buf[1024];
@@ -309,6 +549,23 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
         }
         sstr << " heap allocations: " << p->num_allocs
              << "  peak heap usage: " << p->memory_peak << " bytes\n";
+        bool hw_counters = p->hw_counters[halide_profiler_hw_cycles] != 0;
+        if (hw_counters) {
+            float cycles = (float)p->hw_counters[halide_profiler_hw_cycles];
+            float ipc = p->hw_counters[halide_profiler_hw_instructions] / cycles;
+            // Every last-level cache miss is a cache line's worth of
+            // traffic to and from DRAM.
+            float bytes_per_cycle = (p->hw_counters[halide_profiler_hw_cache_misses] * 64.0f) / cycles;
+            sstr << " cycles: " << p->hw_counters[halide_profiler_hw_cycles]
+                 << "  IPC: " << ipc
+                 << "  DRAM bytes/cycle: " << bytes_per_cycle
+                 << "  branch misses: " << p->hw_counters[halide_profiler_hw_branch_misses] << "\n";
+            if (p->pixels) {
+                float misses_per_pixel = p->hw_counters[halide_profiler_hw_cache_misses] / (float)p->pixels;
+                sstr << " output pixels: " << p->pixels
+                     << "  LLC misses/pixel: " << misses_per_pixel << "\n";
+            }
+        }
         halide_print(user_context, sstr.str());
 
         bool print_f_states = p->time || p->memory_total;
@@ -377,12 +634,36 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
                 if (fs->stack_peak > 0) {
                     sstr << " stack: " << fs->stack_peak;
                 }
+
+                if (hw_counters && fs->hw_counters[halide_profiler_hw_cycles]) {
+                    float cycles = (float)fs->hw_counters[halide_profiler_hw_cycles];
+                    cursor = sstr.size() + 2;
+                    while (sstr.size() < cursor) sstr << " ";
+                    sstr << "ipc: " << fs->hw_counters[halide_profiler_hw_instructions] / cycles;
+                    sstr.erase(3);
+                    if (p->pixels) {
+                        sstr << "  llc/pixel: " << fs->hw_counters[halide_profiler_hw_cache_misses] / (float)p->pixels;
+                        sstr.erase(3);
+                    }
+                    sstr << "  bytes/cycle: " << (fs->hw_counters[halide_profiler_hw_cache_misses] * 64.0f) / cycles;
+                    sstr.erase(3);
+                    sstr << "  br misses: " << fs->hw_counters[halide_profiler_hw_branch_misses];
+                }
                 sstr << "\n";
 
                 halide_print(user_context, sstr.str());
             }
         }
     }
+
+    const char *timeline_file = getenv("HL_TIMELINE_FILE");
+    if (timeline_file && timeline_num_threads > 0) {
+        if (halide_profiler_timeline_dump(user_context, timeline_file) == 0) {
+            sstr.clear();
+            sstr << "Timeline written to " << timeline_file << "\n";
+            halide_print(user_context, sstr.str());
+        }
+    }
 }
 
 WEAK void halide_profiler_report(void *user_context) {
@@ -408,6 +689,17 @@ WEAK void halide_profiler_reset() {
         free(p);
     }
     s->first_free_id = 0;
+
+    // Drop the timeline, which refers to the pipelines freed above.
+    for (int i = 0; i < timeline_num_threads; i++) {
+        timeline_threads[i].count = 0;
+    }
+
+    // Forget which pipeline each thread was billing hardware counters to.
+    for (int i = 0; i < HALIDE_PERF_COUNTERS_MAX_THREADS; i++) {
+        hw_threads[i].pipeline = NULL;
+        hw_threads[i].func_id = halide_profiler_outside_of_halide;
+    }
 }
 
 namespace {
@@ -16,6 +16,12 @@
 // cat src/runtime/runtime_internal.h src/runtime/HalideRuntime*.h | grep "^[^ ][^(]*halide_[^ ]*(" | grep -v '#define' | sed "s/[^(]*halide/halide/" | sed "s/(.*//" | sed "s/^h/    \(void *)\&h/" | sed "s/$/,/" | sort | uniq
 
 extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
+    (void *)&halide_arena_acquire,
+    (void *)&halide_arena_free,
+    (void *)&halide_arena_malloc,
+    (void *)&halide_arena_pool_create,
+    (void *)&halide_arena_pool_destroy,
+    (void *)&halide_arena_release,
     (void *)&halide_buffer_to_string,
     (void *)&halide_can_use_target_features,
     (void *)&halide_cond_broadcast,
@@ -102,6 +108,12 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_int64_to_string,
     (void *)&halide_join_thread,
     (void *)&halide_load_library,
+    (void *)&halide_locked_cache_free,
+    (void *)&halide_locked_cache_malloc,
+    (void *)&halide_loop_profile_dump,
+    (void *)&halide_loop_profile_pipeline_start,
+    (void *)&halide_loop_profile_record,
+    (void *)&halide_loop_profile_reset,
     (void *)&halide_malloc,
     (void *)&halide_matlab_call_pipeline,
     (void *)&halide_memoization_cache_cleanup,
@@ -147,19 +159,31 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_openglcompute_initialize_kernels,
     (void *)&halide_openglcompute_run,
     (void *)&halide_pointer_to_string,
+    (void *)&halide_pipeline_instance_begin,
+    (void *)&halide_pipeline_instance_free,
+    (void *)&halide_pipeline_instance_malloc,
+    (void *)&halide_pipeline_instance_release,
     (void *)&halide_print,
     (void *)&halide_profiler_get_pipeline_state,
     (void *)&halide_profiler_get_state,
+    (void *)&halide_profiler_hw_counters_pipeline_start,
+    (void *)&halide_profiler_hw_counters_switch,
     (void *)&halide_profiler_memory_allocate,
     (void *)&halide_profiler_memory_free,
     (void *)&halide_profiler_pipeline_start,
     (void *)&halide_profiler_report,
     (void *)&halide_profiler_reset,
     (void *)&halide_profiler_stack_peak_update,
+    (void *)&halide_profiler_timeline_dump,
+    (void *)&halide_profiler_timeline_event,
     (void *)&halide_qurt_hvx_lock,
     (void *)&halide_qurt_hvx_unlock,
     (void *)&halide_qurt_hvx_unlock_as_destructor,
     (void *)&halide_release_jit_module,
+    (void *)&halide_semaphore_acquire,
+    (void *)&halide_semaphore_init,
+    (void *)&halide_semaphore_release,
+    (void *)&halide_semaphore_try_acquire,
     (void *)&halide_set_custom_can_use_target_features,
     (void *)&halide_set_custom_do_par_for,
     (void *)&halide_set_custom_do_task,
@@ -167,6 +191,8 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_set_custom_get_library_symbol,
     (void *)&halide_set_custom_get_symbol,
     (void *)&halide_set_custom_load_library,
+    (void *)&halide_set_custom_locked_cache_free,
+    (void *)&halide_set_custom_locked_cache_malloc,
     (void *)&halide_set_custom_malloc,
     (void *)&halide_set_custom_print,
     (void *)&halide_set_custom_trace,
@@ -134,6 +134,22 @@ WEAK int halide_profiler_pipeline_start(void *user_context,
                                         const char *pipeline_name,
                                         int num_funcs,
                                         const uint64_t *func_names);
+WEAK int halide_profiler_hw_counters_pipeline_start(void *user_context,
+                                                    void *pipeline_state,
+                                                    uint64_t pixels);
+WEAK int halide_profiler_hw_counters_switch(void *user_context,
+                                            void *pipeline_state,
+                                            int func_id);
+WEAK int halide_profiler_timeline_event(void *user_context,
+                                        void *pipeline_state,
+                                        int func_id,
+                                        int code,
+                                        int arg);
+WEAK void *halide_loop_profile_pipeline_start(void *user_context,
+                                              const char *pipeline_name,
+                                              int num_counters,
+                                              const uint64_t *counter_names);
+WEAK int halide_loop_profile_record(void *counters, int id, int iterations);
 WEAK int halide_host_cpu_count();
 
 WEAK int halide_device_and_host_malloc(void *user_context, struct halide_buffer_t *buf,
@@ -193,6 +209,18 @@ struct CpuFeatures {
 };
 extern WEAK CpuFeatures halide_get_cpu_features();
 
+// An identifier for the calling thread, unique among live threads.
+extern WEAK uint64_t halide_current_thread_id();
+
+// Per-thread hardware performance counters used by the profiler. The
+// slot is a small integer identifying the calling thread; counters
+// are opened the first time a thread asks for its slot. Returns -1 if
+// counters are not available. Reads halide_profiler_hw_num_counters
+// values into the given array, returning zero on success.
+#define HALIDE_PERF_COUNTERS_MAX_THREADS 256
+extern WEAK int halide_perf_counters_thread_slot(void *user_context);
+extern WEAK int halide_perf_counters_read(int slot, uint64_t *values);
+
 template <typename T>
 __attribute__((always_inline)) void swap(T &a, T &b) {
     T t = a;
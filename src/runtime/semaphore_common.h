@@ -0,0 +1,47 @@
+#ifndef HALIDE_SEMAPHORE_COMMON_H
+#define HALIDE_SEMAPHORE_COMMON_H
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// The contents of a halide_semaphore_t. The count is only ever
+// touched with atomic operations, so that releasing and acquiring
+// never need a lock. The number of blocked waiters lets a release
+// skip waking anybody up in the common case where no one is waiting.
+struct semaphore_impl {
+    volatile int value;
+    volatile int waiters;
+};
+
+WEAK semaphore_impl *get_semaphore_impl(struct halide_semaphore_t *s) {
+    return (semaphore_impl *)s;
+}
+
+WEAK void semaphore_init(struct halide_semaphore_t *s, int n) {
+    semaphore_impl *sem = get_semaphore_impl(s);
+    sem->value = n;
+    sem->waiters = 0;
+    __sync_synchronize();
+}
+
+// Returns the new value of the count.
+WEAK int semaphore_release(struct halide_semaphore_t *s, int n) {
+    semaphore_impl *sem = get_semaphore_impl(s);
+    return __sync_add_and_fetch(&sem->value, n);
+}
+
+WEAK bool semaphore_try_acquire(struct halide_semaphore_t *s, int n) {
+    semaphore_impl *sem = get_semaphore_impl(s);
+    int old = sem->value;
+    while (old >= n) {
+        int prev = __sync_val_compare_and_swap(&sem->value, old, old - n);
+        if (prev == old) {
+            return true;
+        }
+        old = prev;
+    }
+    return false;
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+#endif
@@ -1,3 +1,4 @@
+#include "semaphore_common.h"
 
 namespace Halide { namespace Runtime { namespace Internal {
 
@@ -45,6 +46,9 @@ struct work_queue_t {
     // The number threads created
     int threads_created;
 
+    // The number of threads blocked in halide_semaphore_acquire.
+    int threads_blocked;
+
     // The desired number threads doing work.
     int desired_num_threads;
 
@@ -83,6 +87,48 @@ WEAK int default_desired_num_threads() {
     return desired_num_threads;
 }
 
+// Claim one task from the job on the top of the stack and run
+// it. There must be a job pending.
+WEAK void run_one_task_already_locked(work *owned_job) {
+    // Grab the next job.
+    work *job = work_queue.jobs;
+
+    // Claim a task from it.
+    work myjob = *job;
+    job->next++;
+
+    // If there were no more tasks pending for this job,
+    // remove it from the stack.
+    if (job->next == job->max) {
+        work_queue.jobs = job->next_job;
+    }
+
+    // Increment the active_worker count so that other threads
+    // are aware that this job is still in progress even
+    // though there are no outstanding tasks for it.
+    job->active_workers++;
+
+    // Release the lock and do the task.
+    halide_mutex_unlock(&work_queue.mutex);
+    int result = halide_do_task(myjob.user_context, myjob.f, myjob.next,
+                                myjob.closure);
+    halide_mutex_lock(&work_queue.mutex);
+
+    // If this task failed, set the exit status on the job.
+    if (result) {
+        job->exit_status = result;
+    }
+
+    // We are no longer active on this job
+    job->active_workers--;
+
+    // If the job is done and I'm not the owner of it, wake up
+    // the owner.
+    if (!job->running() && job != owned_job) {
+        halide_cond_broadcast(&work_queue.wakeup_owners);
+    }
+}
+
 WEAK void worker_thread_already_locked(work *owned_job) {
     // If I'm a job owner, then I was the thread that called
     // do_par_for, and I should only stay in this function until my
@@ -108,43 +154,7 @@ WEAK void worker_thread_already_locked(work *owned_job) {
                 work_queue.a_team_size++;
             }
         } else {
-            // Grab the next job.
-            work *job = work_queue.jobs;
-
-            // Claim a task from it.
-            work myjob = *job;
-            job->next++;
-
-            // If there were no more tasks pending for this job,
-            // remove it from the stack.
-            if (job->next == job->max) {
-                work_queue.jobs = job->next_job;
-            }
-
-            // Increment the active_worker count so that other threads
-            // are aware that this job is still in progress even
-            // though there are no outstanding tasks for it.
-            job->active_workers++;
-
-            // Release the lock and do the task.
-            halide_mutex_unlock(&work_queue.mutex);
-            int result = halide_do_task(myjob.user_context, myjob.f, myjob.next,
-                                        myjob.closure);
-            halide_mutex_lock(&work_queue.mutex);
-
-            // If this task failed, set the exit status on the job.
-            if (result) {
-                job->exit_status = result;
-            }
-
-            // We are no longer active on this job
-            job->active_workers--;
-
-            // If the job is done and I'm not the owner of it, wake up
-            // the owner.
-            if (!job->running() && job != owned_job) {
-                halide_cond_broadcast(&work_queue.wakeup_owners);
-            }
+            run_one_task_already_locked(owned_job);
         }
     }
 }
@@ -187,6 +197,7 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
         }
         work_queue.desired_num_threads = clamp_num_threads(work_queue.desired_num_threads);
         work_queue.threads_created = 0;
+        work_queue.threads_blocked = 0;
 
         // Everyone starts on the a team.
         work_queue.a_team_size = work_queue.desired_num_threads;
@@ -265,6 +276,61 @@ WEAK int halide_set_num_threads(int n) {
     return old;
 }
 
+WEAK int halide_semaphore_init(halide_semaphore_t *s, int n) {
+    semaphore_init(s, n);
+    return n;
+}
+
+WEAK int halide_semaphore_release(halide_semaphore_t *s, int n) {
+    int value = semaphore_release(s, n);
+    if (get_semaphore_impl(s)->waiters > 0) {
+        // Someone is blocked in halide_semaphore_acquire. They wait
+        // on the same condition variable as job owners.
+        halide_mutex_lock(&work_queue.mutex);
+        halide_cond_broadcast(&work_queue.wakeup_owners);
+        halide_mutex_unlock(&work_queue.mutex);
+    }
+    return value;
+}
+
+WEAK bool halide_semaphore_try_acquire(halide_semaphore_t *s, int n) {
+    return semaphore_try_acquire(s, n);
+}
+
+WEAK int halide_semaphore_acquire(void *user_context, halide_semaphore_t *s, int n) {
+    if (semaphore_try_acquire(s, n)) {
+        return 0;
+    }
+
+    semaphore_impl *sem = get_semaphore_impl(s);
+    halide_mutex_lock(&work_queue.mutex);
+    // Register as a waiter before checking the count again, so that
+    // a release that happens in between is guaranteed to wake us up.
+    __sync_add_and_fetch(&sem->waiters, 1);
+    work_queue.threads_blocked++;
+    while (!semaphore_try_acquire(s, n)) {
+        // Don't run pending tasks on this thread while waiting. The
+        // task that will release this semaphore may be one of them,
+        // and it may in turn wait for this one to make progress
+        // (e.g. the consumer of an async producer with folded
+        // storage), so it must not run nested inside this call.
+        // Instead, make sure there is a thread that isn't blocked to
+        // pick it up.
+        if (work_queue.jobs != NULL &&
+            work_queue.threads_created < work_queue.threads_blocked &&
+            work_queue.threads_created < MAX_THREADS) {
+            work_queue.threads[work_queue.threads_created++] =
+                halide_spawn_thread(worker_thread, NULL);
+            work_queue.a_team_size++;
+        }
+        halide_cond_wait(&work_queue.wakeup_owners, &work_queue.mutex);
+    }
+    work_queue.threads_blocked--;
+    __sync_sub_and_fetch(&sem->waiters, 1);
+    halide_mutex_unlock(&work_queue.mutex);
+    return 0;
+}
+
 WEAK void halide_shutdown_thread_pool() {
     if (!work_queue.initialized) return;
 
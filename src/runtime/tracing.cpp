@@ -10,11 +10,250 @@ typedef int32_t (*trace_fn)(void *, const halide_trace_event_t *);
 
 namespace Halide { namespace Runtime { namespace Internal {
 
+// A spin lock that can be held by many readers or one writer. Writers
+// take priority: once a writer is waiting, new readers spin.
+class SharedExclusiveSpinLock {
+    volatile uint32_t lock;
+
+    const static uint32_t exclusive_held_mask = 0x80000000;
+    const static uint32_t exclusive_waiting_mask = 0x40000000;
+    const static uint32_t shared_mask = 0x3fffffff;
+
+public:
+    __attribute__((always_inline)) void acquire_shared() {
+        while (1) {
+            uint32_t x = lock & shared_mask;
+            if (__sync_bool_compare_and_swap(&lock, x, x + 1)) {
+                return;
+            }
+        }
+    }
+
+    __attribute__((always_inline)) void release_shared() {
+        __sync_fetch_and_sub(&lock, 1);
+    }
+
+    __attribute__((always_inline)) void acquire_exclusive() {
+        while (1) {
+            // The waiting bit is cleared whenever some writer gets
+            // the lock, so re-request it each time around.
+            __sync_fetch_and_or(&lock, exclusive_waiting_mask);
+            if (__sync_bool_compare_and_swap(&lock, exclusive_waiting_mask, exclusive_held_mask)) {
+                return;
+            }
+        }
+    }
+
+    __attribute__((always_inline)) void release_exclusive() {
+        __sync_fetch_and_and(&lock, ~exclusive_held_mask);
+    }
+
+    __attribute__((always_inline)) void init() {
+        lock = 0;
+    }
+};
+
+// Trace packets are staged in a large buffer shared by all threads
+// and written to the trace file in one write() when it fills up, when
+// a pipeline ends, or when tracing is shut down. Threads claim space
+// for a packet with a single atomic add, so they only contend with
+// each other when the buffer is being flushed.
+class TraceBuffer {
+    SharedExclusiveSpinLock lock;
+    uint32_t cursor, overage;
+    uint8_t buf[1024 * 1024];
+
+    // Try to claim space for a packet. Returns NULL if the buffer is
+    // full. On success, the shared lock is held until release_packet.
+    __attribute__((always_inline)) halide_trace_packet_t *try_acquire_packet(void *user_context, uint32_t size) {
+        lock.acquire_shared();
+        halide_assert(user_context, size <= sizeof(buf));
+        uint32_t my_cursor = __sync_fetch_and_add(&cursor, size);
+        if (my_cursor + size > sizeof(buf)) {
+            // Don't try to back this out. Record the space that was
+            // claimed but never used, and subtract it at the next flush.
+            __sync_fetch_and_add(&overage, size);
+            lock.release_shared();
+            return NULL;
+        } else {
+            return (halide_trace_packet_t *)(buf + my_cursor);
+        }
+    }
+
+public:
+    // Wait for all threads to finish writing their packets, then
+    // write the buffer to the file.
+    __attribute__((always_inline)) void flush(void *user_context, int fd) {
+        lock.acquire_exclusive();
+        bool success = true;
+        if (cursor) {
+            cursor -= overage;
+            success = (cursor == (uint32_t)write(fd, buf, cursor));
+            cursor = 0;
+            overage = 0;
+        }
+        lock.release_exclusive();
+        halide_assert(user_context, success && "Could not write to trace file");
+    }
+
+    // Claim space for a packet of the given size, flushing the buffer
+    // to make room if necessary. The packet must be released before
+    // the buffer can be flushed again.
+    __attribute__((always_inline)) halide_trace_packet_t *acquire_packet(void *user_context, int fd, uint32_t size) {
+        halide_trace_packet_t *packet = NULL;
+        while (!(packet = try_acquire_packet(user_context, size))) {
+            flush(user_context, fd);
+        }
+        return packet;
+    }
+
+    __attribute__((always_inline)) void release_packet(halide_trace_packet_t *) {
+        // Make sure the packet contents have landed before a flush
+        // can read them.
+        __sync_synchronize();
+        lock.release_shared();
+    }
+
+    __attribute__((always_inline)) void init() {
+        lock.init();
+        cursor = 0;
+        overage = 0;
+    }
+};
+
+WEAK TraceBuffer *halide_trace_buffer = NULL;
 WEAK int halide_trace_file = 0;
 WEAK int halide_trace_file_lock = 0;
 WEAK bool halide_trace_file_initialized = false;
 WEAK void *halide_trace_file_internally_opened = NULL;
 
+// Runtime filtering of trace events, configured from the environment
+// the first time an event is traced:
+//   HL_TRACE_EVENTS: a comma-separated list of the kinds of events to
+//     keep, from load, store, realization, produce, consume and pipeline.
+//   HL_TRACE_FUNCS: a comma-separated list of the Funcs to keep events for.
+//   HL_TRACE_SAMPLE: keep only every Nth load and store.
+// Events that are filtered out are not written, but still get an id,
+// so parent ids in the trace remain unique.
+WEAK bool halide_trace_filter_initialized = false;
+WEAK uint32_t halide_trace_event_mask = 0xffffffff;
+WEAK const char *halide_trace_funcs = NULL;
+WEAK int halide_trace_sample_rate = 1;
+WEAK uint32_t halide_trace_sample_counter = 0;
+
+// Func names are global constant strings, so whether to keep a Func
+// can be cached by the address of its name.
+struct trace_func_filter {
+    const char *func;
+    bool keep;
+};
+#define TRACE_FUNC_FILTER_SIZE 64
+WEAK trace_func_filter halide_trace_func_filters[TRACE_FUNC_FILTER_SIZE];
+WEAK int halide_trace_func_filter_lock = 0;
+
+// Does the comma-separated list contain the given name?
+WEAK bool trace_list_contains(const char *list, const char *name, size_t name_len) {
+    const char *p = list;
+    while (*p) {
+        const char *q = strchr(p, ',');
+        size_t len = q ? (size_t)(q - p) : strlen(p);
+        if (len == name_len && strncmp(p, name, len) == 0) {
+            return true;
+        }
+        if (!q) break;
+        p = q + 1;
+    }
+    return false;
+}
+
+WEAK void init_trace_filter() {
+    ScopedSpinLock lock(&halide_trace_file_lock);
+    if (halide_trace_filter_initialized) {
+        return;
+    }
+    const char *events = getenv("HL_TRACE_EVENTS");
+    if (events) {
+        // Each name enables a begin/end pair of event codes, except
+        // for loads and stores.
+        const char *names[] = {"load", "store", "realization", "produce", "consume", "pipeline"};
+        const uint32_t masks[] = {
+            1 << halide_trace_load,
+            1 << halide_trace_store,
+            (1 << halide_trace_begin_realization) | (1 << halide_trace_end_realization),
+            (1 << halide_trace_produce) | (1 << halide_trace_end_produce),
+            (1 << halide_trace_consume) | (1 << halide_trace_end_consume),
+            (1 << halide_trace_begin_pipeline) | (1 << halide_trace_end_pipeline)
+        };
+        halide_trace_event_mask = 0;
+        for (int i = 0; i < 6; i++) {
+            if (trace_list_contains(events, names[i], strlen(names[i]))) {
+                halide_trace_event_mask |= masks[i];
+            }
+        }
+    }
+    halide_trace_funcs = getenv("HL_TRACE_FUNCS");
+    const char *sample = getenv("HL_TRACE_SAMPLE");
+    if (sample && atoi(sample) > 1) {
+        halide_trace_sample_rate = atoi(sample);
+    }
+    __sync_synchronize();
+    halide_trace_filter_initialized = true;
+}
+
+WEAK bool trace_func_enabled(const char *func) {
+    unsigned h = (unsigned)(((uintptr_t)func) >> 3) % TRACE_FUNC_FILTER_SIZE;
+    for (int i = 0; i < TRACE_FUNC_FILTER_SIZE; i++) {
+        trace_func_filter *f = halide_trace_func_filters + ((h + i) % TRACE_FUNC_FILTER_SIZE);
+        if (f->func == func) {
+            return f->keep;
+        }
+        if (f->func == NULL) {
+            break;
+        }
+    }
+
+    // Not cached yet. Tuple elements are traced as f.0, f.1, etc.,
+    // so match on the name before any '.'.
+    const char *dot = strchr(func, '.');
+    size_t len = dot ? (size_t)(dot - func) : strlen(func);
+    bool keep = trace_list_contains(halide_trace_funcs, func, len);
+
+    ScopedSpinLock lock(&halide_trace_func_filter_lock);
+    for (int i = 0; i < TRACE_FUNC_FILTER_SIZE; i++) {
+        trace_func_filter *f = halide_trace_func_filters + ((h + i) % TRACE_FUNC_FILTER_SIZE);
+        if (f->func == func) {
+            break;
+        }
+        if (f->func == NULL) {
+            // Publish the decision before the key, so that lock-free
+            // readers never see a key without its decision.
+            f->keep = keep;
+            __sync_synchronize();
+            f->func = func;
+            break;
+        }
+    }
+    // If the cache is full we just don't cache it.
+    return keep;
+}
+
+WEAK bool trace_event_enabled(const halide_trace_event_t *e) {
+    if (!halide_trace_filter_initialized) {
+        init_trace_filter();
+    }
+    if (!(halide_trace_event_mask & (1 << e->event))) {
+        return false;
+    }
+    if (halide_trace_funcs && !trace_func_enabled(e->func)) {
+        return false;
+    }
+    if (halide_trace_sample_rate > 1 && e->event <= halide_trace_store) {
+        uint32_t n = __sync_fetch_and_add(&halide_trace_sample_counter, 1);
+        return (n % halide_trace_sample_rate) == 0;
+    }
+    return true;
+}
+
 }}}
 
 extern "C" {
@@ -24,6 +263,18 @@ WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t
 
     int32_t my_id = __sync_fetch_and_add(&ids, 1);
 
+    if (!trace_event_enabled(e)) {
+        // Even if the event itself is dropped, the end of a pipeline
+        // is when the trace file should be made complete.
+        if (e->event == halide_trace_end_pipeline && halide_trace_buffer) {
+            int fd = halide_get_trace_file(user_context);
+            if (fd > 0) {
+                halide_trace_buffer->flush(user_context, fd);
+            }
+        }
+        return my_id;
+    }
+
     // If we're dumping to a file, use a binary format
     int fd = halide_get_trace_file(user_context);
     if (fd > 0) {
@@ -36,31 +287,48 @@ WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t
         uint32_t total_size = (total_size_without_padding + 3) & ~3;
         uint32_t padding_bytes = total_size - total_size_without_padding;
 
-        // The packet header
-        halide_trace_packet_t header;
-        header.size = total_size;
-        header.id = my_id;
-        header.type = e->type;
-        header.event = e->event;
-        header.parent_id = e->parent_id;
-        header.value_index = e->value_index;
-        header.dimensions = e->dimensions;
-
-        size_t written = 0;
-        {
+        if (!halide_trace_buffer) {
             ScopedSpinLock lock(&halide_trace_file_lock);
-            written += write(fd, &header, sizeof(header));
-            if (e->coordinates) {
-                written += write(fd, e->coordinates, coords_bytes);
-            }
-            if (e->value) {
-                written += write(fd, e->value, value_bytes);
+            if (!halide_trace_buffer) {
+                TraceBuffer *buffer = (TraceBuffer *)malloc(sizeof(TraceBuffer));
+                halide_assert(user_context, buffer && "Could not allocate trace buffer");
+                buffer->init();
+                __sync_synchronize();
+                halide_trace_buffer = buffer;
             }
-            written += write(fd, e->func, name_bytes);
-            uint32_t zero = 0;
-            written += write(fd, &zero, padding_bytes);
         }
-        halide_assert(user_context, written == total_size && "Can't write to trace file");
+
+        halide_trace_packet_t *packet = halide_trace_buffer->acquire_packet(user_context, fd, total_size);
+
+        // The packet header
+        packet->size = total_size;
+        packet->id = my_id;
+        packet->type = e->type;
+        packet->event = e->event;
+        packet->parent_id = e->parent_id;
+        packet->value_index = e->value_index;
+        packet->dimensions = e->dimensions;
+
+        uint8_t *dst = (uint8_t *)(packet + 1);
+        if (e->coordinates) {
+            memcpy(dst, e->coordinates, coords_bytes);
+        }
+        dst += coords_bytes;
+        if (e->value) {
+            memcpy(dst, e->value, value_bytes);
+        }
+        dst += value_bytes;
+        memcpy(dst, e->func, name_bytes);
+        dst += name_bytes;
+        memset(dst, 0, padding_bytes);
+
+        halide_trace_buffer->release_packet(packet);
+
+        // Flush at the end of each pipeline, so that the trace file
+        // is complete whenever a pipeline isn't running.
+        if (e->event == halide_trace_end_pipeline) {
+            halide_trace_buffer->flush(user_context, fd);
+        }
 
     } else {
         uint8_t buffer[4096];
@@ -182,6 +450,10 @@ WEAK trace_fn halide_set_custom_trace(trace_fn t) {
 }
 
 WEAK void halide_set_trace_file(int fd) {
+    // Anything buffered belongs to the old file.
+    if (halide_trace_buffer && halide_trace_file > 0 && fd != halide_trace_file) {
+        halide_trace_buffer->flush(NULL, halide_trace_file);
+    }
     halide_trace_file = fd;
     halide_trace_file_initialized = true;
 }
@@ -189,6 +461,11 @@ WEAK void halide_set_trace_file(int fd) {
 extern int errno;
 
 WEAK int halide_get_trace_file(void *user_context) {
+    // This is called for every event, so don't take the lock once
+    // the file is set up.
+    if (halide_trace_file_initialized) {
+        return halide_trace_file;
+    }
     // Prevent multiple threads both trying to initialize the trace
     // file at the same time.
     ScopedSpinLock lock(&halide_trace_file_lock);
@@ -211,6 +488,9 @@ WEAK int32_t halide_trace(void *user_context, const halide_trace_event_t *e) {
 }
 
 WEAK int halide_shutdown_trace() {
+    if (halide_trace_buffer && halide_trace_file > 0) {
+        halide_trace_buffer->flush(NULL, halide_trace_file);
+    }
     if (halide_trace_file_internally_opened) {
         int ret = fclose(halide_trace_file_internally_opened);
         halide_trace_file = 0;
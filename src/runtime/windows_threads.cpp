@@ -18,6 +18,7 @@ typedef struct {
 } CriticalSection;
 
 extern WIN32API Thread CreateThread(void *, size_t, void *(*fn)(void *), void *, int32_t, int32_t *);
+extern WIN32API int32_t GetCurrentThreadId();
 extern WIN32API void InitializeConditionVariable(ConditionVariable *);
 extern WIN32API void WakeAllConditionVariable(ConditionVariable *);
 extern WIN32API void SleepConditionVariableCS(ConditionVariable *, CriticalSection *, int);
@@ -53,6 +54,10 @@ WEAK void *spawn_thread_helper(void *arg) {
     return NULL;
 }
 
+WEAK uint64_t halide_current_thread_id() {
+    return (uint64_t)GetCurrentThreadId();
+}
+
 }}} // namespace Halide::Runtime::Internal
 
 extern "C" {
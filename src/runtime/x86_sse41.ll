@@ -7,6 +7,17 @@ define weak_odr <8 x i16>  @packusdwx8(<8 x i32> %arg) nounwind alwaysinline {
   ret <8 x i16> %3
 }
 
+declare <8 x i16> @llvm.x86.ssse3.pmadd.ub.sw.128(<16 x i8>, <16 x i8>) nounwind readnone
+
+; pmaddubsw multiplies unsigned bytes by signed bytes, and adds adjacent
+; pairs of the products with saturation. a and c are the unsigned factors.
+define weak_odr <8 x i16> @pmaddubswx8(<8 x i8> %a, <8 x i8> %b, <8 x i8> %c, <8 x i8> %d) nounwind alwaysinline {
+  %1 = shufflevector <8 x i8> %a, <8 x i8> %c, <16 x i32> <i32 0, i32 8, i32 1, i32 9, i32 2, i32 10, i32 3, i32 11, i32 4, i32 12, i32 5, i32 13, i32 6, i32 14, i32 7, i32 15>
+  %2 = shufflevector <8 x i8> %b, <8 x i8> %d, <16 x i32> <i32 0, i32 8, i32 1, i32 9, i32 2, i32 10, i32 3, i32 11, i32 4, i32 12, i32 5, i32 13, i32 6, i32 14, i32 7, i32 15>
+  %3 = tail call <8 x i16> @llvm.x86.ssse3.pmadd.ub.sw.128(<16 x i8> %1, <16 x i8> %2)
+  ret <8 x i16> %3
+}
+
 define weak_odr <4 x float> @floor_f32x4(<4 x float> %x) nounwind uwtable readnone optsize inlinehint alwaysinline {
   %1 = tail call <4 x float> @llvm.x86.sse41.round.ps(<4 x float> %x, i32 1)
   ret <4 x float> %1
@@ -0,0 +1,157 @@
+#include "Halide.h"
+#include <atomic>
+#include <stdio.h>
+
+using namespace Halide;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+std::atomic<int> call_counter(0);
+extern "C" DLLEXPORT int count(int arg) {
+    call_counter++;
+    return arg;
+}
+HalideExtern_1(int, count, int);
+
+size_t custom_malloc_size = 0;
+
+void *my_malloc(void *user_context, size_t x) {
+    custom_malloc_size = x;
+    void *orig = malloc(x+32);
+    void *ptr = (void *)((((size_t)orig + 32) >> 5) << 5);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(void *user_context, void *ptr) {
+    free(((void**)ptr)[-1]);
+}
+
+// Realize a pipeline in which a Func only used by a producer is
+// computed at the same loop level as it, and return the number of
+// times that Func was evaluated.
+int count_private_input_calls(bool async) {
+    Var x, y;
+    Func in, producer, consumer;
+    in(x, y) = count(x + y);
+    producer(x, y) = in(x, y) * 2;
+    consumer(x, y) = producer(x, y) + producer(x, y + 1);
+    in.compute_at(consumer, y);
+    producer.store_root().compute_at(consumer, y);
+    if (async) {
+        producer.async();
+    }
+
+    call_counter = 0;
+    Buffer<int> out = consumer.realize(32, 32);
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            int correct = 2 * (x + y) + 2 * (x + y + 1);
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return call_counter;
+}
+
+int main(int argc, char **argv) {
+    Var x, y;
+
+    {
+        // A producer computed a scanline at a time, overlapping with
+        // the consumer of the scanlines it has already produced.
+        Func producer, consumer;
+        producer(x, y) = x + y;
+        consumer(x, y) = producer(x, y - 1) + producer(x, y + 1);
+        producer.store_root().compute_at(consumer, y).async();
+
+        Buffer<int> out = consumer.realize(64, 64);
+        for (int y = 0; y < out.height(); y++) {
+            for (int x = 0; x < out.width(); x++) {
+                int correct = 2 * (x + y);
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    {
+        // An async producer with an update definition, that depends
+        // on another Func computed at the same loop level.
+        Func in, producer, consumer;
+        in(x, y) = x * y;
+        producer(x, y) = in(x, y) + 1;
+        producer(x, y) += in(x + 1, y);
+        consumer(x, y) = producer(x, y) * 2 + producer(x, y + 1);
+        in.compute_at(consumer, y);
+        producer.store_root().compute_at(consumer, y).async();
+        consumer.vectorize(x, 8);
+
+        Buffer<int> out = consumer.realize(64, 64);
+        for (int y = 0; y < out.height(); y++) {
+            for (int x = 0; x < out.width(); x++) {
+                auto p = [](int x, int y) { return x * y + 1 + (x + 1) * y; };
+                int correct = p(x, y) * 2 + p(x, y + 1);
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    {
+        // An async producer with folded storage. It must not
+        // overwrite a scanline the consumer still needs, however far
+        // ahead of the consumer it gets.
+        Func producer, consumer;
+        producer(x, y) = x + y;
+        consumer(x, y) = count(producer(x, y - 1)) + producer(x, y + 1);
+        producer.store_root().compute_at(consumer, y).fold_storage(y, 4).async();
+
+        consumer.set_custom_allocator(my_malloc, my_free);
+
+        Buffer<int> out = consumer.realize(64, 64);
+        for (int y = 0; y < out.height(); y++) {
+            for (int x = 0; x < out.width(); x++) {
+                int correct = 2 * (x + y);
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+
+        size_t expected_size = 64*4*sizeof(int) + sizeof(int);
+        if (custom_malloc_size == 0 || custom_malloc_size != expected_size) {
+            printf("Scratch space allocated was %d instead of %d\n", (int)custom_malloc_size, (int)expected_size);
+            return -1;
+        }
+    }
+
+    {
+        // A Func used only by the async producer is computed by the
+        // producer task alone, not again by the consumer task.
+        int serial_calls = count_private_input_calls(false);
+        int async_calls = count_private_input_calls(true);
+        if (serial_calls < 0 || async_calls < 0) {
+            return -1;
+        }
+        if (async_calls != serial_calls) {
+            printf("The input of the async producer was computed %d times instead of %d\n",
+                   async_calls, serial_calls);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
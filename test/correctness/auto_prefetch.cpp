@@ -0,0 +1,86 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Count the prefetches of a buffer.
+class CountPrefetches : public IRMutator {
+    std::string buffer;
+
+    using IRMutator::visit;
+
+    void visit(const Call *op) {
+        if (op->is_intrinsic(Call::prefetch)) {
+            const Variable *base = op->args[0].as<Variable>();
+            if (base && base->name == buffer) {
+                count++;
+            }
+        }
+        IRMutator::visit(op);
+    }
+
+public:
+    int count = 0;
+    CountPrefetches(const std::string &b) : buffer(b) {}
+};
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment().with_feature(Target::AutoPrefetch);
+    Var x("x"), y("y");
+
+    Buffer<int> input(256, 256);
+    input.for_each_element([&](int x, int y) {
+        input(x, y) = x * 3 + y;
+    });
+
+    {
+        // A transposed read touches a new cache line on every
+        // iteration of the innermost loop.
+        Func f("f");
+        f(x, y) = input(y, x) * 2;
+
+        CountPrefetches *counter = new CountPrefetches(input.name());
+        f.add_custom_lowering_pass(counter);
+        Buffer<int> result = f.realize(256, 256, t);
+        for (int y = 0; y < result.height(); y++) {
+            for (int x = 0; x < result.width(); x++) {
+                int correct = (y * 3 + x) * 2;
+                if (result(x, y) != correct) {
+                    printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+        if (counter->count == 0) {
+            printf("The transposed read was not prefetched\n");
+            return -1;
+        }
+    }
+
+    {
+        // A dense read is left to the hardware prefetcher.
+        Func g("g");
+        g(x, y) = input(x, y) * 2;
+
+        CountPrefetches *counter = new CountPrefetches(input.name());
+        g.add_custom_lowering_pass(counter);
+        Buffer<int> result = g.realize(256, 256, t);
+        for (int y = 0; y < result.height(); y++) {
+            for (int x = 0; x < result.width(); x++) {
+                int correct = (x * 3 + y) * 2;
+                if (result(x, y) != correct) {
+                    printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+        if (counter->count != 0) {
+            printf("The dense read was not supposed to be prefetched\n");
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
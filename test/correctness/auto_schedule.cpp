@@ -0,0 +1,73 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+// Make a separable blur followed by a pointwise and a reduction stage.
+Func make_pipeline(Func &blur_x, Func &blur_y) {
+    Var x("x"), y("y");
+    Func in("in"), out("out");
+    in(x, y) = cast<float>(x + y * 3);
+    blur_x(x, y) = (in(x - 1, y) + in(x, y) + in(x + 1, y)) / 3;
+    blur_y(x, y) = (blur_x(x, y - 1) + blur_x(x, y) + blur_x(x, y + 1)) / 3;
+    RDom r(-2, 5);
+    out(x, y) = blur_y(x, y) * 2;
+    out(x, y) += blur_y(x + r, y);
+    return out;
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch != Target::X86 && target.arch != Target::ARM &&
+        target.arch != Target::POWERPC && target.arch != Target::MIPS) {
+        printf("auto_schedule only supports CPU targets. Skipping test.\n");
+        return 0;
+    }
+
+    const int W = 1024, H = 768;
+
+    // Make the pipeline to be scheduled first, so that its Funcs get
+    // the names asked for.
+    Func blur_x("blur_x"), blur_y("blur_y");
+    Func out = make_pipeline(blur_x, blur_y);
+    out.estimate(Var("x"), 0, W).estimate(Var("y"), 0, H);
+
+    Func ref_blur_x("ref_blur_x"), ref_blur_y("ref_blur_y");
+    Func ref = make_pipeline(ref_blur_x, ref_blur_y);
+    Buffer<float> correct = ref.realize(W, H, target);
+
+    Pipeline p(out);
+    std::string schedule = p.auto_schedule(target);
+    printf("%s", schedule.c_str());
+
+    // The cheap pointwise stage should be inlined, and the update
+    // stage of the output forces blur_y to be stored.
+    if (schedule.find("in\n") != std::string::npos ||
+        schedule.find("in.") != std::string::npos) {
+        printf("Expected the pointwise Func in to be inlined\n");
+        return -1;
+    }
+    if (schedule.find("blur_y") == std::string::npos) {
+        printf("Expected blur_y to be scheduled\n");
+        return -1;
+    }
+    if (schedule.find(".parallel(") == std::string::npos ||
+        schedule.find(".vectorize(") == std::string::npos) {
+        printf("Expected the schedule to parallelize and vectorize\n");
+        return -1;
+    }
+
+    Buffer<float> result = p.realize(W, H, target);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            if (result(x, y) != correct(x, y)) {
+                printf("result(%d, %d) = %f instead of %f\n",
+                       x, y, result(x, y), correct(x, y));
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
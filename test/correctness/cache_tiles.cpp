@@ -0,0 +1,87 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Check the extent of every loop with the given suffix.
+class CheckLoopExtent : public IRMutator {
+    std::string suffix;
+    int extent;
+
+    using IRMutator::visit;
+
+    void visit(const For *op) {
+        if (ends_with(op->name, suffix)) {
+            found = true;
+            if (!is_const(op->extent, extent)) {
+                printf("Loop %s has extent %s instead of %d\n",
+                       op->name.c_str(), print_expr(op->extent).c_str(), extent);
+                exit(-1);
+            }
+        }
+        IRMutator::visit(op);
+    }
+
+public:
+    bool found = false;
+    CheckLoopExtent(const std::string &s, int e) : suffix(s), extent(e) {}
+};
+
+int main(int argc, char **argv) {
+    {
+        // Cache sizes round trip through target strings.
+        Target t("x86-64-linux-sse41-l1_cache_32768-l2_cache_262144-llc_8388608-cores_4");
+        if (t.l1_cache_size != 32768 || t.l2_cache_size != 262144 ||
+            t.last_level_cache_size != 8388608 || t.cores != 4) {
+            printf("Failed to parse cache sizes from %s\n", t.to_string().c_str());
+            return -1;
+        }
+        if (Target(t.to_string()) != t) {
+            printf("Cache sizes did not round trip through %s\n", t.to_string().c_str());
+            return -1;
+        }
+        if (Target::validate_target_string("x86-64-linux-l2_cache_") ||
+            Target::validate_target_string("x86-64-linux-cores_x")) {
+            printf("Invalid cache sizes were accepted\n");
+            return -1;
+        }
+    }
+
+    {
+        // A tile that should fit in half of an 8k L1 cache. One 16x16
+        // tile touches 1024 bytes of output and 1088 bytes of input,
+        // and the next size up does not fit.
+        Var x("x"), y("y"), xo("xo"), yo("yo"), xi("xi"), yi("yi");
+        Func in("in"), f("f");
+        in(x, y) = x + y;
+        f(x, y) = in(x, y) + in(x + 1, y);
+        in.compute_root();
+        f.tile(x, y, xo, yo, xi, yi, CacheLevel::L1);
+
+        CheckLoopExtent *check_x = new CheckLoopExtent(".xi", 16);
+        CheckLoopExtent *check_y = new CheckLoopExtent(".yi", 16);
+        f.add_custom_lowering_pass(check_x);
+        f.add_custom_lowering_pass(check_y);
+
+        Target t = get_jit_target_from_environment();
+        t.l1_cache_size = 8192;
+        Buffer<int> result = f.realize(100, 100, t);
+        if (!check_x->found || !check_y->found) {
+            printf("Did not find the loops of the tile\n");
+            return -1;
+        }
+        for (int y = 0; y < result.height(); y++) {
+            for (int x = 0; x < result.width(); x++) {
+                int correct = 2 * (x + y) + 1;
+                if (result(x, y) != correct) {
+                    printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
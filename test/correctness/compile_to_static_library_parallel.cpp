@@ -0,0 +1,63 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+std::string read_file(const std::string &name) {
+    std::ifstream in(name, std::ios::binary);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+// A module holding several independent pipelines.
+Module make_module(const Target &target) {
+    Module result("compile_to_static_library_parallel", target);
+    for (int i = 0; i < 4; i++) {
+        Func f, g;
+        Var x, y;
+        f(x, y) = x + y * i;
+        g(x, y) = cast<float>(f(x, y) + f(x + 1, y));
+        f.compute_root();
+        g.vectorize(x, 8);
+        Module m = g.compile_to_module({}, "pipeline_" + std::to_string(i), target);
+        for (const auto &fn : m.functions()) {
+            result.append(fn);
+        }
+    }
+    return result;
+}
+
+int main(int argc, char **argv) {
+    Target target = get_host_target();
+
+#ifdef _MSC_VER
+    std::string lib = Internal::get_test_tmp_dir() + "compile_to_static_library_parallel.lib";
+#else
+    std::string lib = Internal::get_test_tmp_dir() + "compile_to_static_library_parallel.a";
+#endif
+
+    // Compile the same module twice. The functions are compiled in
+    // parallel, but the output should not depend on the order in
+    // which they finish.
+    Module m = make_module(target);
+    std::string contents[2];
+    for (int i = 0; i < 2; i++) {
+        Internal::ensure_no_file_exists(lib);
+        m.compile(Outputs().static_library(lib));
+        Internal::assert_file_exists(lib);
+        contents[i] = read_file(lib);
+    }
+
+    if (contents[0].empty() || contents[0] != contents[1]) {
+        printf("Static libraries differ across compilations of the same module\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Check that a Func has no loop of its own over a given dimension.
+class CheckNoLoop : public IRMutator {
+    std::string name;
+
+    using IRMutator::visit;
+
+    void visit(const For *op) {
+        if (op->name == name) {
+            printf("Found unexpected loop %s\n", op->name.c_str());
+            exit(-1);
+        }
+        IRMutator::visit(op);
+    }
+
+public:
+    CheckNoLoop(const std::string &n) : name(n) {}
+};
+
+int main(int argc, char **argv) {
+    Var x("x"), y("y");
+
+    {
+        // Two siblings reading the same input, fused one scanline at
+        // a time.
+        Func in("in"), f("f"), g("g"), out("out");
+        in(x, y) = x + y * 7;
+        f(x, y) = in(x, y) + 1;
+        g(x, y) = in(x, y) * 2;
+        out(x, y) = f(x, y) + g(x, y);
+
+        in.compute_root();
+        f.compute_root().vectorize(x, 8);
+        g.compute_with(f, y).vectorize(x, 8);
+        out.add_custom_lowering_pass(new CheckNoLoop(g.name() + ".s0.y"));
+
+        Buffer<int> result = out.realize(64, 32);
+        for (int y = 0; y < result.height(); y++) {
+            for (int x = 0; x < result.width(); x++) {
+                int i = x + y * 7;
+                int correct = (i + 1) + i * 2;
+                if (result(x, y) != correct) {
+                    printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    {
+        // Siblings required over different regions, fused with an
+        // update stage. The fused loop covers both regions.
+        Func f("f2"), g("g2"), out("out2");
+        RDom r(0, 3);
+        f(x, y) = x;
+        f(x, y) += y * r;
+        g(x, y) = x * y;
+        out(x, y) = f(x, y) + g(x + 1, y + 3);
+
+        f.compute_root();
+        f.update().reorder(r, x, y);
+        g.compute_with(f.update(0), y);
+        out.add_custom_lowering_pass(new CheckNoLoop(g.name() + ".s0.y"));
+
+        Buffer<int> result = out.realize(32, 32);
+        for (int y = 0; y < result.height(); y++) {
+            for (int x = 0; x < result.width(); x++) {
+                int correct = (x + y * 3) + (x + 1) * (y + 3);
+                if (result(x, y) != correct) {
+                    printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+using namespace Halide;
+
+#ifndef _WIN32
+int count_cache_entries(const std::string &dir) {
+    int count = 0;
+    DIR *d = opendir(dir.c_str());
+    if (!d) return 0;
+    while (struct dirent *e = readdir(d)) {
+        size_t len = strlen(e->d_name);
+        if (len > 4 && strcmp(e->d_name + len - 4, ".hjc") == 0) {
+            count++;
+        }
+    }
+    closedir(d);
+    return count;
+}
+
+Module make_module(float scale) {
+    Func f("f"), g("g");
+    Var x("x"), y("y");
+    f(x, y) = cast<float>(x + y);
+    g(x, y) = f(x, y) * scale + f(x + 1, y);
+    f.compute_at(g, y);
+    g.vectorize(x, 4);
+
+    Target target = get_jit_target_from_environment().with_feature(Target::JIT);
+    return g.compile_to_module({}, "jit_cache_g", target);
+}
+
+// JIT-compile a module and check its output.
+int run(const Module &m, float scale) {
+    Internal::JITModule jit_module(m, m.get_function_by_name("jit_cache_g"));
+    auto main_function = (int (*)(halide_buffer_t *buf))jit_module.main_function();
+
+    Buffer<float> out(32, 32);
+    if (main_function(out.raw_buffer()) != 0) {
+        printf("Pipeline failed\n");
+        return -1;
+    }
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            float correct = (x + y) * scale + (x + y + 1);
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+#endif
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Skipping test on Windows.\n");
+    return 0;
+#else
+    std::string cache_dir = Internal::dir_make_temp();
+    setenv("HL_JIT_CACHE_DIR", cache_dir.c_str(), 1);
+
+    // The first compilation populates the cache.
+    Module m = make_module(2.0f);
+    if (run(m, 2.0f) != 0) return -1;
+    if (count_cache_entries(cache_dir) != 1) {
+        printf("Expected one cache entry after the first compilation\n");
+        return -1;
+    }
+
+    // Compiling the same lowered code again loads it from the cache,
+    // as a later process would.
+    if (run(m, 2.0f) != 0) return -1;
+    if (count_cache_entries(cache_dir) != 1) {
+        printf("Expected the same module to reuse its cache entry\n");
+        return -1;
+    }
+
+    // A module that differs only in a constant gets its own entry.
+    const float other_scale = 2.0000002f;
+    Module other = make_module(other_scale);
+    if (run(other, other_scale) != 0) return -1;
+    if (count_cache_entries(cache_dir) != 2) {
+        printf("Expected a different module to add a cache entry\n");
+        return -1;
+    }
+
+    unsetenv("HL_JIT_CACHE_DIR");
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,54 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int check(Pipeline p) {
+    Buffer<int> result = p.realize(64, 64);
+    for (int y = 0; y < result.height(); y++) {
+        for (int x = 0; x < result.width(); x++) {
+            int correct = (x + y) * 2 + (x + 1 + y);
+            if (result(x, y) != correct) {
+                printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Var x("x"), y("y");
+    Func f("f"), g("g");
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) * 2 + f(x + 1, y);
+
+    Pipeline p(g);
+
+    f.compute_root();
+    void *root = p.compile_jit();
+    if (check(p) != 0) return -1;
+
+    p.invalidate_cache();
+    f.compute_at(g, y);
+    void *at_y = p.compile_jit();
+    if (check(p) != 0) return -1;
+    if (at_y == root) {
+        printf("Changing the schedule did not recompile the pipeline\n");
+        return -1;
+    }
+
+    // Going back to the first schedule should reuse the code compiled
+    // for it.
+    p.invalidate_cache();
+    f.compute_root();
+    void *root_again = p.compile_jit();
+    if (check(p) != 0) return -1;
+    if (root_again != root) {
+        printf("The pipeline was compiled again for a schedule it was already compiled for\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Count the loops over a given variable in the lowered code.
+class CountLoops : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const For *op) {
+        if (op->name == name) {
+            count++;
+        }
+        IRMutator::visit(op);
+    }
+
+public:
+    std::string name;
+    int count = 0;
+    CountLoops(const std::string &n) : name(n) {}
+};
+
+// Record the condition of the outermost if statement that depends on
+// the named variable.
+class FirstCondition : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const IfThenElse *op) {
+        if (!condition.defined() && expr_uses_var(op->condition, name)) {
+            condition = op->condition;
+        }
+        IRMutator::visit(op);
+    }
+
+public:
+    std::string name;
+    Expr condition;
+    FirstCondition(const std::string &n) : name(n) {}
+};
+
+Var x("x"), y("y");
+
+// A pipeline with a boundary condition on a loop that only runs a
+// few iterations.
+Func boundary_pipeline(Buffer<int> in) {
+    Func clamped = BoundaryConditions::repeat_edge(in);
+    Func g("g");
+    g(x, y) = clamped(x - 1) + clamped(x + 1) + y;
+    return g;
+}
+
+// A pipeline with two specializations.
+Func specialized_pipeline(Param<int> p) {
+    Func h("h");
+    h(x) = x * p;
+    h.specialize(p == 0);
+    h.specialize(p == 1);
+    return h;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Skipping test on Windows.\n");
+    return 0;
+#else
+    std::string profile_file = Internal::get_test_tmp_dir() + "loop_profile.txt";
+    Internal::ensure_no_file_exists(profile_file);
+    setenv("HL_LOOP_PROFILE_FILE", profile_file.c_str(), 1);
+
+    Target t = get_jit_target_from_environment();
+
+    Buffer<int> in(16);
+    in.for_each_element([&](int x) {
+        in(x) = x * 3;
+    });
+
+    // Without a profile, the loop over x is partitioned.
+    int unprofiled_loops = 0;
+    {
+        Func g = boundary_pipeline(in);
+        CountLoops *counter = new CountLoops("g.s0.x");
+        g.add_custom_lowering_pass(counter);
+        g.compile_jit(t);
+        unprofiled_loops = counter->count;
+        if (unprofiled_loops < 2) {
+            printf("Expected the loop over g.s0.x to be partitioned\n");
+            return -1;
+        }
+    }
+
+    // Count the loops and specializations.
+    {
+        Func g = boundary_pipeline(in);
+        g.realize(3, 5, t.with_feature(Target::ProfileLoops));
+
+        Param<int> p("p");
+        Func h = specialized_pipeline(p);
+        Target ht = t.with_feature(Target::ProfileLoops);
+        p.set(0);
+        h.realize(8, ht);
+        p.set(1);
+        for (int i = 0; i < 3; i++) {
+            h.realize(8, ht);
+        }
+    }
+
+    // HL_LOOP_PROFILE_FILE stays set until exit, because the runtime
+    // writes the counts out again when the process exits.
+
+    Internal::assert_file_exists(profile_file);
+    if (!load_loop_profile(profile_file)) {
+        printf("Could not load %s\n", profile_file.c_str());
+        return -1;
+    }
+
+    struct {
+        const char *pipeline, *name;
+        uint64_t entries, iterations;
+    } expected[] = {
+        {"g", "g.s0.y", 1, 5},
+        {"g", "g.s0.x", 5, 15},
+        {"h", "h.s0.specialization.0", 1, 1},
+        {"h", "h.s0.specialization.1", 3, 3},
+    };
+    for (const auto &e : expected) {
+        LoopProfile profile;
+        if (!find_loop_profile(e.pipeline, e.name, &profile)) {
+            printf("No counts for %s in %s\n", e.name, e.pipeline);
+            return -1;
+        }
+        if (profile.entries != e.entries || profile.iterations != e.iterations) {
+            printf("Counts for %s are %d %d instead of %d %d\n", e.name,
+                   (int)profile.entries, (int)profile.iterations,
+                   (int)e.entries, (int)e.iterations);
+            return -1;
+        }
+    }
+
+    // With the profile, the short loop isn't partitioned, and the
+    // result is still right.
+    {
+        Func g = boundary_pipeline(in);
+        CountLoops *counter = new CountLoops("g.s0.x");
+        g.add_custom_lowering_pass(counter);
+        Buffer<int> result = g.realize(3, 5, t);
+        if (counter->count != 1) {
+            printf("The short loop over g.s0.x was partitioned into %d loops\n", counter->count);
+            return -1;
+        }
+        for (int y = 0; y < result.height(); y++) {
+            for (int x = 0; x < result.width(); x++) {
+                int correct = in(std::max(x - 1, 0)) + in(std::min(x + 1, 15)) + y;
+                if (result(x, y) != correct) {
+                    printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // With the profile, the most frequently taken specialization goes
+    // first.
+    {
+        Param<int> p("p");
+        Func h = specialized_pipeline(p);
+        FirstCondition *first = new FirstCondition(p.name());
+        h.add_custom_lowering_pass(first);
+        p.set(1);
+        Buffer<int> result = h.realize(8, t);
+        if (!first->condition.defined() || !equal(first->condition, Expr(p) == 1)) {
+            printf("Expected the specialization for p == 1 to be tried first\n");
+            return -1;
+        }
+        for (int x = 0; x < result.width(); x++) {
+            if (result(x) != x) {
+                printf("result(%d) = %d instead of %d\n", x, result(x), x);
+                return -1;
+            }
+        }
+    }
+
+    clear_loop_profiles();
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,113 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Count the lookups turned into shuffles.
+class CountShuffles : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const Call *op) {
+        if (op->is_intrinsic("dynamic_shuffle")) {
+            count++;
+        }
+        IRMutator::visit(op);
+    }
+
+public:
+    int count = 0;
+};
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    // The targets with a table lookup instruction for 8-bit tables
+    // of 16 entries.
+    bool expect_shuffles = ((t.arch == Target::X86 && t.has_feature(Target::SSE41)) ||
+                            (t.arch == Target::ARM && !t.has_feature(Target::NoNEON)));
+
+    Var x("x");
+
+    Buffer<uint8_t> input(1024);
+    input.for_each_element([&](int x) {
+        input(x) = (uint8_t)(x * 37 + 11);
+    });
+
+    {
+        // A lookup in a table embedded in the pipeline.
+        Buffer<uint8_t> table(16);
+        table.for_each_element([&](int x) {
+            table(x) = (uint8_t)(x * x + 3);
+        });
+
+        Func f("f");
+        f(x) = table(input(x) % 16);
+        f.vectorize(x, 32);
+
+        CountShuffles *counter = new CountShuffles;
+        f.add_custom_lowering_pass(counter);
+        Buffer<uint8_t> result = f.realize(1024, t);
+        for (int x = 0; x < result.width(); x++) {
+            uint8_t correct = table(input(x) % 16);
+            if (result(x) != correct) {
+                printf("result(%d) = %d instead of %d\n", x, result(x), correct);
+                return -1;
+            }
+        }
+        if (expect_shuffles && counter->count == 0) {
+            printf("The lookup in the embedded table was not turned into a shuffle\n");
+            return -1;
+        }
+    }
+
+    {
+        // A lookup in a table computed by the pipeline, indexed by a
+        // clamped value.
+        Func curve("curve"), g("g");
+        curve(x) = cast<uint8_t>(255 - x * 17);
+        g(x) = curve(clamp(input(x), 2, 13));
+        curve.compute_root().bound(x, 0, 16);
+        g.vectorize(x, 16);
+
+        CountShuffles *counter = new CountShuffles;
+        g.add_custom_lowering_pass(counter);
+        Buffer<uint8_t> result = g.realize(1024, t);
+        for (int x = 0; x < result.width(); x++) {
+            int i = std::min(std::max((int)input(x), 2), 13);
+            uint8_t correct = (uint8_t)(255 - i * 17);
+            if (result(x) != correct) {
+                printf("result(%d) = %d instead of %d\n", x, result(x), correct);
+                return -1;
+            }
+        }
+        if (expect_shuffles && counter->count == 0) {
+            printf("The lookup in the computed table was not turned into a shuffle\n");
+            return -1;
+        }
+    }
+
+    {
+        // A table too large to look up in registers still gives the
+        // right answer.
+        Buffer<uint8_t> table(256);
+        table.for_each_element([&](int x) {
+            table(x) = (uint8_t)(x ^ 0x5a);
+        });
+
+        Func h("h");
+        h(x) = table(input(x));
+        h.vectorize(x, 16);
+
+        Buffer<uint8_t> result = h.realize(1024, t);
+        for (int x = 0; x < result.width(); x++) {
+            uint8_t correct = table(input(x));
+            if (result(x) != correct) {
+                printf("result(%d) = %d instead of %d\n", x, result(x), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Count the loops over a variable, and the if statements inside them
+// that depend on it.
+class CountPartitions : public IRMutator {
+    using IRMutator::visit;
+
+    int loop_depth = 0;
+
+    void visit(const For *op) {
+        if (op->name == name) {
+            loops++;
+            loop_depth++;
+            IRMutator::visit(op);
+            loop_depth--;
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+    void visit(const IfThenElse *op) {
+        if (loop_depth > 0 && expr_uses_var(op->condition, name)) {
+            ifs++;
+        }
+        IRMutator::visit(op);
+    }
+
+public:
+    std::string name;
+    int loops = 0, ifs = 0;
+    CountPartitions(const std::string &n) : name(n) {}
+};
+
+int check(Buffer<int> in, Target t, int expected_loops, int expected_ifs) {
+    Var x("x"), y("y");
+    Func clamped = BoundaryConditions::repeat_edge(in);
+    Func g("g");
+    g(x, y) = clamped(x - 1) + clamped(x + 1) * 2 + y;
+
+    CountPartitions *counter = new CountPartitions("g.s0.x");
+    g.add_custom_lowering_pass(counter);
+    Buffer<int> result = g.realize(in.width(), 5, t);
+
+    for (int y = 0; y < result.height(); y++) {
+        for (int x = 0; x < result.width(); x++) {
+            int xm = std::max(x - 1, 0), xp = std::min(x + 1, in.width() - 1);
+            int correct = in(xm) + in(xp) * 2 + y;
+            if (result(x, y) != correct) {
+                printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    if (counter->loops != expected_loops || counter->ifs != expected_ifs) {
+        printf("Expected %d loops over g.s0.x with %d boundary ifs, got %d loops with %d ifs\n",
+               expected_loops, expected_ifs, counter->loops, counter->ifs);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Skipping test on Windows.\n");
+    return 0;
+#else
+    Buffer<int> in(37);
+    in.for_each_element([&](int x) {
+        in(x) = x * 7 + 3;
+    });
+
+    Target t = get_jit_target_from_environment();
+
+    // By default, the loop is split into a prologue, a steady state
+    // and an epilogue.
+    if (check(in, t, 3, 0) != 0) {
+        return -1;
+    }
+
+    // When partitioning for size, the prologue and epilogue share one
+    // body, selected by an if in a single loop.
+    Target small = t.with_feature(Target::PartitionForSize);
+    if (check(in, small, 1, 1) != 0) {
+        return -1;
+    }
+
+    // A budget too small for any partitioning leaves the loop alone.
+    setenv("HL_PARTITION_BUDGET", "1", 1);
+    int result = check(in, small, 1, 0);
+    unsetenv("HL_PARTITION_BUDGET");
+    if (result != 0) {
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,95 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <atomic>
+
+using namespace Halide;
+
+std::atomic<int> malloc_count;
+std::atomic<int> free_count;
+
+void *my_malloc(void *user_context, size_t x) {
+    malloc_count++;
+    void *orig = malloc(x+32);
+    void *ptr = (void *)((((size_t)orig + 32) >> 5) << 5);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(void *user_context, void *ptr) {
+    free_count++;
+    free(((void**)ptr)[-1]);
+}
+
+int main(int argc, char **argv) {
+    Var x("x"), y("y");
+    const int tasks = 1024;
+
+    {
+        // Two intermediates too large for the stack, computed per
+        // task. Without arenas this is two mallocs per task.
+        Func f("f"), g("g"), h("h");
+        f(x, y) = x + y;
+        g(x, y) = f(x, y) * 2;
+        h(x, y) = g(x, y) + f(x, y);
+        f.compute_at(h, y);
+        g.compute_at(h, y);
+        h.parallel(y);
+
+        malloc_count = 0;
+        free_count = 0;
+        h.set_custom_allocator(&my_malloc, &my_free);
+        Buffer<int> result = h.realize(8192, tasks);
+        for (int y = 0; y < result.height(); y++) {
+            for (int x = 0; x < result.width(); x++) {
+                int correct = 3 * (x + y);
+                if (result(x, y) != correct) {
+                    printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+
+        if (malloc_count >= tasks / 2) {
+            printf("There were %d calls to malloc for %d tasks\n", (int)malloc_count, tasks);
+            return -1;
+        }
+        if (malloc_count != free_count) {
+            printf("There were %d calls to malloc but %d calls to free\n",
+                   (int)malloc_count, (int)free_count);
+            return -1;
+        }
+    }
+
+    {
+        // An intermediate with a size that varies from task to task,
+        // so the arenas have to grow.
+        Func f("f"), g("g");
+        f(x, y) = x * y;
+        g(x, y) = f(x * (y % 4 + 1), y);
+        f.compute_at(g, y);
+        g.parallel(y);
+
+        malloc_count = 0;
+        free_count = 0;
+        g.set_custom_allocator(&my_malloc, &my_free);
+        Buffer<int> result = g.realize(8192, 256);
+        for (int y = 0; y < result.height(); y++) {
+            for (int x = 0; x < result.width(); x++) {
+                int correct = x * (y % 4 + 1) * y;
+                if (result(x, y) != correct) {
+                    printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+
+        if (malloc_count != free_count) {
+            printf("There were %d calls to malloc but %d calls to free\n",
+                   (int)malloc_count, (int)free_count);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -113,6 +113,38 @@ int vectorized_predicated_store_scalarized_predicated_load_test() {
     return 0;
 }
 
+int vectorized_narrow_type_tail_test() {
+    Var x("x"), y("y");
+    Func f("f"), g("g");
+
+    g(x, y) = cast<uint8_t>(x + y);
+    g.compute_root();
+
+    f(x, y) = g(x, y) * 3;
+
+    // With AVX512BW, the tail of a loop over 8-bit values is done
+    // with masked loads and stores instead of scalar code.
+    Target target = get_jit_target_from_environment();
+    f.vectorize(x, 64, TailStrategy::GuardWithIf);
+    if (target.arch == Target::X86 &&
+        (target.has_feature(Target::AVX512_Skylake) ||
+         target.has_feature(Target::AVX512_Cannonlake))) {
+        f.add_custom_lowering_pass(new CheckPredicatedStoreLoad(true, true));
+    }
+
+    Buffer<uint8_t> im = f.realize(100, 10);
+    for (int y = 0; y < im.height(); y++) {
+        for (int x = 0; x < im.width(); x++) {
+            uint8_t correct = (uint8_t)((x + y) * 3);
+            if (im(x, y) != correct) {
+                printf("im(%d, %d) = %d instead of %d\n", x, y, im(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
 int vectorized_dense_load_with_stride_minus_one_test() {
     int size = 73;
     Var x("x"), y("y");
@@ -434,6 +466,11 @@ int main(int argc, char **argv) {
         return -1;
     }
 
+    printf("Running vectorized narrow type tail test\n");
+    if (vectorized_narrow_type_tail_test() != 0) {
+        return -1;
+    }
+
     printf("Success!\n");
     return 0;
 }
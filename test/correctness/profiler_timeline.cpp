@@ -0,0 +1,62 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+void my_print(void *, const char *msg) {
+    // Silence the profiler report.
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Skipping test on Windows.\n");
+    return 0;
+#else
+    std::string timeline_file = Internal::get_test_tmp_dir() + "profiler_timeline.json";
+    Internal::ensure_no_file_exists(timeline_file);
+    setenv("HL_TIMELINE_FILE", timeline_file.c_str(), 1);
+
+    Func f("f"), g("g");
+    Var x, y;
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+
+    f.compute_at(g, y);
+    g.parallel(y);
+    g.set_custom_print(&my_print);
+
+    Target t = get_jit_target_from_environment().with_feature(Target::ProfileTimeline);
+    Buffer<int> out = g.realize(64, 16, t);
+
+    unsetenv("HL_TIMELINE_FILE");
+
+    Internal::assert_file_exists(timeline_file);
+    std::ifstream in(timeline_file);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    std::string json = contents.str();
+
+    const char *expected[] = {
+        "{\"traceEvents\":[",
+        "\"cat\":\"pipeline\"",
+        "\"name\":\"f\",\"cat\":\"produce\",\"ph\":\"B\"",
+        "\"name\":\"f\",\"cat\":\"produce\",\"ph\":\"E\"",
+        "\"cat\":\"task\"",
+        "\"task\":15",
+    };
+    for (const char *e : expected) {
+        if (json.find(e) == std::string::npos) {
+            printf("Did not find %s in timeline:\n%s\n", e, json.c_str());
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
@@ -447,6 +447,8 @@ struct Test {
                 check("pabsb", 8*w, abs(i8_1));
                 check("pabsw", 4*w, abs(i16_1));
                 check("pabsd", 2*w, abs(i32_1));
+                check("pmulhrsw", 4*w, i16((i32(i16_1) * i32(i16_2) + 16384) / 32768));
+                check("pmaddubsw", 4*w, i16_sat(i32(u8_1) * i32(i8_2) + i32(u8_2) * i32(i8_3)));
             }
         }
 
@@ -632,6 +634,12 @@ struct Test {
             check("vpcmpeqq" YMM, 4, select(i64_1 == i64_2, i64(1), i64(2)));
             check("vpackusdw", 16, u16(clamp(i32_1, 0, max_u16)));
             check("vpcmpgtq" YMM, 4, select(i64_1 > i64_2, i64(1), i64(2)));
+
+            // Loads at data-dependent indices
+            #if LLVM_VERSION >= 60
+            check("vpgatherdd", 8, in_i32(i32(u8_1)));
+            check("vgatherdps", 8, in_f32(i32(u8_1)));
+            #endif
         }
 
         if (use_avx512) {
@@ -1217,9 +1225,14 @@ struct Test {
 
             // VRSHL    I       -       Rounding Shift Left
             // VRSHR    I       -       Rounding Shift Right
-            // VRSHRN   I       -       Rounding Shift Right Narrow
             // We use the non-rounding forms of these
 
+            // VRSHRN   I       -       Rounding Shift Right Narrow
+            check(arm32 ? "vrshrn.i16" : "rshrn", 8*w,  i8((i16_1 + 8)/16));
+            check(arm32 ? "vrshrn.i32" : "rshrn", 4*w, i16((i32_1 + 8)/16));
+            check(arm32 ? "vrshrn.i16" : "rshrn", 8*w,  u8((u16_1 + 128)/256));
+            check(arm32 ? "vrshrn.i32" : "rshrn", 4*w, u16((u32_1 + 32768)/65536));
+
             // VRSQRTE  I, F    -       Reciprocal Square Root Estimate
             check(arm32 ? "vrsqrte.f32" : "frsqrte", 4*w, fast_inverse_sqrt(f32_1));
 
@@ -0,0 +1,109 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Count the number of times the pipeline is lowered, and record
+// whether the extent of the reduction was a constant.
+class CountLowerings : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const For *op) {
+        if (ends_with(op->name, ".r$x")) {
+            constant_extent = is_const(op->extent);
+        }
+        IRMutator::visit(op);
+    }
+
+public:
+    int count = 0;
+    bool constant_extent = false;
+
+    Stmt mutate(const Stmt &s) {
+        count++;
+        return IRMutator::mutate(s);
+    }
+};
+
+int check(Buffer<int> result, int n) {
+    for (int x = 0; x < result.width(); x++) {
+        int correct = n * x + n * (n - 1) / 2;
+        if (result(x) != correct) {
+            printf("result(%d) = %d instead of %d\n", x, result(x), correct);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Var x("x");
+    Param<int> n("n");
+    RDom r(0, n, "r");
+
+    {
+        // A specialization is compiled once the same values have been
+        // seen four times.
+        Func f("f");
+        f(x) = 0;
+        f(x) += x + r;
+
+        CountLowerings *counter = new CountLowerings;
+        f.add_custom_lowering_pass(counter);
+        f.specialize_on_demand(4, 8);
+
+        n.set(3);
+        for (int i = 0; i < 6; i++) {
+            if (check(f.realize(100), 3) != 0) {
+                return -1;
+            }
+            int expected = i < 3 ? 1 : 2;
+            if (counter->count != expected) {
+                printf("After %d calls, the pipeline was lowered %d times instead of %d\n",
+                       i + 1, counter->count, expected);
+                return -1;
+            }
+        }
+        if (!counter->constant_extent) {
+            printf("The specialization did not have a constant reduction extent\n");
+            return -1;
+        }
+
+        // Different values, and a different output size, use the
+        // generic code until they become hot.
+        n.set(5);
+        if (check(f.realize(100), 5) != 0 || check(f.realize(50), 3) != 0) {
+            return -1;
+        }
+        if (counter->count != 2) {
+            printf("Lowered a specialization for values that were not hot\n");
+            return -1;
+        }
+    }
+
+    {
+        // At most two specializations are compiled.
+        Func f("g");
+        f(x) = 0;
+        f(x) += x + r;
+
+        CountLowerings *counter = new CountLowerings;
+        f.add_custom_lowering_pass(counter);
+        f.specialize_on_demand(1, 2);
+
+        for (int i = 1; i <= 4; i++) {
+            n.set(i);
+            if (check(f.realize(100), i) != 0) {
+                return -1;
+            }
+        }
+        if (counter->count != 3) {
+            printf("Lowered %d times instead of 3\n", counter->count);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
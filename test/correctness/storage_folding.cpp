@@ -324,6 +324,74 @@ int main(int argc, char **argv) {
         }
     }
 
+    {
+        custom_malloc_size = 0;
+        Func f, g;
+
+        f(x, y, c) = x + y + c;
+        g(x, c) = f(x, x, c) + f(x+1, x+1, c);
+
+        // Each instance of g uses a 2x2 box of f that moves along the
+        // diagonal, with an overlap from one instance to the next. We
+        // should be able to fold both x and y.
+        g.reorder(c, x);
+        f.store_root().compute_at(g, x);
+
+        g.set_custom_allocator(my_malloc, my_free);
+
+        Buffer<int> im = g.realize(100, 1000);
+
+        size_t expected_size = 2*2*1000*sizeof(int) + sizeof(int);
+        if (custom_malloc_size == 0 || custom_malloc_size != expected_size) {
+            printf("Scratch space allocated was %d instead of %d\n", (int)custom_malloc_size, (int)expected_size);
+            return -1;
+        }
+
+        for (int c = 0; c < im.height(); c++) {
+            for (int x = 0; x < im.width(); x++) {
+                int correct = (2*x + c) + (2*x + 2 + c);
+                if (im(x, c) != correct) {
+                    printf("im(%d, %d) = %d instead of %d\n", x, c, im(x, c), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    {
+        custom_malloc_size = 0;
+        Func f, g;
+
+        f(x, y) = x + y;
+        f(x, y) *= 2;
+        g(x, y) = f(x, (y * 7) % 16);
+
+        // The scanline of f used by each scanline of g jumps around,
+        // but is computed along with it, so we should be able to fold
+        // f down to a single scanline even though it has an update.
+        f.store_root().compute_at(g, y);
+
+        g.set_custom_allocator(my_malloc, my_free);
+
+        Buffer<int> im = g.realize(1000, 100);
+
+        size_t expected_size = 1000*sizeof(int) + sizeof(int);
+        if (custom_malloc_size == 0 || custom_malloc_size != expected_size) {
+            printf("Scratch space allocated was %d instead of %d\n", (int)custom_malloc_size, (int)expected_size);
+            return -1;
+        }
+
+        for (int y = 0; y < im.height(); y++) {
+            for (int x = 0; x < im.width(); x++) {
+                int correct = (x + (y * 7) % 16) * 2;
+                if (im(x, y) != correct) {
+                    printf("im(%d, %d) = %d instead of %d\n", x, y, im(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
     printf("Success!\n");
     return 0;
 }
@@ -0,0 +1,115 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int mallocs = 0;
+
+void *my_malloc(void *user_context, size_t x) {
+    mallocs++;
+    void *orig = malloc(x+32);
+    void *ptr = (void *)((((size_t)orig + 32) >> 5) << 5);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(void *user_context, void *ptr) {
+    free(((void**)ptr)[-1]);
+}
+
+int check(Buffer<int> result) {
+    for (int y = 0; y < result.height(); y++) {
+        for (int x = 0; x < result.width(); x++) {
+            int correct = 2 * (x + y) + 1;
+            if (result(x, y) != correct) {
+                printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Var x("x"), y("y"), xo("xo"), xi("xi");
+
+    {
+        // A small Func that would otherwise go on the stack, forced
+        // onto the heap.
+        Func f("f"), g("g");
+        f(x, y) = x + y;
+        g(x, y) = f(x, y) + f(x, y) + 1;
+        f.compute_at(g, y).store_in(MemoryType::Heap);
+
+        mallocs = 0;
+        g.set_custom_allocator(&my_malloc, &my_free);
+        if (check(g.realize(64, 16)) != 0) {
+            return -1;
+        }
+        if (mallocs != 16) {
+            printf("Expected 16 heap allocations, got %d\n", mallocs);
+            return -1;
+        }
+    }
+
+    {
+        // A Func too large for the default stack allocation limit,
+        // forced onto the stack.
+        Func f("f"), g("g");
+        f(x, y) = x + y;
+        g(x, y) = f(x, y) + f(x, y) + 1;
+        f.compute_at(g, y).bound_extent(x, 8192).store_in(MemoryType::Stack);
+
+        mallocs = 0;
+        g.set_custom_allocator(&my_malloc, &my_free);
+        if (check(g.realize(8192, 4)) != 0) {
+            return -1;
+        }
+        if (mallocs != 0) {
+            printf("There was not supposed to be a heap allocation\n");
+            return -1;
+        }
+    }
+
+    {
+        // A Func kept in registers. The loops over it are fully
+        // unrolled, so every access is at a constant index.
+        Func f("f"), g("g");
+        f(x) = x;
+        g(x, y) = f(x % 4) * 2 + (x / 4) * 8 + 2 * y + 1;
+        g.split(x, xo, xi, 4).unroll(xi);
+        f.compute_at(g, y).bound(x, 0, 4).unroll(x).store_in(MemoryType::Register);
+
+        mallocs = 0;
+        g.set_custom_allocator(&my_malloc, &my_free);
+        if (check(g.realize(64, 16)) != 0) {
+            return -1;
+        }
+        if (mallocs != 0) {
+            printf("There was not supposed to be a heap allocation\n");
+            return -1;
+        }
+    }
+
+    {
+        // Fast scratch memory falls back to the heap allocator by
+        // default.
+        Func f("f"), g("g");
+        f(x, y) = x + y;
+        g(x, y) = f(x, y) + f(x, y) + 1;
+        f.compute_at(g, y).store_in(MemoryType::LockedCache);
+
+        mallocs = 0;
+        g.set_custom_allocator(&my_malloc, &my_free);
+        if (check(g.realize(64, 16)) != 0) {
+            return -1;
+        }
+        if (mallocs != 16) {
+            printf("Expected 16 locked cache allocations, got %d\n", mallocs);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
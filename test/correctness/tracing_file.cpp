@@ -0,0 +1,94 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Skipping test on Windows.\n");
+    return 0;
+#else
+    std::string trace_file = Internal::get_test_tmp_dir() + "tracing_file.bin";
+    Internal::ensure_no_file_exists(trace_file);
+
+    // Only keep stores and productions of g. The filters are read
+    // the first time anything is traced.
+    setenv("HL_TRACE_FILE", trace_file.c_str(), 1);
+    setenv("HL_TRACE_FUNCS", "g", 1);
+    setenv("HL_TRACE_EVENTS", "store,produce", 1);
+
+    Func f("f"), g("g");
+    Var x, y;
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) * 2;
+
+    f.compute_root().trace_stores().trace_realizations();
+    g.trace_stores().trace_realizations();
+
+    const int W = 100, H = 100;
+    Buffer<int> out = g.realize(W, H);
+
+    unsetenv("HL_TRACE_FILE");
+    unsetenv("HL_TRACE_FUNCS");
+    unsetenv("HL_TRACE_EVENTS");
+
+    // The trace is flushed at the end of each pipeline.
+    FILE *file = fopen(trace_file.c_str(), "rb");
+    if (!file) {
+        printf("Could not open %s\n", trace_file.c_str());
+        return -1;
+    }
+    std::vector<uint8_t> bytes;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        bytes.insert(bytes.end(), chunk, chunk + n);
+    }
+    fclose(file);
+
+    int stores = 0, produces = 0;
+    size_t offset = 0;
+    while (offset < bytes.size()) {
+        const halide_trace_packet_t *p = (const halide_trace_packet_t *)(&bytes[offset]);
+        if (p->size == 0 || offset + p->size > bytes.size()) {
+            printf("Malformed packet at offset %d\n", (int)offset);
+            return -1;
+        }
+        if (strcmp(p->func(), "g") != 0) {
+            printf("Unexpected packet for Func %s\n", p->func());
+            return -1;
+        }
+        if (p->event == halide_trace_store) {
+            const int *coords = p->coordinates();
+            int value = *(const int *)(p->value());
+            if (value != (coords[0] + coords[1]) * 2) {
+                printf("g(%d, %d) = %d instead of %d\n",
+                       coords[0], coords[1], value, (coords[0] + coords[1]) * 2);
+                return -1;
+            }
+            stores++;
+        } else if (p->event == halide_trace_produce ||
+                   p->event == halide_trace_end_produce) {
+            produces++;
+        } else {
+            printf("Unexpected event %d\n", (int)p->event);
+            return -1;
+        }
+        offset += p->size;
+    }
+
+    if (stores != W * H || produces != 2) {
+        printf("Saw %d stores and %d produce events. Expected %d and 2\n",
+               stores, produces, W * H);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,53 @@
+#include "Halide.h"
+#include <fstream>
+#include <stdio.h>
+
+#include "test/common/halide_test_dirs.h"
+
+using namespace Halide;
+
+// A vectorized store to data-dependent addresses should be a scatter
+// on AVX-512, and should store the same values as a scalar loop.
+int main(int argc, char **argv) {
+    const int size = 64;
+    Buffer<int> perm(size), values(size);
+    for (int i = 0; i < size; i++) {
+        // A permutation, so no two lanes store to the same place.
+        perm(i) = (i * 37 + 11) % size;
+        values(i) = i * 3 + 1;
+    }
+
+    Var x;
+    RDom r(0, size);
+    Func f("f");
+    f(x) = 0;
+    f(clamp(perm(r), 0, size - 1)) = values(r);
+    f.update().allow_race_conditions().vectorize(r, 16);
+
+    // Look for the scatter in code for an AVX-512 target, whether
+    // or not the host has AVX-512.
+    std::string asm_filename = Internal::get_test_tmp_dir() + "x86_scatter.s";
+    f.compile_to_assembly(asm_filename, {}, Target("x86-64-linux-avx512_skylake"));
+    std::ifstream asm_file(asm_filename);
+    std::string line;
+    bool found_scatter = false;
+    while (std::getline(asm_file, line)) {
+        found_scatter |= line.find("vpscatterdd") != std::string::npos;
+    }
+    if (!found_scatter) {
+        printf("No vpscatterdd in %s\n", asm_filename.c_str());
+        return -1;
+    }
+
+    // Run it on the host.
+    Buffer<int> out = f.realize(size);
+    for (int i = 0; i < size; i++) {
+        if (out(perm(i)) != values(i)) {
+            printf("out(%d) = %d instead of %d\n", perm(i), out(perm(i)), values(i));
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+#include "pipeline_instance.h"
+
+using namespace Halide::Runtime;
+
+static int malloc_count = 0;
+static size_t largest_malloc = 0;
+
+void *my_halide_malloc(void *user_context, size_t x) {
+    malloc_count++;
+    if (x > largest_malloc) {
+        largest_malloc = x;
+    }
+    void *orig = malloc(x + 128);
+    void *ptr = (void *)((((size_t)orig + 128) >> 7) << 7);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_halide_free(void *user_context, void *ptr) {
+    free(((void **)ptr)[-1]);
+}
+
+static int extern_calls = 0;
+
+extern "C" int pipeline_instance_copy(halide_buffer_t *in, halide_buffer_t *out) {
+    if (in->host == nullptr) {
+        // A bounds query. The same region of the input is needed.
+        for (int i = 0; i < 2; i++) {
+            in->dim[i].min = out->dim[i].min;
+            in->dim[i].extent = out->dim[i].extent;
+        }
+        return 0;
+    }
+    extern_calls++;
+    Buffer<int> input(*in), output(*out);
+    output.for_each_element([&](int x, int y) {
+        output(x, y) = input(x, y);
+    });
+    return 0;
+}
+
+int check(const Buffer<int> &output) {
+    for (int y = 0; y < output.height(); y++) {
+        for (int x = 0; x < output.width(); x++) {
+            int correct = 2 * (x + y) + 2 * (x + 1 + y) + 1;
+            if (output(x, y) != correct) {
+                printf("output(%d, %d) = %d instead of %d\n", x, y, output(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int run(halide_pipeline_instance_t *instance, int size) {
+    Buffer<int> input(size + 1, size);
+    input.for_each_element([&](int x, int y) {
+        input(x, y) = x + y;
+    });
+    Buffer<int> output(size, size);
+    int result = pipeline_instance(instance, input, output);
+    if (result != 0) {
+        printf("pipeline_instance returned %d\n", result);
+        return -1;
+    }
+    return check(output);
+}
+
+int main(int argc, char **argv) {
+    halide_set_custom_malloc(&my_halide_malloc);
+    halide_set_custom_free(&my_halide_free);
+
+    {
+        // The first call allocates the intermediates, and later calls
+        // of the same size or smaller reuse them.
+        halide_pipeline_instance_t instance = {0};
+        malloc_count = 0;
+        if (run(&instance, 128) != 0) {
+            return -1;
+        }
+        int first_mallocs = malloc_count;
+        if (first_mallocs == 0) {
+            printf("Expected the first call to allocate its intermediates\n");
+            return -1;
+        }
+        malloc_count = 0;
+        if (run(&instance, 128) != 0 || run(&instance, 64) != 0) {
+            return -1;
+        }
+        if (malloc_count != 0) {
+            printf("There were %d calls to malloc after the first call\n", malloc_count);
+            return -1;
+        }
+
+        // Growing the inputs reallocates them.
+        if (run(&instance, 256) != 0) {
+            return -1;
+        }
+        if (malloc_count == 0) {
+            printf("Expected a larger call to reallocate its intermediates\n");
+            return -1;
+        }
+        halide_pipeline_instance_release(NULL, &instance);
+    }
+
+    {
+        // Query the scratch memory needed, and supply it.
+        halide_pipeline_instance_t instance = {0};
+        instance.query = 1;
+        Buffer<int> input(129, 128);
+        Buffer<int> output(128, 128);
+        output.fill(0);
+        extern_calls = 0;
+        if (pipeline_instance(&instance, input, output) != 0) {
+            printf("Query call failed\n");
+            return -1;
+        }
+        if (extern_calls != 0) {
+            printf("A query call should not run extern stages\n");
+            return -1;
+        }
+        if (instance.query != 1 || instance.scratch != nullptr || instance._private != nullptr) {
+            printf("A query call should only fill in the required scratch size\n");
+            return -1;
+        }
+        if (instance.required_scratch_size < 3 * 128 * 128 * sizeof(int)) {
+            printf("Scratch size %d is too small\n", (int)instance.required_scratch_size);
+            return -1;
+        }
+        if (output(0, 0) != 0) {
+            printf("A query call should not compute anything\n");
+            return -1;
+        }
+
+        void *scratch = my_halide_malloc(NULL, instance.required_scratch_size);
+        instance.query = 0;
+        instance.scratch = scratch;
+        instance.scratch_size = instance.required_scratch_size;
+
+        // The only memory left to allocate is the bookkeeping of the
+        // instance itself.
+        largest_malloc = 0;
+        if (run(&instance, 128) != 0) {
+            return -1;
+        }
+        if (largest_malloc >= 1024) {
+            printf("There was a %d byte allocation with scratch memory supplied\n", (int)largest_malloc);
+            return -1;
+        }
+        malloc_count = 0;
+        if (run(&instance, 128) != 0) {
+            return -1;
+        }
+        if (malloc_count != 0) {
+            printf("There were %d calls to malloc after the first call\n", malloc_count);
+            return -1;
+        }
+        halide_pipeline_instance_release(NULL, &instance);
+        my_halide_free(NULL, scratch);
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,36 @@
+#include "Halide.h"
+
+namespace {
+
+class PipelineInstance : public Halide::Generator<PipelineInstance> {
+public:
+    ImageParam input{ Int(32), 2, "input" };
+
+    Func build() {
+        Var x, y;
+
+        // Two intermediates computed outside of any loop, too large
+        // for the stack.
+        Func f;
+        f(x, y) = input(x, y) * 2;
+        f.compute_root();
+
+        Func g;
+        g(x, y) = f(x, y) + f(x + 1, y);
+        g.compute_root();
+
+        // An extern stage, which must not run in query mode.
+        Func e;
+        e.define_extern("pipeline_instance_copy", {g}, Int(32), 2);
+        e.compute_root();
+
+        Func h;
+        h(x, y) = e(x, y) + 1;
+
+        return h;
+    }
+};
+
+Halide::RegisterGenerator<PipelineInstance> register_my_gen{"pipeline_instance"};
+
+}  // namespace
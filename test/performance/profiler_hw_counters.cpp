@@ -0,0 +1,96 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace Halide;
+
+bool saw_counters = false;
+int percentage = 0;
+float ipc = 0;
+void my_print(void *, const char *msg) {
+    float this_ms, this_ipc;
+    int this_percentage;
+    if (strstr(msg, "IPC:")) {
+        saw_counters = true;
+    }
+    // The memory columns may come between the percentage and the
+    // ipc, so parse the ipc separately.
+    const char *line = strstr(msg, "fn13:");
+    if (!line) {
+        return;
+    }
+    if (sscanf(line, "fn13: %fms (%d%%)", &this_ms, &this_percentage) == 2) {
+        percentage = this_percentage;
+    }
+    const char *end = strchr(line, '\n');
+    const char *ipc_field = strstr(line, "ipc: ");
+    if (ipc_field && (!end || ipc_field < end) &&
+        sscanf(ipc_field, "ipc: %f", &this_ipc) == 1) {
+        ipc = this_ipc;
+    }
+}
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (t.os != Target::Linux || t.arch != Target::X86) {
+        printf("Hardware performance counters are only supported on x86 Linux. Skipping test.\n");
+        return 0;
+    }
+
+    // The same chain of finely-interleaved Funcs as the profiler
+    // test, of which one is very expensive.
+    Func f[30];
+    Var c, x;
+    for (int i = 0; i < 30; i++) {
+        f[i] = Func("fn" + std::to_string(i));
+        if (i == 0) {
+            f[i](c, x) = cast<float>(x + c);
+        } else if (i == 13) {
+            Expr e = f[i-1](c, x);
+            for (int j = 0; j < 200; j++) {
+                e = sin(e);
+            }
+            f[i](c, x) = e;
+        } else {
+            f[i](c, x) = f[i-1](c, x)*2.0f;
+        }
+    }
+
+    Func out;
+    out(c, x) = 0.0f;
+    const int iters = 100;
+    RDom r(0, iters);
+    out(c, x) += r*f[29](c, x);
+
+    out.set_custom_print(&my_print);
+    out.compute_root();
+    out.update().reorder(c, x, r);
+    for (int i = 0; i < 30; i++) {
+        f[i].compute_at(out, x);
+    }
+
+    Buffer<float> im = out.realize(10, 1000, t.with_feature(Target::ProfileHWCounters));
+
+    if (!saw_counters) {
+        // e.g. running in a container, or perf_event_paranoid is too strict.
+        printf("Hardware performance counters unavailable. Skipping test.\n");
+        return 0;
+    }
+
+    printf("IPC in fn13: %f\n", ipc);
+
+    if (ipc <= 0) {
+        printf("No instructions were attributed to fn13\n");
+        return -1;
+    }
+
+    if (percentage < 40) {
+        printf("Percentage of runtime spent in f13: %d\n"
+               "This is suspiciously low. It should be more like 66%%\n",
+               percentage);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}